@@ -10,14 +10,27 @@
 
 #include "map.h"
 #include "arrayseq.h"
-
-template <typename K, typename V>
+#include "nodepool.h"
+#include "treeiterator.h"
+#include "frozentreemap.h"
+#include <functional>
+#include <iostream>
+#include <thread>
+
+// A is the node allocation policy (see nodepool.h)
+template <typename K, typename V, typename A = HeapAllocator>
 class AVLMap : public Map<K, V>
 {
+  // tree node (defined below)
+  struct Node;
+
 public:
   // default constructor
   AVLMap();
 
+  // constructs a map holding the given key-value pairs (see assign)
+  AVLMap(const ArraySeq<K> &keys, const ArraySeq<V> &values);
+
   // copy constructor
   AVLMap(const AVLMap &rhs);
 
@@ -60,6 +73,18 @@ public:
   // Returns true if the key is in the collection, and false otherwise.
   bool contains(const K &key) const;
 
+  // Heterogeneous versions of operator[], erase, and contains: take
+  // any Q the keys compare with (see is_lookup_key in map.h), such as
+  // a std::string_view for std::string keys, without building a K
+  template <typename Q, typename = lookup_key_t<K, Q>>
+  V &operator[](const Q &key);
+  template <typename Q, typename = lookup_key_t<K, Q>>
+  const V &operator[](const Q &key) const;
+  template <typename Q, typename = lookup_key_t<K, Q>>
+  void erase(const Q &key);
+  template <typename Q, typename = lookup_key_t<K, Q>>
+  bool contains(const Q &key) const;
+
   // Returns the keys k in the collection such that k1 <= k <= k2
   ArraySeq<K> find_keys(const K &k1, const K &k2) const;
 
@@ -79,9 +104,110 @@ public:
   // Removes all key-value pairs from the map.
   void clear();
 
+  // Replaces the contents of the map with the given key-value pairs
+  // (keys[i] maps to values[i]), keeping the first pair of a repeated
+  // key. Builds a perfectly balanced tree straight from the sorted
+  // pairs: O(n) if the keys are already in ascending order, and
+  // O(n log n) otherwise. Throws out_of_range if keys and values
+  // differ in size.
+  void assign(const ArraySeq<K> &keys, const ArraySeq<V> &values);
+
   // Returns the height of the binary search tree
   int height() const;
 
+  // In-order iterators (see treeiterator.h): *it gives the key and a
+  // reference to its value, and each step follows parent links
+  // instead of searching from the root. Inserts keep iterators valid;
+  // an erase may invalidate any of them.
+  typedef TreeIterator<Node, K, V, false> iterator;
+  typedef TreeIterator<Node, K, V, true> const_iterator;
+
+  // Returns an iterator at the smallest key
+  iterator begin();
+  const_iterator begin() const;
+
+  // Returns the iterator one past the largest key
+  iterator end();
+  const_iterator end() const;
+
+  // Returns an iterator at the first key not less than the given key,
+  // or end if there is none
+  iterator lower_bound(const K &key);
+  const_iterator lower_bound(const K &key) const;
+
+  // Returns an iterator at the first key greater than the given key,
+  // or end if there is none
+  iterator upper_bound(const K &key);
+  const_iterator upper_bound(const K &key) const;
+
+  // Returns the number of keys in the collection less than the given
+  // key (its index in sorted order if it is in the collection).
+  // O(log n) using the subtree sizes.
+  int rank(const K &key) const;
+
+  // Returns the i-th smallest key (the key of rank i, counting from
+  // 0), so select(size() / 2) is the median. Throws out_of_range if i
+  // is not in [0, size()). O(log n).
+  const K &select(int i) const;
+
+  // Returns the number of keys k in the collection such that
+  // k1 <= k <= k2 without listing them (see find_keys). O(log n).
+  int count_range(const K &k1, const K &k2) const;
+
+  // Join-based bulk operations: each works on whole subtrees (cutting
+  // a tree at a key, or joining two trees and a key between them back
+  // into one balanced tree) rather than key by key, so combining this
+  // map with an m-key one costs O(m log(n/m + 1)) instead of
+  // O(m log n). Large operations fork their two halves onto separate
+  // threads (see set_join_threads).
+
+  // Moves the keys not less than the given key into the returned map,
+  // keeping the smaller ones. O(log n) when maps can share nodes
+  // (HeapAllocator); a PoolAllocator map copies the moved pairs into
+  // the new map's pool.
+  AVLMap split(const K &key);
+
+  // Moves every pair of rhs into this map, leaving rhs empty. Throws
+  // out_of_range unless all of rhs's keys are greater than all of this
+  // map's keys. O(log n) (a PoolAllocator map also takes over rhs's
+  // slabs).
+  void join(AVLMap &&rhs);
+
+  // Same as join(rhs), with the given pair placed between the two
+  // maps' keys. Throws out_of_range unless the key is greater than
+  // this map's keys and less than rhs's keys.
+  void join(const K &key, const V &value, AVLMap &&rhs);
+
+  // Adds the pairs of rhs to the map. A key in both maps takes rhs's
+  // value.
+  void union_with(const AVLMap &rhs);
+
+  // Removes the keys that are not in rhs (the remaining keys keep this
+  // map's values)
+  void intersect_with(const AVLMap &rhs);
+
+  // Removes the keys that are in rhs
+  void difference_with(const AVLMap &rhs);
+
+  // Sets the number of threads a bulk operation is split across. The
+  // two halves of an operation go to separate threads, each with half
+  // of the threads, until the threads run out; halves that cover fewer
+  // than PARALLEL_JOIN_MIN keys stay on one thread. Each half works on
+  // its own subtrees, so no locks are needed. Throws out_of_range
+  // unless threads >= 1.
+  void set_join_threads(int threads);
+
+  // Returns the number of threads a bulk operation is split across
+  int join_threads() const;
+
+  // smallest operation (keys in both trees) split across threads
+  static const int PARALLEL_JOIN_MIN = 1 << 14;
+
+  // Returns a read-only copy of the map laid out for searching, with
+  // no pointers (see frozentreemap.h). Later changes to this map do
+  // not show up in the copy. O(n).
+  FrozenTreeMap<K, V> freeze() const;
+
   // helper to print the tree for debugging
   void print() const;
 
@@ -92,27 +218,59 @@ private:
     K key;
     V value;
     int height;
+    int size; // number of keys in the subtree rooted here
     Node *left;
     Node *right;
+    Node *parent;
   };
 
+  // node allocator
+  typedef typename A::template Pool<Node> NodePool;
+  NodePool pool;
+
   // number of key-value pairs in map
   int count = 0;
 
   // array of linked lists
   Node *root = nullptr;
 
+  // threads a bulk operation is split across
+  int join_workers = 1;
+
+  // subtrees given up by a bulk operation, chained through their
+  // roots' parent links and destroyed once the operation is done
+  struct Dropped
+  {
+    Node *head = nullptr;
+    Node *tail = nullptr;
+  };
+
   // clean up the tree and reset count to zero given subtree root
   void clear(Node *st_root);
 
-  // copy assignment helper
-  Node *copy(const Node *rhs_st_root) const;
+  // copy assignment helper (the second form takes the nodes from the
+  // given pool)
+  Node *copy(const Node *rhs_st_root);
+  Node *copy(const Node *rhs_st_root, NodePool &nodes);
+
+  // assign helper: builds a balanced subtree from the pairs
+  // order[first] to order[last]
+  Node *build(const ArraySeq<K> &keys, const ArraySeq<V> &values, const ArraySeq<int> &order,
+              int first, int last);
 
-  // insert helper
-  Node *insert(const K &key, const V &value, Node *st_root);
+  // returns the node holding the key, or nullptr if it is not in the
+  // map
+  template <typename Q>
+  Node *find_node(const Q &key) const;
 
-  // erase helper
-  Node *erase(const K &key, Node *st_root);
+  // unlinks and frees a node (a node with two children takes its
+  // successor's pair and the successor is unlinked instead), then
+  // retraces from the unlinked node's parent
+  void remove_node(Node *node);
+
+  // points the link that held old_child (the parent's left or right,
+  // or the root if parent is nullptr) at new_child
+  void replace_child(Node *parent, Node *old_child, Node *new_child);
 
   // find_keys helper
   void find_keys(const K &k1, const K &k2, const Node *st_root, ArraySeq<K> &keys) const;
@@ -120,25 +278,114 @@ private:
   // sorted_keys helper
   void sorted_keys(const Node *st_root, ArraySeq<K> &keys) const;
 
-  // rotations
+  // node of the smallest key (nullptr if empty)
+  Node *leftmost() const;
+
+  // node of the first key not less than the key (greater than it, if
+  // strict), or nullptr if there is none
+  Node *bound(const K &key, bool strict) const;
+
+  // number of keys in a (possibly empty) subtree
+  static int subtree_size(const Node *st_root);
+
+  // number of keys less than the key (or not greater, if inclusive)
+  int count_below(const K &key, bool inclusive) const;
+
+  // recompute a node's subtree size from its children
+  void update_size(Node *st_root);
+
+  // height of a (possibly empty) subtree
+  static int subtree_height(const Node *st_root);
+
+  // recompute a node's height from its children
+  void update_height(Node *st_root);
+
+  // rotations: each returns the new subtree root, which keeps k2's
+  // parent pointer but is not linked into k2's place (the caller does
+  // that, so the bulk operations can rotate detached subtrees)
   Node *rotate_right(Node *k2);
   Node *rotate_left(Node *k2);
 
-  // rebalance
+  // updates the node's height and rotates it if its subtrees differ
+  // in height by more than one, returning the subtree's new root
   Node *rebalance(Node *st_root);
 
+  // walks up from the node after an insert or erase below it,
+  // rebalancing each node until a subtree's height comes out the same
+  // as before (nothing above it can change)
+  void retrace(Node *st_root);
+
+  // node of the largest key (nullptr if empty)
+  Node *rightmost() const;
+
+  // The bulk operation helpers work on detached subtrees: a subtree
+  // root's parent pointer is ignored, and every subtree they return
+  // is balanced with its heights and sizes up to date.
+
+  // makes middle the root over left and right
+  Node *link(Node *left, Node *middle, Node *right);
+
+  // joins two subtrees and a middle node whose key falls between
+  // theirs. join_right walks down the right spine of a left subtree
+  // more than one taller than right (join_left is the mirror image).
+  Node *join(Node *left, Node *middle, Node *right);
+  Node *join_right(Node *left, Node *middle, Node *right);
+  Node *join_left(Node *left, Node *middle, Node *right);
+
+  // joins two subtrees with no middle node (left's largest key moves
+  // up to become it)
+  Node *join2(Node *left, Node *right);
+
+  // takes the node of the largest key out of a nonempty subtree into
+  // last, returning the rest
+  Node *split_last(Node *st_root, Node *&last);
+
+  // splits a subtree into the keys less than and greater than the key.
+  // found gets the key's node (with no children) or nullptr.
+  void split(Node *st_root, const K &key, Node *&less, Node *&found, Node *&greater);
+
+  // union_with, intersect_with, and difference_with on subtrees (t2
+  // is only read). union_of updates t1's nodes of t2's keys in place
+  // and takes nodes for t2's other keys from nodes; the others add
+  // the nodes they leave out of the result to dropped.
+  Node *union_of(Node *t1, const Node *t2, NodePool &nodes, int threads);
+  Node *intersection_of(Node *t1, const Node *t2, Dropped &dropped, int threads);
+  Node *difference_of(Node *t1, const Node *t2, Dropped &dropped, int threads);
+
+  // runs first and second, second on its own thread if there are
+  // threads to spare and work (the keys involved) is large enough.
+  // Each is passed its share of the threads, a dropped list, and a
+  // pool to take new nodes from. A second run on its own thread gets
+  // its own pool (pools are not shared between threads), which is
+  // merged into nodes afterwards.
+  template <typename F, typename G>
+  static void fork(int threads, int work, Dropped &dropped, NodePool &nodes, F first, G second);
+
+  // below this many rhs keys per key of the map, union_with adds
+  // rhs's pairs one at a time instead (a descent per key is cheaper
+  // than splitting and joining around each one)
+  static const int UNION_INSERT_RATIO = 16;
+
+  // adds a subtree to a dropped list, or one dropped list to another
+  static void drop(Dropped &dropped, Node *st_root);
+  static void append(Dropped &dropped, const Dropped &more);
+
+  // makes new_root the tree, destroys the dropped subtrees, and
+  // recounts the map
+  void finish(Node *new_root, Dropped &dropped);
+
   // print helper
   void print(std::string indent, const Node *st_root) const;
 };
 
-template <typename K, typename V>
-void AVLMap<K, V>::print() const
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::print() const
 {
   print(std::string(""), root);
 }
 
-template <typename K, typename V>
-void AVLMap<K, V>::print(std::string indent, const Node *st_root) const
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::print(std::string indent, const Node *st_root) const
 {
   if (!st_root)
     return;
@@ -155,9 +402,16 @@ void AVLMap<K, V>::print(std::string indent, const Node *st_root) const
   }
 }
 
-template <typename K, typename V>
-AVLMap<K, V>::AVLMap()
+template <typename K, typename V, typename A>
+AVLMap<K, V, A>::AVLMap()
+{
+}
+
+// constructs a map holding the given key-value pairs
+template <typename K, typename V, typename A>
+AVLMap<K, V, A>::AVLMap(const ArraySeq<K> &keys, const ArraySeq<V> &values)
 {
+  assign(keys, values);
 }
 
 // TODO: Finish the remaining functions below. Many of the functions
@@ -168,41 +422,44 @@ AVLMap<K, V>::AVLMap()
 //   typename AVLMap<K,V>::Node* AVLMap<K,V>::rotate_right(Node* k2)
 
 // copy constructor
-template <typename K, typename V>
-AVLMap<K, V>::AVLMap(const AVLMap &rhs)
+template <typename K, typename V, typename A>
+AVLMap<K, V, A>::AVLMap(const AVLMap &rhs)
 {
   *this = rhs;
 }
 
 // move constructor
-template <typename K, typename V>
-AVLMap<K, V>::AVLMap(AVLMap &&rhs)
+template <typename K, typename V, typename A>
+AVLMap<K, V, A>::AVLMap(AVLMap &&rhs)
 {
   *this = std::move(rhs);
 }
 
 // copy assignment
-template <typename K, typename V>
-AVLMap<K, V> &AVLMap<K, V>::operator=(const AVLMap &rhs)
+template <typename K, typename V, typename A>
+AVLMap<K, V, A> &AVLMap<K, V, A>::operator=(const AVLMap &rhs)
 {
   if (this != &rhs)
   {
     clear();
     root = copy(rhs.root);
     count = rhs.count;
+    join_workers = rhs.join_workers;
   }
   return *this;
 }
 
 // move assignment
-template <typename K, typename V>
-AVLMap<K, V> &AVLMap<K, V>::operator=(AVLMap &&rhs)
+template <typename K, typename V, typename A>
+AVLMap<K, V, A> &AVLMap<K, V, A>::operator=(AVLMap &&rhs)
 {
   if (this != &rhs)
   {
     clear();
+    pool.swap(rhs.pool);
     root = rhs.root;
     count = rhs.count;
+    join_workers = rhs.join_workers;
 
     rhs.root = nullptr;
     rhs.count = 0;
@@ -211,22 +468,22 @@ AVLMap<K, V> &AVLMap<K, V>::operator=(AVLMap &&rhs)
 }
 
 // destructor
-template <typename K, typename V>
-AVLMap<K, V>::~AVLMap()
+template <typename K, typename V, typename A>
+AVLMap<K, V, A>::~AVLMap()
 {
   clear();
 }
 
 // Returns the number of key-value pairs in the map
-template <typename K, typename V>
-int AVLMap<K, V>::size() const
+template <typename K, typename V, typename A>
+int AVLMap<K, V, A>::size() const
 {
   return count;
 }
 
 // Tests if the map is empty
-template <typename K, typename V>
-bool AVLMap<K, V>::empty() const
+template <typename K, typename V, typename A>
+bool AVLMap<K, V, A>::empty() const
 {
   if (root == nullptr)
   {
@@ -237,107 +494,155 @@ bool AVLMap<K, V>::empty() const
 
 // Allows values associated with a key to be updated. Throws
 // out_of_range if the given key is not in the collection.
-template <typename K, typename V>
-V &AVLMap<K, V>::operator[](const K &key)
+template <typename K, typename V, typename A>
+V &AVLMap<K, V, A>::operator[](const K &key)
 {
-  Node *traverse = root;
-  while (traverse != nullptr)
+  Node *node = find_node(key);
+  if (node == nullptr)
   {
-    if (key == traverse->key)
-    {
-      return traverse->value;
-    }
-    else if (key > traverse->key)
-    {
-      traverse = traverse->right;
-    }
-    else
-    {
-      traverse = traverse->left;
-    }
+    throw std::out_of_range("Key is not in the collection");
   }
-  throw std::out_of_range("Key is not in the collection");
+  return node->value;
 }
 
 // Returns the value for a given key. Throws out_of_range if the
 // given key is not in the collection.
-template <typename K, typename V>
-const V &AVLMap<K, V>::operator[](const K &key) const
+template <typename K, typename V, typename A>
+const V &AVLMap<K, V, A>::operator[](const K &key) const
+{
+  Node *node = find_node(key);
+  if (node == nullptr)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return node->value;
+}
+
+// Extends the collection by adding the given key-value pair.
+// Expects key to not exist in map prior to insertion.
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::insert(const K &key, const V &value)
 {
+  Node *newLeaf = pool.create();
+  newLeaf->key = key;
+  newLeaf->value = value;
+  newLeaf->height = 1;
+  newLeaf->size = 1;
+  newLeaf->left = nullptr;
+  newLeaf->right = nullptr;
+
+  // one pass down, counting the new key in every subtree on the path
+  Node *parent = nullptr;
   Node *traverse = root;
   while (traverse != nullptr)
   {
-    if (key == traverse->key)
+    traverse->size++;
+    parent = traverse;
+    if (key < traverse->key)
     {
-      return traverse->value;
-    }
-    else if (key > traverse->key)
-    {
-      traverse = traverse->right;
+      traverse = traverse->left;
     }
     else
     {
-      traverse = traverse->left;
+      traverse = traverse->right;
     }
   }
-  throw std::out_of_range("Key is not in the collection");
-}
 
-// Extends the collection by adding the given key-value pair.
-// Expects key to not exist in map prior to insertion.
-template <typename K, typename V>
-void AVLMap<K, V>::insert(const K &key, const V &value)
-{
-  root = insert(key, value, root);
+  newLeaf->parent = parent;
+  if (parent == nullptr)
+  {
+    root = newLeaf;
+  }
+  else if (key < parent->key)
+  {
+    parent->left = newLeaf;
+  }
+  else
+  {
+    parent->right = newLeaf;
+  }
+  count++;
+  retrace(parent);
 }
 
 // Shrinks the collection by removing the key-value pair with the
 // given key. Does not modify the collection if the collection does
 // not contain the key. Throws out_of_range if the given key is not
 // in the collection.
-template <typename K, typename V>
-void AVLMap<K, V>::erase(const K &key)
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::erase(const K &key)
 {
-  if (empty())
+  Node *node = find_node(key);
+  if (node == nullptr)
   {
     throw std::out_of_range("Key is not in the collection");
   }
-  else if (!contains(key))
+  remove_node(node);
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template <typename K, typename V, typename A>
+bool AVLMap<K, V, A>::contains(const K &key) const
+{
+  return find_node(key) != nullptr;
+}
+
+// Allows values associated with a key to be updated, looked up by a
+// value the keys compare with. Throws out_of_range if the key is not
+// in the collection.
+template <typename K, typename V, typename A>
+template <typename Q, typename>
+V &AVLMap<K, V, A>::operator[](const Q &key)
+{
+  Node *node = find_node(key);
+  if (node == nullptr)
   {
     throw std::out_of_range("Key is not in the collection");
   }
-  else
+  return node->value;
+}
+
+// Returns the value for a key, looked up by a value the keys compare
+// with. Throws out_of_range if the key is not in the collection.
+template <typename K, typename V, typename A>
+template <typename Q, typename>
+const V &AVLMap<K, V, A>::operator[](const Q &key) const
+{
+  Node *node = find_node(key);
+  if (node == nullptr)
   {
-    root = erase(key, root);
+    throw std::out_of_range("Key is not in the collection");
   }
+  return node->value;
 }
 
-// Returns true if the key is in the collection, and false otherwise.
-template <typename K, typename V>
-bool AVLMap<K, V>::contains(const K &key) const
+// Removes the key-value pair for a key, looked up by a value the keys
+// compare with. Throws out_of_range if the key is not in the
+// collection.
+template <typename K, typename V, typename A>
+template <typename Q, typename>
+void AVLMap<K, V, A>::erase(const Q &key)
 {
-  Node *traverse = root;
-  while (traverse != nullptr)
+  Node *node = find_node(key);
+  if (node == nullptr)
   {
-    if (key == traverse->key)
-    {
-      return true;
-    }
-    else if (key > traverse->key)
-    {
-      traverse = traverse->right;
-    }
-    else
-    {
-      traverse = traverse->left;
-    }
+    throw std::out_of_range("Key is not in the collection");
   }
-  return false;
+  remove_node(node);
+}
+
+// Returns true if a key the value compares equal to is in the
+// collection, and false otherwise.
+template <typename K, typename V, typename A>
+template <typename Q, typename>
+bool AVLMap<K, V, A>::contains(const Q &key) const
+{
+  return find_node(key) != nullptr;
 }
 
 // Returns the keys k in the collection such that k1 <= k <= k2
-template <typename K, typename V>
-ArraySeq<K> AVLMap<K, V>::find_keys(const K &k1, const K &k2) const
+template <typename K, typename V, typename A>
+ArraySeq<K> AVLMap<K, V, A>::find_keys(const K &k1, const K &k2) const
 {
   ArraySeq<K> keys;
   find_keys(k1, k2, root, keys);
@@ -345,8 +650,8 @@ ArraySeq<K> AVLMap<K, V>::find_keys(const K &k1, const K &k2) const
 }
 
 // Returns the keys in the collection in ascending sorted order
-template <typename K, typename V>
-ArraySeq<K> AVLMap<K, V>::sorted_keys() const
+template <typename K, typename V, typename A>
+ArraySeq<K> AVLMap<K, V, A>::sorted_keys() const
 {
   ArraySeq<K> keys;
   sorted_keys(root, keys);
@@ -356,8 +661,8 @@ ArraySeq<K> AVLMap<K, V>::sorted_keys() const
 // Gives the key (as an ouptput parameter) immediately after the
 // given key according to ascending sort order. Returns true if a
 // successor key exists, and false otherwise.
-template <typename K, typename V>
-bool AVLMap<K, V>::next_key(const K &key, K &next_key) const
+template <typename K, typename V, typename A>
+bool AVLMap<K, V, A>::next_key(const K &key, K &next_key) const
 {
   // No keys exist
   if (empty())
@@ -444,8 +749,8 @@ bool AVLMap<K, V>::next_key(const K &key, K &next_key) const
 // Gives the key (as an ouptput parameter) immediately before the
 // given key according to ascending sort order. Returns true if a
 // predecessor key exists, and false otherwise.
-template <typename K, typename V>
-bool AVLMap<K, V>::prev_key(const K &key, K &prev_key) const
+template <typename K, typename V, typename A>
+bool AVLMap<K, V, A>::prev_key(const K &key, K &prev_key) const
 {
   // No keys exist
   if (empty())
@@ -530,15 +835,36 @@ bool AVLMap<K, V>::prev_key(const K &key, K &prev_key) const
 }
 
 // Removes all key-value pairs from the map.
-template <typename K, typename V>
-void AVLMap<K, V>::clear()
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::clear()
+{
+  // nodes that need no destructor go back with their slabs
+  if (pool.drops_nodes)
+  {
+    count = 0;
+  }
+  else
+  {
+    clear(root);
+  }
+  pool.release();
+  root = nullptr;
+}
+
+// Replaces the contents of the map with the given key-value pairs
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::assign(const ArraySeq<K> &keys, const ArraySeq<V> &values)
 {
-  clear(root);
+  this->check_pairs(keys, values);
+  ArraySeq<int> order = this->sorted_unique(keys);
+  clear();
+  root = build(keys, values, order, 0, order.size() - 1);
+  count = order.size();
 }
 
 // Returns the height of the binary search tree
-template <typename K, typename V>
-int AVLMap<K, V>::height() const
+template <typename K, typename V, typename A>
+int AVLMap<K, V, A>::height() const
 {
   if (empty())
   {
@@ -547,195 +873,455 @@ int AVLMap<K, V>::height() const
   return root->height;
 }
 
-// clean up the tree and reset count to zero given subtree root
-template <typename K, typename V>
-void AVLMap<K, V>::clear(Node *st_root)
+// Returns the number of keys in the collection less than the given key
+template <typename K, typename V, typename A>
+int AVLMap<K, V, A>::rank(const K &key) const
 {
-  count = 0;
-  if (st_root != nullptr)
+  return count_below(key, false);
+}
+
+// Returns the i-th smallest key (counting from 0)
+template <typename K, typename V, typename A>
+const K &AVLMap<K, V, A>::select(int i) const
+{
+  if (i < 0 || i >= count)
   {
-    if (st_root->left == nullptr and st_root->right == nullptr)
+    throw std::out_of_range("Rank is out of range");
+  }
+  Node *traverse = root;
+  while (true)
+  {
+    int left_size = subtree_size(traverse->left);
+    if (i < left_size)
     {
-      delete st_root;
-      st_root = nullptr;
+      traverse = traverse->left;
+    }
+    else if (i == left_size)
+    {
+      return traverse->key;
     }
     else
     {
-      clear(st_root->left);
-      clear(st_root->right);
-      delete st_root;
-      st_root = nullptr;
+      i = i - left_size - 1;
+      traverse = traverse->right;
     }
   }
-  return;
 }
 
-// copy assignment helper
-template <typename K, typename V>
-typename AVLMap<K, V>::Node *AVLMap<K, V>::copy(const Node *rhs_st_root) const
+// Returns the number of keys k in the collection such that k1 <= k <= k2
+template <typename K, typename V, typename A>
+int AVLMap<K, V, A>::count_range(const K &k1, const K &k2) const
 {
-  Node *temp = nullptr;
-  if (rhs_st_root != nullptr)
+  if (k2 < k1)
   {
-    temp = new Node;
-    temp->key = rhs_st_root->key;
-    temp->value = rhs_st_root->value;
-    temp->height = rhs_st_root->height;
-
-    temp->left = copy(rhs_st_root->left);
-    temp->right = copy(rhs_st_root->right);
+    return 0;
   }
-  return temp;
+  return count_below(k2, true) - count_below(k1, false);
 }
 
-// insert helper
-template <typename K, typename V>
-typename AVLMap<K, V>::Node *AVLMap<K, V>::insert(const K &key, const V &value, Node *st_root)
+// Returns an iterator at the smallest key
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::iterator AVLMap<K, V, A>::begin()
 {
-  if (st_root == nullptr)
+  return iterator(&root, leftmost());
+}
+
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::const_iterator AVLMap<K, V, A>::begin() const
+{
+  return const_iterator(&root, leftmost());
+}
+
+// Returns the iterator one past the largest key
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::iterator AVLMap<K, V, A>::end()
+{
+  return iterator(&root, nullptr);
+}
+
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::const_iterator AVLMap<K, V, A>::end() const
+{
+  return const_iterator(&root, nullptr);
+}
+
+// Returns an iterator at the first key not less than the given key
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::iterator AVLMap<K, V, A>::lower_bound(const K &key)
+{
+  return iterator(&root, bound(key, false));
+}
+
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::const_iterator AVLMap<K, V, A>::lower_bound(const K &key) const
+{
+  return const_iterator(&root, bound(key, false));
+}
+
+// Returns an iterator at the first key greater than the given key
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::iterator AVLMap<K, V, A>::upper_bound(const K &key)
+{
+  return iterator(&root, bound(key, true));
+}
+
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::const_iterator AVLMap<K, V, A>::upper_bound(const K &key) const
+{
+  return const_iterator(&root, bound(key, true));
+}
+
+// Moves the keys not less than the given key into the returned map
+template <typename K, typename V, typename A>
+AVLMap<K, V, A> AVLMap<K, V, A>::split(const K &key)
+{
+  Node *less = nullptr;
+  Node *found = nullptr;
+  Node *greater = nullptr;
+  split(root, key, less, found, greater);
+
+  // the key itself goes with the greater keys
+  if (found != nullptr)
   {
-    Node *newLeaf = new Node;
-    newLeaf->key = key;
-    newLeaf->value = value;
-    newLeaf->height = 1;
-    newLeaf->right = nullptr;
-    newLeaf->left = nullptr;
-    st_root = newLeaf;
-    count++;
+    greater = join(nullptr, found, greater);
   }
-  else
+  if (greater != nullptr)
   {
-    if (key < st_root->key)
-    {
-      st_root->left = insert(key, value, st_root->left);
-    }
-    else
-    {
-      st_root->right = insert(key, value, st_root->right);
-    }
+    greater->parent = nullptr;
   }
-  // Adjust height correctly
-  if (st_root->left && !st_root->right)
+
+  AVLMap rest;
+  rest.join_workers = join_workers;
+  if (pool.shares_nodes)
   {
-    st_root->height = st_root->left->height + 1;
+    rest.root = greater;
   }
-  else if (!st_root->left && st_root->right)
+  else
   {
-    st_root->height = st_root->right->height + 1;
+    rest.root = rest.copy(greater);
+    clear(greater);
   }
-  else if (st_root->left && st_root->right)
+  rest.count = subtree_size(rest.root);
+
+  root = less;
+  if (root != nullptr)
   {
-    if (st_root->left->height >= st_root->right->height)
-    {
-      st_root->height = st_root->left->height + 1;
-    }
-    else
-    {
-      st_root->height = st_root->right->height + 1;
-    }
+    root->parent = nullptr;
   }
-  return rebalance(st_root);
+  count = subtree_size(root);
+  return rest;
 }
 
-// erase helper
-template <typename K, typename V>
-typename AVLMap<K, V>::Node *AVLMap<K, V>::erase(const K &key, Node *st_root)
+// Moves every pair of rhs into this map, leaving rhs empty
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::join(AVLMap &&rhs)
 {
-  Node *remove = nullptr;
-  Node *successor = nullptr;
-  Node *traverse = nullptr;
+  if (rhs.root == nullptr)
+  {
+    return;
+  }
+  if (root != nullptr && !(rightmost()->key < rhs.leftmost()->key))
+  {
+    throw std::out_of_range("Joined keys are out of order");
+  }
+  pool.merge(rhs.pool);
+  Node *joined = join2(root, rhs.root);
+  rhs.root = nullptr;
+  rhs.count = 0;
+
+  root = joined;
+  root->parent = nullptr;
+  count = root->size;
+}
 
-  if (key < st_root->key)
+// Moves every pair of rhs into this map, with the given pair between
+// the two maps' keys
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::join(const K &key, const V &value, AVLMap &&rhs)
+{
+  if ((root != nullptr && !(rightmost()->key < key)) || (rhs.root != nullptr && !(key < rhs.leftmost()->key)))
   {
-    st_root->left = erase(key, st_root->left);
+    throw std::out_of_range("Joined keys are out of order");
   }
-  else if (key > st_root->key)
+  Node *middle = pool.create();
+  middle->key = key;
+  middle->value = value;
+  if (this != &rhs)
+  {
+    pool.merge(rhs.pool);
+  }
+  Node *joined = join(root, middle, rhs.root);
+  rhs.root = nullptr;
+  rhs.count = 0;
+
+  root = joined;
+  root->parent = nullptr;
+  count = root->size;
+}
+
+// Adds the pairs of rhs to the map (rhs's values win)
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::union_with(const AVLMap &rhs)
+{
+  if (this == &rhs)
   {
-    st_root->right = erase(key, st_root->right);
+    return;
   }
-  else if (key == st_root->key)
+
+  // a small rhs goes in key by key
+  if (static_cast<long>(rhs.count) * UNION_INSERT_RATIO < count)
   {
-    // Case 1: No children
-    if (st_root->left == nullptr and st_root->right == nullptr)
-    {
-      remove = st_root;
-      st_root = nullptr;
-      delete remove;
-      count--;
-    }
-    // Case 2: One child
-    else if (st_root->left == nullptr or st_root->right == nullptr)
+    for (const_iterator it = rhs.begin(); it != rhs.end(); ++it)
     {
-      // no left
-      if (st_root->left == nullptr)
+      Node *node = find_node(it.key());
+      if (node != nullptr)
       {
-        remove = st_root;
-        st_root = st_root->right;
-        delete remove;
-        count--;
+        node->value = it.value();
       }
-      // no right
       else
       {
-        remove = st_root;
-        st_root = st_root->left;
-        delete remove;
-        count--;
+        insert(it.key(), it.value());
       }
     }
-    // Case 3: 2 Children
+    return;
+  }
+  Dropped dropped;
+  finish(union_of(root, rhs.root, pool, join_workers), dropped);
+}
+
+// Removes the keys that are not in rhs
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::intersect_with(const AVLMap &rhs)
+{
+  if (this == &rhs)
+  {
+    return;
+  }
+  Dropped dropped;
+  finish(intersection_of(root, rhs.root, dropped, join_workers), dropped);
+}
+
+// Removes the keys that are in rhs
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::difference_with(const AVLMap &rhs)
+{
+  if (this == &rhs)
+  {
+    clear();
+    return;
+  }
+  Dropped dropped;
+  finish(difference_of(root, rhs.root, dropped, join_workers), dropped);
+}
+
+// Sets the number of threads a bulk operation is split across
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::set_join_threads(int threads)
+{
+  if (threads < 1)
+  {
+    throw std::out_of_range("Join needs at least one thread");
+  }
+  join_workers = threads;
+}
+
+// Returns the number of threads a bulk operation is split across
+template <typename K, typename V, typename A>
+int AVLMap<K, V, A>::join_threads() const
+{
+  return join_workers;
+}
+
+// Returns a read-only copy of the map laid out for searching: the
+// in-order walk hands the pairs over already sorted
+template <typename K, typename V, typename A>
+FrozenTreeMap<K, V> AVLMap<K, V, A>::freeze() const
+{
+  K *keys = new K[count];
+  V *values = new V[count];
+  int i = 0;
+  for (const_iterator it = begin(); it != end(); ++it)
+  {
+    keys[i] = it.key();
+    values[i] = it.value();
+    i++;
+  }
+  FrozenTreeMap<K, V> frozen(keys, values, count);
+  delete[] keys;
+  delete[] values;
+  return frozen;
+}
+
+// clean up the tree and reset count to zero given subtree root
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::clear(Node *st_root)
+{
+  count = 0;
+  if (st_root != nullptr)
+  {
+    if (st_root->left == nullptr and st_root->right == nullptr)
+    {
+      pool.destroy(st_root);
+      st_root = nullptr;
+    }
     else
     {
-      // Find inorder successor
-      traverse = st_root->right;
-      while (traverse != nullptr)
-      {
-        successor = traverse;
-        traverse = traverse->left;
-      }
+      clear(st_root->left);
+      clear(st_root->right);
+      pool.destroy(st_root);
+      st_root = nullptr;
+    }
+  }
+  return;
+}
+
+// copy assignment helper
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::copy(const Node *rhs_st_root)
+{
+  return copy(rhs_st_root, pool);
+}
 
-      // copy key and value
-      st_root->key = successor->key;
-      st_root->value = successor->value;
+// copies a subtree with nodes from the given pool
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::copy(const Node *rhs_st_root, NodePool &nodes)
+{
+  Node *temp = nullptr;
+  if (rhs_st_root != nullptr)
+  {
+    temp = nodes.create();
+    temp->key = rhs_st_root->key;
+    temp->value = rhs_st_root->value;
+    temp->height = rhs_st_root->height;
+    temp->size = rhs_st_root->size;
 
-      // delete and replace successor node
-      st_root->right = erase(successor->key, st_root->right);
+    temp->parent = nullptr;
+    temp->left = copy(rhs_st_root->left, nodes);
+    temp->right = copy(rhs_st_root->right, nodes);
+    if (temp->left != nullptr)
+    {
+      temp->left->parent = temp;
     }
+    if (temp->right != nullptr)
+    {
+      temp->right->parent = temp;
+    }
+  }
+  return temp;
+}
+
+// assign helper: the middle pair becomes the subtree root
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::build(const ArraySeq<K> &keys, const ArraySeq<V> &values,
+                                                       const ArraySeq<int> &order, int first, int last)
+{
+  if (first > last)
+  {
+    return nullptr;
   }
+  int mid = first + (last - first) / 2;
+  Node *temp = pool.create();
+  temp->key = keys[order[mid]];
+  temp->value = values[order[mid]];
+  temp->parent = nullptr;
+  temp->left = build(keys, values, order, first, mid - 1);
+  temp->right = build(keys, values, order, mid + 1, last);
+  if (temp->left != nullptr)
+  {
+    temp->left->parent = temp;
+  }
+  if (temp->right != nullptr)
+  {
+    temp->right->parent = temp;
+  }
+  int left_height = temp->left == nullptr ? 0 : temp->left->height;
+  int right_height = temp->right == nullptr ? 0 : temp->right->height;
+  temp->height = 1 + (left_height > right_height ? left_height : right_height);
+  update_size(temp);
+  return temp;
+}
 
-  // Adjust height correctly
-  if (st_root)
+// returns the node holding the key, or nullptr if it is not in the map
+template <typename K, typename V, typename A>
+template <typename Q>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::find_node(const Q &key) const
+{
+  Node *traverse = root;
+  while (traverse != nullptr)
   {
-    if (st_root->left && !st_root->right)
+    if (key == traverse->key)
     {
-      st_root->height = st_root->left->height + 1;
+      return traverse;
     }
-    else if (!st_root->left && st_root->right)
+    else if (key > traverse->key)
     {
-      st_root->height = st_root->right->height + 1;
+      traverse = traverse->right;
     }
-    else if (st_root->left && st_root->right)
+    else
     {
-      if (st_root->left->height >= st_root->right->height)
-      {
-        st_root->height = st_root->left->height + 1;
-      }
-      else
-      {
-        st_root->height = st_root->right->height + 1;
-      }
+      traverse = traverse->left;
     }
-    else // leaf node
+  }
+  return nullptr;
+}
+
+// unlinks and frees a node, then retraces from its parent
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::remove_node(Node *node)
+{
+  // a node with two children takes its successor's pair, and the
+  // successor (which has no left child) is unlinked instead
+  if (node->left != nullptr && node->right != nullptr)
+  {
+    Node *successor = node->right;
+    while (successor->left != nullptr)
     {
-      st_root->height = 1;
+      successor = successor->left;
     }
+    node->key = std::move(successor->key);
+    node->value = std::move(successor->value);
+    node = successor;
+  }
+
+  Node *child = node->left != nullptr ? node->left : node->right;
+  Node *parent = node->parent;
+  if (child != nullptr)
+  {
+    child->parent = parent;
+  }
+  replace_child(parent, node, child);
+  pool.destroy(node);
+  count--;
+
+  // every subtree above loses the key
+  for (Node *traverse = parent; traverse != nullptr; traverse = traverse->parent)
+  {
+    traverse->size--;
+  }
+  retrace(parent);
+}
+
+// points the link that held old_child at new_child
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::replace_child(Node *parent, Node *old_child, Node *new_child)
+{
+  if (parent == nullptr)
+  {
+    root = new_child;
+  }
+  else if (parent->left == old_child)
+  {
+    parent->left = new_child;
+  }
+  else
+  {
+    parent->right = new_child;
   }
-  return rebalance(st_root);
 }
 
 // find_keys helper
-template <typename K, typename V>
-void AVLMap<K, V>::find_keys(const K &k1, const K &k2, const Node *st_root, ArraySeq<K> &keys) const
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::find_keys(const K &k1, const K &k2, const Node *st_root, ArraySeq<K> &keys) const
 {
   if (st_root == nullptr)
   {
@@ -758,8 +1344,8 @@ void AVLMap<K, V>::find_keys(const K &k1, const K &k2, const Node *st_root, Arra
 }
 
 // sorted_keys helper
-template <typename K, typename V>
-void AVLMap<K, V>::sorted_keys(const Node *st_root, ArraySeq<K> &keys) const
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::sorted_keys(const Node *st_root, ArraySeq<K> &keys) const
 {
   if (st_root == nullptr)
   {
@@ -770,130 +1356,533 @@ void AVLMap<K, V>::sorted_keys(const Node *st_root, ArraySeq<K> &keys) const
   sorted_keys(st_root->right, keys);
 }
 
-// rotations
-template <typename K, typename V>
-typename AVLMap<K, V>::Node *AVLMap<K, V>::rotate_right(Node *k2)
+// node of the smallest key (nullptr if empty)
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::leftmost() const
+{
+  Node *traverse = root;
+  while (traverse != nullptr && traverse->left != nullptr)
+  {
+    traverse = traverse->left;
+  }
+  return traverse;
+}
+
+// node of the first key not less than the key (greater than it, if
+// strict): the last node the search turned left at
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::bound(const K &key, bool strict) const
+{
+  Node *found = nullptr;
+  Node *traverse = root;
+  while (traverse != nullptr)
+  {
+    if (key < traverse->key || (!strict && key == traverse->key))
+    {
+      found = traverse;
+      traverse = traverse->left;
+    }
+    else
+    {
+      traverse = traverse->right;
+    }
+  }
+  return found;
+}
+
+// number of keys in a (possibly empty) subtree
+template <typename K, typename V, typename A>
+int AVLMap<K, V, A>::subtree_size(const Node *st_root)
+{
+  if (st_root == nullptr)
+  {
+    return 0;
+  }
+  return st_root->size;
+}
+
+// number of keys less than the key (or not greater, if inclusive):
+// every left subtree passed on the way down is counted whole
+template <typename K, typename V, typename A>
+int AVLMap<K, V, A>::count_below(const K &key, bool inclusive) const
+{
+  int below = 0;
+  Node *traverse = root;
+  while (traverse != nullptr)
+  {
+    if (traverse->key < key || (inclusive && traverse->key == key))
+    {
+      below = below + subtree_size(traverse->left) + 1;
+      traverse = traverse->right;
+    }
+    else
+    {
+      traverse = traverse->left;
+    }
+  }
+  return below;
+}
+
+// recompute a node's subtree size from its children
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::update_size(Node *st_root)
+{
+  st_root->size = 1 + subtree_size(st_root->left) + subtree_size(st_root->right);
+}
+
+// height of a (possibly empty) subtree
+template <typename K, typename V, typename A>
+int AVLMap<K, V, A>::subtree_height(const Node *st_root)
+{
+  if (st_root == nullptr)
+  {
+    return 0;
+  }
+  return st_root->height;
+}
+
+// recompute a node's height from its children
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::update_height(Node *st_root)
+{
+  int left_height = subtree_height(st_root->left);
+  int right_height = subtree_height(st_root->right);
+  st_root->height = 1 + (left_height > right_height ? left_height : right_height);
+}
+
+// rotations (the caller relinks the returned node into k2's place)
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::rotate_right(Node *k2)
 {
   Node *k1 = k2->left;
   k2->left = k1->right;
-  if (k1->right && k1->left && k1->left->height == k1->right->height)
+  if (k2->left != nullptr)
   {
-    k1->height += 1;
+    k2->left->parent = k2;
   }
   k1->right = k2;
+  k1->parent = k2->parent;
+  k2->parent = k1;
+  update_height(k2);
+  update_size(k2);
+  update_height(k1);
+  update_size(k1);
   return k1;
 }
 
-template <typename K, typename V>
-typename AVLMap<K, V>::Node *AVLMap<K, V>::rotate_left(Node *k2)
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::rotate_left(Node *k2)
 {
   Node *k1 = k2->right;
   k2->right = k1->left;
-  if (k1->right && k1->left && k1->left->height == k1->right->height)
+  if (k2->right != nullptr)
   {
-    k1->height += 1;
+    k2->right->parent = k2;
   }
   k1->left = k2;
+  k1->parent = k2->parent;
+  k2->parent = k1;
+  update_height(k2);
+  update_size(k2);
+  update_height(k1);
+  update_size(k1);
   return k1;
 }
 
-// rebalance
-template <typename K, typename V>
-typename AVLMap<K, V>::Node *AVLMap<K, V>::rebalance(Node *st_root)
+// rebalance: a left-heavy node whose left child leans right needs a
+// double rotation (left at the child, then right), and the mirror
+// image on the right
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::rebalance(Node *st_root)
 {
-  if (st_root == nullptr)
-  {
-    return st_root;
-  }
-
-  Node *l_ptr = st_root->left;
-  Node *r_ptr = st_root->right;
+  update_height(st_root);
+  int bf = subtree_height(st_root->left) - subtree_height(st_root->right);
+  Node *top = st_root;
 
-  int bf = 0;
-  // left, no right
-  if (l_ptr && !r_ptr && l_ptr->height > 1)
+  // left heavy
+  if (bf > 1)
   {
-    // right, no left
-    if (l_ptr->right && !l_ptr->left && l_ptr->right->height > 1)
+    if (subtree_height(st_root->left->left) < subtree_height(st_root->left->right))
     {
-      l_ptr = rotate_left(l_ptr);
-      l_ptr->left->height = l_ptr->height - 1;
+      st_root->left = rotate_left(st_root->left);
     }
-    // left and right
-    else if (l_ptr->right && l_ptr->left)
+    top = rotate_right(st_root);
+  }
+  // right heavy
+  else if (bf < -1)
+  {
+    if (subtree_height(st_root->right->right) < subtree_height(st_root->right->left))
     {
-      bf = l_ptr->left->height - l_ptr->right->height;
-      if (bf < -1)
-      {
-        l_ptr = rotate_left(l_ptr);
-        l_ptr->left->height = l_ptr->height - 1;
-      }
+      st_root->right = rotate_right(st_root->right);
     }
-    // left, no right (left-left)
-    st_root = rotate_right(st_root);
-    st_root->right->height = st_root->height - 1;
+    top = rotate_left(st_root);
   }
-  // right, no left
-  else if (r_ptr && !l_ptr && r_ptr->height > 1)
+  if (top != st_root)
   {
-    // left, no right
-    if (r_ptr->left && !r_ptr->right && r_ptr->left->height > 1)
+    replace_child(top->parent, st_root, top);
+  }
+  return top;
+}
+
+// walks up from the node, rebalancing until a subtree's height is
+// unchanged
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::retrace(Node *st_root)
+{
+  while (st_root != nullptr)
+  {
+    int old_height = st_root->height;
+    st_root = rebalance(st_root);
+    if (st_root->height == old_height)
     {
-      r_ptr = rotate_right(r_ptr);
-      r_ptr->right->height = r_ptr->height - 1;
+      return;
     }
-    // left and right
-    else if (r_ptr->left && r_ptr->right)
-    {
-      bf = r_ptr->left->height - r_ptr->right->height;
-      if (bf > 1)
-      {
-        r_ptr = rotate_right(r_ptr);
-        r_ptr->right->height = r_ptr->height - 1;
-      }
-    }
-    // right, no left (right-right)
-    st_root = rotate_left(st_root);
-    st_root->left->height = st_root->height - 1;
+    st_root = st_root->parent;
+  }
+}
+
+// node of the largest key (nullptr if empty)
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::rightmost() const
+{
+  Node *traverse = root;
+  while (traverse != nullptr && traverse->right != nullptr)
+  {
+    traverse = traverse->right;
   }
-  // left and right
-  else if (l_ptr != nullptr && r_ptr != nullptr)
+  return traverse;
+}
+
+// makes middle the root over left and right
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::link(Node *left, Node *middle, Node *right)
+{
+  middle->left = left;
+  middle->right = right;
+  if (left != nullptr)
+  {
+    left->parent = middle;
+  }
+  if (right != nullptr)
   {
-    bf = l_ptr->height - r_ptr->height;
-    // left heavy
-    if (bf > 1)
+    right->parent = middle;
+  }
+  update_height(middle);
+  update_size(middle);
+  return middle;
+}
+
+// joins two subtrees and a middle node: subtrees within one of each
+// other's height hang straight off the middle node, and otherwise the
+// middle node goes down the taller one's inner spine
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::join(Node *left, Node *middle, Node *right)
+{
+  if (subtree_height(left) > subtree_height(right) + 1)
+  {
+    return join_right(left, middle, right);
+  }
+  if (subtree_height(right) > subtree_height(left) + 1)
+  {
+    return join_left(left, middle, right);
+  }
+  return link(left, middle, right);
+}
+
+// join of a left subtree more than one taller than right: goes down
+// left's right spine to a subtree no more than one taller than right,
+// joins there, and rotates on the way back up where the join made a
+// node two taller on the right
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::join_right(Node *left, Node *middle, Node *right)
+{
+  Node *outer = left->left;
+  Node *inner = left->right;
+  if (subtree_height(inner) <= subtree_height(right) + 1)
+  {
+    Node *joined = link(inner, middle, right);
+    if (subtree_height(joined) <= subtree_height(outer) + 1)
     {
-      // inserted right (double rotation)
-      if (l_ptr->right && l_ptr->left)
-      {
-        bf = l_ptr->left->height - l_ptr->right->height;
-        if (bf < -1)
-        {
-          l_ptr = rotate_left(l_ptr);
-          l_ptr->left->height = l_ptr->height - 1;
-        }
-      }
-      st_root = rotate_right(st_root);
-      st_root->right->height = st_root->height - 1;
+      return link(outer, left, joined);
     }
-    // right heavy
-    else if (bf < -1)
+    return rotate_left(link(outer, left, rotate_right(joined)));
+  }
+  Node *joined = join_right(inner, middle, right);
+  link(outer, left, joined);
+  if (subtree_height(joined) <= subtree_height(outer) + 1)
+  {
+    return left;
+  }
+  return rotate_left(left);
+}
+
+// mirror image of join_right
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::join_left(Node *left, Node *middle, Node *right)
+{
+  Node *outer = right->right;
+  Node *inner = right->left;
+  if (subtree_height(inner) <= subtree_height(left) + 1)
+  {
+    Node *joined = link(left, middle, inner);
+    if (subtree_height(joined) <= subtree_height(outer) + 1)
     {
-      // inserted left (double rotation)
-      if (r_ptr->left && r_ptr->right)
-      {
-        bf = r_ptr->left->height - r_ptr->right->height;
-        if (bf > 1)
-        {
-          r_ptr = rotate_right(r_ptr);
-          r_ptr->right->height = r_ptr->height - 1;
-        }
-      }
-      st_root = rotate_left(st_root);
-      st_root->left->height = st_root->height - 1;
+      return link(joined, right, outer);
     }
+    return rotate_right(link(rotate_left(joined), right, outer));
+  }
+  Node *joined = join_left(left, middle, inner);
+  link(joined, right, outer);
+  if (subtree_height(joined) <= subtree_height(outer) + 1)
+  {
+    return right;
+  }
+  return rotate_right(right);
+}
+
+// joins two subtrees with no middle node
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::join2(Node *left, Node *right)
+{
+  if (left == nullptr)
+  {
+    return right;
+  }
+  Node *last = nullptr;
+  Node *rest = split_last(left, last);
+  return join(rest, last, right);
+}
+
+// takes the node of the largest key out of a nonempty subtree
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::split_last(Node *st_root, Node *&last)
+{
+  if (st_root->right == nullptr)
+  {
+    last = st_root;
+    Node *rest = st_root->left;
+    st_root->left = nullptr;
+    return rest;
+  }
+  Node *rest = split_last(st_root->right, last);
+  return join(st_root->left, st_root, rest);
+}
+
+// splits a subtree at the key: the side of each node on the search
+// path that is away from the key is joined back onto that side's
+// result (O(log n) in all, since the joined heights only grow)
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::split(Node *st_root, const K &key, Node *&less, Node *&found, Node *&greater)
+{
+  if (st_root == nullptr)
+  {
+    less = nullptr;
+    found = nullptr;
+    greater = nullptr;
+    return;
+  }
+  Node *left = st_root->left;
+  Node *right = st_root->right;
+  if (key == st_root->key)
+  {
+    less = left;
+    greater = right;
+    found = st_root;
+    st_root->left = nullptr;
+    st_root->right = nullptr;
+  }
+  else if (key < st_root->key)
+  {
+    split(left, key, less, found, greater);
+    greater = join(greater, st_root, right);
+  }
+  else
+  {
+    split(right, key, less, found, greater);
+    less = join(left, st_root, less);
+  }
+}
+
+// union: t1 is split at t2's root key, the halves are merged with t2's
+// subtrees, and the key's node joins the results. That is t1's node
+// given t2's value if t1 has the key (so rhs's value wins), and
+// otherwise a new node. Only t2's keys missing from t1 get nodes.
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::union_of(Node *t1, const Node *t2, NodePool &nodes, int threads)
+{
+  if (t2 == nullptr)
+  {
+    return t1;
+  }
+  if (t1 == nullptr)
+  {
+    return copy(t2, nodes);
+  }
+  int work = t1->size + t2->size;
+  Node *less = nullptr;
+  Node *middle = nullptr;
+  Node *greater = nullptr;
+  split(t1, t2->key, less, middle, greater);
+  if (middle == nullptr)
+  {
+    middle = nodes.create();
+    middle->key = t2->key;
+  }
+  middle->value = t2->value;
+
+  Node *left = nullptr;
+  Node *right = nullptr;
+  Dropped none;
+  fork(threads, work, none, nodes,
+       [&](int workers, Dropped &, NodePool &part) { left = union_of(less, t2->left, part, workers); },
+       [&](int workers, Dropped &, NodePool &part) { right = union_of(greater, t2->right, part, workers); });
+  return join(left, middle, right);
+}
+
+// intersection: t1 is split at t2's root key, the halves are
+// intersected with t2's subtrees, and t1's node of the key (if any)
+// joins the results
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::intersection_of(Node *t1, const Node *t2, Dropped &dropped,
+                                                                 int threads)
+{
+  if (t1 == nullptr)
+  {
+    return nullptr;
+  }
+  if (t2 == nullptr)
+  {
+    drop(dropped, t1);
+    return nullptr;
+  }
+  int work = t1->size + t2->size;
+  Node *less = nullptr;
+  Node *found = nullptr;
+  Node *greater = nullptr;
+  split(t1, t2->key, less, found, greater);
+
+  Node *left = nullptr;
+  Node *right = nullptr;
+  fork(threads, work, dropped, pool,
+       [&](int workers, Dropped &part, NodePool &) { left = intersection_of(less, t2->left, part, workers); },
+       [&](int workers, Dropped &part, NodePool &) { right = intersection_of(greater, t2->right, part, workers); });
+  if (found != nullptr)
+  {
+    return join(left, found, right);
+  }
+  return join2(left, right);
+}
+
+// difference: t1 is split at t2's root key (dropping t1's node of the
+// key), and the halves minus t2's subtrees are joined back together
+template <typename K, typename V, typename A>
+typename AVLMap<K, V, A>::Node *AVLMap<K, V, A>::difference_of(Node *t1, const Node *t2, Dropped &dropped,
+                                                               int threads)
+{
+  if (t1 == nullptr)
+  {
+    return nullptr;
+  }
+  if (t2 == nullptr)
+  {
+    return t1;
+  }
+  int work = t1->size + t2->size;
+  Node *less = nullptr;
+  Node *found = nullptr;
+  Node *greater = nullptr;
+  split(t1, t2->key, less, found, greater);
+  if (found != nullptr)
+  {
+    drop(dropped, found);
   }
 
-  return st_root;
+  Node *left = nullptr;
+  Node *right = nullptr;
+  fork(threads, work, dropped, pool,
+       [&](int workers, Dropped &part, NodePool &) { left = difference_of(less, t2->left, part, workers); },
+       [&](int workers, Dropped &part, NodePool &) { right = difference_of(greater, t2->right, part, workers); });
+  return join2(left, right);
 }
+
+// runs first and second, second on its own thread when there are
+// threads to spare. The halves touch disjoint subtrees and never
+// destroy nodes, and a second half on its own thread creates nodes
+// from its own pool (pools are not shared between threads), so they
+// need no locks.
+template <typename K, typename V, typename A>
+template <typename F, typename G>
+void AVLMap<K, V, A>::fork(int threads, int work, Dropped &dropped, NodePool &nodes, F first, G second)
+{
+  if (threads < 2 || work < PARALLEL_JOIN_MIN)
+  {
+    first(threads, dropped, nodes);
+    second(threads, dropped, nodes);
+    return;
+  }
+  Dropped second_dropped;
+  NodePool second_nodes;
+  std::thread worker(second, threads - threads / 2, std::ref(second_dropped), std::ref(second_nodes));
+  try
+  {
+    first(threads / 2, dropped, nodes);
+  }
+  catch (...)
+  {
+    worker.join();
+    nodes.merge(second_nodes);
+    throw;
+  }
+  worker.join();
+  nodes.merge(second_nodes);
+  append(dropped, second_dropped);
+}
+
+// adds a subtree to the front of a dropped list
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::drop(Dropped &dropped, Node *st_root)
+{
+  st_root->parent = dropped.head;
+  dropped.head = st_root;
+  if (dropped.tail == nullptr)
+  {
+    dropped.tail = st_root;
+  }
+}
+
+// adds a dropped list to the front of another
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::append(Dropped &dropped, const Dropped &more)
+{
+  if (more.head == nullptr)
+  {
+    return;
+  }
+  more.tail->parent = dropped.head;
+  dropped.head = more.head;
+  if (dropped.tail == nullptr)
+  {
+    dropped.tail = more.tail;
+  }
+}
+
+// makes new_root the tree, destroys the dropped subtrees, and recounts
+template <typename K, typename V, typename A>
+void AVLMap<K, V, A>::finish(Node *new_root, Dropped &dropped)
+{
+  root = new_root;
+  if (root != nullptr)
+  {
+    root->parent = nullptr;
+  }
+  while (dropped.head != nullptr)
+  {
+    Node *next = dropped.head->parent;
+    clear(dropped.head);
+    dropped.head = next;
+  }
+  dropped.tail = nullptr;
+  count = subtree_size(root);
+}
+
 #endif
@@ -15,6 +15,12 @@ template <typename K, typename V>
 class BinSearchMap : public Map<K, V>
 {
 public:
+  // default constructor
+  BinSearchMap();
+
+  // constructs a map holding the given key-value pairs (see assign)
+  BinSearchMap(const ArraySeq<K> &keys, const ArraySeq<V> &values);
+
   // Returns the number of key-value pairs in the map
   int size() const;
 
@@ -44,6 +50,18 @@ public:
   // otherwise.
   bool contains(const K &key) const;
 
+  // Heterogeneous versions of operator[], erase, and contains: take
+  // any Q the keys compare with (see is_lookup_key in map.h), such as
+  // a std::string_view for std::string keys, without building a K
+  template <typename Q, typename = lookup_key_t<K, Q>>
+  V &operator[](const Q &key);
+  template <typename Q, typename = lookup_key_t<K, Q>>
+  const V &operator[](const Q &key) const;
+  template <typename Q, typename = lookup_key_t<K, Q>>
+  void erase(const Q &key);
+  template <typename Q, typename = lookup_key_t<K, Q>>
+  bool contains(const Q &key) const;
+
   // Returns the keys k in the collection such that k1 <= k <= k2
   ArraySeq<K> find_keys(const K &k1, const K &k2) const;
 
@@ -63,18 +81,38 @@ public:
   // Removes all key-value pairs from the map.
   void clear();
 
+  // Replaces the contents of the map with the given key-value pairs
+  // (keys[i] maps to values[i]), keeping the first pair of a repeated
+  // key. Sorts the pairs once instead of shifting the array on every
+  // insert. Throws out_of_range if keys and values differ in size.
+  void assign(const ArraySeq<K> &keys, const ArraySeq<V> &values);
+
 private:
   // If the key is in the collection, bin_search returns true and
   // provides the key's index within the array sequence (via the index
   // output parameter). If the key is not in the collection,
   // bin_search returns false and provides the last index checked by
   // the binary search algorithm.
-  bool bin_search(const K &key, int &index) const;
+  template <typename Q>
+  bool bin_search(const Q &key, int &index) const;
 
   // implemented as a resizable array of (key-value) pairs
   ArraySeq<std::pair<K, V>> seq;
 };
 
+// default constructor
+template <typename K, typename V>
+BinSearchMap<K, V>::BinSearchMap()
+{
+}
+
+// constructs a map holding the given key-value pairs
+template <typename K, typename V>
+BinSearchMap<K, V>::BinSearchMap(const ArraySeq<K> &keys, const ArraySeq<V> &values)
+{
+  assign(keys, values);
+}
+
 template <typename K, typename V>
 int BinSearchMap<K, V>::size() const
 {
@@ -185,6 +223,60 @@ bool BinSearchMap<K, V>::contains(const K &key) const
   return bin_search(key, index);
 }
 
+// Allows values associated with a key to be updated, looked up by a
+// value the keys compare with. Throws out_of_range if the key is not
+// in the collection.
+template <typename K, typename V>
+template <typename Q, typename>
+V &BinSearchMap<K, V>::operator[](const Q &key)
+{
+  int index = -1;
+  if (!bin_search(key, index))
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return seq[index].second;
+}
+
+// Returns the value for a key, looked up by a value the keys compare
+// with. Throws out_of_range if the key is not in the collection.
+template <typename K, typename V>
+template <typename Q, typename>
+const V &BinSearchMap<K, V>::operator[](const Q &key) const
+{
+  int index = -1;
+  if (!bin_search(key, index))
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return seq[index].second;
+}
+
+// Removes the key-value pair for a key, looked up by a value the keys
+// compare with. Throws out_of_range if the key is not in the
+// collection.
+template <typename K, typename V>
+template <typename Q, typename>
+void BinSearchMap<K, V>::erase(const Q &key)
+{
+  int index = -1;
+  if (!bin_search(key, index))
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  seq.erase(index);
+}
+
+// Returns true if a key the value compares equal to is in the
+// collection, and false otherwise.
+template <typename K, typename V>
+template <typename Q, typename>
+bool BinSearchMap<K, V>::contains(const Q &key) const
+{
+  int index = -1;
+  return bin_search(key, index);
+}
+
 // Returns the keys k in the collection such that k1 <= k <= k2
 template <typename K, typename V>
 ArraySeq<K> BinSearchMap<K, V>::find_keys(const K &k1, const K &k2) const
@@ -304,13 +396,27 @@ void BinSearchMap<K, V>::clear()
   seq.clear();
 }
 
+// Replaces the contents of the map with the given key-value pairs
+template <typename K, typename V>
+void BinSearchMap<K, V>::assign(const ArraySeq<K> &keys, const ArraySeq<V> &values)
+{
+  this->check_pairs(keys, values);
+  ArraySeq<int> order = this->sorted_unique(keys);
+  seq.clear();
+  for (int i = 0; i < order.size(); ++i)
+  {
+    seq.insert(std::pair<K, V>(keys[order[i]], values[order[i]]), i);
+  }
+}
+
 // If the key is in the collection, bin_search returns true and
 // provides the key's index within the array sequence (via the index
 // output parameter). If the key is not in the collection,
 // bin_search returns false and provides the last index checked by
 // the binary search algorithm.
 template <typename K, typename V>
-bool BinSearchMap<K, V>::bin_search(const K &key, int &index) const
+template <typename Q>
+bool BinSearchMap<K, V>::bin_search(const Q &key, int &index) const
 {
   int start = 0;
   int end = size() - 1;
@@ -0,0 +1,368 @@
+//---------------------------------------------------------------------------
+// NAME: Joey Macauley
+// FILE: bloomfilter.h
+// DATE: CPSC 223 - Spring 2022
+// DESC: Implementation of a cache-line blocked Bloom filter. Each key
+//       picks one 64-byte block and sets one bit in each of the block's
+//       eight 64-bit words, so adding or testing a key touches a single
+//       cache line. The filter can say a key might be present when it
+//       is not (a false positive), but never the other way around.
+//       Keys cannot be removed; the filter is cleared and refilled
+//       instead.
+//---------------------------------------------------------------------------
+
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+
+#include "hashpolicy.h"
+#include <functional>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+template <typename K>
+class BlockedBloomFilter
+{
+public:
+  // default bits set aside per expected key (about 1% false positives
+  // when full)
+  static const int BITS_PER_KEY = 12;
+
+  // constructs a filter sized for the given number of keys, with
+  // key_bits bits per key. Throws out_of_range if either is invalid.
+  BlockedBloomFilter(int expected_keys = 0, int key_bits = BITS_PER_KEY);
+
+  // copy constructor
+  BlockedBloomFilter(const BlockedBloomFilter &rhs);
+
+  // move constructor
+  BlockedBloomFilter(BlockedBloomFilter &&rhs);
+
+  // copy assignment
+  BlockedBloomFilter &operator=(const BlockedBloomFilter &rhs);
+
+  // move assignment
+  BlockedBloomFilter &operator=(BlockedBloomFilter &&rhs);
+
+  // destructor
+  ~BlockedBloomFilter();
+
+  // Adds a key to the filter
+  void add(const K &key);
+
+  // Returns false if the key was never added, and true if it might
+  // have been
+  bool might_contain(const K &key) const;
+
+  // Removes every key from the filter
+  void clear();
+
+  // Clears the filter and resizes it for the given number of keys
+  // (with the same bits per key). Throws out_of_range if the count is
+  // negative.
+  void reset(int expected_keys);
+
+  // Returns the number of keys the filter was sized for
+  int capacity() const;
+
+  // Returns the number of keys added since the last clear (counting
+  // repeats)
+  int added() const;
+
+  // Returns the number of 64-byte blocks
+  int block_count() const;
+
+  // Returns the number of bits in the filter
+  long bit_count() const;
+
+  // Returns the fraction of the filter's bits that are set
+  double fill_ratio() const;
+
+  // Returns the false positive rate expected from the current fill
+  // (the chance a missing key finds all eight of its bits set)
+  double expected_fpr() const;
+
+private:
+  // one cache line of bits
+  struct alignas(64) Block
+  {
+    std::uint64_t words[8];
+  };
+
+  // odd multipliers that pick a key's bit in each word
+  static constexpr std::uint32_t SALTS[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU,
+                                             0xa2b7289dU, 0x705495c7U, 0x2df1424bU,
+                                             0x9efc4947U, 0x5c6bfb31U};
+
+  // size settings
+  int bits_per_key = BITS_PER_KEY;
+  int expected = 0;
+
+  // the blocks and the keys added to them
+  Block *blocks = nullptr;
+  int blocks_count = 0;
+  int added_count = 0;
+
+  // the hash function (std::hash through a 64-bit finalizer)
+  static std::uint64_t hash(const K &key);
+
+  // the bit each word of the key's block uses, one per word
+  static std::uint64_t mask(std::uint32_t code, int word);
+
+  // the block of a hash code
+  int block(std::uint64_t code) const;
+
+  // allocate the blocks for the expected number of keys
+  void init_blocks();
+};
+
+// number of set bits in a filter word
+inline int bloom_popcount(std::uint64_t word)
+{
+#if defined(__GNUC__)
+  return __builtin_popcountll(word);
+#else
+  int bits = 0;
+  while (word != 0)
+  {
+    word = word & (word - 1);
+    bits++;
+  }
+  return bits;
+#endif
+}
+
+// constructs a filter sized for the given number of keys
+template <typename K>
+BlockedBloomFilter<K>::BlockedBloomFilter(int expected_keys, int key_bits)
+  : bits_per_key(key_bits), expected(expected_keys)
+{
+  if (expected_keys < 0 || key_bits <= 0)
+  {
+    throw std::out_of_range("Invalid bloom filter size");
+  }
+  init_blocks();
+}
+
+// copy constructor
+template <typename K>
+BlockedBloomFilter<K>::BlockedBloomFilter(const BlockedBloomFilter &rhs)
+{
+  *this = rhs;
+}
+
+// move constructor
+template <typename K>
+BlockedBloomFilter<K>::BlockedBloomFilter(BlockedBloomFilter &&rhs)
+{
+  *this = std::move(rhs);
+}
+
+// copy assignment
+template <typename K>
+BlockedBloomFilter<K> &BlockedBloomFilter<K>::operator=(const BlockedBloomFilter &rhs)
+{
+  if (this != &rhs)
+  {
+    delete[] blocks;
+    bits_per_key = rhs.bits_per_key;
+    expected = rhs.expected;
+    blocks_count = rhs.blocks_count;
+    added_count = rhs.added_count;
+    blocks = new Block[blocks_count];
+    for (int i = 0; i < blocks_count; ++i)
+    {
+      blocks[i] = rhs.blocks[i];
+    }
+  }
+  return *this;
+}
+
+// move assignment
+template <typename K>
+BlockedBloomFilter<K> &BlockedBloomFilter<K>::operator=(BlockedBloomFilter &&rhs)
+{
+  if (this != &rhs)
+  {
+    delete[] blocks;
+    bits_per_key = rhs.bits_per_key;
+    expected = rhs.expected;
+    blocks_count = rhs.blocks_count;
+    added_count = rhs.added_count;
+    blocks = rhs.blocks;
+
+    // default state for rhs (one empty block so it can still be used)
+    rhs.expected = 0;
+    rhs.added_count = 0;
+    rhs.blocks = nullptr;
+    rhs.init_blocks();
+  }
+  return *this;
+}
+
+// destructor
+template <typename K>
+BlockedBloomFilter<K>::~BlockedBloomFilter()
+{
+  delete[] blocks;
+}
+
+// Adds a key to the filter
+template <typename K>
+void BlockedBloomFilter<K>::add(const K &key)
+{
+  std::uint64_t code = hash(key);
+  Block &target = blocks[block(code)];
+  for (int i = 0; i < 8; ++i)
+  {
+    target.words[i] = target.words[i] | mask(static_cast<std::uint32_t>(code), i);
+  }
+  added_count++;
+}
+
+// Returns false if the key was never added, and true if it might have
+// been
+template <typename K>
+bool BlockedBloomFilter<K>::might_contain(const K &key) const
+{
+  std::uint64_t code = hash(key);
+  const Block &target = blocks[block(code)];
+
+  // checks every word without branching (the compiler can vectorize it)
+  std::uint64_t missing = 0;
+  for (int i = 0; i < 8; ++i)
+  {
+    std::uint64_t bit = mask(static_cast<std::uint32_t>(code), i);
+    missing = missing | (~target.words[i] & bit);
+  }
+  return missing == 0;
+}
+
+// Removes every key from the filter
+template <typename K>
+void BlockedBloomFilter<K>::clear()
+{
+  for (int i = 0; i < blocks_count; ++i)
+  {
+    for (int j = 0; j < 8; ++j)
+    {
+      blocks[i].words[j] = 0;
+    }
+  }
+  added_count = 0;
+}
+
+// Clears the filter and resizes it for the given number of keys
+template <typename K>
+void BlockedBloomFilter<K>::reset(int expected_keys)
+{
+  if (expected_keys < 0)
+  {
+    throw std::out_of_range("Invalid bloom filter size");
+  }
+  delete[] blocks;
+  blocks = nullptr;
+  expected = expected_keys;
+  added_count = 0;
+  init_blocks();
+}
+
+// Returns the number of keys the filter was sized for
+template <typename K>
+int BlockedBloomFilter<K>::capacity() const
+{
+  return expected;
+}
+
+// Returns the number of keys added since the last clear
+template <typename K>
+int BlockedBloomFilter<K>::added() const
+{
+  return added_count;
+}
+
+// Returns the number of 64-byte blocks
+template <typename K>
+int BlockedBloomFilter<K>::block_count() const
+{
+  return blocks_count;
+}
+
+// Returns the number of bits in the filter
+template <typename K>
+long BlockedBloomFilter<K>::bit_count() const
+{
+  return static_cast<long>(blocks_count) * 512;
+}
+
+// Returns the fraction of the filter's bits that are set
+template <typename K>
+double BlockedBloomFilter<K>::fill_ratio() const
+{
+  long set = 0;
+  for (int i = 0; i < blocks_count; ++i)
+  {
+    for (int j = 0; j < 8; ++j)
+    {
+      set = set + bloom_popcount(blocks[i].words[j]);
+    }
+  }
+  return static_cast<double>(set) / bit_count();
+}
+
+// Returns the false positive rate expected from the current fill
+template <typename K>
+double BlockedBloomFilter<K>::expected_fpr() const
+{
+  // a missing key passes if its bit is set in every word of its block,
+  // so the rate is the average over the blocks of (word fill)^8
+  double total = 0;
+  for (int i = 0; i < blocks_count; ++i)
+  {
+    double pass = 1;
+    for (int j = 0; j < 8; ++j)
+    {
+      pass = pass * bloom_popcount(blocks[i].words[j]) / 64.0;
+    }
+    total = total + pass;
+  }
+  return total / blocks_count;
+}
+
+// the hash function (std::hash through the MurmurHash3 finalizer)
+template <typename K>
+std::uint64_t BlockedBloomFilter<K>::hash(const K &key)
+{
+  std::hash<K> hash_code;
+  return hash_fmix64(hash_code(key));
+}
+
+// the bit of the given word (the top 6 bits of code times the word's
+// salt)
+template <typename K>
+std::uint64_t BlockedBloomFilter<K>::mask(std::uint32_t code, int word)
+{
+  return 1ULL << ((code * SALTS[word]) >> 26);
+}
+
+// the block of a hash code (the high half scaled to the block count)
+template <typename K>
+int BlockedBloomFilter<K>::block(std::uint64_t code) const
+{
+  return static_cast<int>(((code >> 32) * static_cast<std::uint64_t>(blocks_count)) >> 32);
+}
+
+// allocate the blocks for the expected number of keys (at least one)
+template <typename K>
+void BlockedBloomFilter<K>::init_blocks()
+{
+  long bits = static_cast<long>(expected) * bits_per_key;
+  blocks_count = static_cast<int>((bits + 511) / 512);
+  if (blocks_count < 1)
+  {
+    blocks_count = 1;
+  }
+  blocks = new Block[blocks_count]();
+}
+
+#endif
@@ -0,0 +1,328 @@
+//---------------------------------------------------------------------------
+// NAME: Joey Macauley
+// FILE: bloommap.h
+// DATE: CPSC 223 - Spring 2022
+// DESC: A map wrapper that puts a blocked Bloom filter in front of any
+//       other map (HashMap, AVLMap, BinSearchMap, ...). Lookups of keys
+//       the filter has never seen return after one cache-line probe,
+//       without walking a chain or a root-to-leaf path. Inserts add the
+//       key to the filter. Erased keys stay in the filter until it is
+//       rebuilt, which happens when the map outgrows the filter or when
+//       more erased keys than live ones are left in it.
+//---------------------------------------------------------------------------
+
+#ifndef BLOOMMAP_H
+#define BLOOMMAP_H
+
+#include "map.h"
+#include "arrayseq.h"
+#include "bloomfilter.h"
+#include <stdexcept>
+#include <type_traits>
+
+template <typename K, typename V, typename M>
+class BloomFilteredMap : public Map<K, V>
+{
+  static_assert(std::is_base_of<Map<K, V>, M>::value, "BloomFilteredMap wraps a Map<K,V>");
+
+public:
+  // constructs an empty map with the given filter bits per key
+  BloomFilteredMap(int bits_per_key = BlockedBloomFilter<K>::BITS_PER_KEY);
+
+  // Returns the number of key-value pairs in the map
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Allows values associated with a key to be updated. Throws
+  // out_of_range if the given key is not in the collection.
+  V &operator[](const K &key);
+
+  // Returns the value for a given key. Throws out_of_range if the
+  // given key is not in the collection.
+  const V &operator[](const K &key) const;
+
+  // Extends the collection by adding the given key-value pair.
+  // Expects key to not exist in map prior to insertion.
+  void insert(const K &key, const V &value);
+
+  // Shrinks the collection by removing the key-value pair with the
+  // given key. Does not modify the collection if the collection does
+  // not contain the key. Throws out_of_range if the given key is not
+  // in the collection.
+  void erase(const K &key);
+
+  // Returns true if the key is in the collection, and false otherwise.
+  bool contains(const K &key) const;
+
+  // Returns the keys k in the collection such that k1 <= k <= k2
+  ArraySeq<K> find_keys(const K &k1, const K &k2) const;
+
+  // Returns the keys in the collection in ascending sorted order
+  ArraySeq<K> sorted_keys() const;
+
+  // Gives the key (as an ouptput parameter) immediately after the
+  // given key according to ascending sort order. Returns true if a
+  // successor key exists, and false otherwise.
+  bool next_key(const K &key, K &next_key) const;
+
+  // Gives the key (as an ouptput parameter) immediately before the
+  // given key according to ascending sort order. Returns true if a
+  // predecessor key exists, and false otherwise.
+  bool prev_key(const K &key, K &prev_key) const;
+
+  // Removes all key-value pairs from the map.
+  void clear();
+
+  // Replaces the contents of the map with the given key-value pairs
+  // through the wrapped map's bulk load, then rebuilds the filter
+  void assign(const ArraySeq<K> &keys, const ArraySeq<V> &values);
+
+  // Returns the wrapped map
+  const M &wrapped() const;
+
+  // Returns the filter in front of the map
+  const BlockedBloomFilter<K> &bloom_filter() const;
+
+  // Clears the filter and refills it with the map's keys (sized for
+  // twice as many keys)
+  void rebuild();
+
+  // Returns the filter bits per key in the map
+  double bits_per_key() const;
+
+  // Returns the number of contains calls the filter answered on its
+  // own
+  long filtered_lookups() const;
+
+  // Returns the fraction of contains calls for missing keys the filter
+  // let through (the measured false positive rate)
+  double false_positive_rate() const;
+
+  // Resets the contains counts
+  void reset_stats();
+
+private:
+  // smallest number of keys the filter is sized for
+  static const int MIN_KEYS = 64;
+
+  // the wrapped map and its filter
+  M map;
+  BlockedBloomFilter<K> filter;
+
+  // erased keys still set in the filter
+  int stale = 0;
+
+  // contains calls for missing keys stopped by the filter and let
+  // through
+  mutable long filtered = 0;
+  mutable long false_positives = 0;
+};
+
+// constructs an empty map with the given filter bits per key
+template <typename K, typename V, typename M>
+BloomFilteredMap<K, V, M>::BloomFilteredMap(int bits_per_key)
+  : filter(MIN_KEYS, bits_per_key)
+{
+}
+
+// Returns the number of key-value pairs in the map
+template <typename K, typename V, typename M>
+int BloomFilteredMap<K, V, M>::size() const
+{
+  return map.size();
+}
+
+// Tests if the map is empty
+template <typename K, typename V, typename M>
+bool BloomFilteredMap<K, V, M>::empty() const
+{
+  return map.empty();
+}
+
+// Allows values associated with a key to be updated. Throws
+// out_of_range if the given key is not in the collection.
+template <typename K, typename V, typename M>
+V &BloomFilteredMap<K, V, M>::operator[](const K &key)
+{
+  if (!filter.might_contain(key))
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return map[key];
+}
+
+// Returns the value for a given key. Throws out_of_range if the
+// given key is not in the collection.
+template <typename K, typename V, typename M>
+const V &BloomFilteredMap<K, V, M>::operator[](const K &key) const
+{
+  if (!filter.might_contain(key))
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return map[key];
+}
+
+// Extends the collection by adding the given key-value pair.
+template <typename K, typename V, typename M>
+void BloomFilteredMap<K, V, M>::insert(const K &key, const V &value)
+{
+  map.insert(key, value);
+  if (map.size() > filter.capacity())
+  {
+    rebuild();
+  }
+  else
+  {
+    filter.add(key);
+  }
+}
+
+// Shrinks the collection by removing the key-value pair with the
+// given key.
+template <typename K, typename V, typename M>
+void BloomFilteredMap<K, V, M>::erase(const K &key)
+{
+  map.erase(key);
+  stale++;
+  if (stale > map.size())
+  {
+    rebuild();
+  }
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template <typename K, typename V, typename M>
+bool BloomFilteredMap<K, V, M>::contains(const K &key) const
+{
+  if (!filter.might_contain(key))
+  {
+    filtered++;
+    return false;
+  }
+  if (map.contains(key))
+  {
+    return true;
+  }
+  false_positives++;
+  return false;
+}
+
+// Returns the keys k in the collection such that k1 <= k <= k2
+template <typename K, typename V, typename M>
+ArraySeq<K> BloomFilteredMap<K, V, M>::find_keys(const K &k1, const K &k2) const
+{
+  return map.find_keys(k1, k2);
+}
+
+// Returns the keys in the collection in ascending sorted order
+template <typename K, typename V, typename M>
+ArraySeq<K> BloomFilteredMap<K, V, M>::sorted_keys() const
+{
+  return map.sorted_keys();
+}
+
+// Gives the key immediately after the given key
+template <typename K, typename V, typename M>
+bool BloomFilteredMap<K, V, M>::next_key(const K &key, K &next_key) const
+{
+  return map.next_key(key, next_key);
+}
+
+// Gives the key immediately before the given key
+template <typename K, typename V, typename M>
+bool BloomFilteredMap<K, V, M>::prev_key(const K &key, K &prev_key) const
+{
+  return map.prev_key(key, prev_key);
+}
+
+// Removes all key-value pairs from the map.
+template <typename K, typename V, typename M>
+void BloomFilteredMap<K, V, M>::clear()
+{
+  map.clear();
+  filter.reset(MIN_KEYS);
+  stale = 0;
+}
+
+// Replaces the contents of the map with the given key-value pairs
+template <typename K, typename V, typename M>
+void BloomFilteredMap<K, V, M>::assign(const ArraySeq<K> &keys, const ArraySeq<V> &values)
+{
+  map.assign(keys, values);
+  rebuild();
+}
+
+// Returns the wrapped map
+template <typename K, typename V, typename M>
+const M &BloomFilteredMap<K, V, M>::wrapped() const
+{
+  return map;
+}
+
+// Returns the filter in front of the map
+template <typename K, typename V, typename M>
+const BlockedBloomFilter<K> &BloomFilteredMap<K, V, M>::bloom_filter() const
+{
+  return filter;
+}
+
+// Clears the filter and refills it with the map's keys
+template <typename K, typename V, typename M>
+void BloomFilteredMap<K, V, M>::rebuild()
+{
+  ArraySeq<K> keys = map.sorted_keys();
+  int expected = 2 * keys.size();
+  if (expected < MIN_KEYS)
+  {
+    expected = MIN_KEYS;
+  }
+  filter.reset(expected);
+  for (int i = 0; i < keys.size(); ++i)
+  {
+    filter.add(keys[i]);
+  }
+  stale = 0;
+}
+
+// Returns the filter bits per key in the map
+template <typename K, typename V, typename M>
+double BloomFilteredMap<K, V, M>::bits_per_key() const
+{
+  if (map.empty())
+  {
+    return 0;
+  }
+  return static_cast<double>(filter.bit_count()) / map.size();
+}
+
+// Returns the number of contains calls the filter answered on its own
+template <typename K, typename V, typename M>
+long BloomFilteredMap<K, V, M>::filtered_lookups() const
+{
+  return filtered;
+}
+
+// Returns the fraction of contains calls for missing keys the filter
+// let through
+template <typename K, typename V, typename M>
+double BloomFilteredMap<K, V, M>::false_positive_rate() const
+{
+  if (filtered + false_positives == 0)
+  {
+    return 0;
+  }
+  return static_cast<double>(false_positives) / (filtered + false_positives);
+}
+
+// Resets the contains counts
+template <typename K, typename V, typename M>
+void BloomFilteredMap<K, V, M>::reset_stats()
+{
+  filtered = 0;
+  false_positives = 0;
+}
+
+#endif
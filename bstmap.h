@@ -10,14 +10,23 @@
 
 #include "map.h"
 #include "arrayseq.h"
+#include "nodepool.h"
+#include "treeiterator.h"
 
-template <typename K, typename V>
+// A is the node allocation policy (see nodepool.h)
+template <typename K, typename V, typename A = HeapAllocator>
 class BSTMap : public Map<K, V>
 {
+  // tree node (defined below)
+  struct Node;
+
 public:
   // default constructor
   BSTMap();
 
+  // constructs a map holding the given key-value pairs (see assign)
+  BSTMap(const ArraySeq<K> &keys, const ArraySeq<V> &values);
+
   // copy constructor
   BSTMap(const BSTMap &rhs);
 
@@ -60,6 +69,18 @@ public:
   // Returns true if the key is in the collection, and false otherwise.
   bool contains(const K &key) const;
 
+  // Heterogeneous versions of operator[], erase, and contains: take
+  // any Q the keys compare with (see is_lookup_key in map.h), such as
+  // a std::string_view for std::string keys, without building a K
+  template <typename Q, typename = lookup_key_t<K, Q>>
+  V &operator[](const Q &key);
+  template <typename Q, typename = lookup_key_t<K, Q>>
+  const V &operator[](const Q &key) const;
+  template <typename Q, typename = lookup_key_t<K, Q>>
+  void erase(const Q &key);
+  template <typename Q, typename = lookup_key_t<K, Q>>
+  bool contains(const Q &key) const;
+
   // Returns the keys k in the collection such that k1 <= k <= k2
   ArraySeq<K> find_keys(const K &k1, const K &k2) const;
 
@@ -79,9 +100,42 @@ public:
   // Removes all key-value pairs from the map.
   void clear();
 
+  // Replaces the contents of the map with the given key-value pairs
+  // (keys[i] maps to values[i]), keeping the first pair of a repeated
+  // key. Builds a perfectly balanced tree straight from the sorted
+  // pairs: O(n) if the keys are already in ascending order, and
+  // O(n log n) otherwise. Throws out_of_range if keys and values
+  // differ in size.
+  void assign(const ArraySeq<K> &keys, const ArraySeq<V> &values);
+
   // Returns the height of the binary search tree
   int height() const;
 
+  // In-order iterators (see treeiterator.h): *it gives the key and a
+  // reference to its value, and each step follows parent links
+  // instead of searching from the root. Inserts keep iterators valid;
+  // an erase may invalidate any of them.
+  typedef TreeIterator<Node, K, V, false> iterator;
+  typedef TreeIterator<Node, K, V, true> const_iterator;
+
+  // Returns an iterator at the smallest key
+  iterator begin();
+  const_iterator begin() const;
+
+  // Returns the iterator one past the largest key
+  iterator end();
+  const_iterator end() const;
+
+  // Returns an iterator at the first key not less than the given key,
+  // or end if there is none
+  iterator lower_bound(const K &key);
+  const_iterator lower_bound(const K &key) const;
+
+  // Returns an iterator at the first key greater than the given key,
+  // or end if there is none
+  iterator upper_bound(const K &key);
+  const_iterator upper_bound(const K &key) const;
+
 private:
   // node for linked-list separate chaining
   struct Node
@@ -90,8 +144,12 @@ private:
     V value;
     Node *left;
     Node *right;
+    Node *parent;
   };
 
+  // node allocator
+  typename A::template Pool<Node> pool;
+
   // number of key-value pairs in map
   int count = 0;
 
@@ -102,10 +160,32 @@ private:
   void clear(Node *st_root);
 
   // copy assignment helper
-  Node *copy(const Node *rhs_st_root) const;
+  Node *copy(const Node *rhs_st_root);
+
+  // node of the smallest key (nullptr if empty)
+  Node *leftmost() const;
+
+  // node of the first key not less than the key (greater than it, if
+  // strict), or nullptr if there is none
+  Node *bound(const K &key, bool strict) const;
 
-  // erase helper
-  Node *erase(const K &key, Node *st_root);
+  // assign helper: builds a balanced subtree from the pairs
+  // order[first] to order[last]
+  Node *build(const ArraySeq<K> &keys, const ArraySeq<V> &values, const ArraySeq<int> &order,
+              int first, int last);
+
+  // returns the node holding the key, or nullptr if it is not in the
+  // map
+  template <typename Q>
+  Node *find_node(const Q &key) const;
+
+  // unlinks and frees a node (a node with two children takes its
+  // successor's pair and the successor is unlinked instead)
+  void remove_node(Node *node);
+
+  // points the link that held old_child (the parent's left or right,
+  // or the root if parent is nullptr) at new_child
+  void replace_child(Node *parent, Node *old_child, Node *new_child);
 
   // find_keys helper
   void find_keys(const K &k1, const K &k2, const Node *st_root,
@@ -118,28 +198,35 @@ private:
   int height(const Node *st_root) const;
 };
 
-template <typename K, typename V>
-BSTMap<K, V>::BSTMap()
+template <typename K, typename V, typename A>
+BSTMap<K, V, A>::BSTMap()
+{
+}
+
+// constructs a map holding the given key-value pairs
+template <typename K, typename V, typename A>
+BSTMap<K, V, A>::BSTMap(const ArraySeq<K> &keys, const ArraySeq<V> &values)
 {
+  assign(keys, values);
 }
 
 // copy constructor
-template <typename K, typename V>
-BSTMap<K, V>::BSTMap(const BSTMap &rhs)
+template <typename K, typename V, typename A>
+BSTMap<K, V, A>::BSTMap(const BSTMap &rhs)
 {
   *this = rhs;
 }
 
 // move constructor
-template <typename K, typename V>
-BSTMap<K, V>::BSTMap(BSTMap &&rhs)
+template <typename K, typename V, typename A>
+BSTMap<K, V, A>::BSTMap(BSTMap &&rhs)
 {
   *this = std::move(rhs);
 }
 
 // copy assignment
-template <typename K, typename V>
-BSTMap<K, V> &BSTMap<K, V>::operator=(const BSTMap &rhs)
+template <typename K, typename V, typename A>
+BSTMap<K, V, A> &BSTMap<K, V, A>::operator=(const BSTMap &rhs)
 {
   if (this != &rhs)
   {
@@ -151,12 +238,13 @@ BSTMap<K, V> &BSTMap<K, V>::operator=(const BSTMap &rhs)
 }
 
 // move assignment
-template <typename K, typename V>
-BSTMap<K, V> &BSTMap<K, V>::operator=(BSTMap &&rhs)
+template <typename K, typename V, typename A>
+BSTMap<K, V, A> &BSTMap<K, V, A>::operator=(BSTMap &&rhs)
 {
   if (this != &rhs)
   {
     clear();
+    pool.swap(rhs.pool);
     root = rhs.root;
     count = rhs.count;
 
@@ -167,22 +255,22 @@ BSTMap<K, V> &BSTMap<K, V>::operator=(BSTMap &&rhs)
 }
 
 // destructor
-template <typename K, typename V>
-BSTMap<K, V>::~BSTMap()
+template <typename K, typename V, typename A>
+BSTMap<K, V, A>::~BSTMap()
 {
   clear();
 }
 
 // Returns the number of key-value pairs in the map
-template <typename K, typename V>
-int BSTMap<K, V>::size() const
+template <typename K, typename V, typename A>
+int BSTMap<K, V, A>::size() const
 {
   return count;
 }
 
 // Tests if the map is empty
-template <typename K, typename V>
-bool BSTMap<K, V>::empty() const
+template <typename K, typename V, typename A>
+bool BSTMap<K, V, A>::empty() const
 {
   if (root == nullptr)
   {
@@ -193,64 +281,43 @@ bool BSTMap<K, V>::empty() const
 
 // Allows values associated with a key to be updated. Throws
 // out_of_range if the given key is not in the collection.
-template <typename K, typename V>
-V &BSTMap<K, V>::operator[](const K &key)
+template <typename K, typename V, typename A>
+V &BSTMap<K, V, A>::operator[](const K &key)
 {
-  Node *traverse = root;
-  while (traverse != nullptr)
+  Node *node = find_node(key);
+  if (node == nullptr)
   {
-    if (key == traverse->key)
-    {
-      return traverse->value;
-    }
-    else if (key > traverse->key)
-    {
-      traverse = traverse->right;
-    }
-    else
-    {
-      traverse = traverse->left;
-    }
+    throw std::out_of_range("Key is not in the collection");
   }
-  throw std::out_of_range("Key is not in the collection");
+  return node->value;
 }
 
 // Returns the value for a given key. Throws out_of_range if the
 // given key is not in the collection.
-template <typename K, typename V>
-const V &BSTMap<K, V>::operator[](const K &key) const
+template <typename K, typename V, typename A>
+const V &BSTMap<K, V, A>::operator[](const K &key) const
 {
-  Node *traverse = root;
-  while (traverse != nullptr)
+  Node *node = find_node(key);
+  if (node == nullptr)
   {
-    if (key == traverse->key)
-    {
-      return traverse->value;
-    }
-    else if (key > traverse->key)
-    {
-      traverse = traverse->right;
-    }
-    else
-    {
-      traverse = traverse->left;
-    }
+    throw std::out_of_range("Key is not in the collection");
   }
-  throw std::out_of_range("Key is not in the collection");
+  return node->value;
 }
 
 // Extends the collection by adding the given key-value pair.
 // Expects key to not exist in map prior to insertion.
-template <typename K, typename V>
-void BSTMap<K, V>::insert(const K &key, const V &value)
+template <typename K, typename V, typename A>
+void BSTMap<K, V, A>::insert(const K &key, const V &value)
 {
   Node *traverse = root;
   Node *parent = nullptr;
   // Allocate Memory for new leaf
-  Node *newLeaf = new Node;
+  Node *newLeaf = pool.create();
   newLeaf->key = key;
   newLeaf->value = value;
   newLeaf->right = newLeaf->left = nullptr;
+  newLeaf->parent = nullptr;
   count++;
 
   // Empty BST
@@ -274,6 +341,7 @@ void BSTMap<K, V>::insert(const K &key, const V &value)
       }
     }
     // Insert to the correct side of parent
+    newLeaf->parent = parent;
     if (key > parent->key)
     {
       parent->right = newLeaf;
@@ -288,50 +356,80 @@ void BSTMap<K, V>::insert(const K &key, const V &value)
 // given key. Does not modify the collection if the collection does
 // not contain the key. Throws out_of_range if the given key is not
 // in the collection.
-template <typename K, typename V>
-void BSTMap<K, V>::erase(const K &key)
+template <typename K, typename V, typename A>
+void BSTMap<K, V, A>::erase(const K &key)
 {
-  if (empty())
+  Node *node = find_node(key);
+  if (node == nullptr)
   {
     throw std::out_of_range("Key is not in the collection");
   }
-  else if (!contains(key))
+  remove_node(node);
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template <typename K, typename V, typename A>
+bool BSTMap<K, V, A>::contains(const K &key) const
+{
+  return find_node(key) != nullptr;
+}
+
+// Allows values associated with a key to be updated, looked up by a
+// value the keys compare with. Throws out_of_range if the key is not
+// in the collection.
+template <typename K, typename V, typename A>
+template <typename Q, typename>
+V &BSTMap<K, V, A>::operator[](const Q &key)
+{
+  Node *node = find_node(key);
+  if (node == nullptr)
   {
     throw std::out_of_range("Key is not in the collection");
   }
-  else
+  return node->value;
+}
+
+// Returns the value for a key, looked up by a value the keys compare
+// with. Throws out_of_range if the key is not in the collection.
+template <typename K, typename V, typename A>
+template <typename Q, typename>
+const V &BSTMap<K, V, A>::operator[](const Q &key) const
+{
+  Node *node = find_node(key);
+  if (node == nullptr)
   {
-    root = erase(key, root);
+    throw std::out_of_range("Key is not in the collection");
   }
+  return node->value;
 }
 
-// Returns true if the key is in the collection, and false otherwise.
-template <typename K, typename V>
-bool BSTMap<K, V>::contains(const K &key) const
+// Removes the key-value pair for a key, looked up by a value the keys
+// compare with. Throws out_of_range if the key is not in the
+// collection.
+template <typename K, typename V, typename A>
+template <typename Q, typename>
+void BSTMap<K, V, A>::erase(const Q &key)
 {
-  Node *traverse = root;
-
-  while (traverse != nullptr)
+  Node *node = find_node(key);
+  if (node == nullptr)
   {
-    if (key == traverse->key)
-    {
-      return true;
-    }
-    else if (key > traverse->key)
-    {
-      traverse = traverse->right;
-    }
-    else
-    {
-      traverse = traverse->left;
-    }
+    throw std::out_of_range("Key is not in the collection");
   }
-  return false;
+  remove_node(node);
+}
+
+// Returns true if a key the value compares equal to is in the
+// collection, and false otherwise.
+template <typename K, typename V, typename A>
+template <typename Q, typename>
+bool BSTMap<K, V, A>::contains(const Q &key) const
+{
+  return find_node(key) != nullptr;
 }
 
 // Returns the keys k in the collection such that k1 <= k <= k2
-template <typename K, typename V>
-ArraySeq<K> BSTMap<K, V>::find_keys(const K &k1, const K &k2) const
+template <typename K, typename V, typename A>
+ArraySeq<K> BSTMap<K, V, A>::find_keys(const K &k1, const K &k2) const
 {
   ArraySeq<K> keys;
   find_keys(k1, k2, root, keys);
@@ -339,8 +437,8 @@ ArraySeq<K> BSTMap<K, V>::find_keys(const K &k1, const K &k2) const
 }
 
 // Returns the keys in the collection in ascending sorted order
-template <typename K, typename V>
-ArraySeq<K> BSTMap<K, V>::sorted_keys() const
+template <typename K, typename V, typename A>
+ArraySeq<K> BSTMap<K, V, A>::sorted_keys() const
 {
   ArraySeq<K> keys;
   sorted_keys(root, keys);
@@ -350,8 +448,8 @@ ArraySeq<K> BSTMap<K, V>::sorted_keys() const
 // Gives the key (as an ouptput parameter) immediately after the
 // given key according to ascending sort order. Returns true if a
 // successor key exists, and false otherwise.
-template <typename K, typename V>
-bool BSTMap<K, V>::next_key(const K &key, K &next_key) const
+template <typename K, typename V, typename A>
+bool BSTMap<K, V, A>::next_key(const K &key, K &next_key) const
 {
   // No keys exist
   if (empty())
@@ -438,8 +536,8 @@ bool BSTMap<K, V>::next_key(const K &key, K &next_key) const
 // Gives the key (as an ouptput parameter) immediately before the
 // given key according to ascending sort order. Returns true if a
 // predecessor key exists, and false otherwise.
-template <typename K, typename V>
-bool BSTMap<K, V>::prev_key(const K &key, K &prev_key) const
+template <typename K, typename V, typename A>
+bool BSTMap<K, V, A>::prev_key(const K &key, K &prev_key) const
 {
   // No keys exist
   if (empty())
@@ -524,15 +622,36 @@ bool BSTMap<K, V>::prev_key(const K &key, K &prev_key) const
 }
 
 // Removes all key-value pairs from the map.
-template <typename K, typename V>
-void BSTMap<K, V>::clear()
+template <typename K, typename V, typename A>
+void BSTMap<K, V, A>::clear()
+{
+  // nodes that need no destructor go back with their slabs
+  if (pool.drops_nodes)
+  {
+    count = 0;
+  }
+  else
+  {
+    clear(root);
+  }
+  pool.release();
+  root = nullptr;
+}
+
+// Replaces the contents of the map with the given key-value pairs
+template <typename K, typename V, typename A>
+void BSTMap<K, V, A>::assign(const ArraySeq<K> &keys, const ArraySeq<V> &values)
 {
-  clear(root);
+  this->check_pairs(keys, values);
+  ArraySeq<int> order = this->sorted_unique(keys);
+  clear();
+  root = build(keys, values, order, 0, order.size() - 1);
+  count = order.size();
 }
 
 // Returns the height of the binary search tree
-template <typename K, typename V>
-int BSTMap<K, V>::height() const
+template <typename K, typename V, typename A>
+int BSTMap<K, V, A>::height() const
 {
   if (empty())
   {
@@ -544,9 +663,61 @@ int BSTMap<K, V>::height() const
   }
 }
 
+// Returns an iterator at the smallest key
+template <typename K, typename V, typename A>
+typename BSTMap<K, V, A>::iterator BSTMap<K, V, A>::begin()
+{
+  return iterator(&root, leftmost());
+}
+
+template <typename K, typename V, typename A>
+typename BSTMap<K, V, A>::const_iterator BSTMap<K, V, A>::begin() const
+{
+  return const_iterator(&root, leftmost());
+}
+
+// Returns the iterator one past the largest key
+template <typename K, typename V, typename A>
+typename BSTMap<K, V, A>::iterator BSTMap<K, V, A>::end()
+{
+  return iterator(&root, nullptr);
+}
+
+template <typename K, typename V, typename A>
+typename BSTMap<K, V, A>::const_iterator BSTMap<K, V, A>::end() const
+{
+  return const_iterator(&root, nullptr);
+}
+
+// Returns an iterator at the first key not less than the given key
+template <typename K, typename V, typename A>
+typename BSTMap<K, V, A>::iterator BSTMap<K, V, A>::lower_bound(const K &key)
+{
+  return iterator(&root, bound(key, false));
+}
+
+template <typename K, typename V, typename A>
+typename BSTMap<K, V, A>::const_iterator BSTMap<K, V, A>::lower_bound(const K &key) const
+{
+  return const_iterator(&root, bound(key, false));
+}
+
+// Returns an iterator at the first key greater than the given key
+template <typename K, typename V, typename A>
+typename BSTMap<K, V, A>::iterator BSTMap<K, V, A>::upper_bound(const K &key)
+{
+  return iterator(&root, bound(key, true));
+}
+
+template <typename K, typename V, typename A>
+typename BSTMap<K, V, A>::const_iterator BSTMap<K, V, A>::upper_bound(const K &key) const
+{
+  return const_iterator(&root, bound(key, true));
+}
+
 // clean up the tree and reset count to zero given subtree root
-template <typename K, typename V>
-void BSTMap<K, V>::clear(Node *st_root)
+template <typename K, typename V, typename A>
+void BSTMap<K, V, A>::clear(Node *st_root)
 {
   count = 0;
 
@@ -554,14 +725,14 @@ void BSTMap<K, V>::clear(Node *st_root)
   {
     if (st_root->left == nullptr and st_root->right == nullptr)
     {
-      delete st_root;
+      pool.destroy(st_root);
       st_root = nullptr;
     }
     else
     {
       clear(st_root->left);
       clear(st_root->right);
-      delete st_root;
+      pool.destroy(st_root);
       st_root = nullptr;
     }
   }
@@ -570,94 +741,165 @@ void BSTMap<K, V>::clear(Node *st_root)
 }
 
 // copy assignment helper
-template <typename K, typename V>
-typename BSTMap<K, V>::Node *BSTMap<K, V>::copy(const Node *rhs_st_root) const
+template <typename K, typename V, typename A>
+typename BSTMap<K, V, A>::Node *BSTMap<K, V, A>::copy(const Node *rhs_st_root)
 {
   Node *temp = nullptr;
   if (rhs_st_root != nullptr)
   {
-    temp = new Node;
+    temp = pool.create();
     temp->key = rhs_st_root->key;
     temp->value = rhs_st_root->value;
 
+    temp->parent = nullptr;
     temp->left = copy(rhs_st_root->left);
     temp->right = copy(rhs_st_root->right);
+    if (temp->left != nullptr)
+    {
+      temp->left->parent = temp;
+    }
+    if (temp->right != nullptr)
+    {
+      temp->right->parent = temp;
+    }
   }
   return temp;
 }
 
-// erase helper
-template <typename K, typename V>
-typename BSTMap<K, V>::Node *BSTMap<K, V>::erase(const K &key, Node *st_root)
+// node of the smallest key (nullptr if empty)
+template <typename K, typename V, typename A>
+typename BSTMap<K, V, A>::Node *BSTMap<K, V, A>::leftmost() const
 {
-  Node *remove = nullptr;
-  Node *successor = nullptr;
-  Node *traverse = nullptr;
+  Node *traverse = root;
+  while (traverse != nullptr && traverse->left != nullptr)
+  {
+    traverse = traverse->left;
+  }
+  return traverse;
+}
 
-  if (key < st_root->key)
+// node of the first key not less than the key (greater than it, if
+// strict): the last node the search turned left at
+template <typename K, typename V, typename A>
+typename BSTMap<K, V, A>::Node *BSTMap<K, V, A>::bound(const K &key, bool strict) const
+{
+  Node *found = nullptr;
+  Node *traverse = root;
+  while (traverse != nullptr)
   {
-    st_root->left = erase(key, st_root->left);
+    if (key < traverse->key || (!strict && key == traverse->key))
+    {
+      found = traverse;
+      traverse = traverse->left;
+    }
+    else
+    {
+      traverse = traverse->right;
+    }
   }
-  else if (key > st_root->key)
+  return found;
+}
+
+// assign helper: the middle pair becomes the subtree root
+template <typename K, typename V, typename A>
+typename BSTMap<K, V, A>::Node *BSTMap<K, V, A>::build(const ArraySeq<K> &keys, const ArraySeq<V> &values,
+                                                       const ArraySeq<int> &order, int first, int last)
+{
+  if (first > last)
   {
-    st_root->right = erase(key, st_root->right);
+    return nullptr;
   }
-  else if (key == st_root->key)
+  int mid = first + (last - first) / 2;
+  Node *temp = pool.create();
+  temp->key = keys[order[mid]];
+  temp->value = values[order[mid]];
+  temp->parent = nullptr;
+  temp->left = build(keys, values, order, first, mid - 1);
+  temp->right = build(keys, values, order, mid + 1, last);
+  if (temp->left != nullptr)
   {
-    // Case 1: No children
-    if (st_root->left == nullptr and st_root->right == nullptr)
+    temp->left->parent = temp;
+  }
+  if (temp->right != nullptr)
+  {
+    temp->right->parent = temp;
+  }
+  return temp;
+}
+
+// returns the node holding the key, or nullptr if it is not in the map
+template <typename K, typename V, typename A>
+template <typename Q>
+typename BSTMap<K, V, A>::Node *BSTMap<K, V, A>::find_node(const Q &key) const
+{
+  Node *traverse = root;
+  while (traverse != nullptr)
+  {
+    if (key == traverse->key)
     {
-      remove = st_root;
-      st_root = nullptr;
-      delete remove;
-      count--;
+      return traverse;
     }
-    // Case 2: One child
-    else if (st_root->left == nullptr or st_root->right == nullptr)
+    else if (key > traverse->key)
     {
-      // no left
-      if (st_root->left == nullptr)
-      {
-        remove = st_root;
-        st_root = st_root->right;
-        delete remove;
-        count--;
-      }
-      // no right
-      else
-      {
-        remove = st_root;
-        st_root = st_root->left;
-        delete remove;
-        count--;
-      }
+      traverse = traverse->right;
     }
-    // Case 3: 2 Children
     else
     {
-      // Find inorder successor
-      traverse = st_root->right;
-      while (traverse != nullptr)
-      {
-        successor = traverse;
-        traverse = traverse->left;
-      }
-
-      // copy key and value
-      st_root->key = successor->key;
-      st_root->value = successor->value;
+      traverse = traverse->left;
+    }
+  }
+  return nullptr;
+}
 
-      // delete and replace successor node
-      st_root->right = erase(successor->key, st_root->right);
+// unlinks and frees a node
+template <typename K, typename V, typename A>
+void BSTMap<K, V, A>::remove_node(Node *node)
+{
+  // a node with two children takes its successor's pair, and the
+  // successor (which has no left child) is unlinked instead
+  if (node->left != nullptr && node->right != nullptr)
+  {
+    Node *successor = node->right;
+    while (successor->left != nullptr)
+    {
+      successor = successor->left;
     }
+    node->key = std::move(successor->key);
+    node->value = std::move(successor->value);
+    node = successor;
+  }
+
+  Node *child = node->left != nullptr ? node->left : node->right;
+  if (child != nullptr)
+  {
+    child->parent = node->parent;
   }
+  replace_child(node->parent, node, child);
+  pool.destroy(node);
+  count--;
+}
 
-  return st_root;
+// points the link that held old_child at new_child
+template <typename K, typename V, typename A>
+void BSTMap<K, V, A>::replace_child(Node *parent, Node *old_child, Node *new_child)
+{
+  if (parent == nullptr)
+  {
+    root = new_child;
+  }
+  else if (parent->left == old_child)
+  {
+    parent->left = new_child;
+  }
+  else
+  {
+    parent->right = new_child;
+  }
 }
 
 // find_keys helper
-template <typename K, typename V>
-void BSTMap<K, V>::find_keys(const K &k1, const K &k2, const Node *st_root, ArraySeq<K> &keys) const
+template <typename K, typename V, typename A>
+void BSTMap<K, V, A>::find_keys(const K &k1, const K &k2, const Node *st_root, ArraySeq<K> &keys) const
 {
   if (st_root == nullptr)
   {
@@ -680,8 +922,8 @@ void BSTMap<K, V>::find_keys(const K &k1, const K &k2, const Node *st_root, Arra
 }
 
 // sorted_keys helper
-template <typename K, typename V>
-void BSTMap<K, V>::sorted_keys(const Node *st_root, ArraySeq<K> &keys) const
+template <typename K, typename V, typename A>
+void BSTMap<K, V, A>::sorted_keys(const Node *st_root, ArraySeq<K> &keys) const
 {
   if (st_root == nullptr)
   {
@@ -693,8 +935,8 @@ void BSTMap<K, V>::sorted_keys(const Node *st_root, ArraySeq<K> &keys) const
 }
 
 // height helper
-template <typename K, typename V>
-int BSTMap<K, V>::height(const Node *st_root) const
+template <typename K, typename V, typename A>
+int BSTMap<K, V, A>::height(const Node *st_root) const
 {
   int leftHeight = 0, rightHeight = 0;
   if (st_root == nullptr)
@@ -0,0 +1,919 @@
+//---------------------------------------------------------------------------
+// NAME: Joey Macauley
+// FILE: compactavlmap.h
+// DATE: CPSC 223 - Spring 2022
+// DESC: Implementation of a compact AVL map. Nodes live in one growable
+//       array (the arena) and refer to each other by 32-bit index
+//       instead of by pointer. Each slot holds a key and its two child
+//       links; the node's balance factor (-1, 0, or +1) is packed into
+//       the top two bits of the left link. Values sit in a separate
+//       array with the same indexes, so a search only reads the slots
+//       it passes through. For int keys and values a node takes 16
+//       bytes, against 40 bytes plus heap overhead for an AVLMap node.
+//       Erased slots go on a free list and are reused by later inserts.
+//---------------------------------------------------------------------------
+
+#ifndef COMPACTAVLMAP_H
+#define COMPACTAVLMAP_H
+
+#include "map.h"
+#include "arrayseq.h"
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+template <typename K, typename V>
+class CompactAVLMap : public Map<K, V>
+{
+public:
+  // default constructor
+  CompactAVLMap();
+
+  // constructs a map holding the given key-value pairs (see assign)
+  CompactAVLMap(const ArraySeq<K> &keys, const ArraySeq<V> &values);
+
+  // copy constructor
+  CompactAVLMap(const CompactAVLMap &rhs);
+
+  // move constructor
+  CompactAVLMap(CompactAVLMap &&rhs);
+
+  // copy assignment
+  CompactAVLMap &operator=(const CompactAVLMap &rhs);
+
+  // move assignment
+  CompactAVLMap &operator=(CompactAVLMap &&rhs);
+
+  // destructor
+  ~CompactAVLMap();
+
+  // Returns the number of key-value pairs in the map
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Allows values associated with a key to be updated. Throws
+  // out_of_range if the given key is not in the collection.
+  V &operator[](const K &key);
+
+  // Returns the value for a given key. Throws out_of_range if the
+  // given key is not in the collection.
+  const V &operator[](const K &key) const;
+
+  // Extends the collection by adding the given key-value pair.
+  // Expects key to not exist in map prior to insertion. Throws
+  // out_of_range if the map already holds MAX_NODES keys.
+  void insert(const K &key, const V &value);
+
+  // Shrinks the collection by removing the key-value pair with the
+  // given key. Does not modify the collection if the collection does
+  // not contain the key. Throws out_of_range if the given key is not
+  // in the collection.
+  void erase(const K &key);
+
+  // Returns true if the key is in the collection, and false otherwise.
+  bool contains(const K &key) const;
+
+  // Returns the keys k in the collection such that k1 <= k <= k2
+  ArraySeq<K> find_keys(const K &k1, const K &k2) const;
+
+  // Returns the keys in the collection in ascending sorted order
+  ArraySeq<K> sorted_keys() const;
+
+  // Gives the key (as an ouptput parameter) immediately after the
+  // given key according to ascending sort order. Returns true if a
+  // successor key exists, and false otherwise.
+  bool next_key(const K &key, K &next_key) const;
+
+  // Gives the key (as an ouptput parameter) immediately before the
+  // given key according to ascending sort order. Returns true if a
+  // predecessor key exists, and false otherwise.
+  bool prev_key(const K &key, K &prev_key) const;
+
+  // Removes all key-value pairs from the map. Does not change the
+  // arena's capacity.
+  void clear();
+
+  // Replaces the contents of the map with the given key-value pairs
+  // (keys[i] maps to values[i]), keeping the first pair of a repeated
+  // key. Builds a perfectly balanced tree with its nodes in
+  // breadth-first order (so the top of the tree is packed together at
+  // the front of the arena). Throws out_of_range if keys and values
+  // differ in size.
+  void assign(const ArraySeq<K> &keys, const ArraySeq<V> &values);
+
+  // Grows the arena (if needed) so n keys fit without another grow
+  void reserve(int n);
+
+  // Returns the height of the binary search tree (O(log n), following
+  // the balance factors down the taller side)
+  int height() const;
+
+  // Returns the bytes used by the arena (slots and values, including
+  // unused capacity)
+  long arena_bytes() const;
+
+  // most keys a map can hold (indexes take 30 bits)
+  static const int MAX_NODES = (1 << 30) - 2;
+
+private:
+  // a node's key and child links. The top two bits of left hold the
+  // balance factor plus one; index 0 is the null link.
+  struct Slot
+  {
+    K key;
+    std::uint32_t left;
+    std::uint32_t right;
+  };
+
+  static const std::uint32_t INDEX_MASK = (1u << 30) - 1;
+  static const int BALANCE_SHIFT = 30;
+
+  // the arena: slots[i] and values[i] make up node i (slot 0 is never
+  // used, so that index 0 can mean null)
+  Slot *slots = nullptr;
+  V *values = nullptr;
+  int capacity = 0;
+
+  // slots handed out so far (including slot 0), and the first erased
+  // slot (chained through the right links), or 0 if there is none
+  int used = 1;
+  std::uint32_t free_list = 0;
+
+  // number of key-value pairs in map
+  int count = 0;
+
+  // index of the root (0 if empty)
+  std::uint32_t root = 0;
+
+  // links and balance factor of a node
+  std::uint32_t left(std::uint32_t node) const;
+  std::uint32_t right(std::uint32_t node) const;
+  int balance(std::uint32_t node) const;
+  void set_left(std::uint32_t node, std::uint32_t child);
+  void set_balance(std::uint32_t node, int bf);
+
+  // returns a leaf holding the pair (from the free list, or else the
+  // end of the arena)
+  std::uint32_t new_node(const K &key, const V &value);
+
+  // puts a node's slot on the free list
+  void free_node(std::uint32_t node);
+
+  // moves the arena into arrays of the given capacity
+  void grow(int new_capacity);
+
+  // returns the node holding the key, or 0 if it is not in the map
+  std::uint32_t find_node(const K &key) const;
+
+  // insert helper: returns the subtree's new root, and sets grew if
+  // the subtree got taller
+  std::uint32_t insert(std::uint32_t node, const K &key, const V &value, bool &grew);
+
+  // erase helper (the key must be in the subtree): returns the
+  // subtree's new root, and sets shrunk if the subtree got shorter
+  std::uint32_t erase(std::uint32_t node, const K &key, bool &shrunk);
+
+  // unlinks the smallest node of a subtree into min, returning the
+  // subtree's new root
+  std::uint32_t remove_min(std::uint32_t node, std::uint32_t &min, bool &shrunk);
+
+  // update a node's balance after one of its subtrees got one shorter
+  // (rotating if needed), returning the subtree's new root and setting
+  // shrunk if the whole subtree got shorter
+  std::uint32_t left_shrank(std::uint32_t node, bool &shrunk);
+  std::uint32_t right_shrank(std::uint32_t node, bool &shrunk);
+
+  // rotations for a node whose left (right) subtree is two taller than
+  // the other: a single rotation if the taller child leans the same way
+  // or not at all, and a double rotation otherwise. Returns the new
+  // subtree root with every balance factor set.
+  std::uint32_t fix_left_heavy(std::uint32_t node);
+  std::uint32_t fix_right_heavy(std::uint32_t node);
+
+  // assign helper: builds a balanced tree from the sorted pairs into
+  // an empty arena, one level at a time
+  void build(const ArraySeq<K> &keys, const ArraySeq<V> &values, const ArraySeq<int> &order);
+
+  // find_keys helper
+  void find_keys(const K &k1, const K &k2, std::uint32_t node, ArraySeq<K> &keys) const;
+
+  // sorted_keys helper
+  void sorted_keys(std::uint32_t node, ArraySeq<K> &keys) const;
+};
+
+// default constructor
+template <typename K, typename V>
+CompactAVLMap<K, V>::CompactAVLMap()
+{
+}
+
+// constructs a map holding the given key-value pairs
+template <typename K, typename V>
+CompactAVLMap<K, V>::CompactAVLMap(const ArraySeq<K> &keys, const ArraySeq<V> &values)
+{
+  assign(keys, values);
+}
+
+// copy constructor
+template <typename K, typename V>
+CompactAVLMap<K, V>::CompactAVLMap(const CompactAVLMap &rhs)
+{
+  *this = rhs;
+}
+
+// move constructor
+template <typename K, typename V>
+CompactAVLMap<K, V>::CompactAVLMap(CompactAVLMap &&rhs)
+{
+  *this = std::move(rhs);
+}
+
+// copy assignment (the arena is copied as is, free list and all)
+template <typename K, typename V>
+CompactAVLMap<K, V> &CompactAVLMap<K, V>::operator=(const CompactAVLMap &rhs)
+{
+  if (this != &rhs)
+  {
+    delete[] slots;
+    delete[] values;
+    slots = nullptr;
+    values = nullptr;
+    capacity = 0;
+    if (rhs.capacity > 0)
+    {
+      slots = new Slot[rhs.capacity];
+      values = new V[rhs.capacity];
+      capacity = rhs.capacity;
+      for (int i = 0; i < rhs.used; ++i)
+      {
+        slots[i] = rhs.slots[i];
+        values[i] = rhs.values[i];
+      }
+    }
+    used = rhs.used;
+    free_list = rhs.free_list;
+    count = rhs.count;
+    root = rhs.root;
+  }
+  return *this;
+}
+
+// move assignment
+template <typename K, typename V>
+CompactAVLMap<K, V> &CompactAVLMap<K, V>::operator=(CompactAVLMap &&rhs)
+{
+  if (this != &rhs)
+  {
+    delete[] slots;
+    delete[] values;
+    slots = rhs.slots;
+    values = rhs.values;
+    capacity = rhs.capacity;
+    used = rhs.used;
+    free_list = rhs.free_list;
+    count = rhs.count;
+    root = rhs.root;
+
+    rhs.slots = nullptr;
+    rhs.values = nullptr;
+    rhs.capacity = 0;
+    rhs.used = 1;
+    rhs.free_list = 0;
+    rhs.count = 0;
+    rhs.root = 0;
+  }
+  return *this;
+}
+
+// destructor
+template <typename K, typename V>
+CompactAVLMap<K, V>::~CompactAVLMap()
+{
+  delete[] slots;
+  delete[] values;
+}
+
+// Returns the number of key-value pairs in the map
+template <typename K, typename V>
+int CompactAVLMap<K, V>::size() const
+{
+  return count;
+}
+
+// Tests if the map is empty
+template <typename K, typename V>
+bool CompactAVLMap<K, V>::empty() const
+{
+  return count == 0;
+}
+
+// Allows values associated with a key to be updated
+template <typename K, typename V>
+V &CompactAVLMap<K, V>::operator[](const K &key)
+{
+  std::uint32_t node = find_node(key);
+  if (node == 0)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return values[node];
+}
+
+// Returns the value for a given key
+template <typename K, typename V>
+const V &CompactAVLMap<K, V>::operator[](const K &key) const
+{
+  std::uint32_t node = find_node(key);
+  if (node == 0)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return values[node];
+}
+
+// Extends the collection by adding the given key-value pair
+template <typename K, typename V>
+void CompactAVLMap<K, V>::insert(const K &key, const V &value)
+{
+  if (count >= MAX_NODES)
+  {
+    throw std::out_of_range("Map is full");
+  }
+  bool grew = false;
+  root = insert(root, key, value, grew);
+  count++;
+}
+
+// Shrinks the collection by removing the key-value pair with the
+// given key
+template <typename K, typename V>
+void CompactAVLMap<K, V>::erase(const K &key)
+{
+  if (find_node(key) == 0)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  bool shrunk = false;
+  root = erase(root, key, shrunk);
+  count--;
+}
+
+// Returns true if the key is in the collection, and false otherwise
+template <typename K, typename V>
+bool CompactAVLMap<K, V>::contains(const K &key) const
+{
+  return find_node(key) != 0;
+}
+
+// Returns the keys k in the collection such that k1 <= k <= k2
+template <typename K, typename V>
+ArraySeq<K> CompactAVLMap<K, V>::find_keys(const K &k1, const K &k2) const
+{
+  ArraySeq<K> keys;
+  find_keys(k1, k2, root, keys);
+  return keys;
+}
+
+// Returns the keys in the collection in ascending sorted order
+template <typename K, typename V>
+ArraySeq<K> CompactAVLMap<K, V>::sorted_keys() const
+{
+  ArraySeq<K> keys;
+  sorted_keys(root, keys);
+  return keys;
+}
+
+// Gives the key immediately after the given key: the last node the
+// search turned left at
+template <typename K, typename V>
+bool CompactAVLMap<K, V>::next_key(const K &key, K &next_key) const
+{
+  std::uint32_t next = 0;
+  std::uint32_t node = root;
+  while (node != 0)
+  {
+    if (key < slots[node].key)
+    {
+      next = node;
+      node = left(node);
+    }
+    else
+    {
+      node = right(node);
+    }
+  }
+  if (next == 0)
+  {
+    return false;
+  }
+  next_key = slots[next].key;
+  return true;
+}
+
+// Gives the key immediately before the given key: the last node the
+// search turned right at
+template <typename K, typename V>
+bool CompactAVLMap<K, V>::prev_key(const K &key, K &prev_key) const
+{
+  std::uint32_t prev = 0;
+  std::uint32_t node = root;
+  while (node != 0)
+  {
+    if (slots[node].key < key)
+    {
+      prev = node;
+      node = right(node);
+    }
+    else
+    {
+      node = left(node);
+    }
+  }
+  if (prev == 0)
+  {
+    return false;
+  }
+  prev_key = slots[prev].key;
+  return true;
+}
+
+// Removes all key-value pairs from the map
+template <typename K, typename V>
+void CompactAVLMap<K, V>::clear()
+{
+  for (int i = 1; i < used; ++i)
+  {
+    slots[i].key = K();
+    values[i] = V();
+  }
+  used = 1;
+  free_list = 0;
+  count = 0;
+  root = 0;
+}
+
+// Replaces the contents of the map with the given key-value pairs
+template <typename K, typename V>
+void CompactAVLMap<K, V>::assign(const ArraySeq<K> &keys, const ArraySeq<V> &values)
+{
+  this->check_pairs(keys, values);
+  ArraySeq<int> order = this->sorted_unique(keys);
+  clear();
+  reserve(order.size());
+  build(keys, values, order);
+  count = order.size();
+}
+
+// Grows the arena (if needed) so n keys fit without another grow
+template <typename K, typename V>
+void CompactAVLMap<K, V>::reserve(int n)
+{
+  if (n + 1 > capacity)
+  {
+    grow(n + 1);
+  }
+}
+
+// Returns the height of the binary search tree
+template <typename K, typename V>
+int CompactAVLMap<K, V>::height() const
+{
+  int height = 0;
+  std::uint32_t node = root;
+  while (node != 0)
+  {
+    height++;
+    node = balance(node) < 0 ? left(node) : right(node);
+  }
+  return height;
+}
+
+// Returns the bytes used by the arena
+template <typename K, typename V>
+long CompactAVLMap<K, V>::arena_bytes() const
+{
+  return static_cast<long>(capacity) * (sizeof(Slot) + sizeof(V));
+}
+
+// links and balance factor of a node
+template <typename K, typename V>
+std::uint32_t CompactAVLMap<K, V>::left(std::uint32_t node) const
+{
+  return slots[node].left & INDEX_MASK;
+}
+
+template <typename K, typename V>
+std::uint32_t CompactAVLMap<K, V>::right(std::uint32_t node) const
+{
+  return slots[node].right;
+}
+
+template <typename K, typename V>
+int CompactAVLMap<K, V>::balance(std::uint32_t node) const
+{
+  return static_cast<int>(slots[node].left >> BALANCE_SHIFT) - 1;
+}
+
+template <typename K, typename V>
+void CompactAVLMap<K, V>::set_left(std::uint32_t node, std::uint32_t child)
+{
+  slots[node].left = (slots[node].left & ~INDEX_MASK) | child;
+}
+
+template <typename K, typename V>
+void CompactAVLMap<K, V>::set_balance(std::uint32_t node, int bf)
+{
+  slots[node].left = (slots[node].left & INDEX_MASK) | (static_cast<std::uint32_t>(bf + 1) << BALANCE_SHIFT);
+}
+
+// returns a leaf holding the pair
+template <typename K, typename V>
+std::uint32_t CompactAVLMap<K, V>::new_node(const K &key, const V &value)
+{
+  std::uint32_t node = free_list;
+  if (node != 0)
+  {
+    free_list = slots[node].right;
+  }
+  else
+  {
+    if (used >= capacity)
+    {
+      grow(capacity < 16 ? 16 : 2 * capacity);
+    }
+    node = used;
+    used++;
+  }
+  slots[node].key = key;
+  slots[node].left = 0;
+  slots[node].right = 0;
+  set_balance(node, 0);
+  values[node] = value;
+  return node;
+}
+
+// puts a node's slot on the free list (dropping the old pair)
+template <typename K, typename V>
+void CompactAVLMap<K, V>::free_node(std::uint32_t node)
+{
+  slots[node].key = K();
+  values[node] = V();
+  slots[node].left = 0;
+  slots[node].right = free_list;
+  free_list = node;
+}
+
+// moves the arena into arrays of the given capacity
+template <typename K, typename V>
+void CompactAVLMap<K, V>::grow(int new_capacity)
+{
+  if (new_capacity > MAX_NODES + 1)
+  {
+    new_capacity = MAX_NODES + 1;
+  }
+  Slot *new_slots = new Slot[new_capacity];
+  V *new_values = new V[new_capacity];
+  for (int i = 0; i < used && i < capacity; ++i)
+  {
+    new_slots[i] = std::move(slots[i]);
+    new_values[i] = std::move(values[i]);
+  }
+  delete[] slots;
+  delete[] values;
+  slots = new_slots;
+  values = new_values;
+  capacity = new_capacity;
+}
+
+// returns the node holding the key, or 0 if it is not in the map
+template <typename K, typename V>
+std::uint32_t CompactAVLMap<K, V>::find_node(const K &key) const
+{
+  std::uint32_t node = root;
+  while (node != 0)
+  {
+    const Slot &slot = slots[node];
+    if (key == slot.key)
+    {
+      return node;
+    }
+    // written so the compiler picks the link with a conditional move
+    // and masks afterwards (the right link has no balance bits, so
+    // the mask leaves it alone): the turn is a coin flip the branch
+    // predictor misses half the time, and branching on it made
+    // lookups about twice as slow
+    std::uint32_t link = slot.left;
+    node = key < slot.key ? link : slot.right;
+    node &= INDEX_MASK;
+  }
+  return 0;
+}
+
+// insert helper: a subtree that got taller tips its parent's balance
+// toward it, and a parent that was already leaning that way is
+// rotated (which brings the height back down, so nothing above
+// changes)
+template <typename K, typename V>
+std::uint32_t CompactAVLMap<K, V>::insert(std::uint32_t node, const K &key, const V &value, bool &grew)
+{
+  if (node == 0)
+  {
+    grew = true;
+    return new_node(key, value);
+  }
+  if (key < slots[node].key)
+  {
+    std::uint32_t child = insert(left(node), key, value, grew);
+    set_left(node, child);
+    if (grew)
+    {
+      int bf = balance(node);
+      if (bf > 0)
+      {
+        set_balance(node, 0);
+        grew = false;
+      }
+      else if (bf == 0)
+      {
+        set_balance(node, -1);
+      }
+      else
+      {
+        node = fix_left_heavy(node);
+        grew = false;
+      }
+    }
+  }
+  else
+  {
+    std::uint32_t child = insert(right(node), key, value, grew);
+    slots[node].right = child;
+    if (grew)
+    {
+      int bf = balance(node);
+      if (bf < 0)
+      {
+        set_balance(node, 0);
+        grew = false;
+      }
+      else if (bf == 0)
+      {
+        set_balance(node, 1);
+      }
+      else
+      {
+        node = fix_right_heavy(node);
+        grew = false;
+      }
+    }
+  }
+  return node;
+}
+
+// erase helper: a node with two children is replaced by its successor
+// node (relinked, so no pairs are copied)
+template <typename K, typename V>
+std::uint32_t CompactAVLMap<K, V>::erase(std::uint32_t node, const K &key, bool &shrunk)
+{
+  if (key == slots[node].key)
+  {
+    std::uint32_t l = left(node);
+    std::uint32_t r = right(node);
+    if (l == 0 || r == 0)
+    {
+      free_node(node);
+      shrunk = true;
+      return l != 0 ? l : r;
+    }
+    std::uint32_t successor = 0;
+    r = remove_min(r, successor, shrunk);
+    set_left(successor, l);
+    slots[successor].right = r;
+    set_balance(successor, balance(node));
+    free_node(node);
+    node = successor;
+    if (shrunk)
+    {
+      node = right_shrank(node, shrunk);
+    }
+  }
+  else if (key < slots[node].key)
+  {
+    std::uint32_t child = erase(left(node), key, shrunk);
+    set_left(node, child);
+    if (shrunk)
+    {
+      node = left_shrank(node, shrunk);
+    }
+  }
+  else
+  {
+    std::uint32_t child = erase(right(node), key, shrunk);
+    slots[node].right = child;
+    if (shrunk)
+    {
+      node = right_shrank(node, shrunk);
+    }
+  }
+  return node;
+}
+
+// unlinks the smallest node of a subtree into min
+template <typename K, typename V>
+std::uint32_t CompactAVLMap<K, V>::remove_min(std::uint32_t node, std::uint32_t &min, bool &shrunk)
+{
+  if (left(node) == 0)
+  {
+    min = node;
+    shrunk = true;
+    return right(node);
+  }
+  std::uint32_t child = remove_min(left(node), min, shrunk);
+  set_left(node, child);
+  if (shrunk)
+  {
+    node = left_shrank(node, shrunk);
+  }
+  return node;
+}
+
+// the left subtree got one shorter
+template <typename K, typename V>
+std::uint32_t CompactAVLMap<K, V>::left_shrank(std::uint32_t node, bool &shrunk)
+{
+  int bf = balance(node);
+  if (bf < 0)
+  {
+    set_balance(node, 0);
+    return node;
+  }
+  if (bf == 0)
+  {
+    set_balance(node, 1);
+    shrunk = false;
+    return node;
+  }
+  // a single rotation over a balanced child keeps the height
+  shrunk = balance(right(node)) != 0;
+  return fix_right_heavy(node);
+}
+
+// the right subtree got one shorter
+template <typename K, typename V>
+std::uint32_t CompactAVLMap<K, V>::right_shrank(std::uint32_t node, bool &shrunk)
+{
+  int bf = balance(node);
+  if (bf > 0)
+  {
+    set_balance(node, 0);
+    return node;
+  }
+  if (bf == 0)
+  {
+    set_balance(node, -1);
+    shrunk = false;
+    return node;
+  }
+  shrunk = balance(left(node)) != 0;
+  return fix_left_heavy(node);
+}
+
+// rotations for a node whose left subtree is two taller
+template <typename K, typename V>
+std::uint32_t CompactAVLMap<K, V>::fix_left_heavy(std::uint32_t node)
+{
+  std::uint32_t child = left(node);
+  int child_bf = balance(child);
+  if (child_bf <= 0)
+  {
+    set_left(node, right(child));
+    slots[child].right = node;
+    set_balance(node, child_bf == 0 ? -1 : 0);
+    set_balance(child, child_bf == 0 ? 1 : 0);
+    return child;
+  }
+  std::uint32_t grandchild = right(child);
+  int grandchild_bf = balance(grandchild);
+  slots[child].right = left(grandchild);
+  set_left(node, slots[grandchild].right);
+  set_left(grandchild, child);
+  slots[grandchild].right = node;
+  set_balance(node, grandchild_bf < 0 ? 1 : 0);
+  set_balance(child, grandchild_bf > 0 ? -1 : 0);
+  set_balance(grandchild, 0);
+  return grandchild;
+}
+
+// rotations for a node whose right subtree is two taller
+template <typename K, typename V>
+std::uint32_t CompactAVLMap<K, V>::fix_right_heavy(std::uint32_t node)
+{
+  std::uint32_t child = right(node);
+  int child_bf = balance(child);
+  if (child_bf >= 0)
+  {
+    slots[node].right = left(child);
+    set_left(child, node);
+    set_balance(node, child_bf == 0 ? 1 : 0);
+    set_balance(child, child_bf == 0 ? -1 : 0);
+    return child;
+  }
+  std::uint32_t grandchild = left(child);
+  int grandchild_bf = balance(grandchild);
+  set_left(child, slots[grandchild].right);
+  slots[node].right = left(grandchild);
+  set_left(grandchild, node);
+  slots[grandchild].right = child;
+  set_balance(node, grandchild_bf > 0 ? -1 : 0);
+  set_balance(child, grandchild_bf < 0 ? 1 : 0);
+  set_balance(grandchild, 0);
+  return grandchild;
+}
+
+// assign helper: the middle pair of each range becomes the subtree
+// root. Ranges are taken in breadth-first order, so the top levels of
+// the tree sit together at the front of the arena (a preorder layout
+// spreads them over the whole arena and a search misses the cache at
+// nearly every level). Node i is the range at position i - 1 of the
+// queue, so a range's children get the indexes of the positions they
+// are queued at. Splitting at the middle makes a range of s pairs
+// exactly bit-width(s) tall, which gives each balance factor without
+// measuring the subtrees.
+template <typename K, typename V>
+void CompactAVLMap<K, V>::build(const ArraySeq<K> &keys, const ArraySeq<V> &values, const ArraySeq<int> &order)
+{
+  int n = order.size();
+  if (n == 0)
+  {
+    return;
+  }
+  auto height = [](int size) {
+    int h = 0;
+    for (; size > 0; size >>= 1)
+    {
+      h++;
+    }
+    return h;
+  };
+  std::pair<int, int> *ranges = new std::pair<int, int>[n];
+  ranges[0] = std::make_pair(0, n - 1);
+  int queued = 1;
+  for (int i = 0; i < n; ++i)
+  {
+    int first = ranges[i].first;
+    int last = ranges[i].second;
+    int mid = first + (last - first) / 2;
+    std::uint32_t node = new_node(keys[order[mid]], values[order[mid]]);
+    if (first < mid)
+    {
+      set_left(node, queued + 1);
+      ranges[queued++] = std::make_pair(first, mid - 1);
+    }
+    if (mid < last)
+    {
+      slots[node].right = queued + 1;
+      ranges[queued++] = std::make_pair(mid + 1, last);
+    }
+    set_balance(node, height(last - mid) - height(mid - first));
+  }
+  delete[] ranges;
+  root = 1;
+}
+
+// find_keys helper (skips the subtrees wholly outside [k1, k2])
+template <typename K, typename V>
+void CompactAVLMap<K, V>::find_keys(const K &k1, const K &k2, std::uint32_t node, ArraySeq<K> &keys) const
+{
+  if (node == 0)
+  {
+    return;
+  }
+  if (k1 < slots[node].key)
+  {
+    find_keys(k1, k2, left(node), keys);
+  }
+  if (!(slots[node].key < k1) && !(k2 < slots[node].key))
+  {
+    keys.insert(slots[node].key, keys.size());
+  }
+  if (slots[node].key < k2)
+  {
+    find_keys(k1, k2, right(node), keys);
+  }
+}
+
+// sorted_keys helper
+template <typename K, typename V>
+void CompactAVLMap<K, V>::sorted_keys(std::uint32_t node, ArraySeq<K> &keys) const
+{
+  if (node != 0)
+  {
+    sorted_keys(left(node), keys);
+    keys.insert(slots[node].key, keys.size());
+    sorted_keys(right(node), keys);
+  }
+}
+
+#endif
@@ -0,0 +1,488 @@
+//---------------------------------------------------------------------------
+// NAME: Joey Macauley
+// FILE: concurrenthashmap.h
+// DATE: CPSC 223 - Spring 2022
+// DESC: Implementation of a thread-safe chained hash map using lock
+//       striping. The buckets are split over a fixed number of stripes,
+//       each with its own mutex, so threads working on keys in
+//       different stripes never wait for each other. A key's stripe
+//       comes from the low bits of its hash code and the table size is
+//       always a multiple of the stripe count, so a bucket stays in the
+//       same stripe at every table size. Growing the table takes every
+//       stripe lock (in order) and relinks the nodes using their stored
+//       hash codes.
+//---------------------------------------------------------------------------
+
+#ifndef CONCURRENTHASHMAP_H
+#define CONCURRENTHASHMAP_H
+
+#include "arrayseq.h"
+#include "hashpolicy.h"
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+
+// H is the hash policy (see hashpolicy.h). Every member function may be
+// called from any number of threads at once.
+template <typename K, typename V, typename H = WyHash<K>>
+class ConcurrentHashMap
+{
+public:
+  // default constructor
+  ConcurrentHashMap();
+
+  // constructs an empty map whose hash codes are mixed with the seed
+  explicit ConcurrentHashMap(std::uint64_t seed);
+
+  // the map is shared between threads by reference, never copied or
+  // moved
+  ConcurrentHashMap(const ConcurrentHashMap &rhs) = delete;
+  ConcurrentHashMap &operator=(const ConcurrentHashMap &rhs) = delete;
+
+  // destructor
+  ~ConcurrentHashMap();
+
+  // Returns the number of key-value pairs in the map. While other
+  // threads are writing this is only a snapshot.
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Adds the key-value pair if the key is not already in the map.
+  // Returns true if the pair was added and false if the key exists.
+  bool insert_if_absent(const K &key, const V &value);
+
+  // Replaces the value for an existing key. Returns true if the key
+  // was found and false otherwise.
+  bool update(const K &key, const V &value);
+
+  // Applies fn(value) to the value for the key while holding its
+  // stripe lock, so read-modify-write updates are atomic. Returns true
+  // if the key was found and false otherwise.
+  template <typename F>
+  bool update_with(const K &key, F fn);
+
+  // Removes the key-value pair with the given key. Returns true if the
+  // key was found and false otherwise.
+  bool erase(const K &key);
+
+  // Copies the value for the key into value. Returns true if the key
+  // was found and false otherwise.
+  bool get(const K &key, V &value) const;
+
+  // Returns the value for a given key. Throws out_of_range if the
+  // given key is not in the collection.
+  V at(const K &key) const;
+
+  // Returns true if the key is in the collection, and false otherwise.
+  bool contains(const K &key) const;
+
+  // Returns the keys in the collection in ascending sorted order (a
+  // consistent snapshot; all stripes are locked while it is taken)
+  ArraySeq<K> sorted_keys() const;
+
+  // Removes all key-value pairs from the map. Does not change the
+  // current capacity of the table.
+  void clear();
+
+  // Returns the number of buckets in the table
+  int bucket_count() const;
+
+  // Returns the number of lock stripes
+  static int stripe_count();
+
+private:
+  // node for linked-list separate chaining (with its full hash code so
+  // growing never rehashes keys)
+  struct Node
+  {
+    K key;
+    V value;
+    std::uint64_t code;
+    Node *next;
+  };
+
+  // number of lock stripes (a power of two)
+  static const int STRIPES = 64;
+
+  // a lock and the number of keys in the stripe's buckets, padded to a
+  // cache line so neighbouring stripes do not share one
+  struct alignas(64) Stripe
+  {
+    std::mutex lock;
+    int count = 0;
+  };
+
+  // lock per stripe (locked by const readers too)
+  mutable Stripe stripes[STRIPES];
+
+  // max size of the (array) table (a power of two, at least STRIPES).
+  // Only changed while every stripe is locked.
+  int capacity = STRIPES * 4;
+
+  // array of linked lists
+  Node **table = nullptr;
+
+  // hash policy and the seed mixed into every hash code
+  H hasher;
+  std::uint64_t hash_seed = 0;
+
+  // threshold for resize and rehash
+  const double load_factor_threshold = 0.75;
+
+  // the full hash code of a key
+  std::uint64_t hash_code(const K &key) const;
+
+  // the stripe that guards every bucket a hash code can map to
+  Stripe &stripe(std::uint64_t code) const;
+
+  // returns the node for the key in its bucket or nullptr (the key's
+  // stripe must be locked)
+  Node *find_node(const K &key, std::uint64_t code) const;
+
+  // doubles the table unless another thread already grew it past
+  // seen_capacity
+  void grow(int seen_capacity);
+
+  // lock and unlock every stripe in index order
+  void lock_all() const;
+  void unlock_all() const;
+
+  // destroy every node (all stripes must be locked)
+  void destroy_nodes();
+};
+
+// default constructor
+template <typename K, typename V, typename H>
+ConcurrentHashMap<K, V, H>::ConcurrentHashMap()
+{
+  table = new Node *[capacity]();
+}
+
+// constructs an empty map whose hash codes are mixed with the seed
+template <typename K, typename V, typename H>
+ConcurrentHashMap<K, V, H>::ConcurrentHashMap(std::uint64_t seed)
+    : hash_seed(seed)
+{
+  table = new Node *[capacity]();
+}
+
+// destructor
+template <typename K, typename V, typename H>
+ConcurrentHashMap<K, V, H>::~ConcurrentHashMap()
+{
+  destroy_nodes();
+  delete[] table;
+}
+
+// Returns the number of key-value pairs in the map
+template <typename K, typename V, typename H>
+int ConcurrentHashMap<K, V, H>::size() const
+{
+  int total = 0;
+  for (int i = 0; i < STRIPES; ++i)
+  {
+    std::lock_guard<std::mutex> guard(stripes[i].lock);
+    total += stripes[i].count;
+  }
+  return total;
+}
+
+// Tests if the map is empty
+template <typename K, typename V, typename H>
+bool ConcurrentHashMap<K, V, H>::empty() const
+{
+  if (size() == 0)
+  {
+    return true;
+  }
+  return false;
+}
+
+// Adds the key-value pair if the key is not already in the map
+template <typename K, typename V, typename H>
+bool ConcurrentHashMap<K, V, H>::insert_if_absent(const K &key, const V &value)
+{
+  std::uint64_t code = hash_code(key);
+  Stripe &s = stripe(code);
+  int seen_capacity = 0;
+  bool full = false;
+
+  {
+    std::lock_guard<std::mutex> guard(s.lock);
+    if (find_node(key, code) != nullptr)
+    {
+      return false;
+    }
+
+    Node *temp = new Node;
+    temp->key = key;
+    temp->value = value;
+    temp->code = code;
+
+    Node *&head = table[code & static_cast<std::uint64_t>(capacity - 1)];
+    temp->next = head;
+    head = temp;
+    s.count++;
+
+    // each stripe owns capacity / STRIPES buckets, so a well spread
+    // hash fills every stripe at about the same rate
+    seen_capacity = capacity;
+    full = static_cast<double>(s.count) * STRIPES / capacity >= load_factor_threshold;
+  }
+
+  if (full)
+  {
+    grow(seen_capacity);
+  }
+  return true;
+}
+
+// Replaces the value for an existing key
+template <typename K, typename V, typename H>
+bool ConcurrentHashMap<K, V, H>::update(const K &key, const V &value)
+{
+  return update_with(key, [&](V &current)
+  {
+    current = value;
+  });
+}
+
+// Applies fn(value) to the value for the key while holding its stripe
+// lock
+template <typename K, typename V, typename H>
+template <typename F>
+bool ConcurrentHashMap<K, V, H>::update_with(const K &key, F fn)
+{
+  std::uint64_t code = hash_code(key);
+  Stripe &s = stripe(code);
+  std::lock_guard<std::mutex> guard(s.lock);
+
+  Node *node = find_node(key, code);
+  if (node == nullptr)
+  {
+    return false;
+  }
+  fn(node->value);
+  return true;
+}
+
+// Removes the key-value pair with the given key
+template <typename K, typename V, typename H>
+bool ConcurrentHashMap<K, V, H>::erase(const K &key)
+{
+  std::uint64_t code = hash_code(key);
+  Stripe &s = stripe(code);
+  std::lock_guard<std::mutex> guard(s.lock);
+
+  Node **link = &table[code & static_cast<std::uint64_t>(capacity - 1)];
+  while (*link != nullptr)
+  {
+    if ((*link)->code == code && (*link)->key == key)
+    {
+      Node *remove = *link;
+      *link = remove->next;
+      delete remove;
+      s.count--;
+      return true;
+    }
+    link = &(*link)->next;
+  }
+  return false;
+}
+
+// Copies the value for the key into value
+template <typename K, typename V, typename H>
+bool ConcurrentHashMap<K, V, H>::get(const K &key, V &value) const
+{
+  std::uint64_t code = hash_code(key);
+  std::lock_guard<std::mutex> guard(stripe(code).lock);
+
+  Node *node = find_node(key, code);
+  if (node == nullptr)
+  {
+    return false;
+  }
+  value = node->value;
+  return true;
+}
+
+// Returns the value for a given key. Throws out_of_range if the given
+// key is not in the collection.
+template <typename K, typename V, typename H>
+V ConcurrentHashMap<K, V, H>::at(const K &key) const
+{
+  V value;
+  if (!get(key, value))
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return value;
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template <typename K, typename V, typename H>
+bool ConcurrentHashMap<K, V, H>::contains(const K &key) const
+{
+  std::uint64_t code = hash_code(key);
+  std::lock_guard<std::mutex> guard(stripe(code).lock);
+
+  return find_node(key, code) != nullptr;
+}
+
+// Returns the keys in the collection in ascending sorted order
+template <typename K, typename V, typename H>
+ArraySeq<K> ConcurrentHashMap<K, V, H>::sorted_keys() const
+{
+  ArraySeq<K> keys;
+
+  lock_all();
+  for (int i = 0; i < capacity; ++i)
+  {
+    for (Node *traverse = table[i]; traverse != nullptr; traverse = traverse->next)
+    {
+      keys.insert(traverse->key, keys.size());
+    }
+  }
+  unlock_all();
+
+  keys.sort();
+  return keys;
+}
+
+// Removes all key-value pairs from the map
+template <typename K, typename V, typename H>
+void ConcurrentHashMap<K, V, H>::clear()
+{
+  lock_all();
+  destroy_nodes();
+  unlock_all();
+}
+
+// Returns the number of buckets in the table
+template <typename K, typename V, typename H>
+int ConcurrentHashMap<K, V, H>::bucket_count() const
+{
+  lock_all();
+  int buckets = capacity;
+  unlock_all();
+  return buckets;
+}
+
+// Returns the number of lock stripes
+template <typename K, typename V, typename H>
+int ConcurrentHashMap<K, V, H>::stripe_count()
+{
+  return STRIPES;
+}
+
+// the full hash code of a key
+template <typename K, typename V, typename H>
+std::uint64_t ConcurrentHashMap<K, V, H>::hash_code(const K &key) const
+{
+  return hasher(key, hash_seed);
+}
+
+// the stripe that guards every bucket a hash code can map to. Bucket
+// indexes keep the code's low bits, so the stripe is the same for
+// every table size.
+template <typename K, typename V, typename H>
+typename ConcurrentHashMap<K, V, H>::Stripe &ConcurrentHashMap<K, V, H>::stripe(std::uint64_t code) const
+{
+  return stripes[code & (STRIPES - 1)];
+}
+
+// returns the node for the key in its bucket or nullptr
+template <typename K, typename V, typename H>
+typename ConcurrentHashMap<K, V, H>::Node *ConcurrentHashMap<K, V, H>::find_node(const K &key, std::uint64_t code) const
+{
+  Node *traverse = table[code & static_cast<std::uint64_t>(capacity - 1)];
+
+  while (traverse != nullptr)
+  {
+    if (traverse->code == code && traverse->key == key)
+    {
+      return traverse;
+    }
+    traverse = traverse->next;
+  }
+  return nullptr;
+}
+
+// doubles the table unless another thread already grew it
+template <typename K, typename V, typename H>
+void ConcurrentHashMap<K, V, H>::grow(int seen_capacity)
+{
+  Node *traverse = nullptr;
+  Node *next = nullptr;
+
+  lock_all();
+  if (capacity == seen_capacity)
+  {
+    int new_capacity = capacity * 2;
+    Node **new_table = new Node *[new_capacity]();
+    std::uint64_t mask = static_cast<std::uint64_t>(new_capacity - 1);
+
+    for (int i = 0; i < capacity; ++i)
+    {
+      traverse = table[i];
+      while (traverse != nullptr)
+      {
+        next = traverse->next;
+        traverse->next = new_table[traverse->code & mask];
+        new_table[traverse->code & mask] = traverse;
+        traverse = next;
+      }
+    }
+
+    delete[] table;
+    table = new_table;
+    capacity = new_capacity;
+  }
+  unlock_all();
+}
+
+// lock every stripe in index order (the fixed order keeps two threads
+// locking all stripes from deadlocking)
+template <typename K, typename V, typename H>
+void ConcurrentHashMap<K, V, H>::lock_all() const
+{
+  for (int i = 0; i < STRIPES; ++i)
+  {
+    stripes[i].lock.lock();
+  }
+}
+
+// unlock every stripe
+template <typename K, typename V, typename H>
+void ConcurrentHashMap<K, V, H>::unlock_all() const
+{
+  for (int i = STRIPES - 1; i >= 0; --i)
+  {
+    stripes[i].lock.unlock();
+  }
+}
+
+// destroy every node
+template <typename K, typename V, typename H>
+void ConcurrentHashMap<K, V, H>::destroy_nodes()
+{
+  Node *next = nullptr;
+
+  for (int i = 0; i < capacity; ++i)
+  {
+    while (table[i] != nullptr)
+    {
+      next = table[i]->next;
+      delete table[i];
+      table[i] = next;
+    }
+  }
+  for (int i = 0; i < STRIPES; ++i)
+  {
+    stripes[i].count = 0;
+  }
+}
+
+#endif
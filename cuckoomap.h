@@ -0,0 +1,799 @@
+//---------------------------------------------------------------------------
+// NAME: Joey Macauley
+// FILE: cuckoomap.h
+// DATE: CPSC 223 - Spring 2022
+// DESC: Implementation of a bucketized cuckoo hash map. Every key has
+//       exactly two candidate buckets (picked by the two halves of one
+//       64-bit hash code), and each bucket holds four entries in one
+//       cache-line aligned block. A lookup reads the two buckets and,
+//       only while it is non-empty, a small stash, so contains() takes
+//       constant time in the worst case and not just on average.
+//
+//       Inserts that find both buckets full kick a random entry over to
+//       its other bucket, repeating up to MAX_KICKS times. An entry
+//       still left over goes into the stash, and when the stash is full
+//       too the table is rebuilt with new hash functions (doubling the
+//       table if even that fails). Two choices of four slots each keep
+//       working past 95% full, so the table needs far less slack than
+//       chaining.
+//---------------------------------------------------------------------------
+
+#ifndef CUCKOOMAP_H
+#define CUCKOOMAP_H
+
+#include "map.h"
+#include "arrayseq.h"
+#include "hashpolicy.h"
+#include <functional>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+template <typename K, typename V>
+class CuckooMap : public Map<K, V>
+{
+public:
+  // default constructor
+  CuckooMap();
+
+  // copy constructor
+  CuckooMap(const CuckooMap &rhs);
+
+  // move constructor
+  CuckooMap(CuckooMap &&rhs);
+
+  // copy assignment
+  CuckooMap &operator=(const CuckooMap &rhs);
+
+  // move assignment
+  CuckooMap &operator=(CuckooMap &&rhs);
+
+  // destructor
+  ~CuckooMap();
+
+  // Returns the number of key-value pairs in the map
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Allows values associated with a key to be updated. Throws
+  // out_of_range if the given key is not in the collection.
+  V &operator[](const K &key);
+
+  // Returns the value for a given key. Throws out_of_range if the
+  // given key is not in the collection.
+  const V &operator[](const K &key) const;
+
+  // Extends the collection by adding the given key-value pair. If
+  // the key is already in the map the collection is not modified.
+  void insert(const K &key, const V &value);
+
+  // Shrinks the collection by removing the key-value pair with the
+  // given key. Does not modify the collection if the collection does
+  // not contain the key. Throws out_of_range if the given key is not
+  // in the collection.
+  void erase(const K &key);
+
+  // Returns true if the key is in the collection, and false otherwise.
+  // Reads at most the key's two buckets and the stash.
+  bool contains(const K &key) const;
+
+  // Returns the keys k in the collection such that k1 <= k <= k2
+  ArraySeq<K> find_keys(const K &k1, const K &k2) const;
+
+  // Returns the keys in the collection in ascending sorted order
+  ArraySeq<K> sorted_keys() const;
+
+  // Gives the key (as an ouptput parameter) immediately after the
+  // given key according to ascending sort order. Returns true if a
+  // successor key exists, and false otherwise.
+  bool next_key(const K &key, K &next_key) const;
+
+  // Gives the key (as an ouptput parameter) immediately before the
+  // given key according to ascending sort order. Returns true if a
+  // predecessor key exists, and false otherwise.
+  bool prev_key(const K &key, K &next_key) const;
+
+  // Removes all key-value pairs from the map. Does not change the
+  // current capacity of the table.
+  void clear();
+
+  // Replaces the contents of the map with the given key-value pairs
+  // (keys[i] maps to values[i]), keeping the first pair of a repeated
+  // key. The table is sized for all of the pairs up front. Throws
+  // out_of_range if keys and values differ in size.
+  void assign(const ArraySeq<K> &keys, const ArraySeq<V> &values);
+
+  // Grows the table (if needed) so n keys fit under the max load
+  // factor without another resize
+  void reserve(int n);
+
+  // Sets the fraction of slots that may be full before inserts grow
+  // the table, growing it right away if it is already past it. Throws
+  // out_of_range unless 0 < load < 1.
+  void set_max_load_factor(double load);
+
+  // Returns the fraction of slots that may be full before a grow
+  double max_load_factor() const;
+
+  // Returns the fraction of slots in use
+  double load_factor() const;
+
+  // Returns the number of buckets (each holds SLOTS entries)
+  int bucket_count() const;
+
+  // Returns the number of entries waiting in the stash
+  int stash_size() const;
+
+  // Returns the bytes used by the bucket array (including the stash)
+  long table_bytes() const;
+
+  // entries per bucket and entries the stash can hold (at most SLOTS,
+  // since the stash is one more bucket)
+  static const int SLOTS = 4;
+  static const int STASH_SIZE = 4;
+
+private:
+  // four entries and a bit mask of the full slots. The alignment keeps
+  // a bucket of small keys and values inside one cache line.
+  struct alignas(64) Bucket
+  {
+    K keys[SLOTS];
+    V values[SLOTS];
+    unsigned char full;
+  };
+
+  // kicks tried before an insert falls back on the stash
+  static const int MAX_KICKS = 500;
+
+  // smallest table size in buckets
+  static const int MIN_BUCKETS = 4;
+
+  // number of key-value pairs in map
+  int count = 0;
+
+  // number of buckets (always a power of two). buckets[capacity] is
+  // the stash.
+  int capacity = MIN_BUCKETS;
+  Bucket *buckets = nullptr;
+
+  // number of entries in the stash
+  int stash_count = 0;
+
+  // fraction of slots that may be full before the table grows
+  double max_load = 0.95;
+
+  // seed mixed into every hash code (changed by each rebuild)
+  std::uint64_t hash_seed = 0;
+
+  // state of the generator that picks which entry to kick
+  std::uint64_t kick_state = 0x9e3779b97f4a7c15ULL;
+
+  // the hash function
+  std::uint64_t hash(const K &key) const;
+
+  // the two candidate buckets for a hash code (always different)
+  int first_bucket(std::uint64_t code) const;
+  int second_bucket(std::uint64_t code) const;
+
+  // returns the position (bucket * SLOTS + slot) holding key, or -1 if
+  // the key is not in the map
+  int find(const K &key) const;
+
+  // puts the entry in a free slot of the bucket. Returns false if the
+  // bucket is full.
+  bool put(int bucket, const K &key, const V &value);
+
+  // places the entry in one of its buckets, kicking other entries to
+  // their second bucket as needed. Returns false if it gave up, with
+  // the entry still left out handed back in key and value.
+  bool place(K &key, V &value);
+
+  // places the entry, using the stash if the kicks give up. Returns
+  // false if the stash is full too (the left out entry is handed back).
+  bool add(K &key, V &value);
+
+  // moves stash entries back into their buckets where there is room
+  void drain_stash();
+
+  // rebuild the table with the given number of buckets and a new hash
+  // seed, doubling the size until every entry fits
+  void resize_and_rehash(int new_capacity);
+
+  // smallest table size that holds n keys under the max load factor
+  int capacity_for(int n) const;
+
+  // calls visit(key) for every key in the table and stash
+  template <typename F>
+  void for_each_key(F visit) const;
+
+  // allocate the buckets for the current capacity with all slots empty
+  void init_table();
+
+  // release the buckets
+  void free_table();
+};
+
+// default constructor
+template <typename K, typename V>
+CuckooMap<K, V>::CuckooMap()
+{
+  init_table();
+}
+
+// copy constructor
+template <typename K, typename V>
+CuckooMap<K, V>::CuckooMap(const CuckooMap &rhs)
+{
+  *this = rhs;
+}
+
+// move constructor
+template <typename K, typename V>
+CuckooMap<K, V>::CuckooMap(CuckooMap &&rhs)
+{
+  *this = std::move(rhs);
+}
+
+// copy assignment
+template <typename K, typename V>
+CuckooMap<K, V> &CuckooMap<K, V>::operator=(const CuckooMap &rhs)
+{
+  if (this != &rhs)
+  {
+    free_table();
+    count = rhs.count;
+    capacity = rhs.capacity;
+    stash_count = rhs.stash_count;
+    max_load = rhs.max_load;
+    hash_seed = rhs.hash_seed;
+    init_table();
+
+    for (int i = 0; i <= capacity; ++i)
+    {
+      buckets[i] = rhs.buckets[i];
+    }
+  }
+  return *this;
+}
+
+// move assignment
+template <typename K, typename V>
+CuckooMap<K, V> &CuckooMap<K, V>::operator=(CuckooMap &&rhs)
+{
+  if (this != &rhs)
+  {
+    free_table();
+    count = rhs.count;
+    capacity = rhs.capacity;
+    buckets = rhs.buckets;
+    stash_count = rhs.stash_count;
+    max_load = rhs.max_load;
+    hash_seed = rhs.hash_seed;
+
+    // default state for rhs
+    rhs.buckets = nullptr;
+    rhs.count = 0;
+    rhs.capacity = MIN_BUCKETS;
+    rhs.stash_count = 0;
+    rhs.init_table();
+  }
+  return *this;
+}
+
+// destructor
+template <typename K, typename V>
+CuckooMap<K, V>::~CuckooMap()
+{
+  free_table();
+}
+
+// Returns the number of key-value pairs in the map
+template <typename K, typename V>
+int CuckooMap<K, V>::size() const
+{
+  return count;
+}
+
+// Tests if the map is empty
+template <typename K, typename V>
+bool CuckooMap<K, V>::empty() const
+{
+  return count == 0;
+}
+
+// Allows values associated with a key to be updated. Throws
+// out_of_range if the given key is not in the collection.
+template <typename K, typename V>
+V &CuckooMap<K, V>::operator[](const K &key)
+{
+  int index = find(key);
+  if (index < 0)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return buckets[index / SLOTS].values[index % SLOTS];
+}
+
+// Returns the value for a given key. Throws out_of_range if the
+// given key is not in the collection.
+template <typename K, typename V>
+const V &CuckooMap<K, V>::operator[](const K &key) const
+{
+  int index = find(key);
+  if (index < 0)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return buckets[index / SLOTS].values[index % SLOTS];
+}
+
+// Extends the collection by adding the given key-value pair. If
+// the key is already in the map the collection is not modified.
+template <typename K, typename V>
+void CuckooMap<K, V>::insert(const K &key, const V &value)
+{
+  if (find(key) >= 0)
+  {
+    return;
+  }
+
+  if (count + 1 > max_load * capacity * SLOTS)
+  {
+    resize_and_rehash(capacity * 2);
+  }
+
+  // a cycle with a full stash leaves one entry out of the table:
+  // rebuild with new hash functions and place it again (growing the
+  // table if that happens twice in one insert)
+  K cur_key = key;
+  V cur_value = value;
+  int rebuilds = 0;
+  while (!add(cur_key, cur_value))
+  {
+    resize_and_rehash(rebuilds == 0 ? capacity : capacity * 2);
+    rebuilds++;
+  }
+  count++;
+}
+
+// Shrinks the collection by removing the key-value pair with the
+// given key. Does not modify the collection if the collection does
+// not contain the key. Throws out_of_range if the given key is not
+// in the collection.
+template <typename K, typename V>
+void CuckooMap<K, V>::erase(const K &key)
+{
+  int index = find(key);
+  if (index < 0)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+
+  int bucket = index / SLOTS;
+  buckets[bucket].full = buckets[bucket].full & ~(1 << (index % SLOTS));
+  if (bucket == capacity)
+  {
+    stash_count--;
+  }
+  count--;
+
+  // the freed slot may make room for an entry waiting in the stash
+  if (stash_count > 0)
+  {
+    drain_stash();
+  }
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template <typename K, typename V>
+bool CuckooMap<K, V>::contains(const K &key) const
+{
+  return find(key) >= 0;
+}
+
+// Returns the keys k in the collection such that k1 <= k <= k2
+template <typename K, typename V>
+ArraySeq<K> CuckooMap<K, V>::find_keys(const K &k1, const K &k2) const
+{
+  ArraySeq<K> result;
+  for_each_key([&](const K &key)
+  {
+    if (key >= k1 && key <= k2)
+    {
+      result.insert(key, result.size());
+    }
+  });
+  return result;
+}
+
+// Returns the keys in the collection in ascending sorted order
+template <typename K, typename V>
+ArraySeq<K> CuckooMap<K, V>::sorted_keys() const
+{
+  ArraySeq<K> result;
+  for_each_key([&](const K &key)
+  {
+    result.insert(key, result.size());
+  });
+  result.sort();
+  return result;
+}
+
+// Gives the key (as an ouptput parameter) immediately after the
+// given key according to ascending sort order. Returns true if a
+// successor key exists, and false otherwise.
+template <typename K, typename V>
+bool CuckooMap<K, V>::next_key(const K &key, K &next_key) const
+{
+  bool exists = false;
+  for_each_key([&](const K &other)
+  {
+    if (other > key)
+    {
+      if (!exists || other < next_key)
+      {
+        next_key = other;
+      }
+      exists = true;
+    }
+  });
+  return exists;
+}
+
+// Gives the key (as an ouptput parameter) immediately before the
+// given key according to ascending sort order. Returns true if a
+// predecessor key exists, and false otherwise.
+template <typename K, typename V>
+bool CuckooMap<K, V>::prev_key(const K &key, K &next_key) const
+{
+  bool exists = false;
+  for_each_key([&](const K &other)
+  {
+    if (other < key)
+    {
+      if (!exists || other > next_key)
+      {
+        next_key = other;
+      }
+      exists = true;
+    }
+  });
+  return exists;
+}
+
+// Removes all key-value pairs from the map. Does not change the
+// current capacity of the table.
+template <typename K, typename V>
+void CuckooMap<K, V>::clear()
+{
+  for (int i = 0; i <= capacity; ++i)
+  {
+    buckets[i].full = 0;
+  }
+  count = 0;
+  stash_count = 0;
+}
+
+// Replaces the contents of the map with the given key-value pairs
+template <typename K, typename V>
+void CuckooMap<K, V>::assign(const ArraySeq<K> &keys, const ArraySeq<V> &values)
+{
+  this->check_pairs(keys, values);
+  clear();
+  reserve(keys.size());
+  for (int i = 0; i < keys.size(); ++i)
+  {
+    insert(keys[i], values[i]);
+  }
+}
+
+// Grows the table (if needed) so n keys fit under the max load factor
+template <typename K, typename V>
+void CuckooMap<K, V>::reserve(int n)
+{
+  int new_capacity = capacity_for(n);
+
+  if (new_capacity > capacity)
+  {
+    resize_and_rehash(new_capacity);
+  }
+}
+
+// Sets the fraction of slots that may be full before inserts grow the
+// table
+template <typename K, typename V>
+void CuckooMap<K, V>::set_max_load_factor(double load)
+{
+  if (!(load > 0.0 && load < 1.0))
+  {
+    throw std::out_of_range("Load factor is out of range");
+  }
+  max_load = load;
+  reserve(count);
+}
+
+// Returns the fraction of slots that may be full before a grow
+template <typename K, typename V>
+double CuckooMap<K, V>::max_load_factor() const
+{
+  return max_load;
+}
+
+// Returns the fraction of slots in use
+template <typename K, typename V>
+double CuckooMap<K, V>::load_factor() const
+{
+  return static_cast<double>(count) / (capacity * SLOTS);
+}
+
+// Returns the number of buckets
+template <typename K, typename V>
+int CuckooMap<K, V>::bucket_count() const
+{
+  return capacity;
+}
+
+// Returns the number of entries waiting in the stash
+template <typename K, typename V>
+int CuckooMap<K, V>::stash_size() const
+{
+  return stash_count;
+}
+
+// Returns the bytes used by the bucket array (including the stash)
+template <typename K, typename V>
+long CuckooMap<K, V>::table_bytes() const
+{
+  return static_cast<long>(capacity + 1) * sizeof(Bucket);
+}
+
+// the hash function (std::hash and the seed followed by a 64-bit
+// finalizer, so both halves of the code are well mixed)
+template <typename K, typename V>
+std::uint64_t CuckooMap<K, V>::hash(const K &key) const
+{
+  std::hash<K> hash_code;
+  return hash_fmix64(hash_code(key) ^ hash_seed);
+}
+
+// the first candidate bucket comes from the low half of the code
+template <typename K, typename V>
+int CuckooMap<K, V>::first_bucket(std::uint64_t code) const
+{
+  return static_cast<int>(code & (capacity - 1));
+}
+
+// the second comes from the high half, moved over by one if it lands
+// on the first
+template <typename K, typename V>
+int CuckooMap<K, V>::second_bucket(std::uint64_t code) const
+{
+  int first = first_bucket(code);
+  int second = static_cast<int>((code >> 32) & (capacity - 1));
+  if (second == first)
+  {
+    second = (first + 1) & (capacity - 1);
+  }
+  return second;
+}
+
+// returns the position holding key or -1 if the key is not in the map
+template <typename K, typename V>
+int CuckooMap<K, V>::find(const K &key) const
+{
+  std::uint64_t code = hash(key);
+  int candidates[2] = {first_bucket(code), second_bucket(code)};
+
+  for (int bucket : candidates)
+  {
+    const Bucket &b = buckets[bucket];
+    for (int slot = 0; slot < SLOTS; ++slot)
+    {
+      if ((b.full & (1 << slot)) && b.keys[slot] == key)
+      {
+        return bucket * SLOTS + slot;
+      }
+    }
+  }
+
+  // the stash is only read while it holds something
+  if (stash_count > 0)
+  {
+    const Bucket &stash = buckets[capacity];
+    for (int slot = 0; slot < STASH_SIZE; ++slot)
+    {
+      if ((stash.full & (1 << slot)) && stash.keys[slot] == key)
+      {
+        return capacity * SLOTS + slot;
+      }
+    }
+  }
+  return -1;
+}
+
+// puts the entry in a free slot of the bucket
+template <typename K, typename V>
+bool CuckooMap<K, V>::put(int bucket, const K &key, const V &value)
+{
+  Bucket &b = buckets[bucket];
+  for (int slot = 0; slot < SLOTS; ++slot)
+  {
+    if (!(b.full & (1 << slot)))
+    {
+      b.keys[slot] = key;
+      b.values[slot] = value;
+      b.full = b.full | (1 << slot);
+      return true;
+    }
+  }
+  return false;
+}
+
+// places the entry in one of its buckets, kicking other entries to
+// their second bucket as needed
+template <typename K, typename V>
+bool CuckooMap<K, V>::place(K &key, V &value)
+{
+  std::uint64_t code = hash(key);
+  int bucket = first_bucket(code);
+  int other = second_bucket(code);
+
+  if (put(bucket, key, value) || put(other, key, value))
+  {
+    return true;
+  }
+
+  for (int kick = 0; kick < MAX_KICKS; ++kick)
+  {
+    // xorshift picks the bucket to kick from and the entry to kick
+    kick_state = kick_state ^ (kick_state << 13);
+    kick_state = kick_state ^ (kick_state >> 7);
+    kick_state = kick_state ^ (kick_state << 17);
+    if (kick == 0 && ((kick_state >> 32) & 1))
+    {
+      bucket = other;
+    }
+    int slot = static_cast<int>(kick_state % SLOTS);
+    std::swap(key, buckets[bucket].keys[slot]);
+    std::swap(value, buckets[bucket].values[slot]);
+
+    // the kicked entry moves to its other bucket
+    code = hash(key);
+    int first = first_bucket(code);
+    bucket = first == bucket ? second_bucket(code) : first;
+    if (put(bucket, key, value))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// places the entry, using the stash if the kicks give up
+template <typename K, typename V>
+bool CuckooMap<K, V>::add(K &key, V &value)
+{
+  if (place(key, value))
+  {
+    return true;
+  }
+  if (stash_count < STASH_SIZE && put(capacity, key, value))
+  {
+    stash_count++;
+    return true;
+  }
+  return false;
+}
+
+// moves stash entries back into their buckets where there is room
+template <typename K, typename V>
+void CuckooMap<K, V>::drain_stash()
+{
+  Bucket &stash = buckets[capacity];
+  for (int slot = 0; slot < STASH_SIZE; ++slot)
+  {
+    if (stash.full & (1 << slot))
+    {
+      std::uint64_t code = hash(stash.keys[slot]);
+      if (put(first_bucket(code), stash.keys[slot], stash.values[slot]) ||
+          put(second_bucket(code), stash.keys[slot], stash.values[slot]))
+      {
+        stash.full = stash.full & ~(1 << slot);
+        stash_count--;
+      }
+    }
+  }
+}
+
+// rebuild the table with the given number of buckets and a new hash
+// seed. If the entries do not all fit, the rebuild starts over at
+// twice the size.
+template <typename K, typename V>
+void CuckooMap<K, V>::resize_and_rehash(int new_capacity)
+{
+  // old table (with its stash)
+  Bucket *old_buckets = buckets;
+  int old_cap = capacity;
+
+  bool fits = false;
+  while (!fits)
+  {
+    capacity = new_capacity;
+    stash_count = 0;
+    hash_seed = hash_seed + 0x9e3779b97f4a7c15ULL;
+    buckets = nullptr;
+    init_table();
+
+    fits = true;
+    for (int i = 0; i <= old_cap && fits; ++i)
+    {
+      for (int slot = 0; slot < SLOTS && fits; ++slot)
+      {
+        if (old_buckets[i].full & (1 << slot))
+        {
+          K key = old_buckets[i].keys[slot];
+          V value = old_buckets[i].values[slot];
+          fits = add(key, value);
+        }
+      }
+    }
+    if (!fits)
+    {
+      free_table();
+      new_capacity = new_capacity * 2;
+    }
+  }
+
+  delete[] old_buckets;
+}
+
+// smallest table size (a power of two, at least MIN_BUCKETS) that
+// holds n keys under the max load factor
+template <typename K, typename V>
+int CuckooMap<K, V>::capacity_for(int n) const
+{
+  int cap = MIN_BUCKETS;
+
+  while (cap * SLOTS * max_load < n)
+  {
+    cap = cap * 2;
+  }
+  return cap;
+}
+
+// calls visit(key) for every key in the table and stash
+template <typename K, typename V>
+template <typename F>
+void CuckooMap<K, V>::for_each_key(F visit) const
+{
+  for (int i = 0; i <= capacity; ++i)
+  {
+    for (int slot = 0; slot < SLOTS; ++slot)
+    {
+      if (buckets[i].full & (1 << slot))
+      {
+        visit(buckets[i].keys[slot]);
+      }
+    }
+  }
+}
+
+// allocate the buckets (plus one for the stash) with all slots empty
+template <typename K, typename V>
+void CuckooMap<K, V>::init_table()
+{
+  // value-initialized, so every full mask starts at 0
+  buckets = new Bucket[capacity + 1]();
+}
+
+// release the buckets
+template <typename K, typename V>
+void CuckooMap<K, V>::free_table()
+{
+  delete[] buckets;
+  buckets = nullptr;
+}
+
+#endif
@@ -0,0 +1,271 @@
+//---------------------------------------------------------------------------
+// NAME: Joey Macauley
+// FILE: epoch.h
+// DATE: CPSC 223 - Spring 2022
+// DESC: Epoch-based reclamation for lock-free readers. A reader pins
+//       the current global epoch in its thread's slot for as long as an
+//       EpochGuard is alive, and unpins it when the guard goes away.
+//       Writers unlink memory first and then retire it with the epoch
+//       at the time of the unlink. Retired memory is freed once every
+//       pinned reader has pinned a later epoch. By then no reader can
+//       still hold a pointer to it.
+//
+//       Pinning needs a store-load fence so that either the writer sees
+//       the pin or the reader sees the unlink. On Linux the reader's half
+//       is a compiler-only fence, and the writer forces the hardware
+//       fence onto every reader with one membarrier call per collection.
+//       Elsewhere, or when membarrier is unavailable, both sides use a
+//       full fence.
+//---------------------------------------------------------------------------
+
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#if defined(__linux__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// process-wide reader epochs. Each thread claims one slot the first time
+// it pins and gives it back when the thread exits.
+class EpochDomain
+{
+public:
+  // most threads that can hold a slot at the same time
+  static const int MAX_THREADS = 256;
+
+  // pins the calling thread at the current epoch (nested pins only
+  // count once)
+  static void pin()
+  {
+    ThreadSlot &local = thread_slot();
+    if (local.depth++ > 0)
+    {
+      return;
+    }
+
+    // the fence pairs with the one in oldest_pinned(): either the writer
+    // sees this pin, or this reader sees the writer's unlink. The
+    // release orders this thread's earlier reads before any free that
+    // sees the new epoch.
+    slots[local.index].active.store(global_epoch.load(), std::memory_order_release);
+    if (asymmetric)
+    {
+      std::atomic_signal_fence(std::memory_order_seq_cst);
+    }
+    else
+    {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+  }
+
+  // unpins the calling thread
+  static void unpin()
+  {
+    ThreadSlot &local = thread_slot();
+    if (--local.depth == 0)
+    {
+      slots[local.index].active.store(IDLE, std::memory_order_release);
+    }
+  }
+
+  // returns the epoch to record with memory that was just unlinked and
+  // moves the global epoch forward
+  static std::uint64_t advance()
+  {
+    return global_epoch.fetch_add(1);
+  }
+
+  // returns the oldest epoch any reader is pinned at (or the current
+  // epoch if none is). Memory retired in an earlier epoch can no longer
+  // be seen by any reader.
+  static std::uint64_t oldest_pinned()
+  {
+    heavy_fence();
+    std::uint64_t oldest = global_epoch.load();
+    for (int i = 0; i < MAX_THREADS; ++i)
+    {
+      std::uint64_t active = slots[i].active.load(std::memory_order_acquire);
+      if (active != IDLE && active < oldest)
+      {
+        oldest = active;
+      }
+    }
+    return oldest;
+  }
+
+private:
+  // slot value for a thread that is not reading
+  static const std::uint64_t IDLE = 0;
+
+  // a thread's pinned epoch, one per cache line
+  struct alignas(64) Slot
+  {
+    std::atomic<std::uint64_t> active;
+    std::atomic<bool> owned;
+
+    Slot() : active(IDLE), owned(false) {}
+  };
+
+  // the calling thread's slot index and pin depth. The slot is given
+  // back when the thread exits.
+  struct ThreadSlot
+  {
+    int index = -1;
+    int depth = 0;
+
+    ~ThreadSlot()
+    {
+      if (index >= 0)
+      {
+        slots[index].active.store(IDLE);
+        slots[index].owned.store(false);
+      }
+    }
+  };
+
+  // epochs start at 1 so 0 can mean idle
+  static inline std::atomic<std::uint64_t> global_epoch{1};
+  static inline Slot slots[MAX_THREADS];
+
+  // registers the process for expedited membarrier calls. Returns true
+  // if they are available.
+  static bool register_membarrier()
+  {
+#if defined(__linux__) && defined(__NR_membarrier)
+    return syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0;
+#else
+    return false;
+#endif
+  }
+
+  // true if readers only need a compiler fence
+  static inline const bool asymmetric = register_membarrier();
+
+  // a full fence on the calling thread and, with membarrier, on every
+  // other running thread of the process
+  static void heavy_fence()
+  {
+#if defined(__linux__) && defined(__NR_membarrier)
+    if (asymmetric)
+    {
+      syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+      return;
+    }
+#endif
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  // claims a free slot on the calling thread's first pin
+  static ThreadSlot &thread_slot()
+  {
+    thread_local ThreadSlot local;
+    if (local.index < 0)
+    {
+      for (int i = 0; i < MAX_THREADS && local.index < 0; ++i)
+      {
+        bool expected = false;
+        if (slots[i].owned.compare_exchange_strong(expected, true))
+        {
+          local.index = i;
+        }
+      }
+      if (local.index < 0)
+      {
+        throw std::length_error("Too many threads pinned in the epoch domain");
+      }
+    }
+    return local;
+  }
+};
+
+// pins the calling thread for the lifetime of the guard
+class EpochGuard
+{
+public:
+  EpochGuard()
+  {
+    EpochDomain::pin();
+  }
+
+  ~EpochGuard()
+  {
+    EpochDomain::unpin();
+  }
+
+  EpochGuard(const EpochGuard &rhs) = delete;
+  EpochGuard &operator=(const EpochGuard &rhs) = delete;
+};
+
+// memory waiting for every reader that might see it to move on. Not
+// thread safe: each list belongs to one writer (or writer lock).
+class RetireList
+{
+public:
+  // frees everything, so no reader may be pinned when it is destroyed
+  ~RetireList()
+  {
+    for (Retired &item : items)
+    {
+      item.free(item.ptr);
+    }
+  }
+
+  // queues ptr to be released with free(ptr). It must already be
+  // unreachable for new readers.
+  void retire(void *ptr, void (*free)(void *))
+  {
+    items.push_back(Retired{ptr, free, EpochDomain::advance()});
+    if (static_cast<int>(items.size()) >= COLLECT_AT)
+    {
+      collect();
+    }
+  }
+
+  // frees every item no reader can still see
+  void collect()
+  {
+    std::uint64_t oldest = EpochDomain::oldest_pinned();
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < items.size(); ++i)
+    {
+      if (items[i].epoch < oldest)
+      {
+        items[i].free(items[i].ptr);
+      }
+      else
+      {
+        items[kept] = items[i];
+        kept++;
+      }
+    }
+    items.resize(kept);
+  }
+
+  // number of items not yet freed
+  int pending() const
+  {
+    return static_cast<int>(items.size());
+  }
+
+private:
+  // unlinked memory, how to free it, and the epoch it was unlinked in
+  struct Retired
+  {
+    void *ptr;
+    void (*free)(void *);
+    std::uint64_t epoch;
+  };
+
+  // retired items collected in a batch once there are this many
+  static const int COLLECT_AT = 256;
+
+  std::vector<Retired> items;
+};
+
+#endif
@@ -0,0 +1,584 @@
+//---------------------------------------------------------------------------
+// NAME: Joey Macauley
+// FILE: epochhashmap.h
+// DATE: CPSC 223 - Spring 2022
+// DESC: Implementation of a chained hash map for read-mostly workloads.
+//       Readers never lock: they pin an epoch (see epoch.h) and walk
+//       chains of atomic pointers. Writers are serialized by a mutex and
+//       never change a node a reader might be looking at. Inserts
+//       publish a new chain head, updates swap in a copy of the node,
+//       and erases unlink the node; replaced and unlinked nodes are
+//       retired until no reader can see them. Growing builds a complete
+//       new table and publishes it with one pointer swap, so readers in
+//       the middle of a resize keep reading the old, unchanged table.
+//---------------------------------------------------------------------------
+
+#ifndef EPOCHHASHMAP_H
+#define EPOCHHASHMAP_H
+
+#include "map.h"
+#include "arrayseq.h"
+#include "hashpolicy.h"
+#include "epoch.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+
+// H is the hash policy (see hashpolicy.h). Reads (contains, get, the
+// key queries, and size) may run on any number of threads while one or
+// more threads write. References returned by operator[] stay valid only
+// until the key is updated or erased, so concurrent readers should use
+// get() or contains() instead.
+template <typename K, typename V, typename H = WyHash<K>>
+class EpochHashMap : public Map<K, V>
+{
+public:
+  // default constructor
+  EpochHashMap();
+
+  // copy constructor
+  EpochHashMap(const EpochHashMap &rhs);
+
+  // copy assignment
+  EpochHashMap &operator=(const EpochHashMap &rhs);
+
+  // destructor (no other thread may be using the map)
+  ~EpochHashMap();
+
+  // Returns the number of key-value pairs in the map
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Allows values associated with a key to be updated. Throws
+  // out_of_range if the given key is not in the collection. Writing
+  // through the reference is not safe while other threads read the
+  // key; use update() instead.
+  V &operator[](const K &key);
+
+  // Returns the value for a given key. Throws out_of_range if the
+  // given key is not in the collection.
+  const V &operator[](const K &key) const;
+
+  // Extends the collection by adding the given key-value pair. If
+  // the key is already in the map the collection is not modified.
+  void insert(const K &key, const V &value);
+
+  // Shrinks the collection by removing the key-value pair with the
+  // given key. Throws out_of_range if the given key is not in the
+  // collection.
+  void erase(const K &key);
+
+  // Returns true if the key is in the collection, and false otherwise.
+  bool contains(const K &key) const;
+
+  // Copies the value for the key into value. Returns true if the key
+  // was found and false otherwise. Wait-free.
+  bool get(const K &key, V &value) const;
+
+  // Replaces the value for an existing key by publishing a new node.
+  // Returns true if the key was found and false otherwise.
+  bool update(const K &key, const V &value);
+
+  // Returns the keys k in the collection such that k1 <= k <= k2
+  ArraySeq<K> find_keys(const K &k1, const K &k2) const;
+
+  // Returns the keys in the collection in ascending sorted order
+  ArraySeq<K> sorted_keys() const;
+
+  // Gives the key (as an ouptput parameter) immediately after the
+  // given key according to ascending sort order. Returns true if a
+  // successor key exists, and false otherwise.
+  bool next_key(const K &key, K &next_key) const;
+
+  // Gives the key (as an ouptput parameter) immediately before the
+  // given key according to ascending sort order. Returns true if a
+  // predecessor key exists, and false otherwise.
+  bool prev_key(const K &key, K &next_key) const;
+
+  // Removes all key-value pairs from the map.
+  void clear();
+
+  // Returns the number of buckets in the current table
+  int bucket_count() const;
+
+  // Returns the number of retired nodes and tables not yet freed
+  int pending_retired() const;
+
+private:
+  // node for linked-list separate chaining. The key, value, and code
+  // never change once the node is published.
+  struct Node
+  {
+    K key;
+    V value;
+    std::uint64_t code;
+    std::atomic<Node *> next{nullptr};
+  };
+
+  // a bucket array and its size, published as one unit
+  struct Table
+  {
+    int capacity;
+    std::atomic<Node *> *buckets;
+  };
+
+  // current table
+  std::atomic<Table *> table{nullptr};
+
+  // number of key-value pairs in map
+  std::atomic<int> count{0};
+
+  // hash policy
+  H hasher;
+
+  // threshold for resize and rehash
+  const double load_factor_threshold = 0.75;
+
+  // serializes writers
+  mutable std::mutex write_lock;
+
+  // nodes and tables waiting for readers to move on (writers only)
+  RetireList retired;
+
+  // the full hash code of a key
+  std::uint64_t hash_code(const K &key) const;
+
+  // returns the node for the key in the table or nullptr (the caller
+  // must be pinned or hold the write lock)
+  Node *find_node(const Table *t, const K &key, std::uint64_t code) const;
+
+  // returns a new empty table with the given number of buckets
+  static Table *make_table(int capacity);
+
+  // frees a table and every node in it
+  static void free_table(void *ptr);
+
+  // frees a single node
+  static void free_node(void *ptr);
+
+  // builds a table twice the size holding copies of every node and
+  // publishes it (write lock held)
+  void grow();
+
+  // calls visit(node) for every node of the current table
+  template <typename F>
+  void for_each_node(F visit) const;
+};
+
+// default constructor
+template <typename K, typename V, typename H>
+EpochHashMap<K, V, H>::EpochHashMap()
+{
+  table.store(make_table(16));
+}
+
+// copy constructor
+template <typename K, typename V, typename H>
+EpochHashMap<K, V, H>::EpochHashMap(const EpochHashMap &rhs)
+{
+  table.store(make_table(16));
+  *this = rhs;
+}
+
+// copy assignment
+template <typename K, typename V, typename H>
+EpochHashMap<K, V, H> &EpochHashMap<K, V, H>::operator=(const EpochHashMap &rhs)
+{
+  if (this != &rhs)
+  {
+    clear();
+    rhs.for_each_node([&](const Node *node)
+    {
+      insert(node->key, node->value);
+    });
+  }
+  return *this;
+}
+
+// destructor
+template <typename K, typename V, typename H>
+EpochHashMap<K, V, H>::~EpochHashMap()
+{
+  free_table(table.load());
+}
+
+// Returns the number of key-value pairs in the map
+template <typename K, typename V, typename H>
+int EpochHashMap<K, V, H>::size() const
+{
+  return count.load(std::memory_order_relaxed);
+}
+
+// Tests if the map is empty
+template <typename K, typename V, typename H>
+bool EpochHashMap<K, V, H>::empty() const
+{
+  if (size() == 0)
+  {
+    return true;
+  }
+  return false;
+}
+
+// Allows values associated with a key to be updated. Throws
+// out_of_range if the given key is not in the collection.
+template <typename K, typename V, typename H>
+V &EpochHashMap<K, V, H>::operator[](const K &key)
+{
+  EpochGuard guard;
+  Node *node = find_node(table.load(std::memory_order_acquire), key, hash_code(key));
+
+  if (node == nullptr)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return node->value;
+}
+
+// Returns the value for a given key. Throws out_of_range if the given
+// key is not in the collection.
+template <typename K, typename V, typename H>
+const V &EpochHashMap<K, V, H>::operator[](const K &key) const
+{
+  EpochGuard guard;
+  Node *node = find_node(table.load(std::memory_order_acquire), key, hash_code(key));
+
+  if (node == nullptr)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return node->value;
+}
+
+// Extends the collection by adding the given key-value pair
+template <typename K, typename V, typename H>
+void EpochHashMap<K, V, H>::insert(const K &key, const V &value)
+{
+  std::uint64_t code = hash_code(key);
+  std::lock_guard<std::mutex> guard(write_lock);
+
+  Table *t = table.load(std::memory_order_relaxed);
+  if (find_node(t, key, code) != nullptr)
+  {
+    return;
+  }
+
+  if (static_cast<double>(count.load(std::memory_order_relaxed)) / t->capacity >= load_factor_threshold)
+  {
+    grow();
+    t = table.load(std::memory_order_relaxed);
+  }
+
+  Node *temp = new Node;
+  temp->key = key;
+  temp->value = value;
+  temp->code = code;
+
+  // the node is complete before the release store makes it reachable
+  std::atomic<Node *> &head = t->buckets[code & static_cast<std::uint64_t>(t->capacity - 1)];
+  temp->next.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  head.store(temp, std::memory_order_release);
+  count.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Shrinks the collection by removing the key-value pair with the given
+// key. Throws out_of_range if the given key is not in the collection.
+template <typename K, typename V, typename H>
+void EpochHashMap<K, V, H>::erase(const K &key)
+{
+  std::uint64_t code = hash_code(key);
+  std::lock_guard<std::mutex> guard(write_lock);
+
+  // readers standing on the removed node still follow its next link
+  Table *t = table.load(std::memory_order_relaxed);
+  std::atomic<Node *> *link = &t->buckets[code & static_cast<std::uint64_t>(t->capacity - 1)];
+  Node *traverse = link->load(std::memory_order_relaxed);
+  while (traverse != nullptr)
+  {
+    if (traverse->code == code && traverse->key == key)
+    {
+      link->store(traverse->next.load(std::memory_order_relaxed), std::memory_order_release);
+      count.fetch_sub(1, std::memory_order_relaxed);
+      retired.retire(traverse, free_node);
+      return;
+    }
+    link = &traverse->next;
+    traverse = link->load(std::memory_order_relaxed);
+  }
+
+  throw std::out_of_range("Key is not in the collection");
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template <typename K, typename V, typename H>
+bool EpochHashMap<K, V, H>::contains(const K &key) const
+{
+  EpochGuard guard;
+  return find_node(table.load(std::memory_order_acquire), key, hash_code(key)) != nullptr;
+}
+
+// Copies the value for the key into value
+template <typename K, typename V, typename H>
+bool EpochHashMap<K, V, H>::get(const K &key, V &value) const
+{
+  EpochGuard guard;
+  Node *node = find_node(table.load(std::memory_order_acquire), key, hash_code(key));
+
+  if (node == nullptr)
+  {
+    return false;
+  }
+  value = node->value;
+  return true;
+}
+
+// Replaces the value for an existing key by publishing a new node
+template <typename K, typename V, typename H>
+bool EpochHashMap<K, V, H>::update(const K &key, const V &value)
+{
+  std::uint64_t code = hash_code(key);
+  std::lock_guard<std::mutex> guard(write_lock);
+
+  Table *t = table.load(std::memory_order_relaxed);
+  std::atomic<Node *> *link = &t->buckets[code & static_cast<std::uint64_t>(t->capacity - 1)];
+  Node *traverse = link->load(std::memory_order_relaxed);
+  while (traverse != nullptr)
+  {
+    if (traverse->code == code && traverse->key == key)
+    {
+      // the copy takes the old node's place in the chain
+      Node *temp = new Node;
+      temp->key = key;
+      temp->value = value;
+      temp->code = code;
+      temp->next.store(traverse->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      link->store(temp, std::memory_order_release);
+      retired.retire(traverse, free_node);
+      return true;
+    }
+    link = &traverse->next;
+    traverse = link->load(std::memory_order_relaxed);
+  }
+  return false;
+}
+
+// Returns the keys k in the collection such that k1 <= k <= k2
+template <typename K, typename V, typename H>
+ArraySeq<K> EpochHashMap<K, V, H>::find_keys(const K &k1, const K &k2) const
+{
+  ArraySeq<K> keys;
+
+  for_each_node([&](const Node *node)
+  {
+    if (node->key >= k1 && node->key <= k2)
+    {
+      keys.insert(node->key, keys.size());
+    }
+  });
+  return keys;
+}
+
+// Returns the keys in the collection in ascending sorted order
+template <typename K, typename V, typename H>
+ArraySeq<K> EpochHashMap<K, V, H>::sorted_keys() const
+{
+  ArraySeq<K> keys;
+
+  for_each_node([&](const Node *node)
+  {
+    keys.insert(node->key, keys.size());
+  });
+
+  keys.sort();
+  return keys;
+}
+
+// Gives the key (as an ouptput parameter) immediately after the given
+// key according to ascending sort order. Returns true if a successor
+// key exists, and false otherwise.
+template <typename K, typename V, typename H>
+bool EpochHashMap<K, V, H>::next_key(const K &key, K &next_key) const
+{
+  bool exists = false;
+
+  for_each_node([&](const Node *node)
+  {
+    if (node->key > key && (!exists || node->key < next_key))
+    {
+      next_key = node->key;
+      exists = true;
+    }
+  });
+  return exists;
+}
+
+// Gives the key (as an ouptput parameter) immediately before the given
+// key according to ascending sort order. Returns true if a predecessor
+// key exists, and false otherwise.
+template <typename K, typename V, typename H>
+bool EpochHashMap<K, V, H>::prev_key(const K &key, K &next_key) const
+{
+  bool exists = false;
+
+  for_each_node([&](const Node *node)
+  {
+    if (node->key < key && (!exists || node->key > next_key))
+    {
+      next_key = node->key;
+      exists = true;
+    }
+  });
+  return exists;
+}
+
+// Removes all key-value pairs from the map. Readers still walking the
+// old table finish on it; it is freed once they are done.
+template <typename K, typename V, typename H>
+void EpochHashMap<K, V, H>::clear()
+{
+  std::lock_guard<std::mutex> guard(write_lock);
+
+  Table *old = table.exchange(make_table(16), std::memory_order_acq_rel);
+  count.store(0, std::memory_order_relaxed);
+  retired.retire(old, free_table);
+  retired.collect();
+}
+
+// Returns the number of buckets in the current table
+template <typename K, typename V, typename H>
+int EpochHashMap<K, V, H>::bucket_count() const
+{
+  EpochGuard guard;
+  return table.load(std::memory_order_acquire)->capacity;
+}
+
+// Returns the number of retired nodes and tables not yet freed
+template <typename K, typename V, typename H>
+int EpochHashMap<K, V, H>::pending_retired() const
+{
+  std::lock_guard<std::mutex> guard(write_lock);
+  return retired.pending();
+}
+
+// the full hash code of a key
+template <typename K, typename V, typename H>
+std::uint64_t EpochHashMap<K, V, H>::hash_code(const K &key) const
+{
+  return hasher(key, 0);
+}
+
+// returns the node for the key in the table or nullptr
+template <typename K, typename V, typename H>
+typename EpochHashMap<K, V, H>::Node *EpochHashMap<K, V, H>::find_node(const Table *t, const K &key, std::uint64_t code) const
+{
+  Node *traverse = t->buckets[code & static_cast<std::uint64_t>(t->capacity - 1)].load(std::memory_order_acquire);
+
+  while (traverse != nullptr)
+  {
+    if (traverse->code == code && traverse->key == key)
+    {
+      return traverse;
+    }
+    traverse = traverse->next.load(std::memory_order_acquire);
+  }
+  return nullptr;
+}
+
+// returns a new empty table with the given number of buckets
+template <typename K, typename V, typename H>
+typename EpochHashMap<K, V, H>::Table *EpochHashMap<K, V, H>::make_table(int capacity)
+{
+  Table *t = new Table;
+  t->capacity = capacity;
+  t->buckets = new std::atomic<Node *>[capacity];
+  for (int i = 0; i < capacity; ++i)
+  {
+    t->buckets[i].store(nullptr, std::memory_order_relaxed);
+  }
+  return t;
+}
+
+// frees a table and every node in it
+template <typename K, typename V, typename H>
+void EpochHashMap<K, V, H>::free_table(void *ptr)
+{
+  Table *t = static_cast<Table *>(ptr);
+  Node *next = nullptr;
+
+  for (int i = 0; i < t->capacity; ++i)
+  {
+    Node *traverse = t->buckets[i].load(std::memory_order_relaxed);
+    while (traverse != nullptr)
+    {
+      next = traverse->next.load(std::memory_order_relaxed);
+      delete traverse;
+      traverse = next;
+    }
+  }
+  delete[] t->buckets;
+  delete t;
+}
+
+// frees a single node
+template <typename K, typename V, typename H>
+void EpochHashMap<K, V, H>::free_node(void *ptr)
+{
+  delete static_cast<Node *>(ptr);
+}
+
+// builds a table twice the size holding copies of every node and
+// publishes it. Nodes are copied rather than relinked because readers
+// may still be walking the old chains.
+template <typename K, typename V, typename H>
+void EpochHashMap<K, V, H>::grow()
+{
+  Table *old = table.load(std::memory_order_relaxed);
+  Table *t = make_table(old->capacity * 2);
+  std::uint64_t mask = static_cast<std::uint64_t>(t->capacity - 1);
+
+  for (int i = 0; i < old->capacity; ++i)
+  {
+    Node *traverse = old->buckets[i].load(std::memory_order_relaxed);
+    while (traverse != nullptr)
+    {
+      Node *temp = new Node;
+      temp->key = traverse->key;
+      temp->value = traverse->value;
+      temp->code = traverse->code;
+      std::atomic<Node *> &head = t->buckets[traverse->code & mask];
+      temp->next.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      head.store(temp, std::memory_order_relaxed);
+      traverse = traverse->next.load(std::memory_order_relaxed);
+    }
+  }
+
+  table.store(t, std::memory_order_release);
+
+  // whole tables are worth freeing right away
+  retired.retire(old, free_table);
+  retired.collect();
+}
+
+// calls visit(node) for every node of the current table
+template <typename K, typename V, typename H>
+template <typename F>
+void EpochHashMap<K, V, H>::for_each_node(F visit) const
+{
+  EpochGuard guard;
+  const Table *t = table.load(std::memory_order_acquire);
+
+  for (int i = 0; i < t->capacity; ++i)
+  {
+    Node *traverse = t->buckets[i].load(std::memory_order_acquire);
+    while (traverse != nullptr)
+    {
+      visit(traverse);
+      traverse = traverse->next.load(std::memory_order_acquire);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,609 @@
+//---------------------------------------------------------------------------
+// NAME: Joey Macauley
+// FILE: flathashmap.h
+// DATE: CPSC 223 - Spring 2022
+// DESC: Implementation of an open-addressing (SwissTable-style) hash
+//       map. Keys and values are kept in flat slot arrays and a
+//       parallel array of control bytes holds a 7-bit hash tag for
+//       each full slot. Lookups compare 16 control bytes at a time
+//       (using SSE2 when available) and only touch the slot arrays
+//       for tags that match.
+//---------------------------------------------------------------------------
+
+#ifndef FLATHASHMAP_H
+#define FLATHASHMAP_H
+
+#include "map.h"
+#include "arrayseq.h"
+#include "hashpolicy.h"
+#include <functional>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+template <typename K, typename V>
+class FlatHashMap : public Map<K, V>
+{
+public:
+  // default constructor
+  FlatHashMap();
+
+  // copy constructor
+  FlatHashMap(const FlatHashMap &rhs);
+
+  // move constructor
+  FlatHashMap(FlatHashMap &&rhs);
+
+  // copy assignment
+  FlatHashMap &operator=(const FlatHashMap &rhs);
+
+  // move assignment
+  FlatHashMap &operator=(FlatHashMap &&rhs);
+
+  // destructor
+  ~FlatHashMap();
+
+  // Returns the number of key-value pairs in the map
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Allows values associated with a key to be updated. Throws
+  // out_of_range if the given key is not in the collection.
+  V &operator[](const K &key);
+
+  // Returns the value for a given key. Throws out_of_range if the
+  // given key is not in the collection.
+  const V &operator[](const K &key) const;
+
+  // Extends the collection by adding the given key-value pair. If
+  // the key is already in the map the collection is not modified.
+  void insert(const K &key, const V &value);
+
+  // Shrinks the collection by removing the key-value pair with the
+  // given key. Does not modify the collection if the collection does
+  // not contain the key. Throws out_of_range if the given key is not
+  // in the collection.
+  void erase(const K &key);
+
+  // Returns true if the key is in the collection, and false otherwise.
+  bool contains(const K &key) const;
+
+  // Returns the keys k in the collection such that k1 <= k <= k2
+  ArraySeq<K> find_keys(const K &k1, const K &k2) const;
+
+  // Returns the keys in the collection in ascending sorted order
+  ArraySeq<K> sorted_keys() const;
+
+  // Gives the key (as an ouptput parameter) immediately after the
+  // given key according to ascending sort order. Returns true if a
+  // successor key exists, and false otherwise.
+  bool next_key(const K &key, K &next_key) const;
+
+  // Gives the key (as an ouptput parameter) immediately before the
+  // given key according to ascending sort order. Returns true if a
+  // predecessor key exists, and false otherwise.
+  bool prev_key(const K &key, K &next_key) const;
+
+  // Removes all key-value pairs from the map. Does not change the
+  // current capacity of the table.
+  void clear();
+
+  // statistics functions for the hash table implementation
+  int slot_count() const;
+  double load_factor() const;
+
+private:
+  // number of slots compared at once
+  static const int GROUP_WIDTH = 16;
+
+  // control byte values (full slots hold a tag in 0..127)
+  static const signed char EMPTY = -128;
+  static const signed char DELETED = -2;
+
+  // number of key-value pairs in map
+  int count = 0;
+
+  // number of erased slots not yet reused
+  int tombstones = 0;
+
+  // number of slots (always a power of two, at least GROUP_WIDTH)
+  int capacity = 16;
+
+  // control bytes, with the first group mirrored past the end so a
+  // group can be loaded at any slot without wrapping
+  signed char *ctrl = nullptr;
+
+  // flat slot arrays
+  K *keys = nullptr;
+  V *values = nullptr;
+
+  // the hash function
+  std::uint64_t hash(const K &key) const;
+
+  // bitmask of the slots in the group starting at ctrl[pos] whose
+  // control byte equals tag
+  unsigned int match(int pos, signed char tag) const;
+
+  // returns the slot holding key or -1 if the key is not in the map
+  int find(const K &key) const;
+
+  // set a control byte (and its mirror if it is in the first group)
+  void set_ctrl(int index, signed char tag);
+
+  // resize and rehash the table into the given number of slots
+  void resize_and_rehash(int new_capacity);
+
+  // allocate the arrays for the current capacity with all slots empty
+  void init_table();
+
+  // release the arrays
+  void free_table();
+};
+
+// index of the lowest set bit in a (non-zero) match mask
+inline int flat_lowest_bit(unsigned int mask)
+{
+#if defined(__GNUC__)
+  return __builtin_ctz(mask);
+#else
+  int bit = 0;
+  while ((mask & 1) == 0)
+  {
+    mask = mask >> 1;
+    bit++;
+  }
+  return bit;
+#endif
+}
+
+template <typename K, typename V>
+FlatHashMap<K, V>::FlatHashMap()
+{
+  init_table();
+}
+
+// copy constructor
+template <typename K, typename V>
+FlatHashMap<K, V>::FlatHashMap(const FlatHashMap &rhs)
+{
+  *this = rhs;
+}
+
+// move constructor
+template <typename K, typename V>
+FlatHashMap<K, V>::FlatHashMap(FlatHashMap &&rhs)
+{
+  *this = std::move(rhs);
+}
+
+// copy assignment
+template <typename K, typename V>
+FlatHashMap<K, V> &FlatHashMap<K, V>::operator=(const FlatHashMap &rhs)
+{
+  if (this != &rhs)
+  {
+    free_table();
+    count = rhs.count;
+    tombstones = rhs.tombstones;
+    capacity = rhs.capacity;
+    init_table();
+
+    for (int i = 0; i < capacity + GROUP_WIDTH; ++i)
+    {
+      ctrl[i] = rhs.ctrl[i];
+    }
+    for (int i = 0; i < capacity; ++i)
+    {
+      if (ctrl[i] >= 0)
+      {
+        keys[i] = rhs.keys[i];
+        values[i] = rhs.values[i];
+      }
+    }
+  }
+  return *this;
+}
+
+// move assignment
+template <typename K, typename V>
+FlatHashMap<K, V> &FlatHashMap<K, V>::operator=(FlatHashMap &&rhs)
+{
+  if (this != &rhs)
+  {
+    free_table();
+    count = rhs.count;
+    tombstones = rhs.tombstones;
+    capacity = rhs.capacity;
+    ctrl = rhs.ctrl;
+    keys = rhs.keys;
+    values = rhs.values;
+
+    // default state for rhs
+    rhs.ctrl = nullptr;
+    rhs.keys = nullptr;
+    rhs.values = nullptr;
+    rhs.count = 0;
+    rhs.tombstones = 0;
+    rhs.capacity = 16;
+    rhs.init_table();
+  }
+  return *this;
+}
+
+// destructor
+template <typename K, typename V>
+FlatHashMap<K, V>::~FlatHashMap()
+{
+  free_table();
+}
+
+// Returns the number of key-value pairs in the map
+template <typename K, typename V>
+int FlatHashMap<K, V>::size() const
+{
+  return count;
+}
+
+// Tests if the map is empty
+template <typename K, typename V>
+bool FlatHashMap<K, V>::empty() const
+{
+  return count == 0;
+}
+
+// Allows values associated with a key to be updated. Throws
+// out_of_range if the given key is not in the collection.
+template <typename K, typename V>
+V &FlatHashMap<K, V>::operator[](const K &key)
+{
+  int index = find(key);
+  if (index < 0)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return values[index];
+}
+
+// Returns the value for a given key. Throws out_of_range if the
+// given key is not in the collection.
+template <typename K, typename V>
+const V &FlatHashMap<K, V>::operator[](const K &key) const
+{
+  int index = find(key);
+  if (index < 0)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return values[index];
+}
+
+// Extends the collection by adding the given key-value pair. If
+// the key is already in the map the collection is not modified.
+template <typename K, typename V>
+void FlatHashMap<K, V>::insert(const K &key, const V &value)
+{
+  // keep at least 1/8 of the slots empty so probes terminate
+  if ((count + tombstones + 1) * 8 > capacity * 7)
+  {
+    // mostly tombstones, so clean up in place instead of growing
+    if (tombstones > count)
+    {
+      resize_and_rehash(capacity);
+    }
+    else
+    {
+      resize_and_rehash(capacity * 2);
+    }
+  }
+
+  std::uint64_t code = hash(key);
+  signed char tag = static_cast<signed char>(code & 0x7F);
+  int mask = capacity - 1;
+  int pos = static_cast<int>((code >> 7) & mask);
+  int stride = 0;
+  int target = -1;
+
+  while (true)
+  {
+    // already in the map
+    unsigned int hits = match(pos, tag);
+    while (hits != 0)
+    {
+      int index = (pos + flat_lowest_bit(hits)) & mask;
+      if (keys[index] == key)
+      {
+        return;
+      }
+      hits = hits & (hits - 1);
+    }
+
+    // remember the first reusable slot along the probe sequence
+    if (target < 0)
+    {
+      unsigned int open = match(pos, EMPTY) | match(pos, DELETED);
+      if (open != 0)
+      {
+        target = (pos + flat_lowest_bit(open)) & mask;
+      }
+    }
+
+    // an empty slot ends the probe sequence
+    if (match(pos, EMPTY) != 0)
+    {
+      break;
+    }
+    stride = stride + GROUP_WIDTH;
+    pos = (pos + stride) & mask;
+  }
+
+  if (ctrl[target] == DELETED)
+  {
+    tombstones--;
+  }
+  set_ctrl(target, tag);
+  keys[target] = key;
+  values[target] = value;
+  count++;
+}
+
+// Shrinks the collection by removing the key-value pair with the
+// given key. Does not modify the collection if the collection does
+// not contain the key. Throws out_of_range if the given key is not
+// in the collection.
+template <typename K, typename V>
+void FlatHashMap<K, V>::erase(const K &key)
+{
+  int index = find(key);
+  if (index < 0)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  set_ctrl(index, DELETED);
+  tombstones++;
+  count--;
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template <typename K, typename V>
+bool FlatHashMap<K, V>::contains(const K &key) const
+{
+  return find(key) >= 0;
+}
+
+// Returns the keys k in the collection such that k1 <= k <= k2
+template <typename K, typename V>
+ArraySeq<K> FlatHashMap<K, V>::find_keys(const K &k1, const K &k2) const
+{
+  ArraySeq<K> result;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (ctrl[i] >= 0 && keys[i] >= k1 && keys[i] <= k2)
+    {
+      result.insert(keys[i], result.size());
+    }
+  }
+  return result;
+}
+
+// Returns the keys in the collection in ascending sorted order
+template <typename K, typename V>
+ArraySeq<K> FlatHashMap<K, V>::sorted_keys() const
+{
+  ArraySeq<K> result;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (ctrl[i] >= 0)
+    {
+      result.insert(keys[i], result.size());
+    }
+  }
+  result.sort();
+  return result;
+}
+
+// Gives the key (as an ouptput parameter) immediately after the
+// given key according to ascending sort order. Returns true if a
+// successor key exists, and false otherwise.
+template <typename K, typename V>
+bool FlatHashMap<K, V>::next_key(const K &key, K &next_key) const
+{
+  bool exists = false;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (ctrl[i] >= 0 && keys[i] > key)
+    {
+      if (!exists || keys[i] < next_key)
+      {
+        next_key = keys[i];
+      }
+      exists = true;
+    }
+  }
+  return exists;
+}
+
+// Gives the key (as an ouptput parameter) immediately before the
+// given key according to ascending sort order. Returns true if a
+// predecessor key exists, and false otherwise.
+template <typename K, typename V>
+bool FlatHashMap<K, V>::prev_key(const K &key, K &next_key) const
+{
+  bool exists = false;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (ctrl[i] >= 0 && keys[i] < key)
+    {
+      if (!exists || keys[i] > next_key)
+      {
+        next_key = keys[i];
+      }
+      exists = true;
+    }
+  }
+  return exists;
+}
+
+// Removes all key-value pairs from the map. Does not change the
+// current capacity of the table.
+template <typename K, typename V>
+void FlatHashMap<K, V>::clear()
+{
+  for (int i = 0; i < capacity + GROUP_WIDTH; ++i)
+  {
+    ctrl[i] = EMPTY;
+  }
+  count = 0;
+  tombstones = 0;
+}
+
+// statistics functions for the hash table implementation
+template <typename K, typename V>
+int FlatHashMap<K, V>::slot_count() const
+{
+  return capacity;
+}
+
+template <typename K, typename V>
+double FlatHashMap<K, V>::load_factor() const
+{
+  return static_cast<double>(count) / capacity;
+}
+
+// the hash function (std::hash followed by a 64-bit finalizer, since
+// the low 7 bits become the tag and std::hash<int> is the identity)
+template <typename K, typename V>
+std::uint64_t FlatHashMap<K, V>::hash(const K &key) const
+{
+  std::hash<K> hash_code;
+  return hash_fmix64(hash_code(key));
+}
+
+// bitmask of the slots in the group starting at ctrl[pos] whose
+// control byte equals tag
+template <typename K, typename V>
+unsigned int FlatHashMap<K, V>::match(int pos, signed char tag) const
+{
+#if defined(__SSE2__)
+  __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl + pos));
+  __m128i tags = _mm_set1_epi8(tag);
+  return static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, tags)));
+#else
+  unsigned int mask = 0;
+  for (int i = 0; i < GROUP_WIDTH; ++i)
+  {
+    if (ctrl[pos + i] == tag)
+    {
+      mask = mask | (1u << i);
+    }
+  }
+  return mask;
+#endif
+}
+
+// returns the slot holding key or -1 if the key is not in the map
+template <typename K, typename V>
+int FlatHashMap<K, V>::find(const K &key) const
+{
+  if (empty())
+  {
+    return -1;
+  }
+
+  std::uint64_t code = hash(key);
+  signed char tag = static_cast<signed char>(code & 0x7F);
+  int mask = capacity - 1;
+  int pos = static_cast<int>((code >> 7) & mask);
+  int stride = 0;
+
+  while (true)
+  {
+    unsigned int hits = match(pos, tag);
+    while (hits != 0)
+    {
+      int index = (pos + flat_lowest_bit(hits)) & mask;
+      if (keys[index] == key)
+      {
+        return index;
+      }
+      hits = hits & (hits - 1);
+    }
+    // an empty slot ends the probe sequence
+    if (match(pos, EMPTY) != 0)
+    {
+      return -1;
+    }
+    stride = stride + GROUP_WIDTH;
+    pos = (pos + stride) & mask;
+  }
+}
+
+// set a control byte (and its mirror if it is in the first group)
+template <typename K, typename V>
+void FlatHashMap<K, V>::set_ctrl(int index, signed char tag)
+{
+  ctrl[index] = tag;
+  if (index < GROUP_WIDTH)
+  {
+    ctrl[capacity + index] = tag;
+  }
+}
+
+// resize and rehash the table into the given number of slots
+template <typename K, typename V>
+void FlatHashMap<K, V>::resize_and_rehash(int new_capacity)
+{
+  // old table
+  signed char *old_ctrl = ctrl;
+  K *old_keys = keys;
+  V *old_values = values;
+  int old_cap = capacity;
+
+  // resized table
+  capacity = new_capacity;
+  count = 0;
+  tombstones = 0;
+  init_table();
+
+  for (int i = 0; i < old_cap; ++i)
+  {
+    if (old_ctrl[i] >= 0)
+    {
+      insert(old_keys[i], old_values[i]);
+    }
+  }
+
+  delete[] old_ctrl;
+  delete[] old_keys;
+  delete[] old_values;
+}
+
+// allocate the arrays for the current capacity with all slots empty
+template <typename K, typename V>
+void FlatHashMap<K, V>::init_table()
+{
+  ctrl = new signed char[capacity + GROUP_WIDTH];
+  keys = new K[capacity];
+  values = new V[capacity];
+  for (int i = 0; i < capacity + GROUP_WIDTH; ++i)
+  {
+    ctrl[i] = EMPTY;
+  }
+}
+
+// release the arrays
+template <typename K, typename V>
+void FlatHashMap<K, V>::free_table()
+{
+  delete[] ctrl;
+  delete[] keys;
+  delete[] values;
+  ctrl = nullptr;
+  keys = nullptr;
+  values = nullptr;
+}
+
+#endif
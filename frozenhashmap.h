@@ -0,0 +1,572 @@
+//---------------------------------------------------------------------------
+// NAME: Joey Macauley
+// FILE: frozenhashmap.h
+// DATE: CPSC 223 - Spring 2022
+// DESC: Implementation of a read-only hash map built once over a fixed
+//       set of keys with a minimal perfect hash function (in the style
+//       of PTHash). The n entries sit in an array of exactly n slots,
+//       with no empty slots and no collisions.
+//
+//       Keys are hashed into small buckets (about BUCKET_SIZE keys each,
+//       with 60% of the keys sent to 30% of the buckets so the big
+//       buckets are placed while the table is still mostly empty).
+//       Buckets are placed largest first. Each one gets the first 16-bit
+//       pilot that sends all of its keys to free positions in a space of
+//       n / MAX_LOAD positions. The few keys that land past the last
+//       slot are sent to the slots left free below it through a small
+//       remap array. A lookup is one hash, one read of the key's pilot
+//       (the pilots take about 0.5 bytes per key, so they tend to stay
+//       in cache), and one read of the slot to compare the key.
+//---------------------------------------------------------------------------
+
+#ifndef FROZENHASHMAP_H
+#define FROZENHASHMAP_H
+
+#include "map.h"
+#include "arrayseq.h"
+#include "hashpolicy.h"
+#include <functional>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+template <typename K, typename V>
+class FrozenHashMap
+{
+public:
+  // constructs an empty map
+  FrozenHashMap();
+
+  // builds the map from the keys and values of another map. Throws
+  // invalid_argument if the map hands back the same key twice.
+  explicit FrozenHashMap(const Map<K, V> &map);
+
+  // builds the map from n keys and their values (keys[i] maps to
+  // values[i]). Throws invalid_argument if a key appears twice.
+  FrozenHashMap(const K *keys, const V *values, int n);
+
+  // copy constructor
+  FrozenHashMap(const FrozenHashMap &rhs);
+
+  // move constructor
+  FrozenHashMap(FrozenHashMap &&rhs);
+
+  // copy assignment
+  FrozenHashMap &operator=(const FrozenHashMap &rhs);
+
+  // move assignment
+  FrozenHashMap &operator=(FrozenHashMap &&rhs);
+
+  // destructor
+  ~FrozenHashMap();
+
+  // Returns the number of key-value pairs in the map
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Returns the value for a given key. Throws out_of_range if the
+  // given key is not in the collection.
+  const V &operator[](const K &key) const;
+
+  // Returns true if the key is in the collection, and false otherwise.
+  bool contains(const K &key) const;
+
+  // Returns the keys in the collection in ascending sorted order
+  ArraySeq<K> sorted_keys() const;
+
+  // Returns the number of pilot buckets
+  int bucket_count() const;
+
+  // Returns the bytes used by the entries, pilots, and remap array
+  long table_bytes() const;
+
+  // average number of keys per pilot bucket
+  static const int BUCKET_SIZE = 4;
+
+  // keys per position searched by the pilots (the rest of the
+  // positions are remapped)
+  static constexpr double MAX_LOAD = 0.98;
+
+private:
+  struct Entry
+  {
+    K key;
+    V value;
+  };
+
+  // number of key-value pairs in map (and slots in entries)
+  int count = 0;
+
+  // number of positions the pilots place keys in (positions from count
+  // on go through remap)
+  int positions = 0;
+
+  // entries[i] is the entry whose keys hash to slot i
+  Entry *entries = nullptr;
+
+  // one pilot per bucket, and the first buckets_dense buckets share
+  // 60% of the keys
+  int buckets = 0;
+  int buckets_dense = 0;
+  std::uint16_t *pilots = nullptr;
+
+  // remap[i] is the slot for position count + i
+  int *remap = nullptr;
+
+  // seed mixed into every hash code (changed if a build has to start
+  // over)
+  std::uint64_t hash_seed = 0;
+
+  // the hash function
+  std::uint64_t hash(const K &key) const;
+
+  // the bucket of a hash code
+  int bucket(std::uint64_t code) const;
+
+  // the position a pilot sends a hash code to
+  int position(std::uint64_t code, std::uint64_t pilot) const;
+
+  // the slot of a hash code under its bucket's pilot
+  int slot(std::uint64_t code) const;
+
+  // returns the entry for the key or nullptr if it is not in the map
+  const Entry *find(const K &key) const;
+
+  // builds the table from n keys and values read through key_at(i)
+  // and value_at(i)
+  template <typename F, typename G>
+  void build(int n, F key_at, G value_at);
+
+  // looks for pilots that place every bucket and fills in remap.
+  // Returns false if some bucket runs out of pilots, so the seed has to
+  // change.
+  bool find_pilots(const std::vector<std::uint64_t> &codes, const std::vector<int> &order,
+                   const std::vector<int> &starts);
+
+  // release the arrays
+  void free_table();
+};
+
+// constructs an empty map
+template <typename K, typename V>
+FrozenHashMap<K, V>::FrozenHashMap()
+{
+}
+
+// builds the map from the keys and values of another map
+template <typename K, typename V>
+FrozenHashMap<K, V>::FrozenHashMap(const Map<K, V> &map)
+{
+  ArraySeq<K> keys = map.sorted_keys();
+  build(keys.size(), [&](int i) -> const K & { return keys[i]; },
+        [&](int i) -> const V & { return map[keys[i]]; });
+}
+
+// builds the map from n keys and their values
+template <typename K, typename V>
+FrozenHashMap<K, V>::FrozenHashMap(const K *keys, const V *values, int n)
+{
+  build(n, [&](int i) -> const K & { return keys[i]; },
+        [&](int i) -> const V & { return values[i]; });
+}
+
+// copy constructor
+template <typename K, typename V>
+FrozenHashMap<K, V>::FrozenHashMap(const FrozenHashMap &rhs)
+{
+  *this = rhs;
+}
+
+// move constructor
+template <typename K, typename V>
+FrozenHashMap<K, V>::FrozenHashMap(FrozenHashMap &&rhs)
+{
+  *this = std::move(rhs);
+}
+
+// copy assignment
+template <typename K, typename V>
+FrozenHashMap<K, V> &FrozenHashMap<K, V>::operator=(const FrozenHashMap &rhs)
+{
+  if (this != &rhs)
+  {
+    free_table();
+    count = rhs.count;
+    positions = rhs.positions;
+    buckets = rhs.buckets;
+    buckets_dense = rhs.buckets_dense;
+    hash_seed = rhs.hash_seed;
+    entries = new Entry[count];
+    pilots = new std::uint16_t[buckets];
+    remap = new int[positions - count];
+    for (int i = 0; i < count; ++i)
+    {
+      entries[i] = rhs.entries[i];
+    }
+    for (int i = 0; i < buckets; ++i)
+    {
+      pilots[i] = rhs.pilots[i];
+    }
+    for (int i = 0; i < positions - count; ++i)
+    {
+      remap[i] = rhs.remap[i];
+    }
+  }
+  return *this;
+}
+
+// move assignment
+template <typename K, typename V>
+FrozenHashMap<K, V> &FrozenHashMap<K, V>::operator=(FrozenHashMap &&rhs)
+{
+  if (this != &rhs)
+  {
+    free_table();
+    count = rhs.count;
+    positions = rhs.positions;
+    buckets = rhs.buckets;
+    buckets_dense = rhs.buckets_dense;
+    hash_seed = rhs.hash_seed;
+    entries = rhs.entries;
+    pilots = rhs.pilots;
+    remap = rhs.remap;
+
+    // default state for rhs
+    rhs.count = 0;
+    rhs.positions = 0;
+    rhs.buckets = 0;
+    rhs.buckets_dense = 0;
+    rhs.entries = nullptr;
+    rhs.pilots = nullptr;
+    rhs.remap = nullptr;
+  }
+  return *this;
+}
+
+// destructor
+template <typename K, typename V>
+FrozenHashMap<K, V>::~FrozenHashMap()
+{
+  free_table();
+}
+
+// Returns the number of key-value pairs in the map
+template <typename K, typename V>
+int FrozenHashMap<K, V>::size() const
+{
+  return count;
+}
+
+// Tests if the map is empty
+template <typename K, typename V>
+bool FrozenHashMap<K, V>::empty() const
+{
+  return count == 0;
+}
+
+// Returns the value for a given key. Throws out_of_range if the
+// given key is not in the collection.
+template <typename K, typename V>
+const V &FrozenHashMap<K, V>::operator[](const K &key) const
+{
+  const Entry *entry = find(key);
+  if (entry == nullptr)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return entry->value;
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template <typename K, typename V>
+bool FrozenHashMap<K, V>::contains(const K &key) const
+{
+  return find(key) != nullptr;
+}
+
+// Returns the keys in the collection in ascending sorted order
+template <typename K, typename V>
+ArraySeq<K> FrozenHashMap<K, V>::sorted_keys() const
+{
+  ArraySeq<K> result;
+  for (int i = 0; i < count; ++i)
+  {
+    result.insert(entries[i].key, result.size());
+  }
+  result.sort();
+  return result;
+}
+
+// Returns the number of pilot buckets
+template <typename K, typename V>
+int FrozenHashMap<K, V>::bucket_count() const
+{
+  return buckets;
+}
+
+// Returns the bytes used by the entries, pilots, and remap array
+template <typename K, typename V>
+long FrozenHashMap<K, V>::table_bytes() const
+{
+  return static_cast<long>(count) * sizeof(Entry) + static_cast<long>(buckets) * sizeof(std::uint16_t) +
+         static_cast<long>(positions - count) * sizeof(int);
+}
+
+// the hash function (std::hash and the seed through hash_fmix64)
+template <typename K, typename V>
+std::uint64_t FrozenHashMap<K, V>::hash(const K &key) const
+{
+  std::hash<K> hash_code;
+  return hash_fmix64(hash_code(key) ^ hash_seed);
+}
+
+// the bucket of a hash code. The high half picks the dense or sparse
+// group and the low half a bucket within it (scaled by a multiply
+// instead of a division).
+template <typename K, typename V>
+int FrozenHashMap<K, V>::bucket(std::uint64_t code) const
+{
+  std::uint64_t group = code >> 32;
+  std::uint64_t low = code & 0xffffffffULL;
+
+  // 60% of the codes
+  if (group < 0x9999999aULL)
+  {
+    return static_cast<int>((low * buckets_dense) >> 32);
+  }
+  return buckets_dense + static_cast<int>((low * (buckets - buckets_dense)) >> 32);
+}
+
+// the position a pilot sends a hash code to
+template <typename K, typename V>
+int FrozenHashMap<K, V>::position(std::uint64_t code, std::uint64_t pilot) const
+{
+  std::uint64_t mixed = hash_fmix64(code ^ (pilot * 0x9e3779b97f4a7c15ULL));
+  return static_cast<int>(((mixed >> 32) * static_cast<std::uint64_t>(positions)) >> 32);
+}
+
+// the slot of a hash code under its bucket's pilot
+template <typename K, typename V>
+int FrozenHashMap<K, V>::slot(std::uint64_t code) const
+{
+  int index = position(code, pilots[bucket(code)]);
+  if (index >= count)
+  {
+    index = remap[index - count];
+  }
+  return index;
+}
+
+// returns the entry for the key or nullptr if it is not in the map
+template <typename K, typename V>
+const typename FrozenHashMap<K, V>::Entry *FrozenHashMap<K, V>::find(const K &key) const
+{
+  if (count == 0)
+  {
+    return nullptr;
+  }
+
+  // a key outside the set still lands on some slot, so the key there
+  // is compared
+  const Entry *entry = &entries[slot(hash(key))];
+  if (entry->key == key)
+  {
+    return entry;
+  }
+  return nullptr;
+}
+
+// builds the table from n keys and values
+template <typename K, typename V>
+template <typename F, typename G>
+void FrozenHashMap<K, V>::build(int n, F key_at, G value_at)
+{
+  count = n;
+  positions = static_cast<int>(n / MAX_LOAD) + 1;
+  buckets = n / BUCKET_SIZE + 1;
+  buckets_dense = buckets * 3 / 10 + 1;
+  if (buckets_dense >= buckets)
+  {
+    buckets_dense = buckets - 1;
+  }
+
+  std::vector<std::uint64_t> codes(n);
+  std::vector<int> order(n);
+  std::vector<int> starts(buckets + 1);
+  bool placed = false;
+
+  while (!placed)
+  {
+    // group the keys by bucket (a counting sort on the bucket index)
+    for (int b = 0; b <= buckets; ++b)
+    {
+      starts[b] = 0;
+    }
+    for (int i = 0; i < n; ++i)
+    {
+      codes[i] = hash(key_at(i));
+      starts[bucket(codes[i]) + 1]++;
+    }
+    for (int b = 0; b < buckets; ++b)
+    {
+      starts[b + 1] = starts[b + 1] + starts[b];
+    }
+    std::vector<int> next(starts.begin(), starts.end() - 1);
+    for (int i = 0; i < n; ++i)
+    {
+      order[next[bucket(codes[i])]++] = i;
+    }
+
+    // two keys with one code can never be split: the same key twice is
+    // an error, and two different keys need a new seed
+    bool split = true;
+    for (int b = 0; b < buckets; ++b)
+    {
+      for (int i = starts[b]; i < starts[b + 1]; ++i)
+      {
+        for (int j = i + 1; j < starts[b + 1]; ++j)
+        {
+          if (codes[order[i]] != codes[order[j]])
+          {
+            continue;
+          }
+          if (key_at(order[i]) == key_at(order[j]))
+          {
+            free_table();
+            count = 0;
+            positions = 0;
+            buckets = 0;
+            buckets_dense = 0;
+            throw std::invalid_argument("Key appears more than once");
+          }
+          split = false;
+        }
+      }
+    }
+
+    if (split)
+    {
+      free_table();
+      pilots = new std::uint16_t[buckets];
+      remap = new int[positions - count];
+      placed = find_pilots(codes, order, starts);
+    }
+    if (!placed)
+    {
+      hash_seed = hash_seed + 0x9e3779b97f4a7c15ULL;
+    }
+  }
+
+  // every key has its own slot now
+  entries = new Entry[n];
+  for (int i = 0; i < n; ++i)
+  {
+    Entry &entry = entries[slot(codes[i])];
+    entry.key = key_at(i);
+    entry.value = value_at(i);
+  }
+}
+
+// looks for pilots that place every bucket, largest bucket first
+template <typename K, typename V>
+bool FrozenHashMap<K, V>::find_pilots(const std::vector<std::uint64_t> &codes,
+                                      const std::vector<int> &order, const std::vector<int> &starts)
+{
+  // buckets ordered by size, largest first (a counting sort on size)
+  int largest = 0;
+  for (int b = 0; b < buckets; ++b)
+  {
+    int size = starts[b + 1] - starts[b];
+    if (size > largest)
+    {
+      largest = size;
+    }
+  }
+  std::vector<int> by_size(largest + 2, 0);
+  for (int b = 0; b < buckets; ++b)
+  {
+    by_size[largest - (starts[b + 1] - starts[b]) + 1]++;
+  }
+  for (int s = 0; s <= largest; ++s)
+  {
+    by_size[s + 1] = by_size[s + 1] + by_size[s];
+  }
+  std::vector<int> sorted(buckets);
+  for (int b = 0; b < buckets; ++b)
+  {
+    sorted[by_size[largest - (starts[b + 1] - starts[b])]++] = b;
+  }
+
+  // one flag per position, set once the position is taken
+  std::vector<bool> taken(positions, false);
+  std::vector<int> spots(largest);
+
+  for (int b : sorted)
+  {
+    int first = starts[b];
+    int size = starts[b + 1] - first;
+    pilots[b] = 0;
+
+    // the first pilot that puts every key on its own free position
+    bool done = size == 0;
+    for (std::uint64_t pilot = 0; !done; ++pilot)
+    {
+      if (pilot > UINT16_MAX)
+      {
+        return false;
+      }
+      bool fits = true;
+      for (int i = 0; i < size && fits; ++i)
+      {
+        spots[i] = position(codes[order[first + i]], pilot);
+        fits = !taken[spots[i]];
+        for (int j = 0; j < i && fits; ++j)
+        {
+          fits = spots[i] != spots[j];
+        }
+      }
+      if (fits)
+      {
+        for (int i = 0; i < size; ++i)
+        {
+          taken[spots[i]] = true;
+        }
+        pilots[b] = static_cast<std::uint16_t>(pilot);
+        done = true;
+      }
+    }
+  }
+
+  // the keys past the last slot take the free slots, in order
+  int free_slot = 0;
+  for (int i = count; i < positions; ++i)
+  {
+    remap[i - count] = 0;
+    if (taken[i])
+    {
+      while (taken[free_slot])
+      {
+        free_slot++;
+      }
+      remap[i - count] = free_slot++;
+    }
+  }
+  return true;
+}
+
+// release the arrays
+template <typename K, typename V>
+void FrozenHashMap<K, V>::free_table()
+{
+  delete[] entries;
+  delete[] pilots;
+  delete[] remap;
+  entries = nullptr;
+  pilots = nullptr;
+  remap = nullptr;
+}
+
+#endif
@@ -0,0 +1,478 @@
+//---------------------------------------------------------------------------
+// NAME: Joey Macauley
+// FILE: frozentreemap.h
+// DATE: CPSC 223 - Spring 2022
+// DESC: Implementation of a read-only ordered map built once from keys
+//       in ascending order (see AVLMap::freeze). The keys sit in one
+//       array in the breadth-first (Eytzinger) order of a complete
+//       binary search tree: the root is at index 1 and the children of
+//       index i are at 2i and 2i + 1, so the tree needs no pointers.
+//       Values sit in a separate array with the same indexes.
+//
+//       A search always walks the full height of the tree and picks
+//       each child with a compare instead of a branch, so it never
+//       mispredicts; the index it stops at spells out the turns it
+//       took, and the key it wanted is recovered from those bits. The
+//       top levels are packed together at the front of the array, and
+//       the 2^d descendants d levels below a node are adjacent, so each
+//       step prefetches the line holding the node's descendants a cache
+//       line's worth of levels down while it waits on the current one.
+//---------------------------------------------------------------------------
+
+#ifndef FROZENTREEMAP_H
+#define FROZENTREEMAP_H
+
+#include "map.h"
+#include "arrayseq.h"
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+template <typename K, typename V>
+class FrozenTreeMap
+{
+public:
+  // constructs an empty map
+  FrozenTreeMap();
+
+  // builds the map from the keys and values of another map
+  explicit FrozenTreeMap(const Map<K, V> &map);
+
+  // builds the map from n keys in ascending order and their values
+  // (keys[i] maps to values[i]). Throws invalid_argument if the keys
+  // are not in strictly ascending order.
+  FrozenTreeMap(const K *keys, const V *values, int n);
+
+  // copy constructor
+  FrozenTreeMap(const FrozenTreeMap &rhs);
+
+  // move constructor
+  FrozenTreeMap(FrozenTreeMap &&rhs);
+
+  // copy assignment
+  FrozenTreeMap &operator=(const FrozenTreeMap &rhs);
+
+  // move assignment
+  FrozenTreeMap &operator=(FrozenTreeMap &&rhs);
+
+  // destructor
+  ~FrozenTreeMap();
+
+  // Returns the number of key-value pairs in the map
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Returns the value for a given key. Throws out_of_range if the
+  // given key is not in the collection.
+  const V &operator[](const K &key) const;
+
+  // Returns true if the key is in the collection, and false otherwise.
+  bool contains(const K &key) const;
+
+  // Returns the keys k in the collection such that k1 <= k <= k2
+  ArraySeq<K> find_keys(const K &k1, const K &k2) const;
+
+  // Returns the keys in the collection in ascending sorted order
+  ArraySeq<K> sorted_keys() const;
+
+  // Gives the key (as an ouptput parameter) immediately after the
+  // given key according to ascending sort order. Returns true if a
+  // successor key exists, and false otherwise.
+  bool next_key(const K &key, K &next_key) const;
+
+  // Gives the key (as an ouptput parameter) immediately before the
+  // given key according to ascending sort order. Returns true if a
+  // predecessor key exists, and false otherwise.
+  bool prev_key(const K &key, K &prev_key) const;
+
+  // Returns the bytes used by the key and value arrays
+  long layout_bytes() const;
+
+private:
+  // number of key-value pairs in map
+  int count = 0;
+
+  // tree_keys[i] and tree_values[i] make up node i of the implicit
+  // tree (index 0 is unused)
+  K *tree_keys = nullptr;
+  V *tree_values = nullptr;
+
+  // the number of nodes below a node, that many levels down, whose
+  // keys fill one cache line (prefetched together during a search)
+  static constexpr std::size_t prefetch_block();
+
+  // The index a search leaves the tree at: turning right past keys
+  // less than the key (lower) or not greater than it (upper). Its
+  // bits after the leading 1 are the turns taken, 1 for right.
+  std::size_t lower_path(const K &key) const;
+  std::size_t upper_path(const K &key) const;
+
+  // the last node a path turned left at (drop its trailing right
+  // turns and that left turn), or 0 if it never turned left
+  static std::size_t last_left(std::size_t path);
+
+  // the last node a path turned right at, or 0 if it never did
+  static std::size_t last_right(std::size_t path);
+
+  // the node with the smallest key (0 if the map is empty)
+  std::size_t first() const;
+
+  // the node with the next larger key (0 after the largest)
+  std::size_t successor(std::size_t node) const;
+
+  // the node holding the key, or 0 if it is not in the map
+  std::size_t find(const K &key) const;
+
+  // hints that the memory at ptr will be read soon
+  static void prefetch(const void *ptr);
+
+  // release the arrays
+  void free_layout();
+};
+
+// constructs an empty map
+template <typename K, typename V>
+FrozenTreeMap<K, V>::FrozenTreeMap()
+{
+}
+
+// builds the map from the keys and values of another map
+template <typename K, typename V>
+FrozenTreeMap<K, V>::FrozenTreeMap(const Map<K, V> &map)
+{
+  ArraySeq<K> keys = map.sorted_keys();
+  count = keys.size();
+  tree_keys = new K[count + 1];
+  tree_values = new V[count + 1];
+  std::size_t node = first();
+  for (int i = 0; i < count; ++i)
+  {
+    tree_keys[node] = keys[i];
+    tree_values[node] = map[keys[i]];
+    node = successor(node);
+  }
+}
+
+// builds the map from n keys in ascending order and their values:
+// an in-order walk of the implicit tree takes the pairs in turn
+template <typename K, typename V>
+FrozenTreeMap<K, V>::FrozenTreeMap(const K *keys, const V *values, int n)
+{
+  for (int i = 1; i < n; ++i)
+  {
+    if (!(keys[i - 1] < keys[i]))
+    {
+      throw std::invalid_argument("Keys are not in ascending order");
+    }
+  }
+  count = n;
+  tree_keys = new K[count + 1];
+  tree_values = new V[count + 1];
+  std::size_t node = first();
+  for (int i = 0; i < count; ++i)
+  {
+    tree_keys[node] = keys[i];
+    tree_values[node] = values[i];
+    node = successor(node);
+  }
+}
+
+// copy constructor
+template <typename K, typename V>
+FrozenTreeMap<K, V>::FrozenTreeMap(const FrozenTreeMap &rhs)
+{
+  *this = rhs;
+}
+
+// move constructor
+template <typename K, typename V>
+FrozenTreeMap<K, V>::FrozenTreeMap(FrozenTreeMap &&rhs)
+{
+  *this = std::move(rhs);
+}
+
+// copy assignment
+template <typename K, typename V>
+FrozenTreeMap<K, V> &FrozenTreeMap<K, V>::operator=(const FrozenTreeMap &rhs)
+{
+  if (this != &rhs)
+  {
+    free_layout();
+    count = rhs.count;
+    tree_keys = new K[count + 1];
+    tree_values = new V[count + 1];
+    for (int i = 1; i <= count; ++i)
+    {
+      tree_keys[i] = rhs.tree_keys[i];
+      tree_values[i] = rhs.tree_values[i];
+    }
+  }
+  return *this;
+}
+
+// move assignment
+template <typename K, typename V>
+FrozenTreeMap<K, V> &FrozenTreeMap<K, V>::operator=(FrozenTreeMap &&rhs)
+{
+  if (this != &rhs)
+  {
+    free_layout();
+    count = rhs.count;
+    tree_keys = rhs.tree_keys;
+    tree_values = rhs.tree_values;
+
+    // default state for rhs
+    rhs.count = 0;
+    rhs.tree_keys = nullptr;
+    rhs.tree_values = nullptr;
+  }
+  return *this;
+}
+
+// destructor
+template <typename K, typename V>
+FrozenTreeMap<K, V>::~FrozenTreeMap()
+{
+  free_layout();
+}
+
+// Returns the number of key-value pairs in the map
+template <typename K, typename V>
+int FrozenTreeMap<K, V>::size() const
+{
+  return count;
+}
+
+// Tests if the map is empty
+template <typename K, typename V>
+bool FrozenTreeMap<K, V>::empty() const
+{
+  return count == 0;
+}
+
+// Returns the value for a given key. Throws out_of_range if the
+// given key is not in the collection.
+template <typename K, typename V>
+const V &FrozenTreeMap<K, V>::operator[](const K &key) const
+{
+  std::size_t node = find(key);
+  if (node == 0)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return tree_values[node];
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template <typename K, typename V>
+bool FrozenTreeMap<K, V>::contains(const K &key) const
+{
+  return find(key) != 0;
+}
+
+// Returns the keys k in the collection such that k1 <= k <= k2: an
+// in-order walk from the first key not less than k1
+template <typename K, typename V>
+ArraySeq<K> FrozenTreeMap<K, V>::find_keys(const K &k1, const K &k2) const
+{
+  ArraySeq<K> keys;
+  std::size_t node = last_left(lower_path(k1));
+  while (node != 0 && !(k2 < tree_keys[node]))
+  {
+    keys.insert(tree_keys[node], keys.size());
+    node = successor(node);
+  }
+  return keys;
+}
+
+// Returns the keys in the collection in ascending sorted order
+template <typename K, typename V>
+ArraySeq<K> FrozenTreeMap<K, V>::sorted_keys() const
+{
+  ArraySeq<K> keys;
+  for (std::size_t node = first(); node != 0; node = successor(node))
+  {
+    keys.insert(tree_keys[node], keys.size());
+  }
+  return keys;
+}
+
+// Gives the key immediately after the given key: the last node the
+// search turned left at, passing equal keys on the right
+template <typename K, typename V>
+bool FrozenTreeMap<K, V>::next_key(const K &key, K &next_key) const
+{
+  std::size_t node = last_left(upper_path(key));
+  if (node == 0)
+  {
+    return false;
+  }
+  next_key = tree_keys[node];
+  return true;
+}
+
+// Gives the key immediately before the given key: the last node the
+// search turned right at
+template <typename K, typename V>
+bool FrozenTreeMap<K, V>::prev_key(const K &key, K &prev_key) const
+{
+  std::size_t node = last_right(lower_path(key));
+  if (node == 0)
+  {
+    return false;
+  }
+  prev_key = tree_keys[node];
+  return true;
+}
+
+// Returns the bytes used by the key and value arrays
+template <typename K, typename V>
+long FrozenTreeMap<K, V>::layout_bytes() const
+{
+  return tree_keys == nullptr ? 0 : static_cast<long>(count + 1) * (sizeof(K) + sizeof(V));
+}
+
+// descendants per prefetched line: the largest power of two whose
+// keys fit in 64 bytes
+template <typename K, typename V>
+constexpr std::size_t FrozenTreeMap<K, V>::prefetch_block()
+{
+  std::size_t block = 1;
+  while (2 * block * sizeof(K) <= 64)
+  {
+    block = 2 * block;
+  }
+  return block;
+}
+
+// Walks the whole height of the tree. The compare result is the
+// next turn, so the loop has no branch to mispredict; the loop itself
+// runs a fixed number of times. The descendants prefetch_block()
+// below node i start at index prefetch_block() * i (clamped to the
+// array), and both ends of the block are touched in case it straddles
+// two lines.
+template <typename K, typename V>
+std::size_t FrozenTreeMap<K, V>::lower_path(const K &key) const
+{
+  const std::size_t n = count;
+  std::size_t node = 1;
+  while (node <= n)
+  {
+    std::size_t ahead = prefetch_block() * node;
+    prefetch(tree_keys + (ahead < n ? ahead : n));
+    ahead = ahead + prefetch_block() - 1;
+    prefetch(tree_keys + (ahead < n ? ahead : n));
+    node = 2 * node + (tree_keys[node] < key);
+  }
+  return node;
+}
+
+// the same walk, also passing equal keys on the right
+template <typename K, typename V>
+std::size_t FrozenTreeMap<K, V>::upper_path(const K &key) const
+{
+  const std::size_t n = count;
+  std::size_t node = 1;
+  while (node <= n)
+  {
+    std::size_t ahead = prefetch_block() * node;
+    prefetch(tree_keys + (ahead < n ? ahead : n));
+    ahead = ahead + prefetch_block() - 1;
+    prefetch(tree_keys + (ahead < n ? ahead : n));
+    node = 2 * node + !(key < tree_keys[node]);
+  }
+  return node;
+}
+
+// the last node a path turned left at
+template <typename K, typename V>
+std::size_t FrozenTreeMap<K, V>::last_left(std::size_t path)
+{
+  while ((path & 1) == 1)
+  {
+    path = path >> 1;
+  }
+  return path >> 1;
+}
+
+// the last node a path turned right at
+template <typename K, typename V>
+std::size_t FrozenTreeMap<K, V>::last_right(std::size_t path)
+{
+  while (path != 0 && (path & 1) == 0)
+  {
+    path = path >> 1;
+  }
+  return path >> 1;
+}
+
+// the node with the smallest key: keep turning left
+template <typename K, typename V>
+std::size_t FrozenTreeMap<K, V>::first() const
+{
+  if (count == 0)
+  {
+    return 0;
+  }
+  std::size_t node = 1;
+  while (2 * node <= static_cast<std::size_t>(count))
+  {
+    node = 2 * node;
+  }
+  return node;
+}
+
+// the node with the next larger key: the leftmost node of the right
+// subtree, or else the ancestor the node's path last turned left at
+template <typename K, typename V>
+std::size_t FrozenTreeMap<K, V>::successor(std::size_t node) const
+{
+  const std::size_t n = count;
+  if (2 * node + 1 <= n)
+  {
+    node = 2 * node + 1;
+    while (2 * node <= n)
+    {
+      node = 2 * node;
+    }
+    return node;
+  }
+  return last_left(node);
+}
+
+// the node holding the key: the first key not less than it, if that
+// key is equal
+template <typename K, typename V>
+std::size_t FrozenTreeMap<K, V>::find(const K &key) const
+{
+  std::size_t node = last_left(lower_path(key));
+  if (node == 0 || key < tree_keys[node])
+  {
+    return 0;
+  }
+  return node;
+}
+
+// hints that the memory at ptr will be read soon
+template <typename K, typename V>
+void FrozenTreeMap<K, V>::prefetch(const void *ptr)
+{
+#if defined(__GNUC__)
+  __builtin_prefetch(ptr);
+#endif
+}
+
+// release the arrays
+template <typename K, typename V>
+void FrozenTreeMap<K, V>::free_layout()
+{
+  delete[] tree_keys;
+  delete[] tree_values;
+  tree_keys = nullptr;
+  tree_values = nullptr;
+  count = 0;
+}
+
+#endif
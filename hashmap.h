@@ -10,15 +10,78 @@
 
 #include "map.h"
 #include "arrayseq.h"
+#include "nodepool.h"
+#include "hashpolicy.h"
+#include "avlmap.h"
 #include <functional>
+#include <cstdint>
+#include <cmath>
+#include <thread>
+#include <vector>
 
-template <typename K, typename V>
+// summary of how evenly the keys are spread over the buckets
+struct HashReport
+{
+  // number of buckets, buckets holding at least one key, and keys
+  int buckets = 0;
+  int used_buckets = 0;
+  int keys = 0;
+
+  // keys per bucket and fraction of buckets in use
+  double load_factor = 0.0;
+  double occupancy = 0.0;
+
+  // fraction of keys that land in an already used bucket, and the
+  // same rate for an ideal (uniformly random) hash at this load
+  double collision_rate = 0.0;
+  double expected_collision_rate = 0.0;
+};
+
+// chain lengths of a HashMap's buckets (see HashMap::chain_stats)
+struct ChainStats
+{
+  // number of buckets, buckets holding no key, and keys
+  int buckets = 0;
+  int empty_buckets = 0;
+  int keys = 0;
+
+  // fraction of buckets holding no key
+  double empty_ratio = 0.0;
+
+  // keys per bucket over every bucket and over the non-empty ones
+  double mean_length = 0.0;
+  double mean_used_length = 0.0;
+
+  // shortest, median, 99th percentile and longest chain among the
+  // non-empty buckets (all 0 when the map is empty)
+  int min_length = 0;
+  int p50_length = 0;
+  int p99_length = 0;
+  int max_length = 0;
+
+  // histogram[L] is the number of buckets holding exactly L keys, for
+  // L = 0 up to max_length
+  ArraySeq<int> histogram;
+};
+
+// A is the node allocation policy (see nodepool.h) and H is the hash
+// policy (see hashpolicy.h). When C is true each node also stores its
+// key's full hash code, so chain walks skip keys whose code differs and
+// rehashing never calls the hash policy.
+template <typename K, typename V, typename A = HeapAllocator, typename H = WyHash<K>,
+          bool C = cache_hash_code<K>::value>
 class HashMap : public Map<K, V>
 {
 public:
   // default constructor
   HashMap();
 
+  // constructs an empty map whose hash codes are mixed with the seed
+  explicit HashMap(std::uint64_t seed);
+
+  // constructs a map holding the given key-value pairs (see assign)
+  HashMap(const ArraySeq<K> &keys, const ArraySeq<V> &values);
+
   // copy constructor
   HashMap(const HashMap &rhs);
 
@@ -61,6 +124,33 @@ public:
   // Returns true if the key is in the collection, and false otherwise.
   bool contains(const K &key) const;
 
+  // Q if it is a lookup key for K (see is_lookup_key in map.h) and
+  // the hash policy hashes it to the key's code (is transparent)
+  template <typename Q>
+  using hash_lookup_t =
+      typename std::enable_if<is_lookup_key<K, Q>::value && is_transparent_hash<H>::value, Q>::type;
+
+  // Heterogeneous versions of operator[], erase, and contains: take
+  // any Q the keys compare equal with, such as a std::string_view or
+  // C string for std::string keys, without building a K
+  template <typename Q, typename = hash_lookup_t<Q>>
+  V &operator[](const Q &key);
+  template <typename Q, typename = hash_lookup_t<Q>>
+  const V &operator[](const Q &key) const;
+  template <typename Q, typename = hash_lookup_t<Q>>
+  void erase(const Q &key);
+  template <typename Q, typename = hash_lookup_t<Q>>
+  bool contains(const Q &key) const;
+
+  // Looks up n keys at once: found[i] is set to true if keys[i] is in
+  // the collection. The lookups are interleaved so the cache misses of
+  // a whole group of keys are in flight at the same time.
+  void contains_many(const K *keys, int n, bool *found) const;
+
+  // Looks up n keys at once like contains_many, also copying the value
+  // of each key found into values[i]. Returns the number of keys found.
+  int get_many(const K *keys, int n, V *values, bool *found) const;
+
   // Returns the keys k in the collection such that k1 <= k <= k2
   ArraySeq<K> find_keys(const K &k1, const K &k2) const;
 
@@ -81,123 +171,399 @@ public:
   // current capacity of the table.
   void clear();
 
-  // statistics functions for the hash table implementation
+  // Replaces the contents of the map with the given key-value pairs
+  // (keys[i] maps to values[i]), keeping the first pair of a repeated
+  // key. The table is sized for all of the pairs up front, so the load
+  // never resizes. Throws out_of_range if keys and values differ in
+  // size.
+  void assign(const ArraySeq<K> &keys, const ArraySeq<V> &values);
+
+  // Turns incremental rehashing on or off. When on, growing the table
+  // keeps the old and new tables side by side and each insert or
+  // erase migrates a bounded number of old buckets, instead of one
+  // insert rehashing the whole table. Turning it off finishes any
+  // migration in progress.
+  void set_incremental_rehash(bool on);
+
+  // Returns true if incremental rehashing is turned on
+  bool incremental_rehash() const;
+
+  // Returns true while an incremental rehash is migrating buckets
+  bool rehashing() const;
+
+  // Turns the ordered key index on or off. While on, every key is also
+  // kept in a balanced tree so find_keys, next_key, and prev_key take
+  // O(log n + k) and sorted_keys needs no sort, at the cost of one tree
+  // insert or erase per update. Turning it on builds the index from the
+  // current keys.
+  void set_ordered_index(bool on);
+
+  // Returns true if the ordered key index is turned on
+  bool ordered_index() const;
+
+  // Turns chain-length tracking on or off (it is on by default).
+  // While on, the length of every chain, a histogram of the lengths,
+  // and the shortest and longest non-empty chain are kept up to date
+  // on each insert, erase, and rehash step, so the statistics
+  // functions never walk the table, at the cost of an int per bucket
+  // and one more array access and histogram update per insert or
+  // erase (plus, when an erase or rehash step empties the last of the
+  // shortest chains, a scan up the histogram to the next length in
+  // use, at most the longest chain). Turning it off drops that cost
+  // and makes the statistics walk the table instead. Turning it on
+  // counts the current chains.
+  void set_chain_tracking(bool on);
+
+  // Returns true if chain-length tracking is turned on
+  bool chain_tracking() const;
+
+  // Sets the number of threads a full rehash is split across. Each
+  // thread moves the chains of its own range of old buckets into its
+  // own range of new buckets, so no locks are needed. Tables under
+  // PARALLEL_REHASH_MIN buckets always rehash on the calling thread.
+  // Throws out_of_range unless threads >= 1.
+  void set_rehash_threads(int threads);
+
+  // Returns the number of threads a full rehash is split across
+  int rehash_threads() const;
+
+  // smallest table a full rehash is split across threads for
+  static const int PARALLEL_REHASH_MIN = 1 << 16;
+
+  // Grows the table (if needed) so n keys fit under the max load
+  // factor without another resize
+  void reserve(int n);
+
+  // Shrinks the table to the smallest size that holds the current
+  // keys under the max load factor
+  void shrink_to_fit();
+
+  // Sets the load factor (keys per bucket) at which inserts grow the
+  // table, growing it right away if it is already past it. Lowers the
+  // min load factor if needed to keep it under half the max. Throws
+  // out_of_range unless load > 0.
+  void set_max_load_factor(double load);
+
+  // Returns the load factor at which inserts grow the table
+  double max_load_factor() const;
+
+  // Sets the load factor below which erases shrink the table (0 turns
+  // automatic shrinking off). Throws out_of_range unless 0 <= load and
+  // load < max_load_factor() / 2, so a shrink never triggers a grow.
+  void set_min_load_factor(double load);
+
+  // Returns the load factor below which erases shrink the table
+  double min_load_factor() const;
+
+  // Returns the number of buckets in the table
+  int bucket_count() const;
+
+  // Returns the seed the hash policy is mixed with
+  std::uint64_t seed() const;
+
+  // statistics functions for the hash table implementation (shortest
+  // and longest non-empty chain, and keys per non-empty bucket). O(1)
+  // with chain tracking on, and a walk of the table with it off.
   int min_chain_length() const;
   int max_chain_length() const;
   double avg_chain_length() const;
 
+  // Returns the chain-length histogram and its summary statistics.
+  // With chain tracking on this takes time proportional to the longest
+  // chain (the length of the histogram) instead of walking the table.
+  ChainStats chain_stats() const;
+
+  // Reports bucket occupancy and collision rate for the current keys
+  HashReport hash_report() const;
+
 private:
-  // node for linked-list separate chaining
-  struct Node
+  // node for linked-list separate chaining (with the cached hash code
+  // when C is true)
+  struct Node : HashCodeSlot<C>
   {
     K key;
     V value;
     Node *next;
   };
 
+  // node allocator
+  typename A::template Pool<Node> pool;
+
   // number of key-value pairs in map
   int count = 0;
 
-  // max size of the (array) table
+  // max size of the (array) table (always a power of two)
   int capacity = 16;
 
-  // threshold for resize and rehash
-  const double load_factor_threshold = 0.75;
+  // hash policy and the seed mixed into every hash code
+  H hasher;
+  std::uint64_t hash_seed = 0;
+
+  // load factors at which the table grows and shrinks
+  double max_load = 0.75;
+  double min_load = 0.1;
+
+  // smallest table size
+  static const int MIN_CAPACITY = 16;
 
   // array of linked lists
   Node **table = new Node *[capacity];
 
-  // the hash function
-  int hash(const K &key) const;
+  // number of keys in each chain of table (allocated only while
+  // tracking is true, and kept apart from the heads so lookups still
+  // read a dense array of pointers)
+  int *lengths = nullptr;
+
+  // table being drained by an incremental rehash (nullptr otherwise)
+  Node **old_table = nullptr;
+  int *old_lengths = nullptr;
+  int old_capacity = 0;
+
+  // next old bucket to migrate (buckets below it are already moved)
+  int migrate_index = 0;
+
+  // true if resizes migrate a few buckets per operation
+  bool incremental = false;
+
+  // number of old buckets migrated per insert or erase
+  const int rehash_step = 8;
+
+  // every key in order (kept only while ordered is true)
+  AVLMap<K, bool, A> key_index;
+  bool ordered = false;
+
+  // chain_counts[L] is the number of buckets (in either table) holding
+  // exactly L keys, and longest_chain and shortest_chain the largest
+  // and smallest L > 0 with a bucket, or 0 if there is none (kept only
+  // while tracking is true)
+  ArraySeq<int> chain_counts;
+  int longest_chain = 0;
+  int shortest_chain = 0;
+  bool tracking = true;
+
+  // threads a full rehash is split across (1 keeps it on the calling
+  // thread)
+  int rehash_workers = 1;
+
+  // the full hash code of a key (or of a lookup value)
+  template <typename Q>
+  std::uint64_t hash_code(const Q &key) const;
+
+  // the hash code of a stored node (cached or recomputed)
+  std::uint64_t node_code(const Node *node) const;
+
+  // the bucket index of a hash code for a table of the given size
+  int hash(std::uint64_t code, int cap) const;
+
+  // head of the chain that holds (or would hold) the key with the
+  // given hash code
+  Node *&bucket(std::uint64_t code);
+  Node *bucket(std::uint64_t code) const;
+
+  // number of keys in the chain bucket(code) returns
+  int &bucket_length(std::uint64_t code);
+
+  // move a chain of the given length up or down by one key in the
+  // chain-length histogram
+  void grow_chain(int &length);
+  void shrink_chain(int &length);
+
+  // remove a drained old bucket from the chain-length histogram
+  void drop_chain(int &length);
+
+  // move longest_chain down and shortest_chain up past lengths no
+  // bucket has any more
+  void trim_chain_bounds();
+
+  // chain_counts up to the longest chain while tracking, and otherwise
+  // the same histogram counted by walking every chain
+  ArraySeq<int> chain_histogram() const;
+
+  // returns the node for the key or nullptr if it is not in the map
+  template <typename Q>
+  Node *find_node(const Q &key) const;
+
+  // erase helper: unlinks the key's node, shrinking the table if it
+  // falls below the min load factor
+  template <typename Q>
+  void erase_key(const Q &key);
 
-  // resize and rehash the table
-  void resize_and_rehash();
+  // number of lookups a batch keeps in flight at once
+  static const int BATCH_WINDOW = 16;
 
-  // initialize the table to all nullptr
+  // finds the node (or nullptr) for each of n keys and calls
+  // visit(i, node) for key i, keeping BATCH_WINDOW lookups in flight
+  template <typename F>
+  void find_batch(const K *keys, int n, F visit) const;
+
+  // hints that the memory at ptr will be read soon
+  static void prefetch(const void *ptr);
+
+  // smallest table size that holds n keys under the max load factor
+  int capacity_for(int n) const;
+
+  // resize and rehash the table to the given size
+  void resize_and_rehash(int new_capacity);
+
+  // allocate a table of the given size and start draining the old one
+  void start_rehash(int new_capacity);
+
+  // move up to the given number of old buckets into the new table
+  // (full marks a synchronous drain of the whole old table, which
+  // recounts the chains in one pass while tracking)
+  void rehash_some(int buckets, bool full = false);
+
+  // move every old bucket into the new table on rehash_workers threads
+  // (counting the new chain lengths if recount is true)
+  void parallel_drain(bool recount);
+
+  // calls visit(head) for each non-empty chain in either table
+  template <typename F>
+  void for_each_bucket(F visit) const;
+
+  // rebuild the chain-length histogram from the chain lengths
+  void count_chains();
+
+  // initialize the table to all nullptr (and, while tracking, every
+  // chain to empty)
   void init_table();
 };
 
-template <typename K, typename V>
-HashMap<K, V>::HashMap()
+template <typename K, typename V, typename A, typename H, bool C>
+HashMap<K, V, A, H, C>::HashMap()
+{
+  init_table();
+}
+
+// constructs an empty map whose hash codes are mixed with the seed
+template <typename K, typename V, typename A, typename H, bool C>
+HashMap<K, V, A, H, C>::HashMap(std::uint64_t seed)
+    : hash_seed(seed)
+{
+  init_table();
+}
+
+// constructs a map holding the given key-value pairs
+template <typename K, typename V, typename A, typename H, bool C>
+HashMap<K, V, A, H, C>::HashMap(const ArraySeq<K> &keys, const ArraySeq<V> &values)
 {
   init_table();
+  assign(keys, values);
 }
 
 // copy constructor
-template <typename K, typename V>
-HashMap<K, V>::HashMap(const HashMap &rhs)
+template <typename K, typename V, typename A, typename H, bool C>
+HashMap<K, V, A, H, C>::HashMap(const HashMap &rhs)
 {
   init_table();
   *this = rhs;
 }
 
 // move constructor
-template <typename K, typename V>
-HashMap<K, V>::HashMap(HashMap &&rhs)
+template <typename K, typename V, typename A, typename H, bool C>
+HashMap<K, V, A, H, C>::HashMap(HashMap &&rhs)
 {
   init_table();
   *this = std::move(rhs);
 }
 
 // copy assignment
-template <typename K, typename V>
-HashMap<K, V> &HashMap<K, V>::operator=(const HashMap &rhs)
+template <typename K, typename V, typename A, typename H, bool C>
+HashMap<K, V, A, H, C> &HashMap<K, V, A, H, C>::operator=(const HashMap &rhs)
 {
   if (this != &rhs)
   {
     clear();
-    Node *rhsTraverse = nullptr;
-    Node *temp = nullptr;
+    delete[] table;
+    delete[] lengths;
 
     count = rhs.count;
     capacity = rhs.capacity;
+    incremental = rhs.incremental;
+    hasher = rhs.hasher;
+    hash_seed = rhs.hash_seed;
+    ordered = rhs.ordered;
+    key_index = rhs.key_index;
+    max_load = rhs.max_load;
+    min_load = rhs.min_load;
+    tracking = rhs.tracking;
+    rehash_workers = rhs.rehash_workers;
     table = new Node *[capacity];
+    lengths = nullptr;
+    if (tracking)
+    {
+      lengths = new int[capacity];
+    }
     init_table();
 
-    for (int i = 0; i < capacity; i++)
+    // copies land directly in the new table, even if rhs is mid-rehash
+    rhs.for_each_bucket([&](Node *head)
     {
-      if (rhs.table[i] != nullptr)
+      for (Node *rhsTraverse = head; rhsTraverse != nullptr; rhsTraverse = rhsTraverse->next)
       {
-        rhsTraverse = rhs.table[i];
-        while (rhsTraverse != nullptr)
+        Node *temp = pool.create();
+        temp->key = rhsTraverse->key;
+        temp->value = rhsTraverse->value;
+        std::uint64_t code = rhs.node_code(rhsTraverse);
+        temp->set_code(code);
+        int index = hash(code, capacity);
+        temp->next = table[index];
+        table[index] = temp;
+        if (tracking)
         {
-          // new node
-          temp = new Node;
-          temp->key = rhsTraverse->key;
-          temp->value = rhsTraverse->value;
-          temp->next = table[i];
-          table[i] = temp;
-
-          // next
-          rhsTraverse = rhsTraverse->next;
+          grow_chain(lengths[index]);
         }
       }
-    }
+    });
   }
   return *this;
 }
 
 // move assignment
-template <typename K, typename V>
-HashMap<K, V> &HashMap<K, V>::operator=(HashMap &&rhs)
+template <typename K, typename V, typename A, typename H, bool C>
+HashMap<K, V, A, H, C> &HashMap<K, V, A, H, C>::operator=(HashMap &&rhs)
 {
   if (this != &rhs)
   {
+    clear();
+    delete[] table;
+    delete[] lengths;
+    pool.swap(rhs.pool);
+
     count = rhs.count;
     capacity = rhs.capacity;
-
-    for (int i = 0; i < capacity; ++i)
-    {
-      if (rhs.table[i] != nullptr)
-      {
-        table[i] = rhs.table[i];
-        rhs.table[i] = nullptr;
-      }
-    }
+    table = rhs.table;
+    lengths = rhs.lengths;
+    old_table = rhs.old_table;
+    old_lengths = rhs.old_lengths;
+    old_capacity = rhs.old_capacity;
+    migrate_index = rhs.migrate_index;
+    incremental = rhs.incremental;
+    hasher = rhs.hasher;
+    hash_seed = rhs.hash_seed;
+    ordered = rhs.ordered;
+    key_index = std::move(rhs.key_index);
+    max_load = rhs.max_load;
+    min_load = rhs.min_load;
+    tracking = rhs.tracking;
+    rehash_workers = rhs.rehash_workers;
+    chain_counts = std::move(rhs.chain_counts);
+    longest_chain = rhs.longest_chain;
+    shortest_chain = rhs.shortest_chain;
 
     // default state for rhs
     rhs.count = 0;
     rhs.capacity = 16;
+    rhs.table = new Node *[rhs.capacity];
+    rhs.lengths = nullptr;
+    if (rhs.tracking)
+    {
+      rhs.lengths = new int[rhs.capacity];
+    }
+    rhs.old_table = nullptr;
+    rhs.old_lengths = nullptr;
+    rhs.old_capacity = 0;
+    rhs.migrate_index = 0;
     rhs.init_table();
   }
 
@@ -205,22 +571,24 @@ HashMap<K, V> &HashMap<K, V>::operator=(HashMap &&rhs)
 }
 
 // destructor
-template <typename K, typename V>
-HashMap<K, V>::~HashMap()
+template <typename K, typename V, typename A, typename H, bool C>
+HashMap<K, V, A, H, C>::~HashMap()
 {
   clear();
+  delete[] table;
+  delete[] lengths;
 }
 
 // Returns the number of key-value pairs in the map
-template <typename K, typename V>
-int HashMap<K, V>::size() const
+template <typename K, typename V, typename A, typename H, bool C>
+int HashMap<K, V, A, H, C>::size() const
 {
   return count;
 }
 
 // Tests if the map is empty
-template <typename K, typename V>
-bool HashMap<K, V>::empty() const
+template <typename K, typename V, typename A, typename H, bool C>
+bool HashMap<K, V, A, H, C>::empty() const
 {
   if (size() == 0)
   {
@@ -231,198 +599,228 @@ bool HashMap<K, V>::empty() const
 
 // Allows values associated with a key to be updated. Throws
 // out_of_range if the given key is not in the collection.
-template <typename K, typename V>
-V &HashMap<K, V>::operator[](const K &key)
+template <typename K, typename V, typename A, typename H, bool C>
+V &HashMap<K, V, A, H, C>::operator[](const K &key)
 {
-  Node *traverse = nullptr;
-  int index = -1;
+  Node *node = find_node(key);
 
-  if (!contains(key))
+  if (node == nullptr)
   {
     throw std::out_of_range("Key is not in the collection");
   }
-
-  index = hash(key);
-  traverse = table[index];
-
-  while (traverse != nullptr)
-  {
-    if (traverse->key == key)
-    {
-      return traverse->value;
-    }
-    traverse = traverse->next;
-  }
+  return node->value;
 }
 
 // Returns the value for a given key. Throws out_of_range if the
 // given key is not in the collection.
-template <typename K, typename V>
-const V &HashMap<K, V>::operator[](const K &key) const
+template <typename K, typename V, typename A, typename H, bool C>
+const V &HashMap<K, V, A, H, C>::operator[](const K &key) const
 {
-  Node *traverse = nullptr;
-  int index = -1;
+  Node *node = find_node(key);
 
-  if (!contains(key))
+  if (node == nullptr)
   {
     throw std::out_of_range("Key is not in the collection");
   }
-
-  index = hash(key);
-  traverse = table[index];
-
-  while (traverse != nullptr)
-  {
-    if (traverse->key == key)
-    {
-      return traverse->value;
-    }
-    traverse = traverse->next;
-  }
+  return node->value;
 }
 
 // Extends the collection by adding the given key-value pair.
 // Expects key to not exist in map prior to insertion.
-template <typename K, typename V>
-void HashMap<K, V>::insert(const K &key, const V &value)
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::insert(const K &key, const V &value)
 {
   double current_ratio = 0.0;
-  int index = -1;
+
+  if (old_table != nullptr)
+  {
+    rehash_some(rehash_step);
+  }
 
   current_ratio = static_cast<double>(count) / capacity;
 
-  if (current_ratio >= load_factor_threshold)
+  if (current_ratio >= max_load)
   {
-    resize_and_rehash();
+    if (incremental)
+    {
+      // finish the previous migration before starting another
+      rehash_some(old_capacity);
+      start_rehash(capacity * 2);
+    }
+    else
+    {
+      resize_and_rehash(capacity * 2);
+    }
   }
 
-  Node *temp = new Node;
+  std::uint64_t code = hash_code(key);
+  Node *temp = pool.create();
   temp->key = key;
   temp->value = value;
+  temp->set_code(code);
 
-  index = hash(key);
-  temp->next = table[index];
-  table[index] = temp;
+  Node *&head = bucket(code);
+  temp->next = head;
+  head = temp;
+  if (tracking)
+  {
+    grow_chain(bucket_length(code));
+  }
   count++;
+
+  if (ordered)
+  {
+    key_index.insert(key, true);
+  }
 }
 
 // Shrinks the collection by removing the key-value pair with the
 // given key. Does not modify the collection if the collection does
 // not contain the key. Throws out_of_range if the given key is not
 // in the collection.
-template <typename K, typename V>
-void HashMap<K, V>::erase(const K &key)
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::erase(const K &key)
 {
-  Node *traverse = nullptr;
-  Node *remove = nullptr;
-  int index = -1;
+  erase_key(key);
+}
 
-  if (!contains(key))
+// Returns true if the key is in the collection, and false otherwise.
+template <typename K, typename V, typename A, typename H, bool C>
+bool HashMap<K, V, A, H, C>::contains(const K &key) const
+{
+  if (empty())
   {
-    throw std::out_of_range("Key is not in the collection");
+    return false;
   }
+  return find_node(key) != nullptr;
+}
 
-  index = hash(key);
-  traverse = table[index];
+// Allows values associated with a key to be updated, looked up by a
+// value the keys compare equal with. Throws out_of_range if the key is
+// not in the collection.
+template <typename K, typename V, typename A, typename H, bool C>
+template <typename Q, typename>
+V &HashMap<K, V, A, H, C>::operator[](const Q &key)
+{
+  Node *node = find_node(key);
 
-  // remove head
-  if (traverse->key == key)
+  if (node == nullptr)
   {
-    remove = traverse;
-    table[index] = traverse->next;
-    delete remove;
-    count--;
-    return;
+    throw std::out_of_range("Key is not in the collection");
   }
-  // remove later element
-  else
+  return node->value;
+}
+
+// Returns the value for a key, looked up by a value the keys compare
+// equal with. Throws out_of_range if the key is not in the collection.
+template <typename K, typename V, typename A, typename H, bool C>
+template <typename Q, typename>
+const V &HashMap<K, V, A, H, C>::operator[](const Q &key) const
+{
+  Node *node = find_node(key);
+
+  if (node == nullptr)
   {
-    while (traverse->next != nullptr)
-    {
-      if (traverse->next->key == key)
-      {
-        remove = traverse->next;
-        traverse->next = remove->next;
-        delete remove;
-        count--;
-        return;
-      }
-      traverse = traverse->next;
-    }
+    throw std::out_of_range("Key is not in the collection");
   }
+  return node->value;
 }
 
-// Returns true if the key is in the collection, and false otherwise.
-template <typename K, typename V>
-bool HashMap<K, V>::contains(const K &key) const
+// Removes the key-value pair for a key, looked up by a value the keys
+// compare equal with. Throws out_of_range if the key is not in the
+// collection.
+template <typename K, typename V, typename A, typename H, bool C>
+template <typename Q, typename>
+void HashMap<K, V, A, H, C>::erase(const Q &key)
 {
-  Node *traverse = nullptr;
-  int index = -1;
+  erase_key(key);
+}
 
+// Returns true if a key the value compares equal to is in the
+// collection, and false otherwise.
+template <typename K, typename V, typename A, typename H, bool C>
+template <typename Q, typename>
+bool HashMap<K, V, A, H, C>::contains(const Q &key) const
+{
   if (empty())
   {
     return false;
   }
+  return find_node(key) != nullptr;
+}
+
+// Looks up n keys at once, setting found[i] for each
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::contains_many(const K *keys, int n, bool *found) const
+{
+  find_batch(keys, n, [&](int i, Node *node)
+  {
+    found[i] = node != nullptr;
+  });
+}
 
-  index = hash(key);
-  traverse = table[index];
+// Looks up n keys at once, copying the value of each key found
+template <typename K, typename V, typename A, typename H, bool C>
+int HashMap<K, V, A, H, C>::get_many(const K *keys, int n, V *values, bool *found) const
+{
+  int hits = 0;
 
-  while (traverse != nullptr)
+  find_batch(keys, n, [&](int i, Node *node)
   {
-    if (traverse->key == key)
+    found[i] = node != nullptr;
+    if (node != nullptr)
     {
-      return true;
+      values[i] = node->value;
+      hits++;
     }
-    traverse = traverse->next;
-  }
-
-  return false;
+  });
+  return hits;
 }
 
 // Returns the keys k in the collection such that k1 <= k <= k2
-template <typename K, typename V>
-ArraySeq<K> HashMap<K, V>::find_keys(const K &k1, const K &k2) const
+template <typename K, typename V, typename A, typename H, bool C>
+ArraySeq<K> HashMap<K, V, A, H, C>::find_keys(const K &k1, const K &k2) const
 {
+  if (ordered)
+  {
+    return key_index.find_keys(k1, k2);
+  }
+
   ArraySeq<K> keys;
-  Node *traverse = nullptr;
 
-  for (int i = 0; i < capacity; ++i)
+  for_each_bucket([&](Node *traverse)
   {
-    if (table[i] != nullptr)
+    while (traverse != nullptr)
     {
-      traverse = table[i];
-      while (traverse != nullptr)
+      if (traverse->key >= k1 && traverse->key <= k2)
       {
-        if (traverse->key >= k1 && traverse->key <= k2)
-        {
-          keys.insert(traverse->key, keys.size());
-        }
-        traverse = traverse->next;
+        keys.insert(traverse->key, keys.size());
       }
+      traverse = traverse->next;
     }
-  }
+  });
   return keys;
 }
 
 // Returns the keys in the collection in ascending sorted order
-template <typename K, typename V>
-ArraySeq<K> HashMap<K, V>::sorted_keys() const
+template <typename K, typename V, typename A, typename H, bool C>
+ArraySeq<K> HashMap<K, V, A, H, C>::sorted_keys() const
 {
+  if (ordered)
+  {
+    return key_index.sorted_keys();
+  }
+
   ArraySeq<K> keys;
-  Node *traverse = nullptr;
 
-  for (int i = 0; i < capacity; ++i)
+  for_each_bucket([&](Node *traverse)
   {
-    if (table[i] != nullptr)
+    while (traverse != nullptr)
     {
-      traverse = table[i];
-      while (traverse != nullptr)
-      {
-        keys.insert(traverse->key, keys.size());
-        traverse = traverse->next;
-      }
+      keys.insert(traverse->key, keys.size());
+      traverse = traverse->next;
     }
-  }
+  });
 
   keys.sort();
   return keys;
@@ -431,263 +829,1112 @@ ArraySeq<K> HashMap<K, V>::sorted_keys() const
 // Gives the key (as an ouptput parameter) immediately after the
 // given key according to ascending sort order. Returns true if a
 // successor key exists, and false otherwise.
-template <typename K, typename V>
-bool HashMap<K, V>::next_key(const K &key, K &next_key) const
+template <typename K, typename V, typename A, typename H, bool C>
+bool HashMap<K, V, A, H, C>::next_key(const K &key, K &next_key) const
 {
+  if (ordered)
+  {
+    return key_index.next_key(key, next_key);
+  }
+
   K successor = key;
-  Node *traverse = nullptr;
   bool exists = false;
 
-  for (int i = 0; i < capacity; ++i)
+  for_each_bucket([&](Node *traverse)
   {
-    if (table[i] != nullptr)
+    while (traverse != nullptr)
     {
-      traverse = table[i];
-
-      while (traverse != nullptr)
+      if (traverse->key > key)
       {
-        if (traverse->key > key)
+        exists = true;
+        // first time
+        if (successor == key)
         {
-          exists = true;
-          // first time
-          if (successor == key)
-          {
-            successor = traverse->key;
-          }
-          // not first time AND smaller max
-          else if (traverse->key < successor)
-          {
-            successor = traverse->key;
-          }
-          // update
-          next_key = successor;
+          successor = traverse->key;
         }
-        traverse = traverse->next;
+        // not first time AND smaller max
+        else if (traverse->key < successor)
+        {
+          successor = traverse->key;
+        }
+        // update
+        next_key = successor;
       }
+      traverse = traverse->next;
     }
-  }
+  });
   return exists;
 }
 
 // Gives the key (as an ouptput parameter) immediately before the
 // given key according to ascending sort order. Returns true if a
 // predecessor key exists, and false otherwise.
-template <typename K, typename V>
-bool HashMap<K, V>::prev_key(const K &key, K &next_key) const
+template <typename K, typename V, typename A, typename H, bool C>
+bool HashMap<K, V, A, H, C>::prev_key(const K &key, K &next_key) const
 {
+  if (ordered)
+  {
+    return key_index.prev_key(key, next_key);
+  }
+
   K previous = key;
-  Node *traverse = nullptr;
   bool exists = false;
 
-  for (int i = 0; i < capacity; ++i)
+  for_each_bucket([&](Node *traverse)
   {
-    if (table[i] != nullptr)
+    while (traverse != nullptr)
     {
-      traverse = table[i];
-
-      while (traverse != nullptr)
+      if (traverse->key < key)
       {
-        if (traverse->key < key)
+        exists = true;
+        // first time
+        if (previous == key)
         {
-          exists = true;
-          // first time
-          if (previous == key)
-          {
-            previous = traverse->key;
-          }
-          // not first time AND larger MIN
-          else if (traverse->key > previous)
-          {
-            previous = traverse->key;
-          }
-          // update
-          next_key = previous;
+          previous = traverse->key;
         }
-        traverse = traverse->next;
+        // not first time AND larger MIN
+        else if (traverse->key > previous)
+        {
+          previous = traverse->key;
+        }
+        // update
+        next_key = previous;
       }
+      traverse = traverse->next;
     }
-  }
+  });
   return exists;
 }
 
 // Removes all key-value pairs from the map. Does not change the
 // current capacity of the table.
-template <typename K, typename V>
-void HashMap<K, V>::clear()
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::clear()
 {
-  Node *traverse = nullptr;
   Node *next = nullptr;
 
-  for (int i = 0; i < capacity; ++i)
+  // nodes that need no destructor go back with their slabs
+  if (pool.drops_nodes)
   {
-    if (table[i] != nullptr)
+    count = 0;
+  }
+  else
+  {
+    // clear each node
+    for_each_bucket([&](Node *traverse)
     {
-      traverse = table[i];
-      // clear each node
       while (traverse != nullptr)
       {
         next = traverse->next;
-        delete traverse;
+        pool.destroy(traverse);
         traverse = next;
         count--;
       }
-      table[i] = nullptr;
-    }
+    });
   }
+  pool.release();
+  init_table();
 
-  // clear array
-  delete[] table;
+  // drop the table being drained
+  delete[] old_table;
+  delete[] old_lengths;
+  old_table = nullptr;
+  old_lengths = nullptr;
+  old_capacity = 0;
+  migrate_index = 0;
+
+  key_index.clear();
 }
 
-// statistics functions for the hash table implementation
-template <typename K, typename V>
-int HashMap<K, V>::min_chain_length() const
+// Replaces the contents of the map with the given key-value pairs
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::assign(const ArraySeq<K> &keys, const ArraySeq<V> &values)
 {
-  int temp = 0, min = 0;
-  Node *traverse = nullptr;
-  for (int i = 0; i < capacity; ++i)
+  this->check_pairs(keys, values);
+  clear();
+  reserve(keys.size());
+
+  // the ordered index is built once at the end
+  ArraySeq<K> added;
+
+  // hash codes are computed BATCH_WINDOW keys ahead so the bucket
+  // (and, half a window later, the chain head) the duplicate check
+  // reads is already on its way to the cache
+  int n = keys.size();
+  std::uint64_t codes[BATCH_WINDOW];
+  for (int i = 0; i < BATCH_WINDOW && i < n; ++i)
   {
-    if (table[i] != nullptr)
+    codes[i] = hash_code(keys[i]);
+    prefetch(&bucket(codes[i]));
+  }
+  for (int i = 0; i < n; ++i)
+  {
+    std::uint64_t code = codes[i % BATCH_WINDOW];
+    if (i + BATCH_WINDOW < n)
     {
-      traverse = table[i];
-      // count up amount of elements in each array
-      while (traverse != nullptr)
-      {
-        temp++;
-        traverse = traverse->next;
-      }
-      // first time
-      if (min == 0)
-      {
-        min = temp;
-      }
-      // every other time
-      else if (temp < min)
-      {
-        min = temp;
-      }
-      // reset temp counter
-      temp = 0;
+      codes[i % BATCH_WINDOW] = hash_code(keys[i + BATCH_WINDOW]);
+      prefetch(&bucket(codes[i % BATCH_WINDOW]));
+    }
+    if (i + BATCH_WINDOW / 2 < n)
+    {
+      prefetch(bucket(codes[(i + BATCH_WINDOW / 2) % BATCH_WINDOW]));
+    }
+    Node *&head = bucket(code);
+
+    // skip a key already loaded
+    Node *traverse = head;
+    while (traverse != nullptr && !(traverse->same_code(code) && traverse->key == keys[i]))
+    {
+      traverse = traverse->next;
+    }
+    if (traverse != nullptr)
+    {
+      continue;
+    }
+
+    Node *temp = pool.create();
+    temp->key = keys[i];
+    temp->value = values[i];
+    temp->set_code(code);
+    temp->next = head;
+    head = temp;
+    if (tracking)
+    {
+      grow_chain(bucket_length(code));
+    }
+    count++;
+
+    if (ordered)
+    {
+      added.insert(keys[i], added.size());
     }
   }
-  return min;
-}
 
-template <typename K, typename V>
-int HashMap<K, V>::max_chain_length() const
-{
-  int temp = 0, max = 0;
-  Node *traverse = nullptr;
-  for (int i = 0; i < capacity; ++i)
+  if (ordered)
   {
-    // Only at non-empty buckets
-    if (table[i] != nullptr)
+    ArraySeq<bool> flags;
+    for (int i = 0; i < added.size(); ++i)
     {
-      traverse = table[i];
-      // count up amount of elements in each array
-      while (traverse != nullptr)
-      {
-        temp++;
-        traverse = traverse->next;
-      }
-      // first time
-      if (max == 0)
-      {
-        max = temp;
-      }
-      // every other time
-      else if (temp > max)
-      {
-        max = temp;
-      }
-      // reset temp counter
-      temp = 0;
+      flags.insert(true, i);
     }
+    key_index.assign(added, flags);
   }
-  return max;
 }
 
-template <typename K, typename V>
-double HashMap<K, V>::avg_chain_length() const
+// Turns incremental rehashing on or off.
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::set_incremental_rehash(bool on)
 {
-  int numArrays = 0;
-  Node *traverse = nullptr;
-  double avg = 0.0;
-
-  if (size() > 0)
+  if (!on && old_table != nullptr)
   {
-    for (int i = 0; i < capacity; ++i)
-    {
-      // Only at non-empty buckets
-      if (table[i] != nullptr)
-      {
-        numArrays++;
+    rehash_some(old_capacity);
+  }
+  incremental = on;
+}
+
+// Returns true if incremental rehashing is turned on
+template <typename K, typename V, typename A, typename H, bool C>
+bool HashMap<K, V, A, H, C>::incremental_rehash() const
+{
+  return incremental;
+}
+
+// Returns true while an incremental rehash is migrating buckets
+template <typename K, typename V, typename A, typename H, bool C>
+bool HashMap<K, V, A, H, C>::rehashing() const
+{
+  return old_table != nullptr;
+}
+
+// Turns the ordered key index on or off
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::set_ordered_index(bool on)
+{
+  if (on && !ordered)
+  {
+    for_each_bucket([&](Node *traverse)
+    {
+      while (traverse != nullptr)
+      {
+        key_index.insert(traverse->key, true);
+        traverse = traverse->next;
+      }
+    });
+  }
+  else if (!on)
+  {
+    key_index.clear();
+  }
+  ordered = on;
+}
+
+// Returns true if the ordered key index is turned on
+template <typename K, typename V, typename A, typename H, bool C>
+bool HashMap<K, V, A, H, C>::ordered_index() const
+{
+  return ordered;
+}
+
+// Turns chain-length tracking on or off
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::set_chain_tracking(bool on)
+{
+  if (on && !tracking)
+  {
+    lengths = new int[capacity]();
+    if (old_table != nullptr)
+    {
+      old_lengths = new int[old_capacity]();
+    }
+    for (int i = migrate_index; i < old_capacity; ++i)
+    {
+      for (Node *traverse = old_table[i]; traverse != nullptr; traverse = traverse->next)
+      {
+        old_lengths[i]++;
+      }
+    }
+    for (int i = 0; i < capacity; ++i)
+    {
+      for (Node *traverse = table[i]; traverse != nullptr; traverse = traverse->next)
+      {
+        lengths[i]++;
+      }
+    }
+    tracking = true;
+    count_chains();
+  }
+  else if (!on && tracking)
+  {
+    delete[] lengths;
+    delete[] old_lengths;
+    lengths = nullptr;
+    old_lengths = nullptr;
+    chain_counts.clear();
+    longest_chain = 0;
+    shortest_chain = 0;
+    tracking = false;
+  }
+}
+
+// Returns true if chain-length tracking is turned on
+template <typename K, typename V, typename A, typename H, bool C>
+bool HashMap<K, V, A, H, C>::chain_tracking() const
+{
+  return tracking;
+}
+
+// Sets the number of threads a full rehash is split across
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::set_rehash_threads(int threads)
+{
+  if (threads < 1)
+  {
+    throw std::out_of_range("Rehash needs at least one thread");
+  }
+  rehash_workers = threads;
+}
+
+// Returns the number of threads a full rehash is split across
+template <typename K, typename V, typename A, typename H, bool C>
+int HashMap<K, V, A, H, C>::rehash_threads() const
+{
+  return rehash_workers;
+}
+
+// Grows the table (if needed) so n keys fit under the max load factor
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::reserve(int n)
+{
+  int new_capacity = capacity_for(n);
+
+  if (new_capacity > capacity)
+  {
+    resize_and_rehash(new_capacity);
+  }
+}
+
+// Shrinks the table to the smallest size that holds the current keys
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::shrink_to_fit()
+{
+  int new_capacity = capacity_for(count);
+
+  if (new_capacity < capacity)
+  {
+    resize_and_rehash(new_capacity);
+  }
+}
+
+// Sets the load factor at which inserts grow the table
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::set_max_load_factor(double load)
+{
+  if (!(load > 0.0))
+  {
+    throw std::out_of_range("Load factor is out of range");
+  }
+  max_load = load;
+  if (min_load >= max_load / 2)
+  {
+    min_load = max_load / 4;
+  }
+  reserve(count);
+}
+
+// Returns the load factor at which inserts grow the table
+template <typename K, typename V, typename A, typename H, bool C>
+double HashMap<K, V, A, H, C>::max_load_factor() const
+{
+  return max_load;
+}
+
+// Sets the load factor below which erases shrink the table
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::set_min_load_factor(double load)
+{
+  if (!(load >= 0.0) || load >= max_load / 2)
+  {
+    throw std::out_of_range("Load factor is out of range");
+  }
+  min_load = load;
+}
+
+// Returns the load factor below which erases shrink the table
+template <typename K, typename V, typename A, typename H, bool C>
+double HashMap<K, V, A, H, C>::min_load_factor() const
+{
+  return min_load;
+}
+
+// Returns the number of buckets in the table
+template <typename K, typename V, typename A, typename H, bool C>
+int HashMap<K, V, A, H, C>::bucket_count() const
+{
+  return capacity;
+}
+
+// Returns the seed the hash policy is mixed with
+template <typename K, typename V, typename A, typename H, bool C>
+std::uint64_t HashMap<K, V, A, H, C>::seed() const
+{
+  return hash_seed;
+}
+
+// statistics functions for the hash table implementation
+template <typename K, typename V, typename A, typename H, bool C>
+int HashMap<K, V, A, H, C>::min_chain_length() const
+{
+  if (tracking)
+  {
+    return shortest_chain;
+  }
+  return chain_stats().min_length;
+}
+
+template <typename K, typename V, typename A, typename H, bool C>
+int HashMap<K, V, A, H, C>::max_chain_length() const
+{
+  if (tracking)
+  {
+    return longest_chain;
+  }
+  return chain_stats().max_length;
+}
+
+template <typename K, typename V, typename A, typename H, bool C>
+double HashMap<K, V, A, H, C>::avg_chain_length() const
+{
+  // Only at non-empty buckets
+  if (tracking)
+  {
+    int used = capacity + old_capacity - migrate_index - chain_counts[0];
+    return used == 0 ? 0.0 : static_cast<double>(count) / used;
+  }
+  return chain_stats().mean_used_length;
+}
+
+// Returns the chain-length histogram and its summary statistics
+template <typename K, typename V, typename A, typename H, bool C>
+ChainStats HashMap<K, V, A, H, C>::chain_stats() const
+{
+  ChainStats stats;
+
+  stats.histogram = chain_histogram();
+  stats.buckets = capacity + old_capacity - migrate_index;
+  stats.empty_buckets = stats.histogram[0];
+  stats.keys = size();
+  stats.max_length = stats.histogram.size() - 1;
+  stats.empty_ratio = static_cast<double>(stats.empty_buckets) / stats.buckets;
+  stats.mean_length = static_cast<double>(stats.keys) / stats.buckets;
+
+  int used = stats.buckets - stats.empty_buckets;
+  if (used > 0)
+  {
+    stats.mean_used_length = static_cast<double>(stats.keys) / used;
+
+    // the percentiles are the shortest lengths whose running bucket
+    // count reaches half and 99% of the non-empty buckets
+    int seen = 0;
+    for (int length = 1; length <= stats.max_length; ++length)
+    {
+      if (stats.min_length == 0 && stats.histogram[length] > 0)
+      {
+        stats.min_length = length;
+      }
+      seen = seen + stats.histogram[length];
+      if (stats.p50_length == 0 && seen >= 0.50 * used)
+      {
+        stats.p50_length = length;
+      }
+      if (stats.p99_length == 0 && seen >= 0.99 * used)
+      {
+        stats.p99_length = length;
       }
     }
-    avg = static_cast<double>(size()) / numArrays;
   }
+  return stats;
+}
+
+// Reports bucket occupancy and collision rate for the current keys
+template <typename K, typename V, typename A, typename H, bool C>
+HashReport HashMap<K, V, A, H, C>::hash_report() const
+{
+  HashReport report;
+
+  report.buckets = capacity + old_capacity - migrate_index;
+  report.keys = size();
+  for_each_bucket([&](Node *)
+  {
+    report.used_buckets++;
+  });
+
+  if (report.buckets > 0)
+  {
+    report.load_factor = static_cast<double>(report.keys) / report.buckets;
+    report.occupancy = static_cast<double>(report.used_buckets) / report.buckets;
+  }
+  if (report.keys > 0)
+  {
+    // an ideal hash leaves (1 - 1/b)^n of the buckets empty
+    double b = report.buckets;
+    double expected_used = b * (1.0 - std::pow(1.0 - 1.0 / b, report.keys));
+    report.collision_rate = (report.keys - report.used_buckets) / static_cast<double>(report.keys);
+    report.expected_collision_rate = (report.keys - expected_used) / report.keys;
+  }
+  return report;
+}
 
-  return avg;
+// the full hash code of a key (or of a lookup value)
+template <typename K, typename V, typename A, typename H, bool C>
+template <typename Q>
+std::uint64_t HashMap<K, V, A, H, C>::hash_code(const Q &key) const
+{
+  return hasher(key, hash_seed);
 }
 
-// the hash function
-template <typename K, typename V>
-int HashMap<K, V>::hash(const K &key) const
+// the hash code of a stored node (cached or recomputed)
+template <typename K, typename V, typename A, typename H, bool C>
+std::uint64_t HashMap<K, V, A, H, C>::node_code(const Node *node) const
 {
-  std::hash<K> hash_code;
-  int code = hash_code(key);
-  int index = code % capacity;
+  if constexpr (C)
+  {
+    return node->code;
+  }
+  else
+  {
+    return hash_code(node->key);
+  }
+}
+
+// the bucket index of a hash code for a table of the given size. The
+// capacity is a power of two, so the low bits of the code are masked
+// off instead of dividing.
+template <typename K, typename V, typename A, typename H, bool C>
+int HashMap<K, V, A, H, C>::hash(std::uint64_t code, int cap) const
+{
+  int index = static_cast<int>(code & static_cast<std::uint64_t>(cap - 1));
 
   return index;
 }
 
-// resize and rehash the table
-template <typename K, typename V>
-void HashMap<K, V>::resize_and_rehash()
+// head of the chain that holds (or would hold) the key: keys whose old
+// bucket has not been migrated yet still live in the old table
+template <typename K, typename V, typename A, typename H, bool C>
+typename HashMap<K, V, A, H, C>::Node *&HashMap<K, V, A, H, C>::bucket(std::uint64_t code)
+{
+  if (old_table != nullptr)
+  {
+    int old_index = hash(code, old_capacity);
+    if (old_index >= migrate_index)
+    {
+      return old_table[old_index];
+    }
+  }
+  return table[hash(code, capacity)];
+}
+
+template <typename K, typename V, typename A, typename H, bool C>
+typename HashMap<K, V, A, H, C>::Node *HashMap<K, V, A, H, C>::bucket(std::uint64_t code) const
 {
-  // old table
-  Node **old_table = table;
-  int old_cap = capacity;
+  if (old_table != nullptr)
+  {
+    int old_index = hash(code, old_capacity);
+    if (old_index >= migrate_index)
+    {
+      return old_table[old_index];
+    }
+  }
+  return table[hash(code, capacity)];
+}
 
-  // resized table
-  capacity = capacity * 2;
-  table = new Node *[capacity];
-  count = 0;
-  init_table();
+// number of keys in the chain bucket(code) returns
+template <typename K, typename V, typename A, typename H, bool C>
+int &HashMap<K, V, A, H, C>::bucket_length(std::uint64_t code)
+{
+  if (old_table != nullptr)
+  {
+    int old_index = hash(code, old_capacity);
+    if (old_index >= migrate_index)
+    {
+      return old_lengths[old_index];
+    }
+  }
+  return lengths[hash(code, capacity)];
+}
 
-  Node *traverse = nullptr;
+// move a chain up by one key in the chain-length histogram
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::grow_chain(int &length)
+{
+  chain_counts[length]--;
+  if (length > 0 && length == shortest_chain && chain_counts[length] == 0)
+  {
+    shortest_chain = length + 1;
+  }
+  length++;
+  if (length == chain_counts.size())
+  {
+    chain_counts.insert(0, length);
+  }
+  chain_counts[length]++;
+  if (length > longest_chain)
+  {
+    longest_chain = length;
+  }
+  if (shortest_chain == 0 || length < shortest_chain)
+  {
+    shortest_chain = length;
+  }
+}
+
+// move a chain down by one key in the chain-length histogram
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::shrink_chain(int &length)
+{
+  chain_counts[length]--;
+  length--;
+  chain_counts[length]++;
+  if (length > 0 && length < shortest_chain)
+  {
+    shortest_chain = length;
+  }
+  trim_chain_bounds();
+}
+
+// remove a drained old bucket from the chain-length histogram
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::drop_chain(int &length)
+{
+  chain_counts[length]--;
+  length = 0;
+  trim_chain_bounds();
+}
+
+// move longest_chain down and shortest_chain up past lengths no bucket
+// has any more. longest_chain's steps are paid for by the grows that
+// raised it (O(1) amortized), but shortest_chain can walk all the way
+// up to longest_chain each time the only shortest chains empty, so a
+// call costs O(longest chain). That stays small under the max load.
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::trim_chain_bounds()
+{
+  while (longest_chain > 0 && chain_counts[longest_chain] == 0)
+  {
+    longest_chain--;
+  }
+  while (shortest_chain > 0 && shortest_chain <= longest_chain && chain_counts[shortest_chain] == 0)
+  {
+    shortest_chain++;
+  }
+  if (shortest_chain > longest_chain)
+  {
+    shortest_chain = 0;
+  }
+}
+
+// chain_counts up to the longest chain while tracking, and otherwise
+// the same histogram counted by walking every chain
+template <typename K, typename V, typename A, typename H, bool C>
+ArraySeq<int> HashMap<K, V, A, H, C>::chain_histogram() const
+{
+  ArraySeq<int> histogram;
+
+  if (tracking)
+  {
+    for (int length = 0; length <= longest_chain; ++length)
+    {
+      histogram.insert(chain_counts[length], length);
+    }
+    return histogram;
+  }
+
+  // every bucket starts out empty
+  histogram.insert(capacity + old_capacity - migrate_index, 0);
+  for_each_bucket([&](Node *traverse)
+  {
+    int length = 0;
+    for (; traverse != nullptr; traverse = traverse->next)
+    {
+      length++;
+    }
+    while (length >= histogram.size())
+    {
+      histogram.insert(0, histogram.size());
+    }
+    histogram[0]--;
+    histogram[length]++;
+  });
+  return histogram;
+}
+
+// returns the node for the key or nullptr if it is not in the map.
+// Cached codes are compared first so most mismatches never touch the
+// key itself.
+template <typename K, typename V, typename A, typename H, bool C>
+template <typename Q>
+typename HashMap<K, V, A, H, C>::Node *HashMap<K, V, A, H, C>::find_node(const Q &key) const
+{
+  std::uint64_t code = hash_code(key);
+  Node *traverse = bucket(code);
+
+  while (traverse != nullptr)
+  {
+    if (traverse->same_code(code) && traverse->key == key)
+    {
+      return traverse;
+    }
+    traverse = traverse->next;
+  }
+  return nullptr;
+}
+
+// erase helper: unlinks the key's node, shrinking the table if it
+// falls below the min load factor
+template <typename K, typename V, typename A, typename H, bool C>
+template <typename Q>
+void HashMap<K, V, A, H, C>::erase_key(const Q &key)
+{
   Node *remove = nullptr;
 
-  // Go through each element
-  for (int i = 0; i < old_cap; ++i) // go through current list
+  if (old_table != nullptr)
   {
-    if (old_table[i] != nullptr)
+    rehash_some(rehash_step);
+  }
+
+  // walk the link that points at each node so head and later
+  // elements are unlinked the same way
+  std::uint64_t code = hash_code(key);
+  Node **link = &bucket(code);
+  while (*link != nullptr)
+  {
+    if ((*link)->same_code(code) && (*link)->key == key)
     {
-      traverse = old_table[i];
-      while (traverse != nullptr)
+      remove = *link;
+      *link = remove->next;
+      pool.destroy(remove);
+      if (tracking)
       {
-        insert(traverse->key, traverse->value); // hash will happen inside
-        remove = traverse;
-        traverse = traverse->next;
+        shrink_chain(bucket_length(code));
+      }
+      count--;
+      if (ordered)
+      {
+        key_index.erase(key);
+      }
 
-        // clear each node;
-        delete remove;
+      // shrink below the low-water mark, leaving room for the keys to
+      // double before the next grow (an incremental shrink waits for
+      // the current migration to finish)
+      if (count < capacity * min_load && capacity > MIN_CAPACITY && old_table == nullptr)
+      {
+        int new_capacity = capacity_for(count * 2);
+        if (new_capacity < capacity)
+        {
+          if (incremental)
+          {
+            start_rehash(new_capacity);
+          }
+          else
+          {
+            resize_and_rehash(new_capacity);
+          }
+        }
       }
-      old_table[i] = nullptr;
+      return;
     }
+    link = &(*link)->next;
   }
-  // clear old table
-  delete[] old_table;
+
+  throw std::out_of_range("Key is not in the collection");
+}
+
+// finds the node (or nullptr) for each key. Each of the BATCH_WINDOW
+// lookups in flight is a small state machine that does one step (load
+// the bucket, or compare one node) and prefetches what its next step
+// reads before moving on to the next lookup. A finished lookup starts
+// the next key at once, so the window always has misses in flight.
+template <typename K, typename V, typename A, typename H, bool C>
+template <typename F>
+void HashMap<K, V, A, H, C>::find_batch(const K *keys, int n, F visit) const
+{
+  // key index, hash code, and current node (or nullptr while the
+  // bucket is being loaded) of each lookup in flight
+  int index[BATCH_WINDOW];
+  std::uint64_t codes[BATCH_WINDOW];
+  Node *nodes[BATCH_WINDOW];
+  bool loaded[BATCH_WINDOW];
+  int next = 0;
+  int active = 0;
+
+  // hashes the next key into slot w and prefetches its bucket slot (in
+  // the new table; during an incremental rehash a few keys still live
+  // in the old one)
+  auto start = [&](int w)
+  {
+    index[w] = next;
+    codes[w] = hash_code(keys[next]);
+    nodes[w] = nullptr;
+    loaded[w] = false;
+    prefetch(&table[hash(codes[w], capacity)]);
+    next++;
+    active++;
+  };
+
+  int window = n < BATCH_WINDOW ? n : BATCH_WINDOW;
+  for (int w = 0; w < window; ++w)
+  {
+    start(w);
+  }
+
+  while (active > 0)
+  {
+    for (int w = 0; w < window; ++w)
+    {
+      if (index[w] < 0)
+      {
+        continue;
+      }
+
+      Node *node = nullptr;
+      bool finished = false;
+      if (!loaded[w])
+      {
+        // the bucket slot has arrived: fetch the first node
+        nodes[w] = bucket(codes[w]);
+        loaded[w] = true;
+        finished = nodes[w] == nullptr;
+      }
+      else if (nodes[w]->same_code(codes[w]) && nodes[w]->key == keys[index[w]])
+      {
+        node = nodes[w];
+        finished = true;
+      }
+      else
+      {
+        nodes[w] = nodes[w]->next;
+        finished = nodes[w] == nullptr;
+      }
+
+      if (!finished)
+      {
+        prefetch(nodes[w]);
+        continue;
+      }
+
+      visit(index[w], node);
+      active--;
+      if (next < n)
+      {
+        start(w);
+      }
+      else
+      {
+        index[w] = -1;
+      }
+    }
+  }
+}
+
+// hints that the memory at ptr will be read soon
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::prefetch(const void *ptr)
+{
+#if defined(__GNUC__)
+  __builtin_prefetch(ptr);
+#endif
+}
+
+// smallest table size (a power of two, at least MIN_CAPACITY) that
+// holds n keys under the max load factor
+template <typename K, typename V, typename A, typename H, bool C>
+int HashMap<K, V, A, H, C>::capacity_for(int n) const
+{
+  int cap = MIN_CAPACITY;
+
+  while (cap * max_load <= n)
+  {
+    cap = cap * 2;
+  }
+  return cap;
+}
+
+// resize and rehash the table to the given size (all at once, relinking
+// the existing nodes instead of reallocating them). Any migration in
+// progress is finished first.
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::resize_and_rehash(int new_capacity)
+{
+  if (old_table != nullptr)
+  {
+    rehash_some(old_capacity);
+  }
+  start_rehash(new_capacity);
+  rehash_some(old_capacity, true);
 }
 
-// initialize the table to all nullptr
-template <typename K, typename V>
-void HashMap<K, V>::init_table()
+// allocate a table of the given size and start draining the old one
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::start_rehash(int new_capacity)
+{
+  old_table = table;
+  old_lengths = lengths;
+  old_capacity = capacity;
+  migrate_index = 0;
+
+  // value-initialized (all nullptr) in one pass
+  capacity = new_capacity;
+  table = new Node *[capacity]();
+  if (tracking)
+  {
+    lengths = new int[capacity]();
+    chain_counts[0] = chain_counts[0] + capacity;
+  }
+}
+
+// move up to the given number of old buckets into the new table
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::rehash_some(int buckets, bool full)
+{
+  Node *traverse = nullptr;
+  Node *next = nullptr;
+  int index = -1;
+
+  // a large drain is split across the rehash threads
+  bool drains = old_table != nullptr && buckets >= old_capacity - migrate_index;
+  bool parallel = drains && rehash_workers > 1 && old_capacity - migrate_index >= PARALLEL_REHASH_MIN;
+
+  // while tracking, a full or parallel drain only counts the new
+  // chains and rebuilds the histogram afterwards in one pass (a walk
+  // of the whole table). Other steps, including the one that ends a
+  // migration, update the histogram chain by chain.
+  bool recount = tracking && drains && (full || parallel);
+  bool update = tracking && !recount;
+
+  if (parallel)
+  {
+    parallel_drain(recount);
+    migrate_index = old_capacity;
+  }
+
+  while (buckets > 0 && migrate_index < old_capacity)
+  {
+    traverse = old_table[migrate_index];
+    if (update)
+    {
+      drop_chain(old_lengths[migrate_index]);
+    }
+    while (traverse != nullptr)
+    {
+      next = traverse->next;
+      index = hash(node_code(traverse), capacity);
+      traverse->next = table[index];
+      table[index] = traverse;
+      if (recount)
+      {
+        lengths[index]++;
+      }
+      else if (update)
+      {
+        grow_chain(lengths[index]);
+      }
+      traverse = next;
+    }
+    old_table[migrate_index] = nullptr;
+    migrate_index++;
+    buckets--;
+  }
+
+  // clear old table once it is drained
+  if (old_table != nullptr && migrate_index == old_capacity)
+  {
+    delete[] old_table;
+    delete[] old_lengths;
+    old_table = nullptr;
+    old_lengths = nullptr;
+    old_capacity = 0;
+    migrate_index = 0;
+  }
+  if (recount)
+  {
+    count_chains();
+  }
+}
+
+// move every old bucket into the new table on rehash_workers threads.
+// With power-of-two sizes, old bucket i only feeds new buckets that
+// are equal to i modulo the smaller table size, so each thread takes a
+// range of those remainders and writes only its own new buckets.
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::parallel_drain(bool recount)
+{
+  int span = old_capacity < capacity ? old_capacity : capacity;
+  int workers = rehash_workers < span ? rehash_workers : span;
+
+  // moves the old buckets whose index modulo span is in [first, last)
+  auto drain = [this, span, recount](int first, int last)
+  {
+    for (int base = 0; base < old_capacity; base += span)
+    {
+      for (int i = base + first; i < base + last; ++i)
+      {
+        Node *traverse = old_table[i];
+        while (traverse != nullptr)
+        {
+          Node *next = traverse->next;
+          int index = hash(node_code(traverse), capacity);
+          traverse->next = table[index];
+          table[index] = traverse;
+          if (recount)
+          {
+            lengths[index]++;
+          }
+          traverse = next;
+        }
+        old_table[i] = nullptr;
+      }
+    }
+  };
+
+  // the calling thread takes the first range
+  std::vector<std::thread> threads;
+  for (int t = 1; t < workers; ++t)
+  {
+    int first = static_cast<int>(static_cast<long>(span) * t / workers);
+    int last = static_cast<int>(static_cast<long>(span) * (t + 1) / workers);
+    threads.push_back(std::thread(drain, first, last));
+  }
+  drain(0, span / workers);
+  for (std::thread &thread : threads)
+  {
+    thread.join();
+  }
+}
+
+// calls visit(head) for each non-empty chain in either table
+template <typename K, typename V, typename A, typename H, bool C>
+template <typename F>
+void HashMap<K, V, A, H, C>::for_each_bucket(F visit) const
+{
+  for (int i = migrate_index; i < old_capacity; ++i)
+  {
+    if (old_table[i] != nullptr)
+    {
+      visit(old_table[i]);
+    }
+  }
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (table[i] != nullptr)
+    {
+      visit(table[i]);
+    }
+  }
+}
+
+// rebuild the chain-length histogram from the chain lengths of both
+// tables (old buckets below migrate_index are already moved)
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::count_chains()
+{
+  chain_counts.clear();
+  chain_counts.insert(0, 0);
+  longest_chain = 0;
+  auto tally = [&](int length)
+  {
+    while (length >= chain_counts.size())
+    {
+      chain_counts.insert(0, chain_counts.size());
+    }
+    chain_counts[length]++;
+    if (length > longest_chain)
+    {
+      longest_chain = length;
+    }
+  };
+  for (int i = migrate_index; i < old_capacity; ++i)
+  {
+    tally(old_lengths[i]);
+  }
+  for (int i = 0; i < capacity; ++i)
+  {
+    tally(lengths[i]);
+  }
+  shortest_chain = 0;
+  for (int length = longest_chain; length > 0; --length)
+  {
+    if (chain_counts[length] > 0)
+    {
+      shortest_chain = length;
+    }
+  }
+}
+
+// initialize the table to all nullptr (and, while tracking, every
+// chain to empty). Any old table is about to be dropped, so only
+// table's buckets are counted.
+template <typename K, typename V, typename A, typename H, bool C>
+void HashMap<K, V, A, H, C>::init_table()
 {
   for (int i = 0; i < capacity; ++i)
   {
     table[i] = nullptr;
   }
+  if (tracking)
+  {
+    // a new map tracks from the start
+    if (lengths == nullptr)
+    {
+      lengths = new int[capacity];
+    }
+    for (int i = 0; i < capacity; ++i)
+    {
+      lengths[i] = 0;
+    }
+    chain_counts.clear();
+    chain_counts.insert(capacity, 0);
+    longest_chain = 0;
+    shortest_chain = 0;
+  }
 }
 
 #endif
@@ -0,0 +1,214 @@
+//---------------------------------------------------------------------------
+// NAME: Joey Macauley
+// FILE: hashpolicy.h
+// DATE: CPSC 223 - Spring 2022
+// DESC: Hash policies for HashMap. A policy turns a key and a
+//       per-table seed into a 64-bit hash code:
+//
+//          std::uint64_t operator()(const K &key, std::uint64_t seed) const
+//
+//       HashMap picks a bucket from the low bits of the code, so every
+//       policy except StdHash runs std::hash through a mixer that
+//       spreads all of the input bits into the low bits.
+//
+//       The policies here are transparent: operator() also takes
+//       values that stand in for a key (a std::string_view or C string
+//       for a std::string key) and hashes them to the key's code, so
+//       HashMap can look them up without building a temporary key.
+//---------------------------------------------------------------------------
+
+#ifndef HASHPOLICY_H
+#define HASHPOLICY_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// 64 x 64 -> 128 bit multiply, folded back to 64 bits by xor-ing the
+// high and low halves (the "mum" step used by wyhash)
+inline std::uint64_t hash_mum(std::uint64_t a, std::uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+  unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+  return static_cast<std::uint64_t>(product) ^ static_cast<std::uint64_t>(product >> 64);
+#else
+  std::uint64_t a_lo = a & 0xffffffffULL, a_hi = a >> 32;
+  std::uint64_t b_lo = b & 0xffffffffULL, b_hi = b >> 32;
+  std::uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo;
+  std::uint64_t lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+  std::uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffffULL) + lo_hi;
+  std::uint64_t high = hi_hi + (hi_lo >> 32) + (cross >> 32);
+  std::uint64_t low = (cross << 32) | (lo_lo & 0xffffffffULL);
+  return low ^ high;
+#endif
+}
+
+// the 64-bit finalizer from MurmurHash3 (fmix64): every input bit
+// affects every output bit
+inline std::uint64_t hash_fmix64(std::uint64_t code)
+{
+  code = code ^ (code >> 33);
+  code = code * 0xff51afd7ed558ccdULL;
+  code = code ^ (code >> 33);
+  code = code * 0xc4ceb9fe1a85ec53ULL;
+  code = code ^ (code >> 33);
+  return code;
+}
+
+// the type a key's std::hash is taken through. Lookup values only need
+// to convert to it, not to K. std::string keys hash as string_view (the
+// standard requires both hashes to agree), so string_view and C string
+// lookups need no allocation. Specialize for other key types that have
+// a cheaper view type.
+template <typename K>
+struct hash_view
+{
+  typedef K type;
+};
+
+template <>
+struct hash_view<std::string>
+{
+  typedef std::string_view type;
+};
+
+// std::hash of a key, or of a lookup value that stands in for one
+template <typename K, typename Q>
+std::uint64_t std_hash_code(const Q &key)
+{
+  typedef typename hash_view<K>::type T;
+  const T &view = key;
+  std::hash<T> hash_code;
+  return hash_code(view);
+}
+
+// true if the hash policy H takes lookup values other than its key
+// type (it declares is_transparent)
+template <typename H, typename = void>
+struct is_transparent_hash : std::false_type
+{
+};
+
+template <typename H>
+struct is_transparent_hash<H, std::void_t<typename H::is_transparent>> : std::true_type
+{
+};
+
+// std::hash used as is (the seed is ignored). std::hash<int> is the
+// identity, so this is only a good choice for already-random keys.
+template <typename K>
+struct StdHash
+{
+  typedef void is_transparent;
+
+  template <typename Q>
+  std::uint64_t operator()(const Q &key, std::uint64_t) const
+  {
+    return std_hash_code<K>(key);
+  }
+};
+
+// wyhash-style: one 128-bit multiply of the seeded code against a
+// second odd constant
+template <typename K>
+struct WyHash
+{
+  typedef void is_transparent;
+
+  template <typename Q>
+  std::uint64_t operator()(const Q &key, std::uint64_t seed) const
+  {
+    std::uint64_t code = std_hash_code<K>(key);
+    return hash_mum(code ^ seed ^ 0xa0761d6478bd642fULL, code ^ 0xe7037ed1a0b428dbULL);
+  }
+};
+
+// xxh3-style: the XXH3 avalanche finalizer over the seeded code
+template <typename K>
+struct Xxh3Hash
+{
+  typedef void is_transparent;
+
+  template <typename Q>
+  std::uint64_t operator()(const Q &key, std::uint64_t seed) const
+  {
+    std::uint64_t code = std_hash_code<K>(key) ^ seed;
+    code = code ^ (code >> 37);
+    code = code * 0x165667919e3779f9ULL;
+    code = code ^ (code >> 32);
+    return code;
+  }
+};
+
+// Fibonacci hashing: multiply by 2^64 / golden ratio. The mixing ends
+// up in the high bits of the product, so the bytes are reversed to move
+// them onto the low bits that HashMap masks.
+template <typename K>
+struct FibonacciHash
+{
+  typedef void is_transparent;
+
+  template <typename Q>
+  std::uint64_t operator()(const Q &key, std::uint64_t seed) const
+  {
+    std::uint64_t code = (std_hash_code<K>(key) ^ seed) * 0x9e3779b97f4a7c15ULL;
+#if defined(__GNUC__)
+    return __builtin_bswap64(code);
+#else
+    std::uint64_t swapped = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+      swapped = (swapped << 8) | ((code >> (8 * i)) & 0xff);
+    }
+    return swapped;
+#endif
+  }
+};
+
+// true if HashMap should keep each key's full hash code in its node.
+// On for keys that are costly to hash and compare (strings and other
+// class types) and off for arithmetic, enum and pointer keys.
+// Specialize to change the default for a key type.
+template <typename K>
+struct cache_hash_code : std::integral_constant<bool, !std::is_scalar<K>::value>
+{
+};
+
+// a node's cached hash code. The empty version stores nothing and lets
+// every key through to the full key compare.
+template <bool Cached>
+struct HashCodeSlot
+{
+  // nothing to store
+  void set_code(std::uint64_t)
+  {
+  }
+
+  // without a stored code any key may match
+  bool same_code(std::uint64_t) const
+  {
+    return true;
+  }
+};
+
+template <>
+struct HashCodeSlot<true>
+{
+  std::uint64_t code = 0;
+
+  // remembers the key's hash code
+  void set_code(std::uint64_t c)
+  {
+    code = c;
+  }
+
+  // false if the key cannot match (its code differs)
+  bool same_code(std::uint64_t c) const
+  {
+    return code == c;
+  }
+};
+
+#endif
@@ -10,6 +10,55 @@
 //          ./hw9_perf > output.dat
 //       This file can then be used by the plotting script to generate
 //       the corresponding performance graphs.
+//
+//       Additional hash table comparisons can be run with:
+//          ./hw9_perf hash
+//       node allocator comparisons with:
+//          ./hw9_perf alloc
+//       hash policy comparisons with:
+//          ./hw9_perf policy
+//       cached hash code comparisons (string keys) with:
+//          ./hw9_perf cache
+//       multi-threaded hash map throughput with:
+//          ./hw9_perf concurrent
+//       read-mostly reader scaling with:
+//          ./hw9_perf epoch
+//       batched hash map lookups with:
+//          ./hw9_perf batch
+//       hash map range queries with and without the ordered index:
+//          ./hw9_perf ordered
+//       a hash map load factor sweep with:
+//          ./hw9_perf load
+//       hash map chain-length statistics with:
+//          ./hw9_perf stats
+//       cuckoo and chained hashing at high load factors with:
+//          ./hw9_perf cuckoo
+//       frozen (perfect hash) map build times and memory with:
+//          ./hw9_perf frozen [max keys]
+//       Bloom filtered lookups (mostly misses) with:
+//          ./hw9_perf bloom
+//       bulk loads (assign) against one insert per key with:
+//          ./hw9_perf bulk
+//       full hash map rehashes split across threads with:
+//          ./hw9_perf rehash [max keys]
+//       string-key lookups by std::string and by string_view with:
+//          ./hw9_perf strings
+//       avl map range counts and order statistics with:
+//          ./hw9_perf order
+//       in-order walks with next_key against iterators with:
+//          ./hw9_perf iterate
+//       avl map inserts and erases on large trees with:
+//          ./hw9_perf avl [max keys]
+//       merging and diffing avl maps (union_with, difference_with)
+//       against one insert per key with:
+//          ./hw9_perf setops [big map keys]
+//       persistent avl map snapshots against copies with:
+//          ./hw9_perf persistent [max keys]
+//       compact (32-bit index) avl map memory and lookups with:
+//          ./hw9_perf compact [max keys]
+//       and frozen (Eytzinger layout) avl map lookups against the
+//       live tree with:
+//          ./hw9_perf freeze [max keys]
 //---------------------------------------------------------------------------
 
 #include <iostream>
@@ -19,6 +68,13 @@
 #include <functional>
 #include <vector>
 #include <cassert>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <string_view>
+#include <random>
+#include <algorithm>
 #include "util.h"
 #include "arrayseq.h"
 #include "map.h"
@@ -27,6 +83,16 @@
 #include "hashmap.h"
 #include "bstmap.h"
 #include "avlmap.h"
+#include "flathashmap.h"
+#include "robinhoodmap.h"
+#include "cuckoomap.h"
+#include "frozenhashmap.h"
+#include "bloommap.h"
+#include "concurrenthashmap.h"
+#include "epochhashmap.h"
+#include "persistentavlmap.h"
+#include "compactavlmap.h"
+#include "frozentreemap.h"
 
 using namespace std;
 using namespace std::chrono;
@@ -39,6 +105,33 @@ double timed_contains(const Map<int,int>& m, int key);
 double timed_find_range(const Map<int,int>& m, int key1, int key2);
 double timed_next_key(const Map<int,int>& m, int key); 
 double timed_sorted_keys(const Map<int,int>& m);
+double timed_contains_all(const Map<int,int>& m, const ArraySeq<int>& keys, int n);
+double worst_insert(Map<int,int>& m, const ArraySeq<int>& keys, const ArraySeq<int>& vals, int n);
+
+// alternate benchmark modes
+void hash_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals);
+void alloc_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals);
+void policy_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals);
+void cache_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals);
+void concurrent_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals);
+void epoch_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals);
+void batch_perf();
+void ordered_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals);
+void load_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals);
+void stats_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals);
+void cuckoo_perf();
+void frozen_perf(int max_keys);
+void bloom_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals);
+void bulk_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals);
+void rehash_perf(int max_keys);
+void strings_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals);
+void order_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals);
+void iterate_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals);
+void avl_perf(int max_keys);
+void setops_perf(int max_keys);
+void persistent_perf(int max_keys);
+void compact_perf(int max_keys);
+void freeze_perf(int max_keys);
 
 // test parameters
 const int start = 0;
@@ -53,6 +146,109 @@ int main(int argc, char* argv[])
   cout << fixed << showpoint;
   cout << setprecision(2);
 
+  // generate shuffled data
+  ArraySeq<int> keys, vals;
+  for (int i = 2; i <= stop*2; i += 2) {
+    keys.insert(i, keys.size());
+    vals.insert(i, vals.size());
+  }
+  faro_shuffle(keys, 5);
+
+  // run an alternate benchmark if one was requested
+  string mode = (argc > 1) ? argv[1] : "";
+  if (mode == "hash") {
+    hash_perf(keys, vals);
+    return 0;
+  }
+  if (mode == "alloc") {
+    alloc_perf(keys, vals);
+    return 0;
+  }
+  if (mode == "policy") {
+    policy_perf(keys, vals);
+    return 0;
+  }
+  if (mode == "cache") {
+    cache_perf(keys, vals);
+    return 0;
+  }
+  if (mode == "concurrent") {
+    concurrent_perf(keys, vals);
+    return 0;
+  }
+  if (mode == "epoch") {
+    epoch_perf(keys, vals);
+    return 0;
+  }
+  if (mode == "batch") {
+    batch_perf();
+    return 0;
+  }
+  if (mode == "ordered") {
+    ordered_perf(keys, vals);
+    return 0;
+  }
+  if (mode == "load") {
+    load_perf(keys, vals);
+    return 0;
+  }
+  if (mode == "stats") {
+    stats_perf(keys, vals);
+    return 0;
+  }
+  if (mode == "cuckoo") {
+    cuckoo_perf();
+    return 0;
+  }
+  if (mode == "frozen") {
+    frozen_perf((argc > 2) ? stoi(argv[2]) : 10000000);
+    return 0;
+  }
+  if (mode == "bloom") {
+    bloom_perf(keys, vals);
+    return 0;
+  }
+  if (mode == "bulk") {
+    bulk_perf(keys, vals);
+    return 0;
+  }
+  if (mode == "rehash") {
+    rehash_perf((argc > 2) ? stoi(argv[2]) : 16000000);
+    return 0;
+  }
+  if (mode == "strings") {
+    strings_perf(keys, vals);
+    return 0;
+  }
+  if (mode == "order") {
+    order_perf(keys, vals);
+    return 0;
+  }
+  if (mode == "iterate") {
+    iterate_perf(keys, vals);
+    return 0;
+  }
+  if (mode == "avl") {
+    avl_perf((argc > 2) ? stoi(argv[2]) : 10000000);
+    return 0;
+  }
+  if (mode == "setops") {
+    setops_perf((argc > 2) ? stoi(argv[2]) : 10000000);
+    return 0;
+  }
+  if (mode == "persistent") {
+    persistent_perf((argc > 2) ? stoi(argv[2]) : 10000000);
+    return 0;
+  }
+  if (mode == "compact") {
+    compact_perf((argc > 2) ? stoi(argv[2]) : 10000000);
+    return 0;
+  }
+  if (mode == "freeze") {
+    freeze_perf((argc > 2) ? stoi(argv[2]) : 10000000);
+    return 0;
+  }
+
   // output data header
   cout << "# All times in milliseconds (msec)" << endl;
   cout << "# Column 1 = input data size" << endl;
@@ -90,14 +286,6 @@ int main(int argc, char* argv[])
   cout << "# Column 26 = bst map height" << endl;
   cout << "# Column 27 = avl map height" << endl;
   cout << "# Column 28 = log base 2 of input size" << endl;  
-  
-  // generate shuffled data
-  ArraySeq<int> keys, vals;
-  for (int i = 2; i <= stop*2; i += 2) {
-    keys.insert(i, keys.size());
-    vals.insert(i, vals.size());
-  }
-  faro_shuffle(keys, 5);
 
   // generate the timing data
   for (int n = start; n <= stop; n += step) {
@@ -275,6 +463,1501 @@ double timed_sorted_keys(const Map<int,int>& m)
   return (total/1000) / runs;
 }
 
+// times a contains call for each of the first n keys
+double timed_contains_all(const Map<int,int>& m, const ArraySeq<int>& keys, int n)
+{
+  double total = 0;
+  for (int r = 0; r < runs; ++r) {
+    auto t0 = high_resolution_clock::now();
+    for (int i = 0; i < n; ++i)
+      m.contains(keys[i]);
+    auto t1 = high_resolution_clock::now();
+    total += duration_cast<microseconds>(t1 - t0).count();
+  }
+  return (total/1000) / runs;
+}
+
+// loads n keys into an empty map and returns the slowest single insert
+double worst_insert(Map<int,int>& m, const ArraySeq<int>& keys, const ArraySeq<int>& vals, int n)
+{
+  double worst = 0;
+  for (int i = 0; i < n; ++i) {
+    auto t0 = high_resolution_clock::now();
+    m.insert(keys[i], vals[i]);
+    auto t1 = high_resolution_clock::now();
+    double t = duration_cast<nanoseconds>(t1 - t0).count();
+    if (t > worst)
+      worst = t;
+  }
+  return worst / 1000000;
+}
+
+
+//----------------------------------------------------------------------
+// Hash table comparison (./hw9_perf hash)
+//----------------------------------------------------------------------
+
+void hash_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals)
+{
+  cout << "# All times in milliseconds (msec)" << endl;
+  cout << "# Column 1 = input data size" << endl;
+  cout << "# Column 2 = hash map insert" << endl;
+  cout << "# Column 3 = flat hash map insert" << endl;
+  cout << "# Column 4 = robin hood map insert" << endl;
+  cout << "# Column 5 = hash map erase" << endl;
+  cout << "# Column 6 = flat hash map erase" << endl;
+  cout << "# Column 7 = robin hood map erase" << endl;
+  cout << "# Column 8 = hash map contains (miss)" << endl;
+  cout << "# Column 9 = flat hash map contains (miss)" << endl;
+  cout << "# Column 10 = robin hood map contains (miss)" << endl;
+  cout << "# Column 11 = hash map contains (all n keys)" << endl;
+  cout << "# Column 12 = flat hash map contains (all n keys)" << endl;
+  cout << "# Column 13 = robin hood map contains (all n keys)" << endl;
+  cout << "# Column 14 = hash map max chain length" << endl;
+  cout << "# Column 15 = hash map avg chain length" << endl;
+  cout << "# Column 16 = robin hood map max probe distance" << endl;
+  cout << "# Column 17 = robin hood map avg probe distance" << endl;
+  cout << "# Column 18 = hash map worst single insert while loading" << endl;
+  cout << "# Column 19 = incremental hash map worst single insert while loading" << endl;
+
+  for (int n = start; n <= stop; n += step) {
+    HashMap<int,int> m1;
+    FlatHashMap<int,int> m2;
+    RobinHoodMap<int,int> m3;
+    for (int i = 0; i < n; ++i) {
+      m1.insert(keys[i], vals[i]);
+      m2.insert(keys[i], vals[i]);
+      m3.insert(keys[i], vals[i]);
+    }
+
+    int med = n;
+    int max = n * 2;
+
+    cout << n << " ";
+    cout << timed_insert(m1, med + 1) << " " << flush;
+    cout << timed_insert(m2, med + 1) << " " << flush;
+    cout << timed_insert(m3, med + 1) << " " << flush;
+    cout << timed_erase(m1, med + 1) << " " << flush;
+    cout << timed_erase(m2, med + 1) << " " << flush;
+    cout << timed_erase(m3, med + 1) << " " << flush;
+    cout << timed_contains(m1, max + 1) << " " << flush;
+    cout << timed_contains(m2, max + 1) << " " << flush;
+    cout << timed_contains(m3, max + 1) << " " << flush;
+    cout << timed_contains_all(m1, keys, n) << " " << flush;
+    cout << timed_contains_all(m2, keys, n) << " " << flush;
+    cout << timed_contains_all(m3, keys, n) << " " << flush;
+    cout << m1.max_chain_length() << " " << m1.avg_chain_length() << " ";
+    cout << m3.max_probe_distance() << " " << m3.avg_probe_distance() << " ";
+
+    // latency spikes from resizing
+    HashMap<int,int> m4, m5;
+    m5.set_incremental_rehash(true);
+    cout << worst_insert(m4, keys, vals, n) << " " << flush;
+    cout << worst_insert(m5, keys, vals, n) << " " << flush;
+    cout << endl;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Node allocator comparison (./hw9_perf alloc)
+//----------------------------------------------------------------------
+
+// loads n keys into a new map, copies it, and clears the copy. Prints
+// the load, copy, and clear times.
+template<typename M>
+void timed_lifecycle(const ArraySeq<int>& keys, const ArraySeq<int>& vals, int n)
+{
+  double load = 0, copy = 0, clear = 0;
+  for (int r = 0; r < runs; ++r) {
+    M m;
+    auto t0 = high_resolution_clock::now();
+    for (int i = 0; i < n; ++i)
+      m.insert(keys[i], vals[i]);
+    auto t1 = high_resolution_clock::now();
+    M m2(m);
+    auto t2 = high_resolution_clock::now();
+    m2.clear();
+    auto t3 = high_resolution_clock::now();
+    load += duration_cast<microseconds>(t1 - t0).count();
+    copy += duration_cast<microseconds>(t2 - t1).count();
+    clear += duration_cast<microseconds>(t3 - t2).count();
+  }
+  cout << (load/1000) / runs << " " << (copy/1000) / runs << " "
+       << (clear/1000) / runs << " " << flush;
+}
+
+void alloc_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals)
+{
+  cout << "# All times in milliseconds (msec)" << endl;
+  cout << "# Column 1 = input data size" << endl;
+  cout << "# Columns 2-4 = hash map (heap) load, copy, clear" << endl;
+  cout << "# Columns 5-7 = hash map (pool) load, copy, clear" << endl;
+  cout << "# Columns 8-10 = bst map (heap) load, copy, clear" << endl;
+  cout << "# Columns 11-13 = bst map (pool) load, copy, clear" << endl;
+  cout << "# Columns 14-16 = avl map (heap) load, copy, clear" << endl;
+  cout << "# Columns 17-19 = avl map (pool) load, copy, clear" << endl;
+
+  for (int n = start; n <= stop; n += step) {
+    cout << n << " ";
+    timed_lifecycle<HashMap<int,int,HeapAllocator>>(keys, vals, n);
+    timed_lifecycle<HashMap<int,int,PoolAllocator>>(keys, vals, n);
+    timed_lifecycle<BSTMap<int,int,HeapAllocator>>(keys, vals, n);
+    timed_lifecycle<BSTMap<int,int,PoolAllocator>>(keys, vals, n);
+    timed_lifecycle<AVLMap<int,int,HeapAllocator>>(keys, vals, n);
+    timed_lifecycle<AVLMap<int,int,PoolAllocator>>(keys, vals, n);
+    cout << endl;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Hash policy comparison (./hw9_perf policy)
+//----------------------------------------------------------------------
+
+// loads n keys into a map with the hash policy H and prints the time to
+// look up all n keys, the collision rate, and the max chain length
+template<typename H>
+void policy_columns(const ArraySeq<int>& keys, const ArraySeq<int>& vals, int n)
+{
+  HashMap<int,int,HeapAllocator,H> m;
+  for (int i = 0; i < n; ++i)
+    m.insert(keys[i], vals[i]);
+  HashReport report = m.hash_report();
+  cout << timed_contains_all(m, keys, n) << " " << report.collision_rate << " "
+       << m.max_chain_length() << " " << flush;
+}
+
+void policy_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals)
+{
+  cout << "# All times in milliseconds (msec)" << endl;
+  cout << "# Column 1 = input data size" << endl;
+  cout << "# Columns 2-4 = std hash contains all, collision rate, max chain" << endl;
+  cout << "# Columns 5-7 = wyhash contains all, collision rate, max chain" << endl;
+  cout << "# Columns 8-10 = xxh3 contains all, collision rate, max chain" << endl;
+  cout << "# Columns 11-13 = fibonacci contains all, collision rate, max chain" << endl;
+
+  for (int n = start; n <= stop; n += step) {
+    cout << n << " ";
+    policy_columns<StdHash<int>>(keys, vals, n);
+    policy_columns<WyHash<int>>(keys, vals, n);
+    policy_columns<Xxh3Hash<int>>(keys, vals, n);
+    policy_columns<FibonacciHash<int>>(keys, vals, n);
+    cout << endl;
+  }
+}
+
 
+//----------------------------------------------------------------------
+// Cached hash code comparison (./hw9_perf cache)
+//----------------------------------------------------------------------
 
+// long string key with a shared prefix, so full key compares are costly
+string string_key(int key)
+{
+  return "customer/account/settings/" + to_string(key);
+}
+
+// loads n string keys into a map with (C = true) or without cached hash
+// codes and prints the load time (including every rehash), the time to
+// look up all n keys, and the time for n lookups that miss
+template<bool C>
+void cache_columns(const ArraySeq<string>& hits, const ArraySeq<string>& misses,
+                   const ArraySeq<int>& vals, int n)
+{
+  double load = 0, hit = 0, miss = 0;
+  for (int r = 0; r < runs; ++r) {
+    HashMap<string,int,HeapAllocator,WyHash<string>,C> m;
+    auto t0 = high_resolution_clock::now();
+    for (int i = 0; i < n; ++i)
+      m.insert(hits[i], vals[i]);
+    auto t1 = high_resolution_clock::now();
+    for (int i = 0; i < n; ++i)
+      m.contains(hits[i]);
+    auto t2 = high_resolution_clock::now();
+    for (int i = 0; i < n; ++i)
+      m.contains(misses[i]);
+    auto t3 = high_resolution_clock::now();
+    load += duration_cast<microseconds>(t1 - t0).count();
+    hit += duration_cast<microseconds>(t2 - t1).count();
+    miss += duration_cast<microseconds>(t3 - t2).count();
+  }
+  cout << (load/1000) / runs << " " << (hit/1000) / runs << " "
+       << (miss/1000) / runs << " " << flush;
+}
+
+void cache_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals)
+{
+  cout << "# All times in milliseconds (msec)" << endl;
+  cout << "# Column 1 = input data size" << endl;
+  cout << "# Columns 2-4 = cached codes load, contains (hit), contains (miss)" << endl;
+  cout << "# Columns 5-7 = no cached codes load, contains (hit), contains (miss)" << endl;
+
+  // keys are all even, so the odd neighbours always miss
+  ArraySeq<string> hits, misses;
+  for (int i = 0; i < keys.size(); ++i) {
+    hits.insert(string_key(keys[i]), hits.size());
+    misses.insert(string_key(keys[i] + 1), misses.size());
+  }
+
+  for (int n = start; n <= stop; n += step) {
+    cout << n << " ";
+    cache_columns<true>(hits, misses, vals, n);
+    cache_columns<false>(hits, misses, vals, n);
+    cout << endl;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Multi-threaded throughput (./hw9_perf concurrent)
+//----------------------------------------------------------------------
+
+// lookup results from the worker threads (kept so the compiler cannot
+// drop lookups whose result is otherwise unused)
+atomic<long> lookup_sink(0);
+
+// HashMap behind one global mutex (the baseline)
+struct LockedHashMap {
+  mutex lock;
+  HashMap<int,int> m;
+
+  bool insert_if_absent(int key, int value) {
+    lock_guard<mutex> guard(lock);
+    if (m.contains(key))
+      return false;
+    m.insert(key, value);
+    return true;
+  }
+
+  bool contains(int key) {
+    lock_guard<mutex> guard(lock);
+    return m.contains(key);
+  }
+
+  bool erase(int key) {
+    lock_guard<mutex> guard(lock);
+    if (!m.contains(key))
+      return false;
+    m.erase(key);
+    return true;
+  }
+
+  bool update(int key, int value) {
+    lock_guard<mutex> guard(lock);
+    if (!m.contains(key))
+      return false;
+    m[key] = value;
+    return true;
+  }
+};
+
+// splits the keys over the given number of threads. Each thread inserts
+// its share, looks each one up twice, and erases half of them. Returns
+// the wall clock time.
+template<typename M>
+double timed_threads(const ArraySeq<int>& keys, const ArraySeq<int>& vals, int threads)
+{
+  double total = 0;
+  int n = keys.size();
+  for (int r = 0; r < runs; ++r) {
+    M m;
+    vector<thread> workers;
+    auto t0 = high_resolution_clock::now();
+    for (int t = 0; t < threads; ++t) {
+      workers.push_back(thread([&, t]() {
+        int lo = (long long) n * t / threads;
+        int hi = (long long) n * (t + 1) / threads;
+        int found = 0;
+        for (int i = lo; i < hi; ++i)
+          m.insert_if_absent(keys[i], vals[i]);
+        for (int i = lo; i < hi; ++i) {
+          found += m.contains(keys[i]);
+          found += m.contains(keys[i] + 1);
+        }
+        for (int i = lo; i < hi; i += 2)
+          m.erase(keys[i]);
+        lookup_sink += found;
+      }));
+    }
+    for (thread& worker : workers)
+      worker.join();
+    auto t1 = high_resolution_clock::now();
+    total += duration_cast<microseconds>(t1 - t0).count();
+  }
+  return (total/1000) / runs;
+}
+
+void concurrent_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals)
+{
+  // operations per run: an insert, two lookups, and half an erase per key
+  double ops = keys.size() * 3.5;
+  int max_threads = thread::hardware_concurrency() * 2;
+  if (max_threads < 16)
+    max_threads = 16;
+
+  cout << "# All times in milliseconds (msec)" << endl;
+  cout << "# Column 1 = number of threads" << endl;
+  cout << "# Column 2 = mutex-wrapped hash map time" << endl;
+  cout << "# Column 3 = concurrent hash map time" << endl;
+  cout << "# Column 4 = mutex-wrapped hash map million ops per second" << endl;
+  cout << "# Column 5 = concurrent hash map million ops per second" << endl;
+
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    double locked = timed_threads<LockedHashMap>(keys, vals, threads);
+    double striped = timed_threads<ConcurrentHashMap<int,int>>(keys, vals, threads);
+    cout << threads << " " << locked << " " << striped << " "
+         << ops / (locked * 1000) << " " << ops / (striped * 1000) << endl;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Read-mostly reader scaling (./hw9_perf epoch)
+//----------------------------------------------------------------------
+
+// lookups per thread
+const int reads_per_thread = 200000;
+
+// loads every key and has each thread run a 95% contains / 5% update
+// mix over them. Returns the wall clock time.
+template<typename M>
+double timed_read_mostly(const ArraySeq<int>& keys, const ArraySeq<int>& vals, int threads)
+{
+  M m;
+  int n = keys.size();
+  for (int i = 0; i < n; ++i)
+    m.insert_if_absent(keys[i], vals[i]);
+
+  double total = 0;
+  for (int r = 0; r < runs; ++r) {
+    vector<thread> workers;
+    auto t0 = high_resolution_clock::now();
+    for (int t = 0; t < threads; ++t) {
+      workers.push_back(thread([&, t]() {
+        // pseudo-random order, so no map gains from nodes allocated
+        // next to each other in insertion order
+        unsigned long long state = t + 1;
+        int found = 0;
+        for (int i = 0; i < reads_per_thread; ++i) {
+          state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+          int index = (state >> 33) % n;
+          if (i % 20 == 0)
+            m.update(keys[index], i);
+          else
+            found += m.contains(keys[index]);
+        }
+        lookup_sink += found;
+      }));
+    }
+    for (thread& worker : workers)
+      worker.join();
+    auto t1 = high_resolution_clock::now();
+    total += duration_cast<microseconds>(t1 - t0).count();
+  }
+  return (total/1000) / runs;
+}
+
+// EpochHashMap with the insert_if_absent name the other maps use
+struct EpochMap {
+  EpochHashMap<int,int> m;
+
+  void insert_if_absent(int key, int value) {
+    m.insert(key, value);
+  }
+
+  bool contains(int key) {
+    return m.contains(key);
+  }
+
+  bool update(int key, int value) {
+    return m.update(key, value);
+  }
+};
+
+void epoch_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals)
+{
+  int max_threads = thread::hardware_concurrency() * 2;
+  if (max_threads < 32)
+    max_threads = 32;
+
+  cout << "# Million operations per second (95% contains, 5% update)" << endl;
+  cout << "# Column 1 = number of threads" << endl;
+  cout << "# Column 2 = mutex-wrapped hash map" << endl;
+  cout << "# Column 3 = lock-striped concurrent hash map" << endl;
+  cout << "# Column 4 = epoch (lock-free read) hash map" << endl;
+
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    double ops = (double) reads_per_thread * threads;
+    double locked = timed_read_mostly<LockedHashMap>(keys, vals, threads);
+    double striped = timed_read_mostly<ConcurrentHashMap<int,int>>(keys, vals, threads);
+    double epoch = timed_read_mostly<EpochMap>(keys, vals, threads);
+    cout << threads << " " << ops / (locked * 1000) << " " << ops / (striped * 1000)
+         << " " << ops / (epoch * 1000) << endl;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Batched lookups (./hw9_perf batch)
+//----------------------------------------------------------------------
+
+void batch_perf()
+{
+  cout << "# All times in milliseconds (msec)" << endl;
+  cout << "# Column 1 = number of keys (and of lookups, half of them hits)" << endl;
+  cout << "# Column 2 = hash map contains, one key at a time" << endl;
+  cout << "# Column 3 = hash map contains_many" << endl;
+  cout << "# Column 4 = hash map get_many" << endl;
+  cout << "# Column 5 = contains_many speedup" << endl;
+
+  // tables well past the cache sizes
+  for (int n = 1 << 16; n <= 1 << 22; n *= 2) {
+    HashMap<int,int> m;
+    for (int i = 0; i < n; ++i)
+      m.insert(i * 2, i);
+
+    // lookups in pseudo-random order over [0, 2n)
+    vector<int> probes(n);
+    unsigned long long state = 1;
+    for (int i = 0; i < n; ++i) {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      probes[i] = (state >> 33) % (2 * n);
+    }
+    bool* found = new bool[n];
+    int* values = new int[n];
+
+    double single = 0, many = 0, get = 0;
+    int hits = 0;
+    for (int r = 0; r < runs; ++r) {
+      auto t0 = high_resolution_clock::now();
+      for (int i = 0; i < n; ++i)
+        found[i] = m.contains(probes[i]);
+      auto t1 = high_resolution_clock::now();
+      m.contains_many(probes.data(), n, found);
+      auto t2 = high_resolution_clock::now();
+      hits += m.get_many(probes.data(), n, values, found);
+      auto t3 = high_resolution_clock::now();
+      single += duration_cast<microseconds>(t1 - t0).count();
+      many += duration_cast<microseconds>(t2 - t1).count();
+      get += duration_cast<microseconds>(t3 - t2).count();
+    }
+    lookup_sink += hits;
+    delete[] found;
+    delete[] values;
+
+    cout << n << " " << (single/1000) / runs << " " << (many/1000) / runs << " "
+         << (get/1000) / runs << " " << single / many << endl;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Ordered index comparison (./hw9_perf ordered)
+//----------------------------------------------------------------------
+
+// times loading n keys into the map, then prints the load, next key,
+// find range (about 100 keys), and sorted keys times
+void ordered_columns(HashMap<int,int>& m, const ArraySeq<int>& keys, const ArraySeq<int>& vals, int n)
+{
+  double load = 0;
+  for (int r = 0; r < runs; ++r) {
+    m.clear();
+    auto t0 = high_resolution_clock::now();
+    for (int i = 0; i < n; ++i)
+      m.insert(keys[i], vals[i]);
+    auto t1 = high_resolution_clock::now();
+    load += duration_cast<microseconds>(t1 - t0).count();
+  }
+  cout << (load/1000) / runs << " " << flush;
+  cout << timed_next_key(m, n) << " " << flush;
+  cout << timed_find_range(m, n, n + 200) << " " << flush;
+  cout << timed_sorted_keys(m) << " " << flush;
+}
+
+void ordered_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals)
+{
+  cout << "# All times in milliseconds (msec)" << endl;
+  cout << "# Column 1 = input data size" << endl;
+  cout << "# Columns 2-5 = hash map load, next key, find range, sorted keys" << endl;
+  cout << "# Columns 6-9 = same with the ordered index" << endl;
+
+  for (int n = start; n <= stop; n += step) {
+    HashMap<int,int> m1, m2;
+    m2.set_ordered_index(true);
+    cout << n << " ";
+    ordered_columns(m1, keys, vals, n);
+    ordered_columns(m2, keys, vals, n);
+    cout << endl;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Load factor sweep (./hw9_perf load)
+//----------------------------------------------------------------------
+
+// loads all keys into a new map with the given max load factor (after
+// reserving room for them if reserve is true) and returns the time
+double timed_load(double load, bool reserve, const ArraySeq<int>& keys, const ArraySeq<int>& vals)
+{
+  double total = 0;
+  for (int r = 0; r < runs; ++r) {
+    HashMap<int,int> m;
+    m.set_max_load_factor(load);
+    auto t0 = high_resolution_clock::now();
+    if (reserve)
+      m.reserve(keys.size());
+    for (int i = 0; i < keys.size(); ++i)
+      m.insert(keys[i], vals[i]);
+    auto t1 = high_resolution_clock::now();
+    total += duration_cast<microseconds>(t1 - t0).count();
+  }
+  return (total/1000) / runs;
+}
+
+void load_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals)
+{
+  int n = keys.size();
+  cout << "# " << n << " keys, all times in milliseconds (msec)" << endl;
+  cout << "# Column 1 = max load factor" << endl;
+  cout << "# Column 2 = load time" << endl;
+  cout << "# Column 3 = load time after reserve(n)" << endl;
+  cout << "# Column 4 = contains (all n keys)" << endl;
+  cout << "# Column 5 = contains (n misses)" << endl;
+  cout << "# Column 6 = buckets" << endl;
+  cout << "# Column 7 = avg chain length" << endl;
+  cout << "# Column 8 = max chain length" << endl;
+  cout << "# Column 9 = table and node memory (MB)" << endl;
 
+  double loads[] = {0.25, 0.5, 0.75, 1.0, 1.5, 2.0, 3.0, 4.0};
+  for (double load : loads) {
+    HashMap<int,int> m;
+    m.set_max_load_factor(load);
+    for (int i = 0; i < n; ++i)
+      m.insert(keys[i], vals[i]);
+
+    double misses = 0;
+    for (int r = 0; r < runs; ++r) {
+      auto t0 = high_resolution_clock::now();
+      for (int i = 0; i < n; ++i)
+        m.contains(keys[i] + 1);
+      auto t1 = high_resolution_clock::now();
+      misses += duration_cast<microseconds>(t1 - t0).count();
+    }
+
+    // a pointer and a chain length per bucket plus key, value, and
+    // next per node
+    double memory = m.bucket_count() * (sizeof(void*) + sizeof(int)) +
+                    n * (2 * sizeof(int) + sizeof(void*));
+    cout << load << " " << timed_load(load, false, keys, vals) << " "
+         << timed_load(load, true, keys, vals) << " "
+         << timed_contains_all(m, keys, n) << " " << (misses/1000) / runs << " "
+         << m.bucket_count() << " " << m.avg_chain_length() << " "
+         << m.max_chain_length() << " " << memory / (1024 * 1024) << endl;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Chain-length statistics (./hw9_perf stats)
+//----------------------------------------------------------------------
+
+// average time in microseconds of one chain_stats() call
+template<typename M>
+double timed_chain_stats(const M& m)
+{
+  const int calls = 100;
+  long sink = 0;
+  auto t0 = high_resolution_clock::now();
+  for (int i = 0; i < calls; ++i)
+    sink += m.chain_stats().max_length;
+  auto t1 = high_resolution_clock::now();
+  lookup_sink += sink;
+  return duration_cast<nanoseconds>(t1 - t0).count() / 1000.0 / calls;
+}
+
+// time to insert the first n keys into a new map with chain tracking
+// turned on or off
+double timed_tracked_insert(bool tracked, const ArraySeq<int>& keys, const ArraySeq<int>& vals, int n)
+{
+  double total = 0;
+  for (int r = 0; r < runs; ++r) {
+    HashMap<int,int> m;
+    m.set_chain_tracking(tracked);
+    auto t0 = high_resolution_clock::now();
+    for (int i = 0; i < n; ++i)
+      m.insert(keys[i], vals[i]);
+    auto t1 = high_resolution_clock::now();
+    total += duration_cast<microseconds>(t1 - t0).count();
+  }
+  return (total/1000) / runs;
+}
+
+// prints the chain-length summary of m
+template<typename M>
+void stats_columns(const M& m)
+{
+  ChainStats stats = m.chain_stats();
+  cout << stats.empty_ratio << " " << stats.mean_used_length << " "
+       << stats.p50_length << " " << stats.p99_length << " "
+       << stats.max_length << " ";
+}
+
+void stats_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals)
+{
+  cout << "# Insert times in milliseconds (msec), chain_stats() times in" << endl;
+  cout << "# microseconds, then the chain lengths for the WyHash and identity" << endl;
+  cout << "# (StdHash) policies on the benchmark's even keys" << endl;
+  cout << "# Column 1 = input data size" << endl;
+  cout << "# Column 2 = insert" << endl;
+  cout << "# Column 3 = insert with chain tracking" << endl;
+  cout << "# Column 4 = chain_stats() (walks the table)" << endl;
+  cout << "# Column 5 = chain_stats() with chain tracking" << endl;
+  cout << "# Column 6 = wyhash empty bucket ratio" << endl;
+  cout << "# Column 7 = wyhash avg non-empty chain" << endl;
+  cout << "# Column 8 = wyhash p50 chain" << endl;
+  cout << "# Column 9 = wyhash p99 chain" << endl;
+  cout << "# Column 10 = wyhash max chain" << endl;
+  cout << "# Column 11 = std empty bucket ratio" << endl;
+  cout << "# Column 12 = std avg non-empty chain" << endl;
+  cout << "# Column 13 = std p50 chain" << endl;
+  cout << "# Column 14 = std p99 chain" << endl;
+  cout << "# Column 15 = std max chain" << endl;
+
+  for (int n = step; n <= stop; n += step) {
+    HashMap<int,int> m1;
+    HashMap<int,int,HeapAllocator,StdHash<int>> m2;
+    for (int i = 0; i < n; ++i) {
+      m1.insert(keys[i], vals[i]);
+      m2.insert(keys[i], vals[i]);
+    }
+    cout << n << " " << timed_tracked_insert(false, keys, vals, n) << " "
+         << timed_tracked_insert(true, keys, vals, n) << " "
+         << timed_chain_stats(m1) << " ";
+    m1.set_chain_tracking(true);
+    cout << timed_chain_stats(m1) << " ";
+    stats_columns(m1);
+    stats_columns(m2);
+    cout << endl;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Cuckoo hashing at high load (./hw9_perf cuckoo)
+//----------------------------------------------------------------------
+
+// time to look up n keys (key[i] + offset) in m
+template<typename M>
+double timed_lookups(const M& m, const ArraySeq<int>& keys, int n, int offset)
+{
+  double total = 0;
+  long found = 0;
+  for (int r = 0; r < runs; ++r) {
+    auto t0 = high_resolution_clock::now();
+    for (int i = 0; i < n; ++i)
+      found += m.contains(keys[i] + offset);
+    auto t1 = high_resolution_clock::now();
+    total += duration_cast<microseconds>(t1 - t0).count();
+  }
+  lookup_sink += found;
+  return (total/1000) / runs;
+}
+
+// loads n keys into m (already sized for them) and returns the time
+template<typename M>
+double timed_fill(M& m, const ArraySeq<int>& keys, int n)
+{
+  auto t0 = high_resolution_clock::now();
+  for (int i = 0; i < n; ++i)
+    m.insert(keys[i], i);
+  auto t1 = high_resolution_clock::now();
+  return duration_cast<microseconds>(t1 - t0).count() / 1000.0;
+}
+
+void cuckoo_perf()
+{
+  // 32768 buckets of 4 slots (131072 keys at 100% load)
+  const int slots = 32768 * CuckooMap<int,int>::SLOTS;
+  ArraySeq<int> keys;
+  for (int i = 0; i < slots; ++i)
+    keys.insert(i * 2, keys.size());
+  faro_shuffle(keys, 5);
+
+  cout << "# " << slots << " slots, all times in milliseconds (msec)" << endl;
+  cout << "# Column 1 = load factor (keys per cuckoo slot and per hash map bucket)" << endl;
+  cout << "# Column 2 = cuckoo map insert (all keys)" << endl;
+  cout << "# Column 3 = hash map insert (all keys)" << endl;
+  cout << "# Column 4 = cuckoo map contains (all keys)" << endl;
+  cout << "# Column 5 = hash map contains (all keys)" << endl;
+  cout << "# Column 6 = cuckoo map contains (misses)" << endl;
+  cout << "# Column 7 = hash map contains (misses)" << endl;
+  cout << "# Column 8 = cuckoo map stash size" << endl;
+  cout << "# Column 9 = cuckoo map memory (MB)" << endl;
+  cout << "# Column 10 = hash map table and node memory (MB)" << endl;
+
+  double loads[] = {0.5, 0.8, 0.9, 0.93, 0.95};
+  for (double load : loads) {
+    int n = static_cast<int>(load * slots);
+    CuckooMap<int,int> m1;
+    HashMap<int,int> m2;
+    m1.set_max_load_factor(0.98);
+    m2.set_max_load_factor(load);
+    m1.reserve(n);
+    m2.reserve(n);
+
+    cout << load << " " << timed_fill(m1, keys, n) << " " << timed_fill(m2, keys, n) << " "
+         << timed_lookups(m1, keys, n, 0) << " " << timed_lookups(m2, keys, n, 0) << " "
+         << timed_lookups(m1, keys, n, 1) << " " << timed_lookups(m2, keys, n, 1) << " ";
+
+    // a pointer per bucket plus key, value, and next per node
+    double chained = m2.bucket_count() * sizeof(void*) + n * (2 * sizeof(int) + sizeof(void*));
+    cout << m1.stash_size() << " " << m1.table_bytes() / (1024.0 * 1024) << " "
+         << chained / (1024 * 1024) << endl;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Frozen hash map build and memory (./hw9_perf frozen [max keys])
+//----------------------------------------------------------------------
+
+void frozen_perf(int max_keys)
+{
+  cout << "# All times in milliseconds (msec), memory in bytes per key" << endl;
+  cout << "# Column 1 = number of keys" << endl;
+  cout << "# Column 2 = hash map build (insert all keys)" << endl;
+  cout << "# Column 3 = frozen map build (from key and value arrays)" << endl;
+  cout << "# Column 4 = frozen map build (from the hash map)" << endl;
+  cout << "# Column 5 = hash map contains (all keys)" << endl;
+  cout << "# Column 6 = frozen map contains (all keys)" << endl;
+  cout << "# Column 7 = frozen map contains (misses)" << endl;
+  cout << "# Column 8 = hash map memory per key (table and nodes)" << endl;
+  cout << "# Column 9 = frozen map memory per key (entries and pilots)" << endl;
+
+  // 100M keys needs about 4GB for the hash map alone, so the largest
+  // size is given on the command line
+  int sizes[] = {1000000, 3000000, 10000000, 30000000, 100000000};
+  for (int n : sizes) {
+    if (n > max_keys)
+      break;
+    vector<int> keys(n), vals(n);
+    for (int i = 0; i < n; ++i) {
+      keys[i] = static_cast<int>((i * 2654435761u) & 0x7ffffffe);
+      vals[i] = i;
+    }
+
+    HashMap<int,int> m;
+    auto t0 = high_resolution_clock::now();
+    for (int i = 0; i < n; ++i)
+      m.insert(keys[i], vals[i]);
+    auto t1 = high_resolution_clock::now();
+    FrozenHashMap<int,int> f1(keys.data(), vals.data(), n);
+    auto t2 = high_resolution_clock::now();
+    FrozenHashMap<int,int> f2(m);
+    auto t3 = high_resolution_clock::now();
+    cout << n << " " << duration_cast<microseconds>(t1 - t0).count() / 1000.0 << " "
+         << duration_cast<microseconds>(t2 - t1).count() / 1000.0 << " "
+         << duration_cast<microseconds>(t3 - t2).count() / 1000.0 << " ";
+
+    // look the keys up out of insertion order so the hash map nodes
+    // are not read in allocation order
+    vector<int> probes(n);
+    for (int i = 0; i < n; ++i)
+      probes[i] = keys[(i * 40503L) % n];
+    long found = 0;
+    t0 = high_resolution_clock::now();
+    for (int i = 0; i < n; ++i)
+      found += m.contains(probes[i]);
+    t1 = high_resolution_clock::now();
+    for (int i = 0; i < n; ++i)
+      found += f1.contains(probes[i]);
+    t2 = high_resolution_clock::now();
+    for (int i = 0; i < n; ++i)
+      found += f1.contains(probes[i] + 1);
+    t3 = high_resolution_clock::now();
+    lookup_sink += found;
+    cout << duration_cast<microseconds>(t1 - t0).count() / 1000.0 << " "
+         << duration_cast<microseconds>(t2 - t1).count() / 1000.0 << " "
+         << duration_cast<microseconds>(t3 - t2).count() / 1000.0 << " ";
+
+    // a pointer per bucket plus key, value, and next per node
+    double chained = m.bucket_count() * sizeof(void*) + n * (2 * sizeof(int) + sizeof(void*));
+    cout << chained / n << " " << static_cast<double>(f1.table_bytes()) / n << endl;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Bloom filtered lookups (./hw9_perf bloom)
+//----------------------------------------------------------------------
+
+// prints the miss times for the map with and without the filter, and
+// returns the filtered map's false positive rate
+template<typename M>
+double bloom_columns(const ArraySeq<int>& keys, const ArraySeq<int>& vals, int n)
+{
+  M m1;
+  BloomFilteredMap<int,int,M> m2;
+  for (int i = 0; i < n; ++i) {
+    m1.insert(keys[i], vals[i]);
+    m2.insert(keys[i], vals[i]);
+  }
+  cout << timed_lookups(m1, keys, n, 1) << " " << timed_lookups(m2, keys, n, 1) << " ";
+  return m2.false_positive_rate();
+}
+
+void bloom_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals)
+{
+  cout << "# All times in milliseconds (msec)" << endl;
+  cout << "# Column 1 = input data size" << endl;
+  cout << "# Column 2 = hash map contains (n misses)" << endl;
+  cout << "# Column 3 = filtered hash map contains (n misses)" << endl;
+  cout << "# Column 4 = avl map contains (n misses)" << endl;
+  cout << "# Column 5 = filtered avl map contains (n misses)" << endl;
+  cout << "# Column 6 = binsearch map contains (n misses)" << endl;
+  cout << "# Column 7 = filtered binsearch map contains (n misses)" << endl;
+  cout << "# Column 8 = hash map contains (all n keys)" << endl;
+  cout << "# Column 9 = filtered hash map contains (all n keys)" << endl;
+  cout << "# Column 10 = filter false positive rate (%)" << endl;
+  cout << "# Column 11 = filter bits per key" << endl;
+
+  for (int n = step; n <= stop; n += step) {
+    cout << n << " ";
+    double fpr = bloom_columns<HashMap<int,int>>(keys, vals, n);
+    bloom_columns<AVLMap<int,int>>(keys, vals, n);
+    bloom_columns<BinSearchMap<int,int>>(keys, vals, n);
+
+    HashMap<int,int> m1;
+    BloomFilteredMap<int,int,HashMap<int,int>> m2;
+    for (int i = 0; i < n; ++i) {
+      m1.insert(keys[i], vals[i]);
+      m2.insert(keys[i], vals[i]);
+    }
+    cout << timed_lookups(m1, keys, n, 0) << " " << timed_lookups(m2, keys, n, 0) << " "
+         << fpr * 100 << " " << m2.bits_per_key() << endl;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Bulk loads (./hw9_perf bulk)
+//----------------------------------------------------------------------
+
+// time to fill a new M with the pairs one insert at a time (bulk is
+// false) or with one assign (bulk is true)
+template<typename M>
+double timed_bulk(bool bulk, const ArraySeq<int>& keys, const ArraySeq<int>& vals)
+{
+  double total = 0;
+  for (int r = 0; r < runs; ++r) {
+    M m;
+    auto t0 = high_resolution_clock::now();
+    if (bulk)
+      m.assign(keys, vals);
+    else {
+      for (int i = 0; i < keys.size(); ++i)
+        m.insert(keys[i], vals[i]);
+    }
+    auto t1 = high_resolution_clock::now();
+    total += duration_cast<microseconds>(t1 - t0).count();
+  }
+  return (total/1000) / runs;
+}
+
+void bulk_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals)
+{
+  cout << "# All times in milliseconds (msec)" << endl;
+  cout << "# Column 1 = input data size" << endl;
+  cout << "# Column 2 = hash map insert (n keys)" << endl;
+  cout << "# Column 3 = hash map assign" << endl;
+  cout << "# Column 4 = binsearch map insert (n keys)" << endl;
+  cout << "# Column 5 = binsearch map assign" << endl;
+  cout << "# Column 6 = bst map insert (n keys)" << endl;
+  cout << "# Column 7 = bst map assign" << endl;
+  cout << "# Column 8 = avl map insert (n keys)" << endl;
+  cout << "# Column 9 = avl map assign" << endl;
+  cout << "# Column 10 = avl map assign (keys already sorted)" << endl;
+
+  for (int n = step; n <= stop; n += step) {
+    ArraySeq<int> k, v, sorted;
+    for (int i = 0; i < n; ++i) {
+      k.insert(keys[i], i);
+      v.insert(vals[i], i);
+      sorted.insert(2 * i, i);
+    }
+    cout << n << " " << timed_bulk<HashMap<int,int>>(false, k, v) << " "
+         << timed_bulk<HashMap<int,int>>(true, k, v) << " "
+         << timed_bulk<BinSearchMap<int,int>>(false, k, v) << " "
+         << timed_bulk<BinSearchMap<int,int>>(true, k, v) << " "
+         << timed_bulk<BSTMap<int,int>>(false, k, v) << " "
+         << timed_bulk<BSTMap<int,int>>(true, k, v) << " "
+         << timed_bulk<AVLMap<int,int>>(false, k, v) << " "
+         << timed_bulk<AVLMap<int,int>>(true, k, v) << " "
+         << timed_bulk<AVLMap<int,int>>(true, sorted, v) << endl;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Parallel rehashing (./hw9_perf rehash)
+//----------------------------------------------------------------------
+
+void rehash_perf(int max_keys)
+{
+  cout << "# All times in milliseconds (msec)" << endl;
+  cout << "# Column 1 = number of keys" << endl;
+  cout << "# Column 2 = rehash threads" << endl;
+  cout << "# Column 3 = grow (reserve for twice the keys)" << endl;
+  cout << "# Column 4 = shrink back (shrink_to_fit)" << endl;
+
+  int sizes[] = {1000000, 4000000, 16000000};
+  int threads[] = {1, 2, 4, 8};
+  for (int n : sizes) {
+    if (n > max_keys)
+      break;
+    HashMap<int,int> m;
+    m.reserve(n);
+    for (int i = 0; i < n; ++i)
+      m.insert(static_cast<int>((i * 2654435761u) & 0x7ffffffe), i);
+    for (int t : threads) {
+      m.set_rehash_threads(t);
+      double grow = 0, shrink = 0;
+      for (int r = 0; r < runs; ++r) {
+        auto t0 = high_resolution_clock::now();
+        m.reserve(2 * n);
+        auto t1 = high_resolution_clock::now();
+        m.shrink_to_fit();
+        auto t2 = high_resolution_clock::now();
+        grow += duration_cast<microseconds>(t1 - t0).count();
+        shrink += duration_cast<microseconds>(t2 - t1).count();
+      }
+      cout << n << " " << t << " " << (grow/1000) / runs << " "
+           << (shrink/1000) / runs << endl;
+    }
+  }
+}
+
+
+//----------------------------------------------------------------------
+// String-key lookups (./hw9_perf strings)
+//----------------------------------------------------------------------
+
+// time to look up each of n string_views in m, either through a
+// temporary std::string per lookup (as callers had to before the
+// heterogeneous lookups) or passing the view as is. The heap
+// allocations per lookup are returned in allocs.
+template<typename M>
+double timed_view_lookups(const M& m, const vector<string_view>& views, int n,
+                          bool temporary, double& allocs)
+{
+  double total = 0;
+  count_allocations(true);
+  long before = thread_allocations();
+  long found = 0;
+  for (int r = 0; r < runs; ++r) {
+    auto t0 = high_resolution_clock::now();
+    if (temporary) {
+      for (int i = 0; i < n; ++i)
+        found += m.contains(string(views[i]));
+    }
+    else {
+      for (int i = 0; i < n; ++i)
+        found += m.contains(views[i]);
+    }
+    auto t1 = high_resolution_clock::now();
+    total += duration_cast<microseconds>(t1 - t0).count();
+  }
+  allocs = static_cast<double>(thread_allocations() - before) / (static_cast<double>(n) * runs);
+  count_allocations(false);
+  lookup_sink += found;
+  return (total/1000) / runs;
+}
+
+// prints the std::string and string_view lookup times for an M
+// holding the first n keys, and returns the allocations per lookup
+// of each in allocs
+template<typename M>
+void view_columns(const vector<string>& names, const vector<string_view>& views,
+                  const ArraySeq<int>& vals, int n, double allocs[2])
+{
+  M m;
+  for (int i = 0; i < n; ++i)
+    m.insert(names[i], vals[i]);
+  cout << timed_view_lookups(m, views, n, true, allocs[0]) << " "
+       << timed_view_lookups(m, views, n, false, allocs[1]) << " ";
+}
+
+void strings_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals)
+{
+  cout << "# All times in milliseconds (msec)" << endl;
+  cout << "# Column 1 = input data size" << endl;
+  cout << "# Column 2 = hash map contains (temporary std::string per lookup)" << endl;
+  cout << "# Column 3 = hash map contains (string_view)" << endl;
+  cout << "# Column 4 = avl map contains (temporary std::string per lookup)" << endl;
+  cout << "# Column 5 = avl map contains (string_view)" << endl;
+  cout << "# Column 6 = binsearch map contains (temporary std::string per lookup)" << endl;
+  cout << "# Column 7 = binsearch map contains (string_view)" << endl;
+  cout << "# Column 8 = allocations per lookup (temporary std::string)" << endl;
+  cout << "# Column 9 = allocations per lookup (string_view)" << endl;
+
+  // keys too long for the short string buffer, so every temporary
+  // std::string allocates, and views into one large buffer
+  vector<string> names(stop);
+  string text;
+  for (int i = 0; i < stop; ++i) {
+    names[i] = "string-key-" + to_string(keys[i]) + "-padded";
+    text += names[i];
+  }
+  vector<string_view> views(stop);
+  int offset = 0;
+  for (int i = 0; i < stop; ++i) {
+    views[i] = string_view(text.data() + offset, names[i].size());
+    offset += names[i].size();
+  }
+
+  for (int n = step; n <= stop; n += step) {
+    double allocs[2];
+    cout << n << " ";
+    view_columns<HashMap<string,int>>(names, views, vals, n, allocs);
+    view_columns<AVLMap<string,int>>(names, views, vals, n, allocs);
+    view_columns<BinSearchMap<string,int>>(names, views, vals, n, allocs);
+    cout << allocs[0] << " " << allocs[1] << endl;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Order statistics (./hw9_perf order)
+//----------------------------------------------------------------------
+
+void order_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals)
+{
+  cout << "# All times in milliseconds (msec)" << endl;
+  cout << "# Column 1 = input data size" << endl;
+  cout << "# Column 2 = 100 range counts with find_keys (a tenth of the keys each)" << endl;
+  cout << "# Column 3 = 100 range counts with count_range" << endl;
+  cout << "# Column 4 = 100 medians with sorted_keys" << endl;
+  cout << "# Column 5 = 100 medians with select" << endl;
+
+  const int queries = 100;
+  for (int n = step; n <= stop; n += step) {
+    AVLMap<int,int> m;
+    for (int i = 0; i < n; ++i)
+      m.insert(keys[i], vals[i]);
+    // keys are the even numbers up to 2 * stop
+    int width = (2 * n) / 10;
+    long found = 0;
+    auto t0 = high_resolution_clock::now();
+    for (int q = 0; q < queries; ++q)
+      found += m.find_keys(q * 11, q * 11 + width).size();
+    auto t1 = high_resolution_clock::now();
+    for (int q = 0; q < queries; ++q)
+      found += m.count_range(q * 11, q * 11 + width);
+    auto t2 = high_resolution_clock::now();
+    for (int q = 0; q < queries; ++q)
+      found += m.sorted_keys()[n / 2];
+    auto t3 = high_resolution_clock::now();
+    for (int q = 0; q < queries; ++q)
+      found += m.select(n / 2);
+    auto t4 = high_resolution_clock::now();
+    lookup_sink += found;
+    cout << n << " " << duration_cast<microseconds>(t1 - t0).count() / 1000.0 << " "
+         << duration_cast<microseconds>(t2 - t1).count() / 1000.0 << " "
+         << duration_cast<microseconds>(t3 - t2).count() / 1000.0 << " "
+         << duration_cast<microseconds>(t4 - t3).count() / 1000.0 << endl;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// In-order walks (./hw9_perf iterate)
+//----------------------------------------------------------------------
+
+// prints the time to visit every key of an M holding the first n
+// keys with repeated next_key calls, and with an iterator
+template<typename M>
+void iterate_columns(const ArraySeq<int>& keys, const ArraySeq<int>& vals, int n)
+{
+  M m;
+  for (int i = 0; i < n; ++i)
+    m.insert(keys[i], vals[i]);
+  long total = 0;
+  auto t0 = high_resolution_clock::now();
+  for (int r = 0; r < runs; ++r) {
+    // the keys are positive, so the walk starts below all of them
+    int key = 0;
+    while (m.next_key(key, key))
+      total += key;
+  }
+  auto t1 = high_resolution_clock::now();
+  for (int r = 0; r < runs; ++r) {
+    for (auto [key, value] : m)
+      total += key;
+  }
+  auto t2 = high_resolution_clock::now();
+  lookup_sink += total;
+  cout << (duration_cast<microseconds>(t1 - t0).count() / 1000.0) / runs << " "
+       << (duration_cast<microseconds>(t2 - t1).count() / 1000.0) / runs << " ";
+}
+
+void iterate_perf(const ArraySeq<int>& keys, const ArraySeq<int>& vals)
+{
+  cout << "# All times in milliseconds (msec)" << endl;
+  cout << "# Column 1 = input data size" << endl;
+  cout << "# Column 2 = avl map walk with next_key" << endl;
+  cout << "# Column 3 = avl map walk with an iterator" << endl;
+  cout << "# Column 4 = bst map walk with next_key" << endl;
+  cout << "# Column 5 = bst map walk with an iterator" << endl;
+
+  for (int n = step; n <= stop; n += step) {
+    cout << n << " ";
+    iterate_columns<AVLMap<int,int>>(keys, vals, n);
+    iterate_columns<BSTMap<int,int>>(keys, vals, n);
+    cout << endl;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Large avl trees (./hw9_perf avl)
+//----------------------------------------------------------------------
+
+void avl_perf(int max_keys)
+{
+  cout << "# All times in nanoseconds per operation" << endl;
+  cout << "# Column 1 = number of keys" << endl;
+  cout << "# Column 2 = tree height after the inserts" << endl;
+  cout << "# Column 3 = insert (random order)" << endl;
+  cout << "# Column 4 = contains (random order)" << endl;
+  cout << "# Column 5 = erase (random order, down to an empty tree)" << endl;
+
+  int sizes[] = {1000000, 3000000, 10000000};
+  for (int n : sizes) {
+    if (n > max_keys)
+      break;
+    // distinct keys, and a prime stride (coprime to every size) that
+    // visits them in a scrambled order
+    vector<int> keys(n);
+    for (int i = 0; i < n; ++i)
+      keys[i] = static_cast<int>((i * 2654435761u) & 0x7ffffffe);
+    const long stride = 1000003;
+    AVLMap<int,int> m;
+    auto t0 = high_resolution_clock::now();
+    for (int i = 0; i < n; ++i)
+      m.insert(keys[i], i);
+    auto t1 = high_resolution_clock::now();
+    long found = 0;
+    for (int i = 0; i < n; ++i)
+      found += m.contains(keys[(i * stride) % n]);
+    auto t2 = high_resolution_clock::now();
+    int height = m.height();
+    for (int i = 0; i < n; ++i)
+      m.erase(keys[(i * stride) % n]);
+    auto t3 = high_resolution_clock::now();
+    lookup_sink += found;
+    cout << n << " " << height << " "
+         << static_cast<double>(duration_cast<nanoseconds>(t1 - t0).count()) / n << " "
+         << static_cast<double>(duration_cast<nanoseconds>(t2 - t1).count()) / n << " "
+         << static_cast<double>(duration_cast<nanoseconds>(t3 - t2).count()) / n << endl;
+  }
+}
+
+
+void setops_perf(int max_keys)
+{
+  cout << "# All times in milliseconds (msec)" << endl;
+  cout << "# Column 1 = keys in the big map" << endl;
+  cout << "# Column 2 = keys in the delta (half new, half already in the big map)" << endl;
+  cout << "# Column 3 = delta built by inserts (0) or from sorted arrays (1)" << endl;
+  cout << "# Column 4 = insert (or update) the delta map's pairs one by one" << endl;
+  cout << "# Column 5 = same, from the delta's sorted keys in an array" << endl;
+  cout << "# Column 6 = union_with on one thread" << endl;
+  cout << "# Column 7 = union_with on four threads" << endl;
+  cout << "# Column 8 = difference_with on one thread" << endl;
+
+  int n = max_keys;
+  ArraySeq<int> big_keys, big_vals;
+  for (int i = 0; i < n; ++i) {
+    big_keys.insert(2 * i, big_keys.size());
+    big_vals.insert(i, big_vals.size());
+  }
+  AVLMap<int,int> big(big_keys, big_vals);
+
+  int deltas[] = {1000, 10000, 100000, 1000000};
+  for (int m : deltas) {
+    if (m > n)
+      break;
+    for (int packed = 0; packed <= 1; ++packed) {
+      // scrambled keys, alternately odd (new) and even (updates)
+      AVLMap<int,int> delta;
+      for (long i = 0; delta.size() < m; ++i) {
+        int key = static_cast<int>((i * 2654435761u) % (2L * n));
+        key = key - key % 2 + static_cast<int>(i % 2);
+        if (!delta.contains(key))
+          delta.insert(key, -1);
+      }
+      ArraySeq<int> delta_keys = delta.sorted_keys();
+      // the same pairs with their nodes laid out in key order
+      if (packed) {
+        ArraySeq<int> delta_vals;
+        for (int i = 0; i < delta_keys.size(); ++i)
+          delta_vals.insert(-1, delta_vals.size());
+        delta = AVLMap<int,int>(delta_keys, delta_vals);
+      }
+
+      AVLMap<int,int> m0(big);
+      auto s0 = high_resolution_clock::now();
+      for (auto it = delta.begin(); it != delta.end(); ++it) {
+        if (m0.contains(it.key()))
+          m0[it.key()] = it.value();
+        else
+          m0.insert(it.key(), it.value());
+      }
+      auto s1 = high_resolution_clock::now();
+
+      AVLMap<int,int> m1(big);
+      auto t0 = high_resolution_clock::now();
+      for (int i = 0; i < delta_keys.size(); ++i) {
+        if (m1.contains(delta_keys[i]))
+          m1[delta_keys[i]] = -1;
+        else
+          m1.insert(delta_keys[i], -1);
+      }
+      auto t1 = high_resolution_clock::now();
+
+      AVLMap<int,int> m2(big);
+      auto t2 = high_resolution_clock::now();
+      m2.union_with(delta);
+      auto t3 = high_resolution_clock::now();
+
+      AVLMap<int,int> m3(big);
+      m3.set_join_threads(4);
+      auto t4 = high_resolution_clock::now();
+      m3.union_with(delta);
+      auto t5 = high_resolution_clock::now();
+
+      AVLMap<int,int> m4(big);
+      auto t6 = high_resolution_clock::now();
+      m4.difference_with(delta);
+      auto t7 = high_resolution_clock::now();
+
+      assert(m0.size() == m1.size() && m1.size() == m2.size() && m2.size() == m3.size());
+      lookup_sink += m4.size();
+      cout << n << " " << m << " " << packed << " "
+           << duration_cast<microseconds>(s1 - s0).count() / 1000.0 << " "
+           << duration_cast<microseconds>(t1 - t0).count() / 1000.0 << " "
+           << duration_cast<microseconds>(t3 - t2).count() / 1000.0 << " "
+           << duration_cast<microseconds>(t5 - t4).count() / 1000.0 << " "
+           << duration_cast<microseconds>(t7 - t6).count() / 1000.0 << endl;
+    }
+  }
+}
+
+
+void persistent_perf(int max_keys)
+{
+  cout << "# Column 1 = number of keys" << endl;
+  cout << "# Column 2 = AVLMap copy (msec)" << endl;
+  cout << "# Column 3 = PersistentAVLMap snapshot (usec)" << endl;
+  cout << "# Column 4 = AVLMap update, erase and reinsert (nsec per key)" << endl;
+  cout << "# Column 5 = PersistentAVLMap update, erase and reinsert (nsec per key)" << endl;
+  cout << "# Column 6 = same, with a new snapshot every 1000 keys (nsec per key)" << endl;
+
+  int sizes[] = {100000, 1000000, 10000000};
+  for (int n : sizes) {
+    if (n > max_keys)
+      break;
+    vector<int> keys(n);
+    for (int i = 0; i < n; ++i)
+      keys[i] = static_cast<int>((i * 2654435761u) & 0x7ffffffe);
+    const long stride = 1000003;
+    AVLMap<int,int> m1;
+    PersistentAVLMap<int,int> m2;
+    for (int i = 0; i < n; ++i) {
+      m1.insert(keys[i], i);
+      m2.insert(keys[i], i);
+    }
+
+    auto t0 = high_resolution_clock::now();
+    AVLMap<int,int> copy(m1);
+    auto t1 = high_resolution_clock::now();
+    PersistentAVLMap<int,int>::Snapshot snapshot = m2.snapshot();
+    auto t2 = high_resolution_clock::now();
+    lookup_sink += copy.size() + snapshot.size();
+    copy.clear();
+    snapshot = PersistentAVLMap<int,int>::Snapshot();
+
+    // one update, erase, and reinsert per key, in a scrambled order
+    auto churn = [&](auto& m, int every) {
+      PersistentAVLMap<int,int>::Snapshot held;
+      auto start = high_resolution_clock::now();
+      for (int i = 0; i < n; ++i) {
+        int key = keys[(i * stride) % n];
+        m[key] = i;
+        m.erase(key);
+        m.insert(key, i);
+        if constexpr (is_same<decay_t<decltype(m)>, PersistentAVLMap<int,int>>::value)
+          if (every > 0 && i % every == 0)
+            held = m.snapshot();
+      }
+      auto end = high_resolution_clock::now();
+      return static_cast<double>(duration_cast<nanoseconds>(end - start).count()) / n;
+    };
+    double live_churn = churn(m1, 0);
+    double persistent_churn = churn(m2, 0);
+    double snapshot_churn = churn(m2, 1000);
+
+    cout << n << " "
+         << duration_cast<microseconds>(t1 - t0).count() / 1000.0 << " "
+         << duration_cast<nanoseconds>(t2 - t1).count() / 1000.0 << " "
+         << live_churn << " " << persistent_churn << " " << snapshot_churn << endl;
+  }
+}
+
+void compact_perf(int max_keys)
+{
+  cout << "# Column 1 = number of keys" << endl;
+  cout << "# Column 2 = AVLMap heap bytes per key (requested, before malloc overhead)" << endl;
+  cout << "# Column 3 = CompactAVLMap arena bytes per key (with unused capacity)" << endl;
+  cout << "# Column 4 = AVLMap insert (random order, nsec per key)" << endl;
+  cout << "# Column 5 = CompactAVLMap insert (random order, nsec per key)" << endl;
+  cout << "# Column 6 = AVLMap contains (random order, nsec per key)" << endl;
+  cout << "# Column 7 = CompactAVLMap contains (random order, nsec per key)" << endl;
+  cout << "# Column 8 = CompactAVLMap contains after assign (level-order arena)" << endl;
+
+  int sizes[] = {1000000, 10000000, 30000000};
+  for (int n : sizes) {
+    if (n > max_keys)
+      break;
+    vector<int> keys(n);
+    for (int i = 0; i < n; ++i)
+      keys[i] = static_cast<int>((i * 2654435761u) & 0x7ffffffe);
+    // probe in an order unrelated to the insertion order (a fixed
+    // stride lines successive probes up with neighbouring inserts)
+    vector<int> probes(keys);
+    shuffle(probes.begin(), probes.end(), mt19937(n));
+    auto per_key = [n](auto start, auto end) {
+      return static_cast<double>(duration_cast<nanoseconds>(end - start).count()) / n;
+    };
+    long found = 0;
+    double avl_bytes, avl_insert, avl_contains;
+    {
+      AVLMap<int,int> m;
+      count_allocations(true);
+      long before = thread_allocated_bytes();
+      auto t0 = high_resolution_clock::now();
+      for (int i = 0; i < n; ++i)
+        m.insert(keys[i], i);
+      auto t1 = high_resolution_clock::now();
+      long after = thread_allocated_bytes();
+      count_allocations(false);
+      for (int i = 0; i < n; ++i)
+        found += m.contains(probes[i]);
+      auto t2 = high_resolution_clock::now();
+      avl_bytes = static_cast<double>(after - before) / n;
+      avl_insert = per_key(t0, t1);
+      avl_contains = per_key(t1, t2);
+    }
+    double compact_bytes, compact_insert, compact_contains, built_contains;
+    {
+      CompactAVLMap<int,int> m;
+      auto t0 = high_resolution_clock::now();
+      for (int i = 0; i < n; ++i)
+        m.insert(keys[i], i);
+      auto t1 = high_resolution_clock::now();
+      for (int i = 0; i < n; ++i)
+        found += m.contains(probes[i]);
+      auto t2 = high_resolution_clock::now();
+      compact_bytes = static_cast<double>(m.arena_bytes()) / n;
+      compact_insert = per_key(t0, t1);
+      compact_contains = per_key(t1, t2);
+
+      ArraySeq<int> sorted = m.sorted_keys();
+      m.assign(sorted, sorted);
+      auto t3 = high_resolution_clock::now();
+      for (int i = 0; i < n; ++i)
+        found += m.contains(probes[i]);
+      auto t4 = high_resolution_clock::now();
+      built_contains = per_key(t3, t4);
+    }
+    lookup_sink += found;
+    cout << n << " " << avl_bytes << " " << compact_bytes << " " << avl_insert << " "
+         << compact_insert << " " << avl_contains << " " << compact_contains << " "
+         << built_contains << endl;
+  }
+}
+
+
+void freeze_perf(int max_keys)
+{
+  cout << "# Column 1 = number of keys" << endl;
+  cout << "# Column 2 = freeze (msec)" << endl;
+  cout << "# Column 3 = AVLMap contains (random order, nsec per key)" << endl;
+  cout << "# Column 4 = FrozenTreeMap contains (random order, nsec per key)" << endl;
+  cout << "# Column 5 = AVLMap next_key (random order, nsec per key)" << endl;
+  cout << "# Column 6 = FrozenTreeMap next_key (random order, nsec per key)" << endl;
+  cout << "# Column 7 = AVLMap find_keys (100-key ranges, nsec per range)" << endl;
+  cout << "# Column 8 = FrozenTreeMap find_keys (100-key ranges, nsec per range)" << endl;
+  cout << "# Column 9 = FrozenTreeMap bytes per key" << endl;
+
+  int sizes[] = {1000, 100000, 1000000, 10000000};
+  for (int n : sizes) {
+    if (n > max_keys)
+      break;
+    vector<int> keys(n);
+    for (int i = 0; i < n; ++i)
+      keys[i] = static_cast<int>((i * 2654435761u) & 0x7ffffffe);
+    vector<int> probes(keys);
+    shuffle(probes.begin(), probes.end(), mt19937(n));
+    AVLMap<int,int> m;
+    for (int i = 0; i < n; ++i)
+      m.insert(keys[i], i);
+
+    auto start = high_resolution_clock::now();
+    FrozenTreeMap<int,int> f = m.freeze();
+    auto end = high_resolution_clock::now();
+    double freeze_ms = duration_cast<microseconds>(end - start).count() / 1000.0;
+
+    // enough probes that the small maps are timed over many passes
+    int probe_count = n < 1000000 ? 1000000 : n;
+    auto per_probe = [probe_count](auto start, auto end) {
+      return static_cast<double>(duration_cast<nanoseconds>(end - start).count()) / probe_count;
+    };
+    long found = 0;
+    int next = 0;
+    auto t0 = high_resolution_clock::now();
+    for (int i = 0; i < probe_count; ++i)
+      found += m.contains(probes[i % n]);
+    auto t1 = high_resolution_clock::now();
+    for (int i = 0; i < probe_count; ++i)
+      found += f.contains(probes[i % n]);
+    auto t2 = high_resolution_clock::now();
+    for (int i = 0; i < probe_count; ++i)
+      found += m.next_key(probes[i % n] + 1, next);
+    auto t3 = high_resolution_clock::now();
+    for (int i = 0; i < probe_count; ++i)
+      found += f.next_key(probes[i % n] + 1, next);
+    auto t4 = high_resolution_clock::now();
+
+    // ranges covering about 100 keys each (the keys are spread evenly
+    // over [0, 2^31))
+    const int ranges = 10000;
+    const long width = 100L * 0x7fffffff / n;
+    auto t5 = high_resolution_clock::now();
+    for (int i = 0; i < ranges; ++i)
+      found += m.find_keys(probes[i % n], static_cast<int>(min(probes[i % n] + width, 0x7fffffffL))).size();
+    auto t6 = high_resolution_clock::now();
+    for (int i = 0; i < ranges; ++i)
+      found += f.find_keys(probes[i % n], static_cast<int>(min(probes[i % n] + width, 0x7fffffffL))).size();
+    auto t7 = high_resolution_clock::now();
+    lookup_sink += found + next;
+
+    cout << n << " " << freeze_ms << " " << per_probe(t0, t1) << " " << per_probe(t1, t2) << " "
+         << per_probe(t2, t3) << " " << per_probe(t3, t4) << " "
+         << static_cast<double>(duration_cast<nanoseconds>(t6 - t5).count()) / ranges << " "
+         << static_cast<double>(duration_cast<nanoseconds>(t7 - t6).count()) / ranges << " "
+         << static_cast<double>(f.layout_bytes()) / n << endl;
+  }
+}
@@ -6,10 +6,28 @@
 //---------------------------------------------------------------------------
 
 #include <iostream>
+#include <iterator>
 #include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <mutex>
 #include <gtest/gtest.h>
 #include "arrayseq.h"
 #include "avlmap.h"
+#include "bstmap.h"
+#include "hashmap.h"
+#include "flathashmap.h"
+#include "robinhoodmap.h"
+#include "cuckoomap.h"
+#include "frozenhashmap.h"
+#include "binsearchmap.h"
+#include "bloommap.h"
+#include "concurrenthashmap.h"
+#include "epochhashmap.h"
+#include "persistentavlmap.h"
+#include "compactavlmap.h"
+#include "frozentreemap.h"
 
 using namespace std;
 
@@ -554,6 +572,1832 @@ TEST(BasicAVLMapTests, EraseRebalanceCheck)
   ASSERT_EQ(3, c3.height());
 }
 
+TEST(BasicAVLMapTests, AssignCheck)
+{
+  // unsorted keys with repeats (the first pair of a key is kept)
+  ArraySeq<int> keys, vals;
+  for (int i = 0; i < 1000; ++i) {
+    keys.insert((i * 7919) % 1000, i);
+    vals.insert(i, i);
+  }
+  keys.insert(0, 1000);
+  vals.insert(-1, 1000);
+  AVLMap<int, int> m1(keys, vals);
+  BSTMap<int, int> m2(keys, vals);
+  BinSearchMap<int, int> m3(keys, vals);
+  ASSERT_EQ(1000, m1.size());
+  ASSERT_EQ(1000, m2.size());
+  ASSERT_EQ(1000, m3.size());
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(i, m1[(i * 7919) % 1000]);
+    ASSERT_EQ(i, m2[(i * 7919) % 1000]);
+    ASSERT_EQ(i, m3[(i * 7919) % 1000]);
+  }
+  // perfectly balanced: 1000 keys need 10 levels
+  ASSERT_EQ(10, m1.height());
+  ASSERT_EQ(10, m2.height());
+  ArraySeq<int> sorted = m1.sorted_keys();
+  for (int i = 0; i < 1000; ++i)
+    ASSERT_EQ(i, sorted[i]);
+  // the tree is a valid AVL tree afterwards
+  for (int i = 0; i < 1000; i += 2)
+    m1.erase(i);
+  m1.insert(5000, 1);
+  ASSERT_EQ(501, m1.size());
+  ASSERT_EQ(true, m1.contains(999));
+  ASSERT_EQ(false, m1.contains(998));
+  // sorted input and replacing a non-empty map
+  ArraySeq<int> k2, v2;
+  for (int i = 0; i < 7; ++i) {
+    k2.insert(i * 10, i);
+    v2.insert(i, i);
+  }
+  m1.assign(k2, v2);
+  m3.assign(k2, v2);
+  ASSERT_EQ(7, m1.size());
+  ASSERT_EQ(3, m1.height());
+  ASSERT_EQ(false, m1.contains(999));
+  ASSERT_EQ(6, m3[60]);
+  m1.assign(ArraySeq<int>(), ArraySeq<int>());
+  ASSERT_EQ(true, m1.empty());
+  v2.erase(0);
+  ASSERT_THROW(m2.assign(k2, v2), std::out_of_range);
+}
+
+TEST(BasicAVLMapTests, OrderStatisticsCheck)
+{
+  AVLMap<int, int> m;
+  ASSERT_EQ(0, m.rank(10));
+  ASSERT_EQ(0, m.count_range(0, 100));
+  ASSERT_THROW(m.select(0), std::out_of_range);
+  // even keys 0..1998 in a scrambled order, then every third erased
+  for (int i = 0; i < 1000; ++i)
+    m.insert(2 * ((i * 7919) % 1000), i);
+  for (int i = 0; i < 1000; i += 3)
+    m.erase(2 * i);
+  ArraySeq<int> keys = m.sorted_keys();
+  ASSERT_EQ(m.size(), keys.size());
+  for (int i = 0; i < keys.size(); ++i) {
+    ASSERT_EQ(keys[i], m.select(i));
+    ASSERT_EQ(i, m.rank(keys[i]));
+    ASSERT_EQ(i + 1, m.rank(keys[i] + 1));
+  }
+  ASSERT_THROW(m.select(-1), std::out_of_range);
+  ASSERT_THROW(m.select(m.size()), std::out_of_range);
+  ASSERT_EQ(m.size(), m.rank(5000));
+  // counts match find_keys, including missing and reversed bounds
+  for (int k1 = -5; k1 < 2005; k1 += 37) {
+    for (int k2 = k1 - 40; k2 < 2010; k2 += 131)
+      ASSERT_EQ(m.find_keys(k1, k2).size(), m.count_range(k1, k2));
+  }
+  // copies and bulk loads keep the sizes
+  AVLMap<int, int> copy(m);
+  ASSERT_EQ(keys[keys.size() / 2], copy.select(copy.size() / 2));
+  ASSERT_EQ(keys.size(), copy.count_range(-1, 5000));
+  copy.assign(keys, keys);
+  for (int i = 0; i < keys.size(); i += 7)
+    ASSERT_EQ(keys[i], copy.select(i));
+  ASSERT_EQ(keys.size() - 1, copy.rank(keys[keys.size() - 1]));
+}
+
+// walks m forward with ++ and back from end with --, checking both
+// against the sorted keys (and so every parent link on the way)
+template <typename M>
+void check_iterators(const M& m)
+{
+  ArraySeq<int> keys = m.sorted_keys();
+  int i = 0;
+  for (auto [key, value] : m) {
+    ASSERT_EQ(keys[i], key);
+    ASSERT_EQ(m[key], value);
+    ++i;
+  }
+  ASSERT_EQ(keys.size(), i);
+  typename M::const_iterator it = m.end();
+  while (it != m.begin()) {
+    --it;
+    --i;
+    ASSERT_EQ(keys[i], it.key());
+  }
+  ASSERT_EQ(0, i);
+}
+
+TEST(BasicAVLMapTests, IteratorCheck)
+{
+  AVLMap<int, int> m1;
+  BSTMap<int, int> m2;
+  ASSERT_EQ(true, m1.begin() == m1.end());
+  ASSERT_EQ(true, m2.lower_bound(5) == m2.end());
+  for (int i = 0; i < 500; ++i) {
+    int key = 2 * ((i * 7919) % 500);
+    m1.insert(key, i);
+    m2.insert(key, i);
+  }
+  check_iterators(m1);
+  check_iterators(m2);
+  // erases (with rotations and two-child cases) keep the links right
+  for (int i = 0; i < 1000; i += 6) {
+    m1.erase(i);
+    m2.erase(i);
+  }
+  check_iterators(m1);
+  check_iterators(m2);
+  // bounds
+  ASSERT_EQ(2, m1.lower_bound(1).key());
+  ASSERT_EQ(2, m1.lower_bound(2).key());
+  ASSERT_EQ(4, m1.upper_bound(2).key());
+  ASSERT_EQ(8, m2.lower_bound(6).key());
+  ASSERT_EQ(true, m1.upper_bound(998) == m1.end());
+  ASSERT_EQ(998, (--m2.end()).key());
+  // the standard algorithms take the iterators
+  ASSERT_EQ(m1.size(), std::distance(m1.begin(), m1.end()));
+  const BSTMap<int, int>& c2 = m2;
+  ASSERT_EQ(m2.size(), std::distance(c2.begin(), c2.end()));
+  ASSERT_EQ(998, std::prev(m1.end()).key());
+  ASSERT_EQ(2, std::prev(m2.end(), m2.size()).key());
+  ASSERT_EQ(4, std::next(m1.begin()).key());
+  AVLMap<int, int>::iterator it = m1.lower_bound(100);
+  AVLMap<int, int>::iterator before = it--;
+  ASSERT_EQ(98, it.key());
+  ASSERT_EQ(100, before.key());
+  // values can be changed through a mutable iterator
+  for (auto [key, value] : m1)
+    value = key + 1;
+  for (AVLMap<int, int>::iterator e = m1.begin(); e != m1.end(); ++e)
+    ASSERT_EQ(e.key() + 1, e.value());
+  // copies, bulk loads, and moves
+  AVLMap<int, int> m3(m1);
+  check_iterators(m3);
+  ArraySeq<int> keys = m2.sorted_keys();
+  m3.assign(keys, keys);
+  m2.assign(keys, keys);
+  check_iterators(m3);
+  check_iterators(m2);
+  BSTMap<int, int> m4(std::move(m2));
+  check_iterators(m4);
+  ASSERT_EQ(true, m2.begin() == m2.end());
+}
+
+// only converts to a string (it does not compare with one)
+struct KeyName {
+  string text;
+  operator string() const { return text; }
+};
+
+TEST(BasicAVLMapTests, TransparentLookupCheck)
+{
+  AVLMap<string, int> m1;
+  BSTMap<string, int> m2;
+  BinSearchMap<string, int> m3;
+  for (int i = 0; i < 100; ++i) {
+    string key = "a-long-enough-key-" + to_string(i);
+    m1.insert(key, i);
+    m2.insert(key, i);
+    m3.insert(key, i);
+  }
+  // string_view (not null terminated) and C string lookups
+  string text = "a-long-enough-key-42 and more";
+  string_view view(text.data(), 20);
+  ASSERT_EQ(true, m1.contains(view));
+  ASSERT_EQ(true, m2.contains(view));
+  ASSERT_EQ(true, m3.contains(view));
+  ASSERT_EQ(42, m1[view]);
+  ASSERT_EQ(42, m2["a-long-enough-key-42"]);
+  const char* missing = "a-long-enough-key-100";
+  ASSERT_EQ(false, m1.contains(missing));
+  ASSERT_EQ(false, m3.contains(string_view("a-long")));
+  ASSERT_THROW(m3[missing], std::out_of_range);
+  m1[view] = 7;
+  ASSERT_EQ(7, m1["a-long-enough-key-42"]);
+  const AVLMap<string, int>& c1 = m1;
+  ASSERT_EQ(7, c1[view]);
+  // erase by view, and every other key is still there
+  m1.erase(view);
+  m2.erase(view);
+  m3.erase(view);
+  ASSERT_THROW(m1.erase(view), std::out_of_range);
+  ASSERT_THROW(m2.erase(missing), std::out_of_range);
+  ASSERT_EQ(99, m1.size());
+  ASSERT_EQ(99, m2.size());
+  ASSERT_EQ(99, m3.size());
+  ASSERT_EQ(false, m2.contains(view));
+  for (int i = 0; i < 100; i += 3) {
+    string key = "a-long-enough-key-" + to_string(i);
+    ASSERT_EQ(i != 42, m1.contains(key.c_str()));
+    ASSERT_EQ(i != 42, m2.contains(string_view(key)));
+    ASSERT_EQ(i != 42, m3.contains(key.c_str()));
+  }
+  // a type that only converts to the key type is converted
+  ASSERT_EQ(true, (is_lookup_key<string, string_view>::value));
+  ASSERT_EQ(false, (is_lookup_key<string, KeyName>::value));
+  KeyName name{"a-long-enough-key-3"};
+  ASSERT_EQ(true, m1.contains(name));
+  ASSERT_EQ(true, m2.contains(name));
+  ASSERT_EQ(true, m3.contains(name));
+  ASSERT_EQ(3, m3[name]);
+  // scalar keys still convert (2.5 finds 2)
+  AVLMap<int, int> m4;
+  m4.insert(2, 20);
+  ASSERT_EQ(true, m4.contains(2.5));
+  ASSERT_EQ(20, m4[2.5]);
+}
+
+// multiples of 2 in one map and of 3 in the other (with values 2
+// and 3 to tell them apart), split across threads or not
+template <typename M>
+void fill_set_operands(M& m1, M& m2, int threads)
+{
+  m1.set_join_threads(threads);
+  for (int i = 0; i < 30000; i += 2)
+    m1.insert(i, 2);
+  for (int i = 0; i < 30000; i += 3)
+    m2.insert(i, 3);
+}
+
+TEST(BasicAVLMapTests, SetOperationsCheck)
+{
+  for (int threads = 1; threads <= 4; threads += 3) {
+    AVLMap<int, int> m1, m2, m3, m4;
+    fill_set_operands(m1, m2, threads);
+    m3 = m1;
+    m4 = m1;
+    m1.union_with(m2);
+    m3.intersect_with(m2);
+    m4.difference_with(m2);
+    ASSERT_EQ(20000, m1.size());
+    ASSERT_EQ(5000, m3.size());
+    ASSERT_EQ(10000, m4.size());
+    ASSERT_EQ(10000, m2.size());
+    for (int i = 0; i < 30000; ++i) {
+      ASSERT_EQ(i % 2 == 0 || i % 3 == 0, m1.contains(i));
+      ASSERT_EQ(i % 6 == 0, m3.contains(i));
+      ASSERT_EQ(i % 2 == 0 && i % 3 != 0, m4.contains(i));
+    }
+    // rhs's value wins in a union, this map's in an intersection
+    ASSERT_EQ(3, m1[6]);
+    ASSERT_EQ(2, m1[4]);
+    ASSERT_EQ(2, m3[6]);
+    // the results are balanced with their links and sizes intact
+    ASSERT_LE(m1.height(), 20);
+    ASSERT_EQ(4999, m3.rank(29994));
+    check_iterators(m1);
+    check_iterators(m3);
+    check_iterators(m4);
+  }
+  // with itself and with an empty map
+  AVLMap<int, int> m1, m2;
+  fill_set_operands(m1, m2, 1);
+  m1.union_with(m1);
+  m1.intersect_with(m1);
+  ASSERT_EQ(15000, m1.size());
+  m2.union_with(AVLMap<int, int>());
+  ASSERT_EQ(10000, m2.size());
+  // a small rhs is added key by key
+  AVLMap<int, int> m5;
+  m5.insert(4, 9);
+  m5.insert(7, 8);
+  m1.union_with(m5);
+  ASSERT_EQ(15001, m1.size());
+  ASSERT_EQ(9, m1[4]);
+  ASSERT_EQ(8, m1[7]);
+  check_iterators(m1);
+  m2.difference_with(m2);
+  ASSERT_EQ(true, m2.empty());
+  m1.intersect_with(m2);
+  ASSERT_EQ(true, m1.empty());
+}
+
+TEST(BasicAVLMapTests, SplitJoinCheck)
+{
+  AVLMap<int, int> m1;
+  AVLMap<int, int, PoolAllocator> m2;
+  for (int i = 0; i < 1000; ++i) {
+    m1.insert(i, i);
+    m2.insert(i, i);
+  }
+  // the key itself goes with the greater keys
+  AVLMap<int, int> m3 = m1.split(600);
+  AVLMap<int, int, PoolAllocator> m4 = m2.split(600);
+  ASSERT_EQ(600, m1.size());
+  ASSERT_EQ(400, m4.size());
+  ASSERT_EQ(600, m3.select(0));
+  ASSERT_EQ(599, m2.select(599));
+  ASSERT_EQ(false, m1.contains(600));
+  check_iterators(m1);
+  check_iterators(m4);
+  // joins must keep the keys in order
+  ASSERT_THROW(m3.join(std::move(m1)), std::out_of_range);
+  ASSERT_THROW(m1.join(599, 0, std::move(m3)), std::out_of_range);
+  m4.erase(600);
+  m2.join(600, -1, std::move(m4));
+  m1.join(std::move(m3));
+  ASSERT_EQ(true, m3.empty());
+  ASSERT_EQ(true, m4.empty());
+  ASSERT_EQ(1000, m1.size());
+  ASSERT_EQ(1000, m2.size());
+  ASSERT_EQ(-1, m2[600]);
+  ASSERT_LE(m1.height(), 11);
+  ASSERT_LE(m2.height(), 11);
+  check_iterators(m1);
+  check_iterators(m2);
+  // splitting past either end
+  AVLMap<int, int> m5 = m1.split(-1);
+  ASSERT_EQ(true, m1.empty());
+  ASSERT_EQ(1000, m5.size());
+  ASSERT_EQ(true, m5.split(1000).empty());
+  ASSERT_THROW(m5.set_join_threads(0), std::out_of_range);
+}
+
+//----------------------------------------------------------------------
+// Basic Tests for the HashMap implementation of Map
+//----------------------------------------------------------------------
+
+TEST(BasicHashMapTests, InsertAccessEraseCheck)
+{
+  HashMap<char, int> m;
+  ASSERT_EQ(true, m.empty());
+  m.insert('a', 10);
+  m.insert('b', 20);
+  m.insert('c', 30);
+  ASSERT_EQ(3, m.size());
+  ASSERT_EQ(20, m['b']);
+  m['b'] = 25;
+  ASSERT_EQ(25, m['b']);
+  m.erase('a');
+  ASSERT_EQ(2, m.size());
+  ASSERT_EQ(false, m.contains('a'));
+  EXPECT_THROW(m.erase('a'), std::out_of_range);
+  EXPECT_THROW(m['a'] = 1, std::out_of_range);
+}
+
+TEST(BasicHashMapTests, ClearAndReuseCheck)
+{
+  HashMap<int, int> m;
+  for (int i = 0; i < 100; ++i)
+    m.insert(i, i);
+  m.clear();
+  ASSERT_EQ(0, m.size());
+  ASSERT_EQ(false, m.contains(5));
+  m.insert(5, 50);
+  ASSERT_EQ(50, m[5]);
+}
+
+TEST(BasicHashMapTests, CopyAndMoveCheck)
+{
+  HashMap<string, int> m1;
+  for (int i = 0; i < 100; ++i)
+    m1.insert(to_string(i), i);
+  HashMap<string, int> m2(m1);
+  m2.erase("50");
+  ASSERT_EQ(100, m1.size());
+  ASSERT_EQ(99, m2.size());
+  HashMap<string, int> m3(std::move(m2));
+  ASSERT_EQ(0, m2.size());
+  ASSERT_EQ(99, m3.size());
+  ASSERT_EQ(42, m3["42"]);
+  m2.insert("x", 1);
+  m3 = std::move(m2);
+  ASSERT_EQ(1, m3.size());
+  ASSERT_EQ(0, m2.size());
+}
+
+TEST(BasicHashMapTests, IncrementalRehashCheck)
+{
+  HashMap<int, int> m;
+  m.set_incremental_rehash(true);
+  bool saw_rehash = false;
+  for (int i = 0; i < 5000; ++i) {
+    m.insert(i, i * 2);
+    saw_rehash = saw_rehash || m.rehashing();
+    // every key stays reachable while buckets migrate
+    if (i % 97 == 0) {
+      for (int j = 0; j <= i; ++j)
+        ASSERT_EQ(true, m.contains(j));
+    }
+  }
+  ASSERT_EQ(true, saw_rehash);
+  for (int i = 0; i < 5000; i += 2)
+    m.erase(i);
+  ASSERT_EQ(2500, m.size());
+  for (int i = 0; i < 5000; ++i)
+    ASSERT_EQ(i % 2 == 1, m.contains(i));
+  ASSERT_EQ(2500, m.sorted_keys().size());
+  m.set_incremental_rehash(false);
+  ASSERT_EQ(false, m.rehashing());
+  ASSERT_EQ(4999 * 2, m[4999]);
+}
+
+TEST(BasicHashMapTests, HashPolicyCheck)
+{
+  HashMap<int, int, HeapAllocator, StdHash<int>> m1;
+  HashMap<int, int, HeapAllocator, Xxh3Hash<int>> m2(7);
+  HashMap<int, int, HeapAllocator, FibonacciHash<int>> m3(42);
+  ASSERT_EQ(7u, m2.seed());
+  for (int i = 0; i < 3000; ++i) {
+    m1.insert(i * 8, i);
+    m2.insert(i * 8, i);
+    m3.insert(i * 8, i);
+  }
+  for (int i = 0; i < 3000; ++i) {
+    ASSERT_EQ(i, m1[i * 8]);
+    ASSERT_EQ(i, m2[i * 8]);
+    ASSERT_EQ(i, m3[i * 8]);
+  }
+  ASSERT_EQ(false, m2.contains(12));
+  HashMap<int, int, HeapAllocator, Xxh3Hash<int>> m4(m2);
+  ASSERT_EQ(7u, m4.seed());
+  ASSERT_EQ(5, m4[40]);
+}
+
+TEST(BasicHashMapTests, HashReportCheck)
+{
+  HashMap<int, int> m;
+  HashReport empty = m.hash_report();
+  ASSERT_EQ(16, empty.buckets);
+  ASSERT_EQ(0, empty.used_buckets);
+  ASSERT_EQ(0.0, empty.collision_rate);
+  // the identity hash piles strided keys into a few buckets
+  HashMap<int, int, HeapAllocator, StdHash<int>> identity;
+  for (int i = 0; i < 1000; ++i) {
+    m.insert(i * 64, i);
+    identity.insert(i * 64, i);
+  }
+  HashReport mixed = m.hash_report();
+  HashReport clustered = identity.hash_report();
+  ASSERT_EQ(1000, mixed.keys);
+  ASSERT_EQ(mixed.buckets, clustered.buckets);
+  ASSERT_LT(mixed.collision_rate, 2 * mixed.expected_collision_rate);
+  ASSERT_GT(clustered.collision_rate, mixed.collision_rate);
+}
+
+// hash policy that sends every key to bucket 0 of a small table but
+// keeps their hash codes distinct
+template <typename K>
+struct HighBitsHash
+{
+  std::uint64_t operator()(const K &key, std::uint64_t) const
+  {
+    std::hash<K> hash_code;
+    return (hash_code(key) | 1) << 32;
+  }
+};
+
+TEST(BasicHashMapTests, CachedHashCodeCheck)
+{
+  ASSERT_EQ(true, cache_hash_code<std::string>::value);
+  ASSERT_EQ(false, cache_hash_code<int>::value);
+  HashMap<std::string, int> cached;
+  HashMap<std::string, int, HeapAllocator, WyHash<std::string>, false> plain;
+  cached.set_incremental_rehash(true);
+  for (int i = 0; i < 2000; ++i) {
+    cached.insert("key" + std::to_string(i), i);
+    plain.insert("key" + std::to_string(i), i);
+  }
+  for (int i = 0; i < 2000; i += 2) {
+    cached.erase("key" + std::to_string(i));
+    plain.erase("key" + std::to_string(i));
+  }
+  HashMap<std::string, int> copy(cached);
+  for (int i = 0; i < 2000; ++i) {
+    std::string key = "key" + std::to_string(i);
+    ASSERT_EQ(i % 2 == 1, cached.contains(key));
+    ASSERT_EQ(i % 2 == 1, plain.contains(key));
+    ASSERT_EQ(i % 2 == 1, copy.contains(key));
+  }
+  ASSERT_EQ(1999, copy["key1999"]);
+  // one long chain: the codes differ even though the bucket is shared
+  HashMap<std::string, int, HeapAllocator, HighBitsHash<std::string>> chain;
+  for (int i = 0; i < 200; ++i)
+    chain.insert(std::to_string(i), i);
+  ASSERT_EQ(200, chain.max_chain_length());
+  for (int i = 0; i < 200; ++i)
+    ASSERT_EQ(i, chain[std::to_string(i)]);
+  ASSERT_EQ(false, chain.contains("200"));
+  chain.erase("100");
+  ASSERT_EQ(false, chain.contains("100"));
+  ASSERT_EQ(199, chain.size());
+}
+
+TEST(BasicHashMapTests, BatchLookupCheck)
+{
+  HashMap<int, int> m;
+  m.set_incremental_rehash(true);
+  for (int i = 0; i < 800; ++i)
+    m.insert(i * 2, i);
+  // lookups span both tables while the last resize is still migrating
+  ASSERT_EQ(true, m.rehashing());
+  int keys[101];
+  for (int i = 0; i < 101; ++i)
+    keys[i] = i * 3;
+  bool found[101];
+  int values[101];
+  m.contains_many(keys, 101, found);
+  for (int i = 0; i < 101; ++i)
+    ASSERT_EQ(keys[i] % 2 == 0, found[i]);
+  ASSERT_EQ(51, m.get_many(keys, 101, values, found));
+  for (int i = 0; i < 101; i += 2)
+    ASSERT_EQ(i * 3 / 2, values[i]);
+  m.contains_many(keys, 0, found);
+  HashMap<std::string, int> s;
+  s.insert("a", 1);
+  s.insert("b", 2);
+  std::string names[3] = {"b", "c", "a"};
+  std::string *name_ptr = names;
+  ASSERT_EQ(2, s.get_many(name_ptr, 3, values, found));
+  ASSERT_EQ(2, values[0]);
+  ASSERT_EQ(false, found[1]);
+  ASSERT_EQ(1, values[2]);
+}
+
+TEST(BasicHashMapTests, OrderedIndexCheck)
+{
+  HashMap<int, int> m;
+  for (int i = 0; i < 50; ++i)
+    m.insert(i * 10, i);
+  m.set_ordered_index(true);
+  ASSERT_EQ(true, m.ordered_index());
+  for (int i = 50; i < 100; ++i)
+    m.insert(i * 10, i);
+  m.erase(500);
+  int key = 0;
+  ASSERT_EQ(true, m.next_key(495, key));
+  ASSERT_EQ(510, key);
+  ASSERT_EQ(true, m.prev_key(510, key));
+  ASSERT_EQ(490, key);
+  ASSERT_EQ(false, m.next_key(990, key));
+  ASSERT_EQ(false, m.prev_key(0, key));
+  ArraySeq<int> keys = m.find_keys(480, 530);
+  ASSERT_EQ(5, keys.size());
+  ASSERT_EQ(480, keys[0]);
+  ASSERT_EQ(510, keys[2]);
+  keys = m.sorted_keys();
+  ASSERT_EQ(99, keys.size());
+  for (int i = 1; i < keys.size(); ++i)
+    ASSERT_LT(keys[i - 1], keys[i]);
+  // the index travels with copies and moves and empties with clear
+  HashMap<int, int> copy(m);
+  HashMap<int, int> moved(std::move(m));
+  ASSERT_EQ(true, copy.next_key(495, key));
+  ASSERT_EQ(510, key);
+  ASSERT_EQ(99, moved.sorted_keys().size());
+  copy.clear();
+  ASSERT_EQ(0, copy.sorted_keys().size());
+  ASSERT_EQ(false, copy.next_key(0, key));
+  // answers match the full scan once the index is off
+  moved.set_ordered_index(false);
+  ASSERT_EQ(5, moved.find_keys(480, 530).size());
+  ASSERT_EQ(true, moved.next_key(495, key));
+  ASSERT_EQ(510, key);
+}
+
+TEST(BasicHashMapTests, LoadFactorPolicyCheck)
+{
+  HashMap<int, int> m;
+  ASSERT_EQ(16, m.bucket_count());
+  m.reserve(1000);
+  ASSERT_EQ(2048, m.bucket_count());
+  for (int i = 0; i < 1000; ++i)
+    m.insert(i, i);
+  ASSERT_EQ(2048, m.bucket_count());
+  // a denser table after shrink_to_fit
+  m.set_max_load_factor(2.0);
+  m.shrink_to_fit();
+  ASSERT_EQ(512, m.bucket_count());
+  ASSERT_EQ(999, m[999]);
+  // a sparser one grows right away
+  m.set_max_load_factor(0.5);
+  ASSERT_EQ(2048, m.bucket_count());
+  ASSERT_LT(m.min_load_factor(), 0.25);
+  // erases shrink the table once it falls below the low-water mark
+  m.set_min_load_factor(0.1);
+  for (int i = 0; i < 990; ++i)
+    m.erase(i);
+  ASSERT_GT(2048, m.bucket_count());
+  for (int i = 990; i < 1000; ++i)
+    ASSERT_EQ(i, m[i]);
+  m.clear();
+  m.shrink_to_fit();
+  ASSERT_EQ(16, m.bucket_count());
+  ASSERT_THROW(m.set_max_load_factor(0.0), std::out_of_range);
+  ASSERT_THROW(m.set_min_load_factor(0.3), std::out_of_range);
+  ASSERT_THROW(m.set_min_load_factor(-1.0), std::out_of_range);
+  // turning the low-water mark off keeps the peak size
+  HashMap<int, int> keep;
+  keep.set_min_load_factor(0.0);
+  keep.set_incremental_rehash(true);
+  for (int i = 0; i < 1000; ++i)
+    keep.insert(i, i);
+  int peak = keep.bucket_count();
+  for (int i = 0; i < 1000; ++i)
+    keep.erase(i);
+  ASSERT_EQ(peak, keep.bucket_count());
+}
+
+TEST(BasicHashMapTests, ChainStatsCheck)
+{
+  // the identity hash puts multiples of 16 in bucket 0
+  HashMap<int, int, HeapAllocator, StdHash<int>> m;
+  m.insert(0, 0);
+  m.insert(16, 16);
+  m.insert(32, 32);
+  m.insert(1, 1);
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    // counted by walking the table, then from the tracked histogram
+    m.set_chain_tracking(pass == 1);
+    ChainStats stats = m.chain_stats();
+    ASSERT_EQ(16, stats.buckets);
+    ASSERT_EQ(14, stats.empty_buckets);
+    ASSERT_EQ(4, stats.keys);
+    ASSERT_EQ(4, stats.histogram.size());
+    ASSERT_EQ(14, stats.histogram[0]);
+    ASSERT_EQ(1, stats.histogram[1]);
+    ASSERT_EQ(0, stats.histogram[2]);
+    ASSERT_EQ(1, stats.histogram[3]);
+    ASSERT_EQ(1, stats.min_length);
+    ASSERT_EQ(1, stats.p50_length);
+    ASSERT_EQ(3, stats.p99_length);
+    ASSERT_EQ(3, stats.max_length);
+    ASSERT_DOUBLE_EQ(14.0 / 16, stats.empty_ratio);
+    ASSERT_DOUBLE_EQ(0.25, stats.mean_length);
+    ASSERT_DOUBLE_EQ(2.0, stats.mean_used_length);
+    ASSERT_EQ(1, m.min_chain_length());
+    ASSERT_EQ(3, m.max_chain_length());
+    ASSERT_DOUBLE_EQ(2.0, m.avg_chain_length());
+  }
+  m.erase(16);
+  ASSERT_EQ(2, m.max_chain_length());
+  ASSERT_EQ(3, m.chain_stats().histogram.size());
+  // the tracked histogram matches a walk of the table through grows,
+  // an incremental rehash, shrinks, copies, moves and clear
+  auto same = [](HashMap<int, int> &tracked)
+  {
+    ChainStats s = tracked.chain_stats();
+    int shortest = tracked.min_chain_length();
+    double average = tracked.avg_chain_length();
+    tracked.set_chain_tracking(false);
+    ChainStats walked = tracked.chain_stats();
+    tracked.set_chain_tracking(true);
+    bool equal = s.histogram.size() == walked.histogram.size() && s.buckets == walked.buckets &&
+                 s.max_length == tracked.max_chain_length() && shortest == walked.min_length &&
+                 average == walked.mean_used_length;
+    for (int length = 0; equal && length < s.histogram.size(); ++length)
+    {
+      equal = s.histogram[length] == walked.histogram[length];
+    }
+    return equal;
+  };
+  HashMap<int, int> n;
+  ASSERT_EQ(true, n.chain_tracking());
+  n.set_incremental_rehash(true);
+  bool seen_rehash = false;
+  for (int i = 0; i < 2000; ++i)
+  {
+    n.insert(i, i);
+    seen_rehash = seen_rehash || n.rehashing();
+    ASSERT_TRUE(same(n));
+  }
+  ASSERT_TRUE(seen_rehash);
+  for (int i = 0; i < 1990; ++i)
+  {
+    n.erase(i);
+    ASSERT_TRUE(same(n));
+  }
+  HashMap<int, int> copy(n);
+  ASSERT_TRUE(same(copy));
+  HashMap<int, int> moved(std::move(copy));
+  ASSERT_TRUE(same(moved));
+  ASSERT_TRUE(same(copy));
+  ASSERT_EQ(0, copy.max_chain_length());
+  n.clear();
+  ASSERT_TRUE(same(n));
+  ASSERT_EQ(1, n.chain_stats().histogram.size());
+  // turning tracking on partway through a migration
+  HashMap<int, int> late;
+  late.set_chain_tracking(false);
+  late.set_incremental_rehash(true);
+  for (int i = 0; !late.rehashing(); ++i)
+  {
+    late.insert(i, i);
+  }
+  late.set_chain_tracking(true);
+  ASSERT_TRUE(same(late));
+  for (int i = 0; late.rehashing(); ++i)
+  {
+    late.insert(-1 - i, i);
+    ASSERT_TRUE(same(late));
+  }
+  // the steps of a migration, including the last one, keep the
+  // histogram up to date chain by chain (same recounts it, so it is
+  // only checked once the migration is over)
+  HashMap<int, int> steps;
+  steps.set_incremental_rehash(true);
+  int key = 0;
+  while (steps.bucket_count() < 4096 || !steps.rehashing())
+  {
+    steps.insert(key, key);
+    key++;
+  }
+  ASSERT_TRUE(same(steps));
+  while (steps.rehashing())
+  {
+    steps.insert(key, key);
+    key++;
+  }
+  ASSERT_TRUE(same(steps));
+}
+
+TEST(BasicHashMapTests, AssignCheck)
+{
+  ArraySeq<int> keys, vals;
+  for (int i = 0; i < 5000; ++i) {
+    keys.insert(i % 4000, i);
+    vals.insert(i, i);
+  }
+  HashMap<int, int> m1(keys, vals);
+  ASSERT_EQ(4000, m1.size());
+  for (int i = 0; i < 4000; ++i)
+    ASSERT_EQ(i, m1[i]);
+  // sized for every pair up front
+  ASSERT_LE(5000 / 0.75, m1.bucket_count());
+  // the ordered index and chain tracking stay in step
+  HashMap<int, int> m2;
+  m2.set_ordered_index(true);
+  m2.set_chain_tracking(true);
+  m2.insert(-5, 0);
+  m2.assign(keys, vals);
+  ASSERT_EQ(4000, m2.size());
+  ASSERT_EQ(false, m2.contains(-5));
+  int k = 0;
+  ASSERT_EQ(true, m2.next_key(10, k));
+  ASSERT_EQ(11, k);
+  ASSERT_EQ(4000, m2.chain_stats().keys);
+  m2.set_chain_tracking(false);
+  ASSERT_EQ(4000, m2.chain_stats().keys);
+  // other maps keep the first pair too
+  CuckooMap<int, int> m3;
+  FlatHashMap<int, int> m4;
+  m3.assign(keys, vals);
+  m4.assign(keys, vals);
+  ASSERT_EQ(4000, m3.size());
+  ASSERT_EQ(4000, m4.size());
+  ASSERT_EQ(3999, m3[3999]);
+  ASSERT_EQ(3999, m4[3999]);
+  vals.erase(0);
+  ASSERT_THROW(m1.assign(keys, vals), std::out_of_range);
+}
+
+TEST(BasicHashMapTests, ParallelRehashCheck)
+{
+  HashMap<int, int> m1;
+  HashMap<int, int> m2;
+  ASSERT_EQ(1, m1.rehash_threads());
+  ASSERT_THROW(m1.set_rehash_threads(0), std::out_of_range);
+  m1.set_rehash_threads(4);
+  m2.set_rehash_threads(3);
+  m2.set_chain_tracking(true);
+  m2.set_incremental_rehash(true);
+  // grows past PARALLEL_REHASH_MIN buckets a few times
+  for (int i = 0; i < 300000; ++i) {
+    m1.insert(i, i);
+    m2.insert(i, -i);
+  }
+  int parallel_min = HashMap<int, int>::PARALLEL_REHASH_MIN;
+  ASSERT_LT(4 * parallel_min, m1.bucket_count());
+  for (int i = 0; i < 300000; ++i) {
+    ASSERT_EQ(i, m1[i]);
+    ASSERT_EQ(-i, m2[i]);
+  }
+  ChainStats tracked = m2.chain_stats();
+  m2.set_chain_tracking(false);
+  ChainStats walked = m2.chain_stats();
+  ASSERT_EQ(300000, tracked.keys);
+  ASSERT_EQ(walked.max_length, tracked.max_length);
+  for (int i = 0; i < walked.histogram.size(); ++i)
+    ASSERT_EQ(walked.histogram[i], tracked.histogram[i]);
+  // erases shrink the table on several threads too
+  for (int i = 0; i < 295000; ++i)
+    m1.erase(i);
+  ASSERT_EQ(5000, m1.size());
+  ASSERT_GT(parallel_min, m1.bucket_count());
+  for (int i = 295000; i < 300000; ++i)
+    ASSERT_EQ(true, m1.contains(i));
+  HashMap<int, int> m3(m1);
+  ASSERT_EQ(4, m3.rehash_threads());
+}
+
+TEST(BasicHashMapTests, TransparentLookupCheck)
+{
+  ASSERT_EQ(true, is_transparent_hash<WyHash<string>>::value);
+  ASSERT_EQ(false, is_transparent_hash<HighBitsHash<string>>::value);
+  HashMap<string, int> m1;
+  HashMap<string, int, HeapAllocator, Xxh3Hash<string>, false> m2;
+  m1.set_ordered_index(true);
+  for (int i = 0; i < 1000; ++i) {
+    string key = "a-long-enough-key-" + to_string(i);
+    m1.insert(key, i);
+    m2.insert(key, i);
+  }
+  // string_view and C strings hash to the same codes as the keys
+  string text = "a-long-enough-key-420 and more";
+  string_view view(text.data(), 21);
+  ASSERT_EQ(WyHash<string>()(string(view), 1), WyHash<string>()(view, 1));
+  ASSERT_EQ(true, m1.contains(view));
+  ASSERT_EQ(true, m2.contains(view));
+  ASSERT_EQ(420, m1[view]);
+  ASSERT_EQ(420, m2["a-long-enough-key-420"]);
+  ASSERT_EQ(false, m1.contains("a-long-enough-key-1000"));
+  ASSERT_THROW(m2[string_view("a-long")], std::out_of_range);
+  m2[view] = 7;
+  const HashMap<string, int>& c1 = m1;
+  ASSERT_EQ(420, c1[view]);
+  // erasing by view also updates the ordered index, and shrinks the
+  // table as usual
+  for (int i = 0; i < 1000; ++i) {
+    string key = "a-long-enough-key-" + to_string(i);
+    if (i % 10 != 0) {
+      m1.erase(string_view(key));
+      m2.erase(key.c_str());
+    }
+  }
+  ASSERT_THROW(m1.erase("a-long-enough-key-421"), std::out_of_range);
+  ASSERT_EQ(100, m1.size());
+  ASSERT_EQ(100, m2.size());
+  ASSERT_EQ(7, m2[view]);
+  ArraySeq<string> keys;
+  keys = m1.find_keys("a-long-enough-key-0", "a-long-enough-key-2");
+  ASSERT_EQ(12, keys.size());
+  // a policy without is_transparent still takes K only
+  HashMap<string, int, HeapAllocator, HighBitsHash<string>> m3;
+  m3.insert("abc", 1);
+  ASSERT_EQ(true, m3.contains("abc"));
+  // as does a type that only converts to the key type
+  ASSERT_EQ(true, m1.contains(KeyName{"a-long-enough-key-0"}));
+  ASSERT_EQ(true, m3.contains(KeyName{"abc"}));
+}
+
+//----------------------------------------------------------------------
+// Basic Tests for the FlatHashMap implementation of Map
+//----------------------------------------------------------------------
+
+TEST(BasicFlatHashMapTests, InsertAccessCheck)
+{
+  FlatHashMap<char, int> m;
+  ASSERT_EQ(true, m.empty());
+  m.insert('a', 10);
+  m.insert('b', 20);
+  m.insert('c', 30);
+  ASSERT_EQ(3, m.size());
+  ASSERT_EQ(10, m['a']);
+  ASSERT_EQ(20, m['b']);
+  m['c'] = 35;
+  ASSERT_EQ(35, m['c']);
+  ASSERT_EQ(false, m.contains('d'));
+}
+
+TEST(BasicFlatHashMapTests, GrowAndEraseCheck)
+{
+  FlatHashMap<int, int> m;
+  for (int i = 0; i < 1000; ++i)
+    m.insert(i * 2, i);
+  ASSERT_EQ(1000, m.size());
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(true, m.contains(i * 2));
+    ASSERT_EQ(false, m.contains(i * 2 + 1));
+  }
+  for (int i = 0; i < 1000; i += 2)
+    m.erase(i * 2);
+  ASSERT_EQ(500, m.size());
+  for (int i = 0; i < 1000; ++i)
+    ASSERT_EQ(i % 2 == 1, m.contains(i * 2));
+  // reuse erased slots
+  for (int i = 0; i < 1000; i += 2)
+    m.insert(i * 2, i);
+  ASSERT_EQ(1000, m.size());
+  ASSERT_EQ(998, m[1996]);
+}
+
+TEST(BasicFlatHashMapTests, InvalidKeyCheck)
+{
+  FlatHashMap<char, int> m;
+  int x = 10;
+  EXPECT_THROW(m['a'] = x, std::out_of_range);
+  EXPECT_THROW(m.erase('a'), std::out_of_range);
+  m.insert('a', 10);
+  m.erase('a');
+  EXPECT_THROW(x = m['a'], std::out_of_range);
+  EXPECT_THROW(m.erase('a'), std::out_of_range);
+}
+
+TEST(BasicFlatHashMapTests, KeyOrderCheck)
+{
+  FlatHashMap<char, int> m;
+  m.insert('e', 50);
+  m.insert('a', 10);
+  m.insert('c', 30);
+  m.insert('d', 40);
+  m.insert('h', 80);
+  ArraySeq<char> k = m.sorted_keys();
+  ASSERT_EQ(5, k.size());
+  ASSERT_EQ('a', k[0]);
+  ASSERT_EQ('h', k[4]);
+  k = m.find_keys('b', 'e');
+  ASSERT_EQ(3, k.size());
+  char key = 0;
+  ASSERT_EQ(true, m.next_key('e', key));
+  ASSERT_EQ('h', key);
+  ASSERT_EQ(true, m.prev_key('c', key));
+  ASSERT_EQ('a', key);
+  ASSERT_EQ(false, m.next_key('h', key));
+}
+
+TEST(BasicFlatHashMapTests, CopyAndMoveCheck)
+{
+  FlatHashMap<string, int> m1;
+  for (int i = 0; i < 100; ++i)
+    m1.insert(to_string(i), i);
+  FlatHashMap<string, int> m2(m1);
+  m2.erase("50");
+  ASSERT_EQ(100, m1.size());
+  ASSERT_EQ(99, m2.size());
+  ASSERT_EQ(true, m1.contains("50"));
+  FlatHashMap<string, int> m3(std::move(m2));
+  ASSERT_EQ(0, m2.size());
+  ASSERT_EQ(99, m3.size());
+  ASSERT_EQ(42, m3["42"]);
+  m2 = m1;
+  ASSERT_EQ(100, m2.size());
+  m1.clear();
+  ASSERT_EQ(0, m1.size());
+  ASSERT_EQ(false, m1.contains("1"));
+  ASSERT_EQ(true, m2.contains("1"));
+}
+
+//----------------------------------------------------------------------
+// Basic Tests for the RobinHoodMap implementation of Map
+//----------------------------------------------------------------------
+
+TEST(BasicRobinHoodMapTests, InsertAccessCheck)
+{
+  RobinHoodMap<char, int> m;
+  ASSERT_EQ(true, m.empty());
+  m.insert('a', 10);
+  m.insert('b', 20);
+  m.insert('c', 30);
+  ASSERT_EQ(3, m.size());
+  ASSERT_EQ(10, m['a']);
+  m['b'] = 25;
+  ASSERT_EQ(25, m['b']);
+  ASSERT_EQ(false, m.contains('d'));
+  EXPECT_THROW(m.erase('d'), std::out_of_range);
+}
+
+TEST(BasicRobinHoodMapTests, BackwardShiftEraseCheck)
+{
+  RobinHoodMap<int, int> m;
+  for (int i = 0; i < 2000; ++i)
+    m.insert(i, i * 10);
+  ASSERT_EQ(2000, m.size());
+  for (int i = 0; i < 2000; i += 3)
+    m.erase(i);
+  for (int i = 0; i < 2000; ++i) {
+    ASSERT_EQ(i % 3 != 0, m.contains(i));
+    if (i % 3 != 0) {
+      ASSERT_EQ(i * 10, m[i]);
+    }
+  }
+  // no tombstones left behind
+  m.clear();
+  ASSERT_EQ(0, m.size());
+  ASSERT_EQ(0, m.max_probe_distance());
+}
+
+TEST(BasicRobinHoodMapTests, ProbeDistanceCheck)
+{
+  RobinHoodMap<int, int> m;
+  ASSERT_EQ(0, m.max_probe_distance());
+  ASSERT_EQ(0.0, m.avg_probe_distance());
+  for (int i = 0; i < 10000; ++i)
+    m.insert(i * 2, i);
+  ASSERT_EQ(0, m.min_probe_distance());
+  ASSERT_LE(m.avg_probe_distance(), 3.0);
+  ASSERT_LE(m.avg_probe_distance(), m.max_probe_distance());
+}
+
+TEST(BasicRobinHoodMapTests, CopyAndMoveCheck)
+{
+  RobinHoodMap<string, int> m1;
+  for (int i = 0; i < 100; ++i)
+    m1.insert(to_string(i), i);
+  RobinHoodMap<string, int> m2(m1);
+  m2.erase("7");
+  ASSERT_EQ(100, m1.size());
+  ASSERT_EQ(99, m2.size());
+  RobinHoodMap<string, int> m3(std::move(m2));
+  ASSERT_EQ(0, m2.size());
+  ASSERT_EQ(99, m3.size());
+  ASSERT_EQ(false, m3.contains("7"));
+  ArraySeq<string> k = m3.find_keys("8", "9");
+  ASSERT_EQ(12, k.size());
+}
+
+//----------------------------------------------------------------------
+// Basic Tests for the CuckooMap implementation of Map
+//----------------------------------------------------------------------
+
+TEST(BasicCuckooMapTests, InsertAccessCheck)
+{
+  CuckooMap<char, int> m;
+  ASSERT_EQ(true, m.empty());
+  m.insert('a', 10);
+  m.insert('b', 20);
+  m.insert('c', 30);
+  m.insert('a', 40);
+  ASSERT_EQ(3, m.size());
+  ASSERT_EQ(10, m['a']);
+  m['b'] = 25;
+  ASSERT_EQ(25, m['b']);
+  ASSERT_EQ(false, m.contains('d'));
+  EXPECT_THROW(m['d'], std::out_of_range);
+  EXPECT_THROW(m.erase('d'), std::out_of_range);
+  char k = 0;
+  ASSERT_EQ(true, m.next_key('a', k));
+  ASSERT_EQ('b', k);
+  ASSERT_EQ(true, m.prev_key('c', k));
+  ASSERT_EQ('b', k);
+}
+
+TEST(BasicCuckooMapTests, HighLoadCheck)
+{
+  // 4096 buckets of 4 slots filled to 97%
+  CuckooMap<int, int> m;
+  m.set_max_load_factor(0.98);
+  m.reserve(16000);
+  ASSERT_EQ(4096, m.bucket_count());
+  for (int i = 0; i < 15900; ++i)
+    m.insert(i * 3, i);
+  ASSERT_EQ(4096, m.bucket_count());
+  ASSERT_GT(m.load_factor(), 0.97);
+  ASSERT_LE(m.stash_size(), 4);
+  for (int i = 0; i < 15900; ++i) {
+    ASSERT_EQ(true, m.contains(i * 3));
+    ASSERT_EQ(i, m[i * 3]);
+    ASSERT_EQ(false, m.contains(i * 3 + 1));
+  }
+  ASSERT_THROW(m.set_max_load_factor(1.0), std::out_of_range);
+  // past the point where two 4-way buckets can hold every key the
+  // table is rebuilt (and grown) instead of failing
+  CuckooMap<int, int> full;
+  full.set_max_load_factor(0.999);
+  for (int i = 0; i < 5000; ++i)
+    full.insert(i, i);
+  for (int i = 0; i < 5000; ++i)
+    ASSERT_EQ(i, full[i]);
+  ASSERT_EQ(5000, full.sorted_keys().size());
+}
+
+TEST(BasicCuckooMapTests, EraseCheck)
+{
+  CuckooMap<int, int> m;
+  m.set_max_load_factor(0.98);
+  for (int i = 0; i < 4000; ++i)
+    m.insert(i, i * 10);
+  for (int i = 0; i < 4000; i += 3)
+    m.erase(i);
+  for (int i = 0; i < 4000; ++i) {
+    ASSERT_EQ(i % 3 != 0, m.contains(i));
+    if (i % 3 != 0) {
+      ASSERT_EQ(i * 10, m[i]);
+    }
+  }
+  // erased slots are reused
+  int buckets = m.bucket_count();
+  for (int i = 0; i < 4000; i += 3)
+    m.insert(i, i);
+  ASSERT_EQ(4000, m.size());
+  ASSERT_EQ(buckets, m.bucket_count());
+  m.clear();
+  ASSERT_EQ(0, m.size());
+  ASSERT_EQ(0, m.stash_size());
+  ASSERT_EQ(false, m.contains(1));
+}
+
+TEST(BasicCuckooMapTests, CopyAndMoveCheck)
+{
+  CuckooMap<string, int> m1;
+  for (int i = 0; i < 100; ++i)
+    m1.insert(to_string(i), i);
+  CuckooMap<string, int> m2(m1);
+  m2.erase("7");
+  ASSERT_EQ(100, m1.size());
+  ASSERT_EQ(99, m2.size());
+  CuckooMap<string, int> m3(std::move(m2));
+  ASSERT_EQ(0, m2.size());
+  ASSERT_EQ(99, m3.size());
+  ASSERT_EQ(false, m3.contains("7"));
+  ASSERT_EQ(42, m3["42"]);
+  ArraySeq<string> k = m3.find_keys("8", "9");
+  ASSERT_EQ(12, k.size());
+  m2 = m3;
+  ASSERT_EQ(99, m2.size());
+}
+
+//----------------------------------------------------------------------
+// Basic Tests for the FrozenHashMap
+//----------------------------------------------------------------------
+
+TEST(BasicFrozenHashMapTests, BuildFromMapCheck)
+{
+  HashMap<int, int> m;
+  for (int i = 0; i < 10000; ++i)
+    m.insert(i * 7, i);
+  FrozenHashMap<int, int> f(m);
+  ASSERT_EQ(10000, f.size());
+  ASSERT_EQ(false, f.empty());
+  for (int i = 0; i < 10000; ++i) {
+    ASSERT_EQ(true, f.contains(i * 7));
+    ASSERT_EQ(i, f[i * 7]);
+  }
+  for (int i = 0; i < 10000; ++i)
+    ASSERT_EQ(false, f.contains(i * 7 + 1));
+  ASSERT_THROW(f[3], std::out_of_range);
+  ArraySeq<int> keys = f.sorted_keys();
+  ASSERT_EQ(10000, keys.size());
+  for (int i = 0; i < 10000; ++i)
+    ASSERT_EQ(i * 7, keys[i]);
+  ASSERT_EQ(10000 / 4 + 1, f.bucket_count());
+}
+
+TEST(BasicFrozenHashMapTests, BuildFromArraysCheck)
+{
+  // small and empty builds, then strings from an AVL map
+  FrozenHashMap<int, int> empty;
+  ASSERT_EQ(true, empty.empty());
+  ASSERT_EQ(false, empty.contains(0));
+  ASSERT_THROW(empty[0], std::out_of_range);
+  for (int n = 0; n < 40; ++n) {
+    int keys[40];
+    int values[40];
+    for (int i = 0; i < n; ++i) {
+      keys[i] = i * 1000003;
+      values[i] = -i;
+    }
+    FrozenHashMap<int, int> f(keys, values, n);
+    ASSERT_EQ(n, f.size());
+    for (int i = 0; i < n; ++i)
+      ASSERT_EQ(-i, f[keys[i]]);
+    ASSERT_EQ(false, f.contains(1));
+  }
+  AVLMap<string, int> a;
+  for (int i = 0; i < 500; ++i)
+    a.insert(to_string(i), i);
+  FrozenHashMap<string, int> s(a);
+  ASSERT_EQ(500, s.size());
+  ASSERT_EQ(42, s["42"]);
+  ASSERT_EQ(false, s.contains("500"));
+}
+
+TEST(BasicFrozenHashMapTests, DuplicateKeyCheck)
+{
+  int keys[] = {1, 2, 3, 2};
+  int values[] = {1, 2, 3, 4};
+  ASSERT_THROW((FrozenHashMap<int, int>(keys, values, 4)), std::invalid_argument);
+  FrozenHashMap<int, int> f(keys, values, 3);
+  ASSERT_EQ(3, f.size());
+}
+
+TEST(BasicFrozenHashMapTests, CopyAndMoveCheck)
+{
+  HashMap<string, int> m;
+  for (int i = 0; i < 100; ++i)
+    m.insert(to_string(i), i);
+  FrozenHashMap<string, int> f1(m);
+  FrozenHashMap<string, int> f2(f1);
+  ASSERT_EQ(100, f2.size());
+  ASSERT_EQ(7, f2["7"]);
+  FrozenHashMap<string, int> f3(std::move(f2));
+  ASSERT_EQ(0, f2.size());
+  ASSERT_EQ(false, f2.contains("7"));
+  ASSERT_EQ(100, f3.size());
+  ASSERT_EQ(99, f3["99"]);
+  f2 = f3;
+  ASSERT_EQ(100, f2.size());
+  ASSERT_EQ(f1.table_bytes(), f2.table_bytes());
+  f1 = FrozenHashMap<string, int>();
+  ASSERT_EQ(0, f1.size());
+  ASSERT_EQ(true, f2.contains("0"));
+}
+
+//----------------------------------------------------------------------
+// Basic Tests for the BlockedBloomFilter and BloomFilteredMap
+//----------------------------------------------------------------------
+
+TEST(BasicBloomFilterTests, NoFalseNegativesCheck)
+{
+  BlockedBloomFilter<int> f(10000);
+  ASSERT_EQ(10000, f.capacity());
+  ASSERT_EQ(10000 * 12 / 512 + 1, f.block_count());
+  for (int i = 0; i < 10000; ++i)
+    ASSERT_EQ(false, f.might_contain(i * 2));
+  for (int i = 0; i < 10000; ++i)
+    f.add(i * 2);
+  ASSERT_EQ(10000, f.added());
+  for (int i = 0; i < 10000; ++i)
+    ASSERT_EQ(true, f.might_contain(i * 2));
+  int passed = 0;
+  for (int i = 0; i < 100000; ++i)
+    passed += f.might_contain(i * 2 + 1);
+  // about 1% at 12 bits per key
+  ASSERT_GT(3000, passed);
+  ASSERT_GT(0.03, f.expected_fpr());
+  ASSERT_LT(0.0, f.fill_ratio());
+  BlockedBloomFilter<int> g(f);
+  f.clear();
+  ASSERT_EQ(false, f.might_contain(2));
+  ASSERT_EQ(true, g.might_contain(2));
+  ASSERT_THROW(BlockedBloomFilter<int>(-1), std::out_of_range);
+}
+
+TEST(BasicBloomFilteredMapTests, WrappedMapsCheck)
+{
+  BloomFilteredMap<int, int, HashMap<int, int>> m1;
+  BloomFilteredMap<int, int, AVLMap<int, int>> m2;
+  BloomFilteredMap<int, int, BinSearchMap<int, int>> m3;
+  for (int i = 0; i < 2000; ++i) {
+    m1.insert(i * 2, i);
+    m2.insert(i * 2, i);
+    m3.insert(i * 2, i);
+  }
+  ASSERT_EQ(2000, m1.size());
+  ASSERT_EQ(2000, m2.wrapped().size());
+  ASSERT_EQ(false, m3.empty());
+  for (int i = 0; i < 2000; ++i) {
+    ASSERT_EQ(true, m1.contains(i * 2));
+    ASSERT_EQ(true, m2.contains(i * 2));
+    ASSERT_EQ(i, m3[i * 2]);
+    ASSERT_EQ(false, m1.contains(i * 2 + 1));
+    ASSERT_EQ(false, m2.contains(i * 2 + 1));
+    ASSERT_EQ(false, m3.contains(i * 2 + 1));
+  }
+  ASSERT_THROW(m1[1], std::out_of_range);
+  ASSERT_THROW(m2[1], std::out_of_range);
+  m3[4] = 40;
+  ASSERT_EQ(40, m3[4]);
+  ASSERT_EQ(4, m2.find_keys(10, 16).size());
+  int k = 0;
+  ASSERT_EQ(true, m2.next_key(10, k));
+  ASSERT_EQ(12, k);
+  ASSERT_EQ(true, m1.prev_key(10, k));
+  ASSERT_EQ(8, k);
+  ASSERT_EQ(2000, m1.sorted_keys().size());
+}
+
+TEST(BasicBloomFilteredMapTests, RebuildAndStatsCheck)
+{
+  BloomFilteredMap<int, int, HashMap<int, int>> m;
+  ASSERT_EQ(0, m.bits_per_key());
+  for (int i = 0; i < 1000; ++i)
+    m.insert(i, i);
+  // the filter grows with the map
+  ASSERT_LE(1000, m.bloom_filter().capacity());
+  ASSERT_LE(12.0, m.bits_per_key());
+  for (int i = 1000; i < 11000; ++i)
+    ASSERT_EQ(false, m.contains(i));
+  ASSERT_LT(9000, m.filtered_lookups());
+  ASSERT_GT(0.1, m.false_positive_rate());
+  m.reset_stats();
+  ASSERT_EQ(0, m.filtered_lookups());
+  ASSERT_EQ(0, m.false_positive_rate());
+  // erased keys are dropped from the filter once they outnumber the rest
+  for (int i = 0; i < 600; ++i)
+    m.erase(i);
+  ASSERT_THROW(m.erase(0), std::out_of_range);
+  ASSERT_EQ(400, m.size());
+  // rebuilt on the 501st erase (501 stale keys to 499 live ones)
+  ASSERT_EQ(499, m.bloom_filter().added());
+  for (int i = 600; i < 1000; ++i)
+    ASSERT_EQ(true, m.contains(i));
+  for (int i = 0; i < 600; ++i)
+    ASSERT_EQ(false, m.contains(i));
+  BloomFilteredMap<int, int, HashMap<int, int>> m2(m);
+  m.clear();
+  ASSERT_EQ(true, m.empty());
+  ASSERT_EQ(false, m.contains(700));
+  ASSERT_EQ(true, m2.contains(700));
+  m.insert(1, 1);
+  ASSERT_EQ(true, m.contains(1));
+}
+
+//----------------------------------------------------------------------
+// Basic Tests for the ConcurrentHashMap
+//----------------------------------------------------------------------
+
+TEST(ConcurrentHashMapTests, SingleThreadCheck)
+{
+  ConcurrentHashMap<std::string, int> m;
+  ASSERT_EQ(true, m.empty());
+  ASSERT_EQ(true, m.insert_if_absent("a", 1));
+  ASSERT_EQ(false, m.insert_if_absent("a", 2));
+  ASSERT_EQ(1, m.at("a"));
+  ASSERT_EQ(true, m.update("a", 3));
+  ASSERT_EQ(false, m.update("b", 3));
+  int value = 0;
+  ASSERT_EQ(true, m.get("a", value));
+  ASSERT_EQ(3, value);
+  ASSERT_THROW(m.at("b"), std::out_of_range);
+  ASSERT_EQ(true, m.erase("a"));
+  ASSERT_EQ(false, m.erase("a"));
+  ASSERT_EQ(false, m.contains("a"));
+  for (int i = 0; i < 1000; ++i)
+    m.insert_if_absent(std::to_string(i), i);
+  ASSERT_EQ(1000, m.size());
+  ASSERT_LT(256, m.bucket_count());
+  ArraySeq<std::string> keys = m.sorted_keys();
+  ASSERT_EQ(1000, keys.size());
+  ASSERT_EQ("0", keys[0]);
+  m.clear();
+  ASSERT_EQ(true, m.empty());
+}
+
+TEST(ConcurrentHashMapTests, ParallelInsertCheck)
+{
+  // four threads insert overlapping ranges while the table grows
+  ConcurrentHashMap<int, int> m;
+  std::atomic<int> added(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.push_back(std::thread([&, t]() {
+      for (int i = t * 5000; i < t * 5000 + 10000; ++i)
+        if (m.insert_if_absent(i, i))
+          added++;
+    }));
+  }
+  for (std::thread &thread : threads)
+    thread.join();
+  ASSERT_EQ(25000, added.load());
+  ASSERT_EQ(25000, m.size());
+  for (int i = 0; i < 25000; ++i)
+    ASSERT_EQ(i, m.at(i));
+}
+
+TEST(ConcurrentHashMapTests, ParallelUpdateEraseCheck)
+{
+  ConcurrentHashMap<int, int> m;
+  for (int i = 0; i < 100; ++i) {
+    m.insert_if_absent(i, 0);
+    m.insert_if_absent(i + 1000, 0);
+  }
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.push_back(std::thread([&, t]() {
+      for (int r = 0; r < 100; ++r)
+        for (int i = 0; i < 100; ++i)
+          m.update_with(i, [](int &v) { v++; });
+      for (int i = t; i < 100; i += 4)
+        ASSERT_EQ(true, m.erase(i + 1000));
+    }));
+  }
+  for (std::thread &thread : threads)
+    thread.join();
+  for (int i = 0; i < 100; ++i)
+    ASSERT_EQ(400, m.at(i));
+  ASSERT_EQ(100, m.size());
+}
+
+//----------------------------------------------------------------------
+// Basic Tests for the EpochHashMap implementation of Map
+//----------------------------------------------------------------------
+
+TEST(EpochHashMapTests, MapSemanticsCheck)
+{
+  EpochHashMap<int, int> m;
+  ASSERT_EQ(true, m.empty());
+  for (int i = 0; i < 1000; ++i)
+    m.insert(i * 2, i);
+  m.insert(0, 99);
+  ASSERT_EQ(1000, m.size());
+  ASSERT_EQ(0, m[0]);
+  ASSERT_EQ(true, m.update(10, 50));
+  ASSERT_EQ(false, m.update(11, 50));
+  int value = 0;
+  ASSERT_EQ(true, m.get(10, value));
+  ASSERT_EQ(50, value);
+  m.erase(10);
+  ASSERT_EQ(false, m.contains(10));
+  ASSERT_THROW(m.erase(10), std::out_of_range);
+  ASSERT_THROW(m[11], std::out_of_range);
+  int next = 0;
+  ASSERT_EQ(true, m.next_key(8, next));
+  ASSERT_EQ(12, next);
+  ASSERT_EQ(true, m.prev_key(12, next));
+  ASSERT_EQ(8, next);
+  ASSERT_EQ(false, m.next_key(1998, next));
+  ASSERT_EQ(4, m.find_keys(4, 12).size());
+  ArraySeq<int> keys = m.sorted_keys();
+  ASSERT_EQ(999, keys.size());
+  ASSERT_EQ(1998, keys[998]);
+  EpochHashMap<int, int> copy(m);
+  m.clear();
+  ASSERT_EQ(true, m.empty());
+  ASSERT_EQ(999, copy.size());
+  ASSERT_EQ(500, copy[1000]);
+}
+
+TEST(EpochHashMapTests, ReadersDuringWritesCheck)
+{
+  // readers never see a torn value while a writer inserts (growing the
+  // table several times), updates, and erases
+  EpochHashMap<int, int> m;
+  std::atomic<bool> done(false);
+  std::atomic<int> bad(0);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; ++t) {
+    readers.push_back(std::thread([&]() {
+      while (!done.load()) {
+        for (int i = 0; i < 20000; i += 7) {
+          int value = 0;
+          if (m.get(i, value) && value != i && value != -i)
+            bad++;
+        }
+      }
+    }));
+  }
+  for (int i = 0; i < 20000; ++i)
+    m.insert(i, i);
+  for (int i = 0; i < 20000; i += 2)
+    m.update(i, -i);
+  for (int i = 1; i < 20000; i += 2)
+    m.erase(i);
+  done = true;
+  for (std::thread &reader : readers)
+    reader.join();
+  ASSERT_EQ(0, bad.load());
+  ASSERT_EQ(10000, m.size());
+  ASSERT_EQ(-100, m[100]);
+  ASSERT_LE(16384, m.bucket_count());
+}
+
+//----------------------------------------------------------------------
+// Basic Tests for the PersistentAVLMap implementation of Map
+//----------------------------------------------------------------------
+
+TEST(PersistentAVLMapTests, MapSemanticsCheck)
+{
+  PersistentAVLMap<int, int> m;
+  ASSERT_EQ(true, m.empty());
+  for (int i = 0; i < 1000; ++i)
+    m.insert(i * 2, i);
+  ASSERT_EQ(1000, m.size());
+  ASSERT_EQ(10, m.height());
+  ASSERT_EQ(5, m[10]);
+  m[10] = 50;
+  ASSERT_EQ(50, m[10]);
+  for (int i = 0; i < 2000; i += 4)
+    m.erase(i);
+  ASSERT_EQ(500, m.size());
+  ASSERT_EQ(false, m.contains(8));
+  ASSERT_THROW(m.erase(8), std::out_of_range);
+  ASSERT_THROW(m[8], std::out_of_range);
+  int next = 0;
+  ASSERT_EQ(true, m.next_key(2, next));
+  ASSERT_EQ(6, next);
+  ASSERT_EQ(true, m.prev_key(6, next));
+  ASSERT_EQ(2, next);
+  ASSERT_EQ(false, m.next_key(1998, next));
+  ASSERT_EQ(3, m.find_keys(1, 10).size());
+  ArraySeq<int> keys = m.sorted_keys();
+  ASSERT_EQ(500, keys.size());
+  ASSERT_EQ(1998, keys[499]);
+  ASSERT_LE(m.height(), 10);
+  m.clear();
+  ASSERT_EQ(true, m.empty());
+  ASSERT_EQ(0, m.live_nodes());
+}
+
+TEST(PersistentAVLMapTests, SnapshotCheck)
+{
+  PersistentAVLMap<int, int> m;
+  for (int i = 0; i < 1024; ++i)
+    m.insert(i, i);
+  // a snapshot and a copy share every node
+  PersistentAVLMap<int, int>::Snapshot s1 = m.snapshot();
+  PersistentAVLMap<int, int> m2(m);
+  ASSERT_EQ(1024, m.live_nodes());
+  // a write copies only its path (and rotations near it)
+  m.insert(5000, 1);
+  ASSERT_LE(m.live_nodes(), 1024 + 2 * m.height());
+  m.erase(0);
+  m[100] = -100;
+  m2.erase(1);
+  // every version still reads as it was
+  ASSERT_EQ(1024, s1.size());
+  ASSERT_EQ(true, s1.contains(0));
+  ASSERT_EQ(false, s1.contains(5000));
+  ASSERT_EQ(100, s1[100]);
+  ASSERT_EQ(-100, m[100]);
+  ASSERT_EQ(100, m2[100]);
+  ASSERT_EQ(true, m2.contains(0));
+  ASSERT_EQ(false, m2.contains(1));
+  ASSERT_EQ(1024, m.size());
+  int next = 0;
+  ASSERT_EQ(true, s1.next_key(1022, next));
+  ASSERT_EQ(1023, next);
+  ASSERT_EQ(1024, s1.sorted_keys().size());
+  // versions nothing refers to are freed
+  m2.clear();
+  s1 = PersistentAVLMap<int, int>::Snapshot();
+  ASSERT_EQ(1024, m.live_nodes());
+
+  // readers check snapshots while the map keeps changing: each
+  // snapshot holds the keys 0 to size() - 1, each with its own value
+  // or its negation
+  PersistentAVLMap<int, int> m3;
+  std::mutex lock;
+  PersistentAVLMap<int, int>::Snapshot latest;
+  std::atomic<bool> done(false);
+  std::atomic<int> bad(0);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 3; ++t) {
+    readers.push_back(std::thread([&]() {
+      while (!done.load()) {
+        PersistentAVLMap<int, int>::Snapshot s;
+        {
+          std::lock_guard<std::mutex> guard(lock);
+          s = latest;
+        }
+        for (int i = 0; i < s.size(); i += 7)
+          if (s[i] != i && s[i] != -i)
+            bad++;
+      }
+    }));
+  }
+  for (int i = 0; i < 20000; ++i) {
+    m3.insert(i, i);
+    m3[i / 2] = -(i / 2);
+    if (i % 100 == 0) {
+      PersistentAVLMap<int, int>::Snapshot s = m3.snapshot();
+      std::lock_guard<std::mutex> guard(lock);
+      latest = std::move(s);
+    }
+  }
+  done = true;
+  for (std::thread &reader : readers)
+    reader.join();
+  ASSERT_EQ(0, bad.load());
+  latest = PersistentAVLMap<int, int>::Snapshot();
+  ASSERT_EQ(1024 + 20000, m.live_nodes());
+}
+
+//----------------------------------------------------------------------
+// Basic Tests for the CompactAVLMap implementation of Map
+//----------------------------------------------------------------------
+
+TEST(CompactAVLMapTests, MapSemanticsCheck)
+{
+  CompactAVLMap<int, int> m;
+  ASSERT_EQ(true, m.empty());
+  ASSERT_EQ(0, m.height());
+  for (int i = 0; i < 1000; ++i)
+    m.insert(i * 2, i);
+  ASSERT_EQ(1000, m.size());
+  ASSERT_EQ(10, m.height());
+  m[10] = 50;
+  ASSERT_EQ(50, m[10]);
+  for (int i = 0; i < 2000; i += 4)
+    m.erase(i);
+  ASSERT_EQ(500, m.size());
+  ASSERT_LE(m.height(), 10);
+  ASSERT_EQ(false, m.contains(8));
+  ASSERT_THROW(m.erase(8), std::out_of_range);
+  ASSERT_THROW(m[8], std::out_of_range);
+  int next = 0;
+  ASSERT_EQ(true, m.next_key(2, next));
+  ASSERT_EQ(6, next);
+  ASSERT_EQ(true, m.prev_key(6, next));
+  ASSERT_EQ(2, next);
+  ASSERT_EQ(false, m.prev_key(2, next));
+  ASSERT_EQ(3, m.find_keys(1, 10).size());
+  ArraySeq<int> keys = m.sorted_keys();
+  ASSERT_EQ(500, keys.size());
+  for (int i = 0; i < keys.size(); ++i)
+    ASSERT_EQ(4 * i + 2, keys[i]);
+  // erase down to nothing and rebuild (rotations both ways)
+  for (int i = 0; i < keys.size(); i += 2)
+    m.erase(keys[i]);
+  for (int i = keys.size() - 1; i > 0; i -= 2)
+    m.erase(keys[i]);
+  ASSERT_EQ(true, m.empty());
+  for (int i = 1000; i > 0; --i)
+    m.insert(i, -i);
+  ASSERT_EQ(10, m.height());
+  ASSERT_EQ(-500, m[500]);
+}
+
+TEST(CompactAVLMapTests, ArenaCheck)
+{
+  CompactAVLMap<int, int> m1;
+  m1.reserve(1000);
+  long bytes = m1.arena_bytes();
+  ASSERT_LE(1000 * 16L, bytes);
+  for (int i = 0; i < 1000; ++i)
+    m1.insert(i, i);
+  // erased slots are reused before the arena grows
+  for (int i = 0; i < 500; ++i)
+    m1.erase(i);
+  for (int i = 0; i < 500; ++i)
+    m1.insert(i + 1000, i);
+  ASSERT_EQ(bytes, m1.arena_bytes());
+  ASSERT_EQ(1000, m1.size());
+  // bulk loads, copies, and moves
+  ArraySeq<int> keys, values;
+  for (int i = 99; i >= 0; --i) {
+    keys.insert(i, keys.size());
+    values.insert(i * 10, values.size());
+  }
+  keys.insert(5, keys.size());
+  values.insert(-1, values.size());
+  CompactAVLMap<int, int> m2(keys, values);
+  ASSERT_EQ(100, m2.size());
+  ASSERT_EQ(7, m2.height());
+  ASSERT_EQ(50, m2[5]);
+  CompactAVLMap<int, int> m3(m2);
+  m2.erase(5);
+  ASSERT_EQ(true, m3.contains(5));
+  CompactAVLMap<int, int> m4(std::move(m3));
+  ASSERT_EQ(100, m4.size());
+  ASSERT_EQ(true, m3.empty());
+  m3.insert(1, 1);
+  ASSERT_EQ(1, m3[1]);
+  m4.clear();
+  ASSERT_EQ(0, m4.height());
+  m4.insert(2, 2);
+  ASSERT_EQ(1, m4.size());
+}
+
+//----------------------------------------------------------------------
+// Basic Tests for the FrozenTreeMap
+//----------------------------------------------------------------------
+
+TEST(FrozenTreeMapTests, FreezeCheck)
+{
+  AVLMap<int, int> m;
+  for (int i = 0; i < 1000; ++i)
+    m.insert(i * 2, i);
+  FrozenTreeMap<int, int> f = m.freeze();
+  ASSERT_EQ(1000, f.size());
+  ASSERT_EQ(false, f.empty());
+  ASSERT_EQ(1001 * 8L, f.layout_bytes());
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(true, f.contains(i * 2));
+    ASSERT_EQ(i, f[i * 2]);
+    ASSERT_EQ(false, f.contains(i * 2 + 1));
+  }
+  ASSERT_THROW(f[-2], std::out_of_range);
+  ASSERT_THROW(f[3], std::out_of_range);
+  // next_key and prev_key agree with the live tree, including keys
+  // that are not in the map and keys past either end
+  for (int k = -2; k <= 2000; ++k) {
+    int expected = 0, actual = 0;
+    ASSERT_EQ(m.next_key(k, expected), f.next_key(k, actual));
+    ASSERT_EQ(expected, actual);
+    ASSERT_EQ(m.prev_key(k, expected), f.prev_key(k, actual));
+    ASSERT_EQ(expected, actual);
+  }
+  ASSERT_EQ(3, f.find_keys(1, 6).size());
+  ASSERT_EQ(4, f.find_keys(1, 6)[1]);
+  ASSERT_EQ(1000, f.find_keys(-5, 5000).size());
+  ASSERT_EQ(0, f.find_keys(3, 3).size());
+  ArraySeq<int> keys = f.sorted_keys();
+  ASSERT_EQ(1000, keys.size());
+  for (int i = 0; i < 1000; ++i)
+    ASSERT_EQ(i * 2, keys[i]);
+  // the frozen copy does not see later changes
+  m.erase(10);
+  m[12] = -1;
+  ASSERT_EQ(true, f.contains(10));
+  ASSERT_EQ(6, f[12]);
+}
+
+TEST(FrozenTreeMapTests, BuildCheck)
+{
+  // every size up to 40 (complete and partly filled last levels)
+  FrozenTreeMap<int, int> empty;
+  ASSERT_EQ(true, empty.empty());
+  ASSERT_EQ(false, empty.contains(0));
+  int key = 0;
+  ASSERT_EQ(false, empty.next_key(0, key));
+  ASSERT_EQ(0, empty.sorted_keys().size());
+  for (int n = 0; n <= 40; ++n) {
+    int keys[40];
+    int values[40];
+    for (int i = 0; i < n; ++i) {
+      keys[i] = i * 10;
+      values[i] = -i;
+    }
+    FrozenTreeMap<int, int> f(keys, values, n);
+    ASSERT_EQ(n, f.size());
+    for (int i = 0; i < n; ++i) {
+      ASSERT_EQ(-i, f[keys[i]]);
+      ASSERT_EQ(i + 1 < n, f.next_key(keys[i], key));
+      ASSERT_EQ(i > 0, f.prev_key(keys[i], key));
+      ASSERT_EQ(true, f.prev_key(keys[i] + 5, key));
+      ASSERT_EQ(keys[i], key);
+    }
+    ASSERT_EQ(n, f.sorted_keys().size());
+    ASSERT_EQ(false, f.contains(5));
+  }
+  int unsorted[] = {1, 3, 2};
+  int values[] = {1, 2, 3};
+  ASSERT_THROW((FrozenTreeMap<int, int>(unsorted, values, 3)), std::invalid_argument);
+  int repeated[] = {1, 2, 2};
+  ASSERT_THROW((FrozenTreeMap<int, int>(repeated, values, 3)), std::invalid_argument);
+  // strings through the Map constructor, then copies and moves
+  HashMap<string, int> h;
+  for (int i = 0; i < 100; ++i)
+    h.insert(to_string(i), i);
+  FrozenTreeMap<string, int> f1(h);
+  ASSERT_EQ(100, f1.size());
+  ASSERT_EQ(42, f1["42"]);
+  string next;
+  ASSERT_EQ(true, f1.next_key("9", next));
+  ASSERT_EQ("90", next);
+  FrozenTreeMap<string, int> f2(f1);
+  FrozenTreeMap<string, int> f3(std::move(f2));
+  ASSERT_EQ(0, f2.size());
+  ASSERT_EQ(false, f2.contains("7"));
+  ASSERT_EQ(99, f3["99"]);
+  f2 = f3;
+  ASSERT_EQ(f1.layout_bytes(), f2.layout_bytes());
+  f1 = FrozenTreeMap<string, int>();
+  ASSERT_EQ(0, f1.size());
+  ASSERT_EQ(true, f2.contains("0"));
+}
+
+//----------------------------------------------------------------------
+// Node pool allocator tests
+//----------------------------------------------------------------------
+
+TEST(PoolAllocatorTests, HashMapPoolCheck)
+{
+  HashMap<int, int, PoolAllocator> m;
+  for (int i = 0; i < 5000; ++i)
+    m.insert(i, i);
+  for (int i = 0; i < 5000; i += 2)
+    m.erase(i);
+  // reuses the freed slots
+  for (int i = 0; i < 5000; i += 2)
+    m.insert(i, -i);
+  ASSERT_EQ(5000, m.size());
+  ASSERT_EQ(-10, m[10]);
+  HashMap<int, int, PoolAllocator> m2(m);
+  m.clear();
+  ASSERT_EQ(0, m.size());
+  ASSERT_EQ(false, m.contains(11));
+  ASSERT_EQ(11, m2[11]);
+  m.insert(1, 1);
+  ASSERT_EQ(1, m[1]);
+}
+
+TEST(PoolAllocatorTests, BSTMapPoolCheck)
+{
+  BSTMap<string, string, PoolAllocator> m;
+  m.insert("m", "13");
+  m.insert("c", "3");
+  m.insert("x", "24");
+  m.insert("a", "1");
+  ASSERT_EQ(4, m.size());
+  m.erase("c");
+  ASSERT_EQ(false, m.contains("c"));
+  BSTMap<string, string, PoolAllocator> m2(std::move(m));
+  ASSERT_EQ(0, m.size());
+  ASSERT_EQ(3, m2.size());
+  ASSERT_EQ("24", m2["x"]);
+  m2.clear();
+  ASSERT_EQ(true, m2.empty());
+  m2.insert("b", "2");
+  ASSERT_EQ(1, m2.size());
+}
+
+TEST(PoolAllocatorTests, AVLMapPoolCheck)
+{
+  AVLMap<int, int, PoolAllocator> m1;
+  for (int i = 0; i < 1000; ++i)
+    m1.insert(i, i * 3);
+  ASSERT_EQ(10, m1.height());
+  AVLMap<int, int, PoolAllocator> m2;
+  m2 = m1;
+  for (int i = 0; i < 1000; i += 2)
+    m1.erase(i);
+  ASSERT_EQ(500, m1.size());
+  ASSERT_EQ(1000, m2.size());
+  ASSERT_EQ(6, m2[2]);
+  m1 = std::move(m2);
+  ASSERT_EQ(1000, m1.size());
+  ASSERT_EQ(0, m2.size());
+  m1.clear();
+  ASSERT_EQ(0, m1.height());
+}
+
 //----------------------------------------------------------------------
 // Main
 //----------------------------------------------------------------------
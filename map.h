@@ -17,6 +17,43 @@
 #define MAP_H
 
 #include "arrayseq.h"
+#include <utility>
+#include <type_traits>
+
+
+// True if a Q compares against a K with ==, < and > (Q on the left)
+template<typename K, typename Q, typename = void>
+struct is_key_comparable : std::false_type
+{
+};
+
+template<typename K, typename Q>
+struct is_key_comparable<K, Q,
+  std::void_t<decltype(std::declval<const Q&>() == std::declval<const K&>()),
+              decltype(std::declval<const Q&>() < std::declval<const K&>()),
+              decltype(std::declval<const Q&>() > std::declval<const K&>())>>
+  : std::true_type
+{
+};
+
+// True if a Q can be used as is to look up a K key, by comparing it
+// against the stored keys with ==, < and >, instead of being
+// converted to a K first. The maps enable their heterogeneous
+// operator[], contains and erase for these types, so a std::string
+// key can be found by string_view or C string without allocating a
+// temporary string. Off for scalar keys, where converting is free
+// and keeps the usual conversion rules, and for types that do not
+// compare with K (a type that only converts to K is converted).
+template<typename K, typename Q>
+struct is_lookup_key
+  : std::integral_constant<bool, !std::is_same<K,Q>::value && !std::is_scalar<K>::value &&
+                                 is_key_comparable<K,Q>::value>
+{
+};
+
+// Q if it is a lookup key for K (removes the overload otherwise)
+template<typename K, typename Q>
+using lookup_key_t = typename std::enable_if<is_lookup_key<K,Q>::value, Q>::type;
 
 
 template<typename K, typename V>
@@ -72,8 +109,71 @@ public:
 
   // Removes all key-value pairs from the map.
   virtual void clear() = 0;
+
+  // Replaces the contents of the map with the given key-value pairs
+  // (keys[i] maps to values[i]). If a key is given more than once,
+  // its first pair is kept. Throws out_of_range if keys and values
+  // differ in size. Maps override this with a faster bulk load.
+  virtual void assign(const ArraySeq<K>& keys, const ArraySeq<V>& values);
+
+protected:
+
+  // Returns the index of the first pair for each distinct key, in
+  // ascending key order. O(n) if the keys are already in strictly
+  // ascending order, and O(n log n) otherwise.
+  static ArraySeq<int> sorted_unique(const ArraySeq<K>& keys);
+
+  // Throws out_of_range if keys and values differ in size
+  static void check_pairs(const ArraySeq<K>& keys, const ArraySeq<V>& values);
   
 };
 
 
+template<typename K, typename V>
+void Map<K,V>::assign(const ArraySeq<K>& keys, const ArraySeq<V>& values)
+{
+  check_pairs(keys, values);
+  clear();
+  for (int i = 0; i < keys.size(); ++i) {
+    if (!contains(keys[i]))
+      insert(keys[i], values[i]);
+  }
+}
+
+
+template<typename K, typename V>
+ArraySeq<int> Map<K,V>::sorted_unique(const ArraySeq<K>& keys)
+{
+  ArraySeq<int> order;
+  int n = keys.size();
+  bool ascending = true;
+  for (int i = 1; i < n && ascending; ++i)
+    ascending = keys[i-1] < keys[i];
+  if (ascending) {
+    for (int i = 0; i < n; ++i)
+      order.insert(i, i);
+    return order;
+  }
+
+  // sorting (key, index) pairs keeps equal keys in input order
+  ArraySeq<std::pair<K,int>> pairs;
+  for (int i = 0; i < n; ++i)
+    pairs.insert(std::pair<K,int>(keys[i], i), i);
+  pairs.sort();
+  for (int i = 0; i < n; ++i) {
+    if (i == 0 || pairs[i-1].first < pairs[i].first)
+      order.insert(pairs[i].second, order.size());
+  }
+  return order;
+}
+
+
+template<typename K, typename V>
+void Map<K,V>::check_pairs(const ArraySeq<K>& keys, const ArraySeq<V>& values)
+{
+  if (keys.size() != values.size())
+    throw std::out_of_range("Keys and values differ in size");
+}
+
+
 #endif
@@ -0,0 +1,224 @@
+//---------------------------------------------------------------------------
+// NAME: Joey Macauley
+// FILE: nodepool.h
+// DATE: CPSC 223 - Spring 2022
+// DESC: Node allocation policies for the linked maps (HashMap, BSTMap,
+//       AVLMap). A map declares a pool for its node type with
+//
+//          typename A::template Pool<Node> pool;
+//
+//       and creates and destroys nodes through pool.create() and
+//       pool.destroy(node). HeapAllocator uses new/delete for every
+//       node. PoolAllocator hands out nodes from large, cache-line
+//       aligned slabs, keeps a free list of destroyed nodes, and can
+//       release all of its slabs at once.
+//---------------------------------------------------------------------------
+
+#ifndef NODEPOOL_H
+#define NODEPOOL_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// one node at a time from the global heap
+struct HeapAllocator
+{
+  template <typename T>
+  class Pool
+  {
+  public:
+    // true if release() can drop every node without destroying them
+    // one at a time
+    static const bool drops_nodes = false;
+
+    // true if a node created by one pool can be destroyed by another,
+    // so maps can hand nodes to each other
+    static const bool shares_nodes = true;
+
+    // returns a new default-constructed node
+    T *create()
+    {
+      return new T;
+    }
+
+    // destroys the node and gives its memory back
+    void destroy(T *node)
+    {
+      delete node;
+    }
+
+    // nothing is held by the pool itself
+    void release()
+    {
+    }
+
+    // nothing to exchange
+    void swap(Pool &)
+    {
+    }
+
+    // nothing to take over
+    void merge(Pool &)
+    {
+    }
+  };
+};
+
+// nodes carved out of large cache-line aligned slabs
+struct PoolAllocator
+{
+  template <typename T>
+  class Pool
+  {
+  public:
+    static const bool drops_nodes = std::is_trivially_destructible<T>::value;
+
+    // a node lives in its pool's slabs, so only that pool can destroy it
+    static const bool shares_nodes = false;
+
+    Pool() {}
+
+    // every map owns its own pool
+    Pool(const Pool &rhs) = delete;
+    Pool &operator=(const Pool &rhs) = delete;
+
+    ~Pool()
+    {
+      release();
+    }
+
+    // returns a new default-constructed node
+    T *create()
+    {
+      void *slot = nullptr;
+      if (free_list != nullptr)
+      {
+        slot = free_list;
+        free_list = free_list->next;
+      }
+      else
+      {
+        if (bump == bump_end)
+        {
+          add_slab();
+        }
+        slot = bump;
+        bump = bump + SLOT_BYTES;
+      }
+      return new (slot) T;
+    }
+
+    // destroys the node and puts its slot on the free list
+    void destroy(T *node)
+    {
+      node->~T();
+      FreeSlot *slot = reinterpret_cast<FreeSlot *>(node);
+      slot->next = free_list;
+      free_list = slot;
+    }
+
+    // frees every slab at once. Any nodes still in use must either
+    // have been destroyed already or be trivially destructible.
+    void release()
+    {
+      while (slabs != nullptr)
+      {
+        Slab *next = slabs->next;
+        ::operator delete(static_cast<void *>(slabs), std::align_val_t(CACHE_LINE));
+        slabs = next;
+      }
+      free_list = nullptr;
+      bump = nullptr;
+      bump_end = nullptr;
+    }
+
+    // exchanges slabs with another pool (used when a map is moved)
+    void swap(Pool &rhs)
+    {
+      std::swap(slabs, rhs.slabs);
+      std::swap(free_list, rhs.free_list);
+      std::swap(bump, rhs.bump);
+      std::swap(bump_end, rhs.bump_end);
+    }
+
+    // takes over rhs's slabs and free slots, so the nodes in them now
+    // belong to this pool (used when one map's nodes are joined into
+    // another). The unused rest of rhs's newest slab is given up until
+    // release. Costs a walk of rhs's slab and free lists.
+    void merge(Pool &rhs)
+    {
+      if (rhs.slabs != nullptr)
+      {
+        Slab *last = rhs.slabs;
+        while (last->next != nullptr)
+        {
+          last = last->next;
+        }
+        last->next = slabs;
+        slabs = rhs.slabs;
+      }
+      if (rhs.free_list != nullptr)
+      {
+        FreeSlot *last = rhs.free_list;
+        while (last->next != nullptr)
+        {
+          last = last->next;
+        }
+        last->next = free_list;
+        free_list = rhs.free_list;
+      }
+      rhs.slabs = nullptr;
+      rhs.free_list = nullptr;
+      rhs.bump = nullptr;
+      rhs.bump_end = nullptr;
+    }
+
+  private:
+    // a destroyed node's slot links to the next free slot
+    struct FreeSlot
+    {
+      FreeSlot *next;
+    };
+
+    // slab header (padded to a cache line so the slots stay aligned)
+    struct alignas(64) Slab
+    {
+      Slab *next;
+    };
+
+    static const std::size_t CACHE_LINE = 64;
+
+    // bytes per slot, rounded up to the node's alignment
+    static const std::size_t RAW_BYTES = sizeof(T) > sizeof(FreeSlot) ? sizeof(T) : sizeof(FreeSlot);
+    static const std::size_t SLOT_BYTES = (RAW_BYTES + alignof(T) - 1) / alignof(T) * alignof(T);
+
+    // slots per slab (about 64 KiB per slab, at least 64 slots)
+    static const std::size_t SLAB_SLOTS = (65536 / SLOT_BYTES) > 64 ? (65536 / SLOT_BYTES) : 64;
+
+    // all slabs allocated so far
+    Slab *slabs = nullptr;
+
+    // destroyed slots ready for reuse
+    FreeSlot *free_list = nullptr;
+
+    // never-used slots at the end of the newest slab
+    char *bump = nullptr;
+    char *bump_end = nullptr;
+
+    // allocate another slab and point the bump range at it
+    void add_slab()
+    {
+      std::size_t bytes = sizeof(Slab) + SLAB_SLOTS * SLOT_BYTES;
+      void *memory = ::operator new(bytes, std::align_val_t(CACHE_LINE));
+      Slab *slab = static_cast<Slab *>(memory);
+      slab->next = slabs;
+      slabs = slab;
+      bump = static_cast<char *>(memory) + sizeof(Slab);
+      bump_end = bump + SLAB_SLOTS * SLOT_BYTES;
+    }
+  };
+};
+
+#endif
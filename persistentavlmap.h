@@ -0,0 +1,890 @@
+//---------------------------------------------------------------------------
+// NAME: Joey Macauley
+// FILE: persistentavlmap.h
+// DATE: CPSC 223 - Spring 2022
+// DESC: Implementation of a persistent (path-copying) AVL map. Nodes
+//       are reference counted and shared between the map, its copies,
+//       and its snapshots. A write changes a node in place only when
+//       nothing else refers to it (or to any node above it); otherwise
+//       it copies the node, so inserts, erases, and their rotations
+//       copy at most the O(log n) nodes on the path they touch. Copying
+//       the map or taking a snapshot is O(1). A node is freed when the
+//       last version using it goes away.
+//---------------------------------------------------------------------------
+
+#ifndef PERSISTENTAVLMAP_H
+#define PERSISTENTAVLMAP_H
+
+#include "map.h"
+#include "arrayseq.h"
+#include <atomic>
+#include <stdexcept>
+#include <utility>
+
+// Nodes are freed by whichever version drops the last reference, which
+// may be on another thread, so they come from new and delete rather
+// than a per-map pool (see nodepool.h).
+template <typename K, typename V>
+class PersistentAVLMap : public Map<K, V>
+{
+  // tree node (defined below)
+  struct Node;
+
+public:
+  // An immutable version of the map. Reads (and copying or destroying
+  // the snapshot) are safe on any thread while the map it came from
+  // keeps being written, since writes never change a node a snapshot
+  // can reach.
+  class Snapshot
+  {
+  public:
+    // an empty snapshot
+    Snapshot();
+
+    // copy constructor (O(1), shares the nodes)
+    Snapshot(const Snapshot &rhs);
+
+    // move constructor
+    Snapshot(Snapshot &&rhs);
+
+    // copy assignment
+    Snapshot &operator=(const Snapshot &rhs);
+
+    // move assignment
+    Snapshot &operator=(Snapshot &&rhs);
+
+    // destructor (frees the nodes no other version uses)
+    ~Snapshot();
+
+    // Returns the number of key-value pairs in the snapshot
+    int size() const;
+
+    // Tests if the snapshot is empty
+    bool empty() const;
+
+    // Returns the value for a given key. Throws out_of_range if the
+    // given key is not in the snapshot.
+    const V &operator[](const K &key) const;
+
+    // Returns true if the key is in the snapshot, and false otherwise.
+    bool contains(const K &key) const;
+
+    // Returns the keys k in the snapshot such that k1 <= k <= k2
+    ArraySeq<K> find_keys(const K &k1, const K &k2) const;
+
+    // Returns the keys in the snapshot in ascending sorted order
+    ArraySeq<K> sorted_keys() const;
+
+    // Gives the key immediately after (before) the given key. Returns
+    // true if one exists, and false otherwise.
+    bool next_key(const K &key, K &next_key) const;
+    bool prev_key(const K &key, K &prev_key) const;
+
+    // Returns the height of the snapshot's tree
+    int height() const;
+
+  private:
+    friend class PersistentAVLMap;
+
+    // takes over a reference to the version's root
+    Snapshot(Node *version_root, int version_count);
+
+    Node *root = nullptr;
+    int count = 0;
+  };
+
+  // default constructor
+  PersistentAVLMap();
+
+  // copy constructor (O(1): the copy shares every node with rhs, and
+  // the two part ways as either is written)
+  PersistentAVLMap(const PersistentAVLMap &rhs);
+
+  // move constructor
+  PersistentAVLMap(PersistentAVLMap &&rhs);
+
+  // copy assignment (O(1), see the copy constructor)
+  PersistentAVLMap &operator=(const PersistentAVLMap &rhs);
+
+  // move assignment
+  PersistentAVLMap &operator=(PersistentAVLMap &&rhs);
+
+  // destructor
+  ~PersistentAVLMap();
+
+  // Returns the number of key-value pairs in the map
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Allows values associated with a key to be updated. Throws
+  // out_of_range if the given key is not in the collection. Copies
+  // the shared nodes on the key's path first, so writing through the
+  // reference never changes a snapshot.
+  V &operator[](const K &key);
+
+  // Returns the value for a given key. Throws out_of_range if the
+  // given key is not in the collection.
+  const V &operator[](const K &key) const;
+
+  // Extends the collection by adding the given key-value pair.
+  // Expects key to not exist in map prior to insertion.
+  void insert(const K &key, const V &value);
+
+  // Shrinks the collection by removing the key-value pair with the
+  // given key. Does not modify the collection if the collection does
+  // not contain the key. Throws out_of_range if the given key is not
+  // in the collection.
+  void erase(const K &key);
+
+  // Returns true if the key is in the collection, and false otherwise.
+  bool contains(const K &key) const;
+
+  // Returns the keys k in the collection such that k1 <= k <= k2
+  ArraySeq<K> find_keys(const K &k1, const K &k2) const;
+
+  // Returns the keys in the collection in ascending sorted order
+  ArraySeq<K> sorted_keys() const;
+
+  // Gives the key (as an ouptput parameter) immediately after the
+  // given key according to ascending sort order. Returns true if a
+  // successor key exists, and false otherwise.
+  bool next_key(const K &key, K &next_key) const;
+
+  // Gives the key (as an ouptput parameter) immediately before the
+  // given key according to ascending sort order. Returns true if a
+  // predecessor key exists, and false otherwise.
+  bool prev_key(const K &key, K &prev_key) const;
+
+  // Removes all key-value pairs from the map.
+  void clear();
+
+  // Returns the height of the binary search tree
+  int height() const;
+
+  // Returns an immutable version of the map as it is now in O(1).
+  // Must not run at the same time as a write to the map (take it on
+  // the writing thread); the snapshot can then be handed to readers.
+  Snapshot snapshot() const;
+
+  // Returns the number of nodes alive across every map and snapshot
+  // of this type (shared nodes count once)
+  static long live_nodes();
+
+private:
+  // tree node. Once a second reference to a node exists, nothing in
+  // it changes again.
+  struct Node
+  {
+    K key;
+    V value;
+    int height;
+    std::atomic<int> refs;
+    Node *left;
+    Node *right;
+  };
+
+  // root of this version
+  Node *root = nullptr;
+
+  // number of key-value pairs in map
+  int count = 0;
+
+  // nodes alive in every version
+  static inline std::atomic<long> nodes_alive{0};
+
+  // returns a new node with one reference, taking over the
+  // references to left and right
+  static Node *make_node(const K &key, const V &value, Node *left, Node *right);
+
+  // adds a reference to a (possibly null) node and returns it
+  static Node *share(Node *node);
+
+  // drops a reference to a (possibly null) node, freeing it (and
+  // dropping its references to its children) when none are left
+  static void release(Node *node);
+
+  // returns a node the caller may change, given the caller's reference
+  // to node: node itself if that is the only reference, or else a copy
+  // (which the reference moves to)
+  static Node *own(Node *node);
+
+  // insert and erase helpers: each takes the caller's reference to the
+  // subtree root and returns the new subtree root
+  static Node *insert(Node *st_root, const K &key, const V &value);
+  static Node *erase(Node *st_root, const K &key);
+
+  // operator[] helper: owns every node on the path to the key (which
+  // must be in the subtree), setting found to the key's node
+  static Node *own_path(Node *st_root, const K &key, Node *&found);
+
+  // returns the node holding the key, or nullptr if it is not in the
+  // subtree
+  static const Node *find_node(const Node *st_root, const K &key);
+
+  // read helpers shared with Snapshot
+  static void find_keys(const K &k1, const K &k2, const Node *st_root, ArraySeq<K> &keys);
+  static void sorted_keys(const Node *st_root, ArraySeq<K> &keys);
+  static bool next_key(const Node *st_root, const K &key, K &next_key);
+  static bool prev_key(const Node *st_root, const K &key, K &prev_key);
+
+  // height of a (possibly empty) subtree
+  static int subtree_height(const Node *st_root);
+
+  // recompute a node's height from its children
+  static void update_height(Node *st_root);
+
+  // rotations (each owns the nodes it changes)
+  static Node *rotate_right(Node *k2);
+  static Node *rotate_left(Node *k2);
+
+  // updates an owned node's height and rotates it if its subtrees
+  // differ in height by more than one, returning the subtree's new root
+  static Node *rebalance(Node *st_root);
+};
+
+//----------------------------------------------------------------------
+// Snapshot
+//----------------------------------------------------------------------
+
+// an empty snapshot
+template <typename K, typename V>
+PersistentAVLMap<K, V>::Snapshot::Snapshot()
+{
+}
+
+// takes over a reference to the version's root
+template <typename K, typename V>
+PersistentAVLMap<K, V>::Snapshot::Snapshot(Node *version_root, int version_count)
+  : root(version_root), count(version_count)
+{
+}
+
+// copy constructor
+template <typename K, typename V>
+PersistentAVLMap<K, V>::Snapshot::Snapshot(const Snapshot &rhs)
+  : root(share(rhs.root)), count(rhs.count)
+{
+}
+
+// move constructor
+template <typename K, typename V>
+PersistentAVLMap<K, V>::Snapshot::Snapshot(Snapshot &&rhs)
+  : root(rhs.root), count(rhs.count)
+{
+  rhs.root = nullptr;
+  rhs.count = 0;
+}
+
+// copy assignment
+template <typename K, typename V>
+typename PersistentAVLMap<K, V>::Snapshot &PersistentAVLMap<K, V>::Snapshot::operator=(const Snapshot &rhs)
+{
+  Node *old_root = root;
+  root = share(rhs.root);
+  count = rhs.count;
+  release(old_root);
+  return *this;
+}
+
+// move assignment
+template <typename K, typename V>
+typename PersistentAVLMap<K, V>::Snapshot &PersistentAVLMap<K, V>::Snapshot::operator=(Snapshot &&rhs)
+{
+  if (this != &rhs)
+  {
+    release(root);
+    root = rhs.root;
+    count = rhs.count;
+    rhs.root = nullptr;
+    rhs.count = 0;
+  }
+  return *this;
+}
+
+// destructor
+template <typename K, typename V>
+PersistentAVLMap<K, V>::Snapshot::~Snapshot()
+{
+  release(root);
+}
+
+// Returns the number of key-value pairs in the snapshot
+template <typename K, typename V>
+int PersistentAVLMap<K, V>::Snapshot::size() const
+{
+  return count;
+}
+
+// Tests if the snapshot is empty
+template <typename K, typename V>
+bool PersistentAVLMap<K, V>::Snapshot::empty() const
+{
+  return count == 0;
+}
+
+// Returns the value for a given key
+template <typename K, typename V>
+const V &PersistentAVLMap<K, V>::Snapshot::operator[](const K &key) const
+{
+  const Node *node = find_node(root, key);
+  if (node == nullptr)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return node->value;
+}
+
+// Returns true if the key is in the snapshot
+template <typename K, typename V>
+bool PersistentAVLMap<K, V>::Snapshot::contains(const K &key) const
+{
+  return find_node(root, key) != nullptr;
+}
+
+// Returns the keys k in the snapshot such that k1 <= k <= k2
+template <typename K, typename V>
+ArraySeq<K> PersistentAVLMap<K, V>::Snapshot::find_keys(const K &k1, const K &k2) const
+{
+  ArraySeq<K> keys;
+  PersistentAVLMap::find_keys(k1, k2, root, keys);
+  return keys;
+}
+
+// Returns the keys in the snapshot in ascending sorted order
+template <typename K, typename V>
+ArraySeq<K> PersistentAVLMap<K, V>::Snapshot::sorted_keys() const
+{
+  ArraySeq<K> keys;
+  PersistentAVLMap::sorted_keys(root, keys);
+  return keys;
+}
+
+// Gives the key immediately after the given key
+template <typename K, typename V>
+bool PersistentAVLMap<K, V>::Snapshot::next_key(const K &key, K &next_key) const
+{
+  return PersistentAVLMap::next_key(root, key, next_key);
+}
+
+// Gives the key immediately before the given key
+template <typename K, typename V>
+bool PersistentAVLMap<K, V>::Snapshot::prev_key(const K &key, K &prev_key) const
+{
+  return PersistentAVLMap::prev_key(root, key, prev_key);
+}
+
+// Returns the height of the snapshot's tree
+template <typename K, typename V>
+int PersistentAVLMap<K, V>::Snapshot::height() const
+{
+  return subtree_height(root);
+}
+
+//----------------------------------------------------------------------
+// PersistentAVLMap
+//----------------------------------------------------------------------
+
+// default constructor
+template <typename K, typename V>
+PersistentAVLMap<K, V>::PersistentAVLMap()
+{
+}
+
+// copy constructor
+template <typename K, typename V>
+PersistentAVLMap<K, V>::PersistentAVLMap(const PersistentAVLMap &rhs)
+  : root(share(rhs.root)), count(rhs.count)
+{
+}
+
+// move constructor
+template <typename K, typename V>
+PersistentAVLMap<K, V>::PersistentAVLMap(PersistentAVLMap &&rhs)
+  : root(rhs.root), count(rhs.count)
+{
+  rhs.root = nullptr;
+  rhs.count = 0;
+}
+
+// copy assignment (the new root is shared before the old one is
+// released, in case they are the same)
+template <typename K, typename V>
+PersistentAVLMap<K, V> &PersistentAVLMap<K, V>::operator=(const PersistentAVLMap &rhs)
+{
+  Node *old_root = root;
+  root = share(rhs.root);
+  count = rhs.count;
+  release(old_root);
+  return *this;
+}
+
+// move assignment
+template <typename K, typename V>
+PersistentAVLMap<K, V> &PersistentAVLMap<K, V>::operator=(PersistentAVLMap &&rhs)
+{
+  if (this != &rhs)
+  {
+    release(root);
+    root = rhs.root;
+    count = rhs.count;
+    rhs.root = nullptr;
+    rhs.count = 0;
+  }
+  return *this;
+}
+
+// destructor
+template <typename K, typename V>
+PersistentAVLMap<K, V>::~PersistentAVLMap()
+{
+  release(root);
+}
+
+// Returns the number of key-value pairs in the map
+template <typename K, typename V>
+int PersistentAVLMap<K, V>::size() const
+{
+  return count;
+}
+
+// Tests if the map is empty
+template <typename K, typename V>
+bool PersistentAVLMap<K, V>::empty() const
+{
+  return count == 0;
+}
+
+// Allows values associated with a key to be updated
+template <typename K, typename V>
+V &PersistentAVLMap<K, V>::operator[](const K &key)
+{
+  if (find_node(root, key) == nullptr)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  Node *found = nullptr;
+  root = own_path(root, key, found);
+  return found->value;
+}
+
+// Returns the value for a given key
+template <typename K, typename V>
+const V &PersistentAVLMap<K, V>::operator[](const K &key) const
+{
+  const Node *node = find_node(root, key);
+  if (node == nullptr)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return node->value;
+}
+
+// Extends the collection by adding the given key-value pair
+template <typename K, typename V>
+void PersistentAVLMap<K, V>::insert(const K &key, const V &value)
+{
+  root = insert(root, key, value);
+  count++;
+}
+
+// Shrinks the collection by removing the key-value pair with the
+// given key (checked first, so a missing key copies nothing)
+template <typename K, typename V>
+void PersistentAVLMap<K, V>::erase(const K &key)
+{
+  if (find_node(root, key) == nullptr)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  root = erase(root, key);
+  count--;
+}
+
+// Returns true if the key is in the collection, and false otherwise
+template <typename K, typename V>
+bool PersistentAVLMap<K, V>::contains(const K &key) const
+{
+  return find_node(root, key) != nullptr;
+}
+
+// Returns the keys k in the collection such that k1 <= k <= k2
+template <typename K, typename V>
+ArraySeq<K> PersistentAVLMap<K, V>::find_keys(const K &k1, const K &k2) const
+{
+  ArraySeq<K> keys;
+  find_keys(k1, k2, root, keys);
+  return keys;
+}
+
+// Returns the keys in the collection in ascending sorted order
+template <typename K, typename V>
+ArraySeq<K> PersistentAVLMap<K, V>::sorted_keys() const
+{
+  ArraySeq<K> keys;
+  sorted_keys(root, keys);
+  return keys;
+}
+
+// Gives the key immediately after the given key
+template <typename K, typename V>
+bool PersistentAVLMap<K, V>::next_key(const K &key, K &next_key) const
+{
+  return PersistentAVLMap::next_key(root, key, next_key);
+}
+
+// Gives the key immediately before the given key
+template <typename K, typename V>
+bool PersistentAVLMap<K, V>::prev_key(const K &key, K &prev_key) const
+{
+  return PersistentAVLMap::prev_key(root, key, prev_key);
+}
+
+// Removes all key-value pairs from the map (snapshots keep theirs)
+template <typename K, typename V>
+void PersistentAVLMap<K, V>::clear()
+{
+  release(root);
+  root = nullptr;
+  count = 0;
+}
+
+// Returns the height of the binary search tree
+template <typename K, typename V>
+int PersistentAVLMap<K, V>::height() const
+{
+  return subtree_height(root);
+}
+
+// Returns an immutable version of the map as it is now
+template <typename K, typename V>
+typename PersistentAVLMap<K, V>::Snapshot PersistentAVLMap<K, V>::snapshot() const
+{
+  return Snapshot(share(root), count);
+}
+
+// Returns the number of nodes alive across every map and snapshot
+template <typename K, typename V>
+long PersistentAVLMap<K, V>::live_nodes()
+{
+  return nodes_alive.load();
+}
+
+// returns a new node with one reference
+template <typename K, typename V>
+typename PersistentAVLMap<K, V>::Node *PersistentAVLMap<K, V>::make_node(const K &key, const V &value, Node *left,
+                                                                         Node *right)
+{
+  Node *node = new Node{key, value, 1, {1}, left, right};
+  update_height(node);
+  nodes_alive.fetch_add(1, std::memory_order_relaxed);
+  return node;
+}
+
+// adds a reference to a (possibly null) node
+template <typename K, typename V>
+typename PersistentAVLMap<K, V>::Node *PersistentAVLMap<K, V>::share(Node *node)
+{
+  if (node != nullptr)
+  {
+    node->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  return node;
+}
+
+// drops a reference to a (possibly null) node. The thread that drops
+// the last one frees the node, after seeing every other thread's
+// changes to it (acquire), and releases the node's children.
+template <typename K, typename V>
+void PersistentAVLMap<K, V>::release(Node *node)
+{
+  if (node != nullptr && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+  {
+    release(node->left);
+    release(node->right);
+    delete node;
+    nodes_alive.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+// returns a node the caller may change. A node with one reference is
+// reachable only through the caller (whose own path was already
+// owned), so no other version can see it change.
+template <typename K, typename V>
+typename PersistentAVLMap<K, V>::Node *PersistentAVLMap<K, V>::own(Node *node)
+{
+  if (node->refs.load(std::memory_order_acquire) == 1)
+  {
+    return node;
+  }
+  Node *copy = make_node(node->key, node->value, share(node->left), share(node->right));
+  release(node);
+  return copy;
+}
+
+// insert helper: owns the path down to the new leaf and rebalances it
+// on the way back up
+template <typename K, typename V>
+typename PersistentAVLMap<K, V>::Node *PersistentAVLMap<K, V>::insert(Node *st_root, const K &key, const V &value)
+{
+  if (st_root == nullptr)
+  {
+    return make_node(key, value, nullptr, nullptr);
+  }
+  Node *node = own(st_root);
+  if (key < node->key)
+  {
+    node->left = insert(node->left, key, value);
+  }
+  else
+  {
+    node->right = insert(node->right, key, value);
+  }
+  return rebalance(node);
+}
+
+// erase helper: a node with two children takes its successor's pair,
+// and the successor is erased from the right subtree instead
+template <typename K, typename V>
+typename PersistentAVLMap<K, V>::Node *PersistentAVLMap<K, V>::erase(Node *st_root, const K &key)
+{
+  Node *node = own(st_root);
+  if (key == node->key)
+  {
+    if (node->left == nullptr || node->right == nullptr)
+    {
+      // the caller's reference moves to the only child
+      Node *child = node->left != nullptr ? node->left : node->right;
+      node->left = nullptr;
+      node->right = nullptr;
+      release(node);
+      return child;
+    }
+    const Node *successor = node->right;
+    while (successor->left != nullptr)
+    {
+      successor = successor->left;
+    }
+    node->key = successor->key;
+    node->value = successor->value;
+    node->right = erase(node->right, node->key);
+  }
+  else if (key < node->key)
+  {
+    node->left = erase(node->left, key);
+  }
+  else
+  {
+    node->right = erase(node->right, key);
+  }
+  return rebalance(node);
+}
+
+// operator[] helper: owns every node on the path to the key
+template <typename K, typename V>
+typename PersistentAVLMap<K, V>::Node *PersistentAVLMap<K, V>::own_path(Node *st_root, const K &key, Node *&found)
+{
+  Node *node = own(st_root);
+  if (key == node->key)
+  {
+    found = node;
+  }
+  else if (key < node->key)
+  {
+    node->left = own_path(node->left, key, found);
+  }
+  else
+  {
+    node->right = own_path(node->right, key, found);
+  }
+  return node;
+}
+
+// returns the node holding the key, or nullptr if it is not in the
+// subtree
+template <typename K, typename V>
+const typename PersistentAVLMap<K, V>::Node *PersistentAVLMap<K, V>::find_node(const Node *st_root, const K &key)
+{
+  const Node *traverse = st_root;
+  while (traverse != nullptr)
+  {
+    if (key == traverse->key)
+    {
+      return traverse;
+    }
+    else if (key < traverse->key)
+    {
+      traverse = traverse->left;
+    }
+    else
+    {
+      traverse = traverse->right;
+    }
+  }
+  return nullptr;
+}
+
+// find_keys helper (skips the subtrees wholly outside [k1, k2])
+template <typename K, typename V>
+void PersistentAVLMap<K, V>::find_keys(const K &k1, const K &k2, const Node *st_root, ArraySeq<K> &keys)
+{
+  if (st_root == nullptr)
+  {
+    return;
+  }
+  if (k1 < st_root->key)
+  {
+    find_keys(k1, k2, st_root->left, keys);
+  }
+  if (!(st_root->key < k1) && !(k2 < st_root->key))
+  {
+    keys.insert(st_root->key, keys.size());
+  }
+  if (st_root->key < k2)
+  {
+    find_keys(k1, k2, st_root->right, keys);
+  }
+}
+
+// sorted_keys helper
+template <typename K, typename V>
+void PersistentAVLMap<K, V>::sorted_keys(const Node *st_root, ArraySeq<K> &keys)
+{
+  if (st_root != nullptr)
+  {
+    sorted_keys(st_root->left, keys);
+    keys.insert(st_root->key, keys.size());
+    sorted_keys(st_root->right, keys);
+  }
+}
+
+// the smallest key greater than the given key: the last node the
+// search turned left at
+template <typename K, typename V>
+bool PersistentAVLMap<K, V>::next_key(const Node *st_root, const K &key, K &next_key)
+{
+  const Node *next = nullptr;
+  const Node *traverse = st_root;
+  while (traverse != nullptr)
+  {
+    if (key < traverse->key)
+    {
+      next = traverse;
+      traverse = traverse->left;
+    }
+    else
+    {
+      traverse = traverse->right;
+    }
+  }
+  if (next == nullptr)
+  {
+    return false;
+  }
+  next_key = next->key;
+  return true;
+}
+
+// the largest key less than the given key: the last node the search
+// turned right at
+template <typename K, typename V>
+bool PersistentAVLMap<K, V>::prev_key(const Node *st_root, const K &key, K &prev_key)
+{
+  const Node *prev = nullptr;
+  const Node *traverse = st_root;
+  while (traverse != nullptr)
+  {
+    if (traverse->key < key)
+    {
+      prev = traverse;
+      traverse = traverse->right;
+    }
+    else
+    {
+      traverse = traverse->left;
+    }
+  }
+  if (prev == nullptr)
+  {
+    return false;
+  }
+  prev_key = prev->key;
+  return true;
+}
+
+// height of a (possibly empty) subtree
+template <typename K, typename V>
+int PersistentAVLMap<K, V>::subtree_height(const Node *st_root)
+{
+  if (st_root == nullptr)
+  {
+    return 0;
+  }
+  return st_root->height;
+}
+
+// recompute a node's height from its children
+template <typename K, typename V>
+void PersistentAVLMap<K, V>::update_height(Node *st_root)
+{
+  int left_height = subtree_height(st_root->left);
+  int right_height = subtree_height(st_root->right);
+  st_root->height = 1 + (left_height > right_height ? left_height : right_height);
+}
+
+// rotations: k2 is owned by the caller, and the child that moves up is
+// owned here before it changes
+template <typename K, typename V>
+typename PersistentAVLMap<K, V>::Node *PersistentAVLMap<K, V>::rotate_right(Node *k2)
+{
+  Node *k1 = own(k2->left);
+  k2->left = k1->right;
+  k1->right = k2;
+  update_height(k2);
+  update_height(k1);
+  return k1;
+}
+
+template <typename K, typename V>
+typename PersistentAVLMap<K, V>::Node *PersistentAVLMap<K, V>::rotate_left(Node *k2)
+{
+  Node *k1 = own(k2->right);
+  k2->right = k1->left;
+  k1->left = k2;
+  update_height(k2);
+  update_height(k1);
+  return k1;
+}
+
+// rebalance: a left-heavy node whose left child leans right needs a
+// double rotation (left at the child, then right), and the mirror
+// image on the right
+template <typename K, typename V>
+typename PersistentAVLMap<K, V>::Node *PersistentAVLMap<K, V>::rebalance(Node *st_root)
+{
+  update_height(st_root);
+  int bf = subtree_height(st_root->left) - subtree_height(st_root->right);
+
+  // left heavy
+  if (bf > 1)
+  {
+    if (subtree_height(st_root->left->left) < subtree_height(st_root->left->right))
+    {
+      st_root->left = rotate_left(own(st_root->left));
+    }
+    st_root = rotate_right(st_root);
+  }
+  // right heavy
+  else if (bf < -1)
+  {
+    if (subtree_height(st_root->right->right) < subtree_height(st_root->right->left))
+    {
+      st_root->right = rotate_right(own(st_root->right));
+    }
+    st_root = rotate_left(st_root);
+  }
+  return st_root;
+}
+
+#endif
@@ -0,0 +1,541 @@
+//---------------------------------------------------------------------------
+// NAME: Joey Macauley
+// FILE: robinhoodmap.h
+// DATE: CPSC 223 - Spring 2022
+// DESC: Implementation of an open-addressing hash map using Robin Hood
+//       hashing. Each slot records how far its entry is from its home
+//       slot (the probe distance). Inserts displace entries that are
+//       closer to home than the entry being placed, and erases shift
+//       the following entries back instead of leaving tombstones, so
+//       probe distances stay short and evenly spread.
+//---------------------------------------------------------------------------
+
+#ifndef ROBINHOODMAP_H
+#define ROBINHOODMAP_H
+
+#include "map.h"
+#include "arrayseq.h"
+#include "hashpolicy.h"
+#include <functional>
+#include <cstdint>
+#include <utility>
+
+template <typename K, typename V>
+class RobinHoodMap : public Map<K, V>
+{
+public:
+  // default constructor
+  RobinHoodMap();
+
+  // copy constructor
+  RobinHoodMap(const RobinHoodMap &rhs);
+
+  // move constructor
+  RobinHoodMap(RobinHoodMap &&rhs);
+
+  // copy assignment
+  RobinHoodMap &operator=(const RobinHoodMap &rhs);
+
+  // move assignment
+  RobinHoodMap &operator=(RobinHoodMap &&rhs);
+
+  // destructor
+  ~RobinHoodMap();
+
+  // Returns the number of key-value pairs in the map
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Allows values associated with a key to be updated. Throws
+  // out_of_range if the given key is not in the collection.
+  V &operator[](const K &key);
+
+  // Returns the value for a given key. Throws out_of_range if the
+  // given key is not in the collection.
+  const V &operator[](const K &key) const;
+
+  // Extends the collection by adding the given key-value pair. If
+  // the key is already in the map the collection is not modified.
+  void insert(const K &key, const V &value);
+
+  // Shrinks the collection by removing the key-value pair with the
+  // given key. Does not modify the collection if the collection does
+  // not contain the key. Throws out_of_range if the given key is not
+  // in the collection.
+  void erase(const K &key);
+
+  // Returns true if the key is in the collection, and false otherwise.
+  bool contains(const K &key) const;
+
+  // Returns the keys k in the collection such that k1 <= k <= k2
+  ArraySeq<K> find_keys(const K &k1, const K &k2) const;
+
+  // Returns the keys in the collection in ascending sorted order
+  ArraySeq<K> sorted_keys() const;
+
+  // Gives the key (as an ouptput parameter) immediately after the
+  // given key according to ascending sort order. Returns true if a
+  // successor key exists, and false otherwise.
+  bool next_key(const K &key, K &next_key) const;
+
+  // Gives the key (as an ouptput parameter) immediately before the
+  // given key according to ascending sort order. Returns true if a
+  // predecessor key exists, and false otherwise.
+  bool prev_key(const K &key, K &next_key) const;
+
+  // Removes all key-value pairs from the map. Does not change the
+  // current capacity of the table.
+  void clear();
+
+  // statistics functions for the hash table implementation (probe
+  // distance is the number of slots an entry sits past its home slot)
+  int min_probe_distance() const;
+  int max_probe_distance() const;
+  double avg_probe_distance() const;
+
+private:
+  // probe distance marking an empty slot
+  static const short EMPTY = -1;
+
+  // number of key-value pairs in map
+  int count = 0;
+
+  // number of slots (always a power of two)
+  int capacity = 16;
+
+  // threshold for resize and rehash
+  const double load_factor_threshold = 0.85;
+
+  // flat slot arrays
+  K *keys = nullptr;
+  V *values = nullptr;
+  short *dist = nullptr;
+
+  // the hash function
+  std::uint64_t hash(const K &key) const;
+
+  // returns the slot holding key or -1 if the key is not in the map
+  int find(const K &key) const;
+
+  // resize and rehash the table into the given number of slots
+  void resize_and_rehash(int new_capacity);
+
+  // allocate the arrays for the current capacity with all slots empty
+  void init_table();
+
+  // release the arrays
+  void free_table();
+};
+
+template <typename K, typename V>
+RobinHoodMap<K, V>::RobinHoodMap()
+{
+  init_table();
+}
+
+// copy constructor
+template <typename K, typename V>
+RobinHoodMap<K, V>::RobinHoodMap(const RobinHoodMap &rhs)
+{
+  *this = rhs;
+}
+
+// move constructor
+template <typename K, typename V>
+RobinHoodMap<K, V>::RobinHoodMap(RobinHoodMap &&rhs)
+{
+  *this = std::move(rhs);
+}
+
+// copy assignment
+template <typename K, typename V>
+RobinHoodMap<K, V> &RobinHoodMap<K, V>::operator=(const RobinHoodMap &rhs)
+{
+  if (this != &rhs)
+  {
+    free_table();
+    count = rhs.count;
+    capacity = rhs.capacity;
+    init_table();
+
+    for (int i = 0; i < capacity; ++i)
+    {
+      dist[i] = rhs.dist[i];
+      if (dist[i] != EMPTY)
+      {
+        keys[i] = rhs.keys[i];
+        values[i] = rhs.values[i];
+      }
+    }
+  }
+  return *this;
+}
+
+// move assignment
+template <typename K, typename V>
+RobinHoodMap<K, V> &RobinHoodMap<K, V>::operator=(RobinHoodMap &&rhs)
+{
+  if (this != &rhs)
+  {
+    free_table();
+    count = rhs.count;
+    capacity = rhs.capacity;
+    keys = rhs.keys;
+    values = rhs.values;
+    dist = rhs.dist;
+
+    // default state for rhs
+    rhs.keys = nullptr;
+    rhs.values = nullptr;
+    rhs.dist = nullptr;
+    rhs.count = 0;
+    rhs.capacity = 16;
+    rhs.init_table();
+  }
+  return *this;
+}
+
+// destructor
+template <typename K, typename V>
+RobinHoodMap<K, V>::~RobinHoodMap()
+{
+  free_table();
+}
+
+// Returns the number of key-value pairs in the map
+template <typename K, typename V>
+int RobinHoodMap<K, V>::size() const
+{
+  return count;
+}
+
+// Tests if the map is empty
+template <typename K, typename V>
+bool RobinHoodMap<K, V>::empty() const
+{
+  return count == 0;
+}
+
+// Allows values associated with a key to be updated. Throws
+// out_of_range if the given key is not in the collection.
+template <typename K, typename V>
+V &RobinHoodMap<K, V>::operator[](const K &key)
+{
+  int index = find(key);
+  if (index < 0)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return values[index];
+}
+
+// Returns the value for a given key. Throws out_of_range if the
+// given key is not in the collection.
+template <typename K, typename V>
+const V &RobinHoodMap<K, V>::operator[](const K &key) const
+{
+  int index = find(key);
+  if (index < 0)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+  return values[index];
+}
+
+// Extends the collection by adding the given key-value pair. If
+// the key is already in the map the collection is not modified.
+template <typename K, typename V>
+void RobinHoodMap<K, V>::insert(const K &key, const V &value)
+{
+  if (find(key) >= 0)
+  {
+    return;
+  }
+
+  if (static_cast<double>(count + 1) / capacity > load_factor_threshold)
+  {
+    resize_and_rehash(capacity * 2);
+  }
+
+  K cur_key = key;
+  V cur_value = value;
+  short cur_dist = 0;
+  int mask = capacity - 1;
+  int index = static_cast<int>(hash(key) & mask);
+
+  while (true)
+  {
+    // empty slot ends the probe
+    if (dist[index] == EMPTY)
+    {
+      keys[index] = cur_key;
+      values[index] = cur_value;
+      dist[index] = cur_dist;
+      count++;
+      return;
+    }
+    // take the slot from an entry that is closer to its home
+    if (dist[index] < cur_dist)
+    {
+      std::swap(cur_key, keys[index]);
+      std::swap(cur_value, values[index]);
+      std::swap(cur_dist, dist[index]);
+    }
+    index = (index + 1) & mask;
+    cur_dist++;
+  }
+}
+
+// Shrinks the collection by removing the key-value pair with the
+// given key. Does not modify the collection if the collection does
+// not contain the key. Throws out_of_range if the given key is not
+// in the collection.
+template <typename K, typename V>
+void RobinHoodMap<K, V>::erase(const K &key)
+{
+  int index = find(key);
+  if (index < 0)
+  {
+    throw std::out_of_range("Key is not in the collection");
+  }
+
+  // shift the following displaced entries back one slot
+  int mask = capacity - 1;
+  int next = (index + 1) & mask;
+  while (dist[next] > 0)
+  {
+    keys[index] = keys[next];
+    values[index] = values[next];
+    dist[index] = dist[next] - 1;
+    index = next;
+    next = (next + 1) & mask;
+  }
+  dist[index] = EMPTY;
+  count--;
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template <typename K, typename V>
+bool RobinHoodMap<K, V>::contains(const K &key) const
+{
+  return find(key) >= 0;
+}
+
+// Returns the keys k in the collection such that k1 <= k <= k2
+template <typename K, typename V>
+ArraySeq<K> RobinHoodMap<K, V>::find_keys(const K &k1, const K &k2) const
+{
+  ArraySeq<K> result;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (dist[i] != EMPTY && keys[i] >= k1 && keys[i] <= k2)
+    {
+      result.insert(keys[i], result.size());
+    }
+  }
+  return result;
+}
+
+// Returns the keys in the collection in ascending sorted order
+template <typename K, typename V>
+ArraySeq<K> RobinHoodMap<K, V>::sorted_keys() const
+{
+  ArraySeq<K> result;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (dist[i] != EMPTY)
+    {
+      result.insert(keys[i], result.size());
+    }
+  }
+  result.sort();
+  return result;
+}
+
+// Gives the key (as an ouptput parameter) immediately after the
+// given key according to ascending sort order. Returns true if a
+// successor key exists, and false otherwise.
+template <typename K, typename V>
+bool RobinHoodMap<K, V>::next_key(const K &key, K &next_key) const
+{
+  bool exists = false;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (dist[i] != EMPTY && keys[i] > key)
+    {
+      if (!exists || keys[i] < next_key)
+      {
+        next_key = keys[i];
+      }
+      exists = true;
+    }
+  }
+  return exists;
+}
+
+// Gives the key (as an ouptput parameter) immediately before the
+// given key according to ascending sort order. Returns true if a
+// predecessor key exists, and false otherwise.
+template <typename K, typename V>
+bool RobinHoodMap<K, V>::prev_key(const K &key, K &next_key) const
+{
+  bool exists = false;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (dist[i] != EMPTY && keys[i] < key)
+    {
+      if (!exists || keys[i] > next_key)
+      {
+        next_key = keys[i];
+      }
+      exists = true;
+    }
+  }
+  return exists;
+}
+
+// Removes all key-value pairs from the map. Does not change the
+// current capacity of the table.
+template <typename K, typename V>
+void RobinHoodMap<K, V>::clear()
+{
+  for (int i = 0; i < capacity; ++i)
+  {
+    dist[i] = EMPTY;
+  }
+  count = 0;
+}
+
+// statistics functions for the hash table implementation
+template <typename K, typename V>
+int RobinHoodMap<K, V>::min_probe_distance() const
+{
+  int min = -1;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (dist[i] != EMPTY && (min < 0 || dist[i] < min))
+    {
+      min = dist[i];
+    }
+  }
+  return min < 0 ? 0 : min;
+}
+
+template <typename K, typename V>
+int RobinHoodMap<K, V>::max_probe_distance() const
+{
+  int max = 0;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (dist[i] > max)
+    {
+      max = dist[i];
+    }
+  }
+  return max;
+}
+
+template <typename K, typename V>
+double RobinHoodMap<K, V>::avg_probe_distance() const
+{
+  double total = 0.0;
+  if (empty())
+  {
+    return 0.0;
+  }
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (dist[i] != EMPTY)
+    {
+      total += dist[i];
+    }
+  }
+  return total / count;
+}
+
+// the hash function (std::hash followed by a 64-bit finalizer, since
+// std::hash<int> is the identity and linear probing clusters on it)
+template <typename K, typename V>
+std::uint64_t RobinHoodMap<K, V>::hash(const K &key) const
+{
+  std::hash<K> hash_code;
+  return hash_fmix64(hash_code(key));
+}
+
+// returns the slot holding key or -1 if the key is not in the map
+template <typename K, typename V>
+int RobinHoodMap<K, V>::find(const K &key) const
+{
+  int mask = capacity - 1;
+  int index = static_cast<int>(hash(key) & mask);
+  short d = 0;
+
+  // a key can never sit past a slot that is closer to its own home
+  while (dist[index] >= d)
+  {
+    if (keys[index] == key)
+    {
+      return index;
+    }
+    index = (index + 1) & mask;
+    d++;
+  }
+  return -1;
+}
+
+// resize and rehash the table into the given number of slots
+template <typename K, typename V>
+void RobinHoodMap<K, V>::resize_and_rehash(int new_capacity)
+{
+  // old table
+  K *old_keys = keys;
+  V *old_values = values;
+  short *old_dist = dist;
+  int old_cap = capacity;
+
+  // resized table
+  capacity = new_capacity;
+  count = 0;
+  init_table();
+
+  for (int i = 0; i < old_cap; ++i)
+  {
+    if (old_dist[i] != EMPTY)
+    {
+      insert(old_keys[i], old_values[i]);
+    }
+  }
+
+  delete[] old_keys;
+  delete[] old_values;
+  delete[] old_dist;
+}
+
+// allocate the arrays for the current capacity with all slots empty
+template <typename K, typename V>
+void RobinHoodMap<K, V>::init_table()
+{
+  keys = new K[capacity];
+  values = new V[capacity];
+  dist = new short[capacity];
+  for (int i = 0; i < capacity; ++i)
+  {
+    dist[i] = EMPTY;
+  }
+}
+
+// release the arrays
+template <typename K, typename V>
+void RobinHoodMap<K, V>::free_table()
+{
+  delete[] keys;
+  delete[] values;
+  delete[] dist;
+  keys = nullptr;
+  values = nullptr;
+  dist = nullptr;
+}
+
+#endif
@@ -0,0 +1,202 @@
+//---------------------------------------------------------------------------
+// NAME: Joey Macauley
+// FILE: treeiterator.h
+// DATE: CPSC 223 - Spring 2022
+// DESC: In-order bidirectional iterator shared by the binary search
+//       tree maps (AVLMap and BSTMap). The iterator follows the nodes'
+//       parent links, so a step does not search from the root and a
+//       full walk costs O(n) (amortized O(1) per step) without
+//       allocating. Node must have key, value, left, right, and parent
+//       members. The end iterator holds no node; stepping back from it
+//       goes to the largest key, which is why the iterator keeps a
+//       pointer to the map's root.
+//---------------------------------------------------------------------------
+
+#ifndef TREEITERATOR_H
+#define TREEITERATOR_H
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+template <typename Node, typename K, typename V, bool Const>
+class TreeIterator
+{
+public:
+  // the mapped type handed out (values are read-only through a
+  // const iterator)
+  typedef typename std::conditional<Const, const V, V>::type mapped_type;
+
+  // what *it returns: the key and a reference to its value, so
+  //   for (auto [key, value] : m)
+  // works without copying either
+  typedef std::pair<const K &, mapped_type &> value_type;
+  typedef value_type reference;
+
+  // types for the standard algorithms (the iterator is bidirectional,
+  // but *it is a proxy pair with no address, so there is no pointer)
+  typedef std::bidirectional_iterator_tag iterator_category;
+  typedef std::ptrdiff_t difference_type;
+  typedef void pointer;
+
+  // an iterator at the node of the tree with the given root (nullptr
+  // for end)
+  TreeIterator(Node *const *tree_root = nullptr, Node *at = nullptr);
+
+  // a mutable iterator converts to a const one
+  template <bool C = Const, typename = typename std::enable_if<C>::type>
+  TreeIterator(const TreeIterator<Node, K, V, false> &rhs);
+
+  // The key and value at the iterator. Undefined at end.
+  const K &key() const;
+  mapped_type &value() const;
+  reference operator*() const;
+
+  // move to the next larger key (end after the largest key)
+  TreeIterator &operator++();
+  TreeIterator operator++(int);
+
+  // move to the next smaller key (the largest key from end)
+  TreeIterator &operator--();
+  TreeIterator operator--(int);
+
+  // true if both are at the same node (or both at end)
+  bool operator==(const TreeIterator &rhs) const;
+  bool operator!=(const TreeIterator &rhs) const;
+
+private:
+  template <typename, typename, typename, bool>
+  friend class TreeIterator;
+
+  // the map's root pointer, and the current node (nullptr at end)
+  Node *const *root;
+  Node *node;
+};
+
+// an iterator at the node of the tree with the given root
+template <typename Node, typename K, typename V, bool Const>
+TreeIterator<Node, K, V, Const>::TreeIterator(Node *const *tree_root, Node *at)
+  : root(tree_root), node(at)
+{
+}
+
+// a mutable iterator converts to a const one
+template <typename Node, typename K, typename V, bool Const>
+template <bool C, typename>
+TreeIterator<Node, K, V, Const>::TreeIterator(const TreeIterator<Node, K, V, false> &rhs)
+  : root(rhs.root), node(rhs.node)
+{
+}
+
+// the key at the iterator
+template <typename Node, typename K, typename V, bool Const>
+const K &TreeIterator<Node, K, V, Const>::key() const
+{
+  return node->key;
+}
+
+// the value at the iterator
+template <typename Node, typename K, typename V, bool Const>
+typename TreeIterator<Node, K, V, Const>::mapped_type &TreeIterator<Node, K, V, Const>::value() const
+{
+  return node->value;
+}
+
+// the key and value at the iterator
+template <typename Node, typename K, typename V, bool Const>
+typename TreeIterator<Node, K, V, Const>::reference TreeIterator<Node, K, V, Const>::operator*() const
+{
+  return reference(node->key, node->value);
+}
+
+// move to the next larger key: the smallest key of the right subtree,
+// or else the first ancestor reached from its left side
+template <typename Node, typename K, typename V, bool Const>
+TreeIterator<Node, K, V, Const> &TreeIterator<Node, K, V, Const>::operator++()
+{
+  if (node->right != nullptr)
+  {
+    node = node->right;
+    while (node->left != nullptr)
+    {
+      node = node->left;
+    }
+  }
+  else
+  {
+    Node *child = node;
+    node = node->parent;
+    while (node != nullptr && child == node->right)
+    {
+      child = node;
+      node = node->parent;
+    }
+  }
+  return *this;
+}
+
+template <typename Node, typename K, typename V, bool Const>
+TreeIterator<Node, K, V, Const> TreeIterator<Node, K, V, Const>::operator++(int)
+{
+  TreeIterator before = *this;
+  ++*this;
+  return before;
+}
+
+// move to the next smaller key: the mirror image of ++, except that
+// end steps back to the largest key
+template <typename Node, typename K, typename V, bool Const>
+TreeIterator<Node, K, V, Const> &TreeIterator<Node, K, V, Const>::operator--()
+{
+  if (node == nullptr)
+  {
+    node = *root;
+    while (node != nullptr && node->right != nullptr)
+    {
+      node = node->right;
+    }
+  }
+  else if (node->left != nullptr)
+  {
+    node = node->left;
+    while (node->right != nullptr)
+    {
+      node = node->right;
+    }
+  }
+  else
+  {
+    Node *child = node;
+    node = node->parent;
+    while (node != nullptr && child == node->left)
+    {
+      child = node;
+      node = node->parent;
+    }
+  }
+  return *this;
+}
+
+template <typename Node, typename K, typename V, bool Const>
+TreeIterator<Node, K, V, Const> TreeIterator<Node, K, V, Const>::operator--(int)
+{
+  TreeIterator before = *this;
+  --*this;
+  return before;
+}
+
+// true if both are at the same node (or both at end)
+template <typename Node, typename K, typename V, bool Const>
+bool TreeIterator<Node, K, V, Const>::operator==(const TreeIterator &rhs) const
+{
+  return node == rhs.node;
+}
+
+template <typename Node, typename K, typename V, bool Const>
+bool TreeIterator<Node, K, V, Const>::operator!=(const TreeIterator &rhs) const
+{
+  return node != rhs.node;
+}
+
+#endif
@@ -7,9 +7,58 @@
 //---------------------------------------------------------------------------
 
 #include <iostream>
+#include <cstdlib>
+#include <new>
 #include "util.h"
 
 
+// the calling thread's allocation counts (see count_allocations)
+static thread_local bool counting = false;
+static thread_local long allocations = 0;
+static thread_local long allocated_bytes = 0;
+
+// Global replacements that count while the calling thread's counting
+// is on. They live in this file rather than next to the benchmarks so
+// the compiler never sees malloc and free inlined against new and
+// delete expressions.
+void* operator new(std::size_t size)
+{
+  if (counting) {
+    allocations++;
+    allocated_bytes += size;
+  }
+  void* p = std::malloc(size ? size : 1);
+  if (p == nullptr)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void count_allocations(bool on)
+{
+  counting = on;
+}
+
+long thread_allocations()
+{
+  return allocations;
+}
+
+long thread_allocated_bytes()
+{
+  return allocated_bytes;
+}
+
+
 void faro_shuffle(Sequence<int>& seq, int shuffles)
 {
   int n = seq.size();
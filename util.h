@@ -105,4 +105,25 @@ void reset_reversed(Sequence<int>& s);
 //----------------------------------------------------------------------
 void reset_shuffled(Sequence<int>& s, int shuffles);
 
+
+//----------------------------------------------------------------------
+// Turn heap allocation counting on or off for the calling thread. The
+// counts are kept per thread (by the operator new in util.cpp), so
+// benchmarks that leave counting off, or run on other threads, pay
+// only a thread-local flag test per allocation and never share a
+// counter.
+//
+// Inputs:
+//   on -- true to count the calling thread's allocations
+//----------------------------------------------------------------------
+void count_allocations(bool on);
+
+
+//----------------------------------------------------------------------
+// The number of heap allocations, and the bytes they requested, made
+// by the calling thread while its counting was on.
+//----------------------------------------------------------------------
+long thread_allocations();
+long thread_allocated_bytes();
+
 #endif